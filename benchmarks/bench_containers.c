@@ -0,0 +1,65 @@
+// Copyright (c) 2020-2021, ellie/@ell1e & Horse64 Team (see AUTHORS.md),
+// also see LICENSE.md file.
+// SPDX-License-Identifier: BSD-2-Clause
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "valuecontentstruct.h"
+#include "vmlist.h"
+#include "vmmap.h"
+
+#include "benchmain.h"
+
+#define CONTAINER_SIZE 1024
+
+static void bench_vmmap_setget(int64_t iterations) {
+    // Set and look up int keys in a map that has left small map mode:
+    genericmap *m = vmmap_New();
+    assert(m != NULL);
+    int64_t i = 0;
+    while (i < iterations) {
+        valuecontent key = {0};
+        key.type = H64VALTYPE_INT64;
+        key.int_value = (i * 7) % CONTAINER_SIZE;
+        valuecontent value = {0};
+        value.type = H64VALTYPE_INT64;
+        value.int_value = i;
+        int result = vmmap_Set(NULL, m, &key, &value);
+        assert(result);
+        int oom = 0;
+        valuecontent got = {0};
+        key.int_value = (i * 13) % CONTAINER_SIZE;
+        if (vmmap_Get(NULL, m, &key, &got, &oom))
+            bench_sink += got.int_value;
+        i++;
+    }
+    vmmap_Free(NULL, m);
+}
+
+static void bench_vmlist_addget(int64_t iterations) {
+    // Append to a list, starting over once it is large:
+    genericlist *l = vmlist_New();
+    assert(l != NULL);
+    int64_t i = 0;
+    while (i < iterations) {
+        if (vmlist_Count(l) >= CONTAINER_SIZE) {
+            vmlist_Free(NULL, l);
+            l = vmlist_New();
+            assert(l != NULL);
+        }
+        valuecontent value = {0};
+        value.type = H64VALTYPE_INT64;
+        value.int_value = i;
+        int result = vmlist_Add(l, &value);
+        assert(result);
+        bench_sink += vmlist_Get(
+            l, 1 + (i % vmlist_Count(l))
+        )->int_value;
+        i++;
+    }
+    vmlist_Free(NULL, l);
+}
+
+BENCH_MAIN(BENCH(bench_vmmap_setget), BENCH(bench_vmlist_addget))
@@ -0,0 +1,70 @@
+// Copyright (c) 2020-2021, ellie/@ell1e & Horse64 Team (see AUTHORS.md),
+// also see LICENSE.md file.
+// SPDX-License-Identifier: BSD-2-Clause
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "itemsort.h"
+
+#include "benchmain.h"
+
+#define SORT_ITEMS 1000
+
+static int _compare_int64(void *item1, void *item2) {
+    int64_t i1 = *(int64_t *)item1;
+    int64_t i2 = *(int64_t *)item2;
+    return (i1 < i2 ? -1 : (i1 > i2 ? 1 : 0));
+}
+
+static void _fill_shuffled(int64_t *items, int64_t seed) {
+    // Simple LCG so every run sorts the same input:
+    uint64_t state = (uint64_t)seed * 2862933555777941757ULL + 3037000493ULL;
+    int i = 0;
+    while (i < SORT_ITEMS) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        items[i] = (int64_t)(state >> 33);
+        i++;
+    }
+}
+
+static void bench_itemsort_random1000(int64_t iterations) {
+    int64_t items[SORT_ITEMS];
+    int64_t i = 0;
+    while (i < iterations) {
+        _fill_shuffled(items, i % 16);
+        int oom = 0;
+        int result = itemsort_Do(
+            items, sizeof(items), sizeof(*items),
+            _compare_int64, &oom, NULL
+        );
+        assert(result);
+        bench_sink += items[0];
+        i++;
+    }
+}
+
+static void bench_itemsort_sorted1000(int64_t iterations) {
+    int64_t items[SORT_ITEMS];
+    int64_t i = 0;
+    while (i < iterations) {
+        int k = 0;
+        while (k < SORT_ITEMS) {
+            items[k] = k;
+            k++;
+        }
+        int oom = 0;
+        int result = itemsort_Do(
+            items, sizeof(items), sizeof(*items),
+            _compare_int64, &oom, NULL
+        );
+        assert(result);
+        bench_sink += items[0];
+        i++;
+    }
+}
+
+BENCH_MAIN(BENCH(bench_itemsort_random1000),
+           BENCH(bench_itemsort_sorted1000))
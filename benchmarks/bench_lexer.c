@@ -0,0 +1,67 @@
+// Copyright (c) 2020-2021, ellie/@ell1e & Horse64 Team (see AUTHORS.md),
+// also see LICENSE.md file.
+// SPDX-License-Identifier: BSD-2-Clause
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "compiler/lexer.h"
+#include "compiler/warningconfig.h"
+#include "mainpreinit.h"
+#include "uri32.h"
+#include "widechar.h"
+
+#include "benchmain.h"
+
+#define LEXER_SOURCE_FILE ".benchdata.h64"
+#define LEXER_SOURCE_REPEAT 200
+
+static void bench_lexer_parsefile(int64_t iterations) {
+    main_PreInit();
+
+    h64compilewarnconfig wconfig;
+    memset(&wconfig, 0, sizeof(wconfig));
+    warningconfig_Init(&wconfig);
+
+    FILE *f = fopen(LEXER_SOURCE_FILE, "wb");
+    assert(f != NULL);
+    int i = 0;
+    while (i < LEXER_SOURCE_REPEAT) {
+        fprintf(f,
+            "func fib_%d(n) {\n"
+            "    if n <= 1 {\n"
+            "        return n\n"
+            "    }\n"
+            "    # Some comment that the lexer has to skip.\n"
+            "    var s = \"some string literal with \\\"escapes\\\"\"\n"
+            "    return fib_%d(n - 1) + fib_%d(n - 2) * 0x1F - 1.5\n"
+            "}\n", i, i, i);
+        i++;
+    }
+    fclose(f);
+
+    int64_t urilen = 0;
+    h64wchar *uri = AS_U32(LEXER_SOURCE_FILE, &urilen);
+    assert(uri != NULL);
+    int64_t k = 0;
+    while (k < iterations) {
+        uri32info *uinfo = uri32_ParseExU8Protocol(
+            uri, urilen, "file", URI32_PARSEEX_FLAG_GUESSPORT
+        );
+        assert(uinfo != NULL);
+        h64tokenizedfile tfile = lexer_ParseFromFile(uinfo, &wconfig);
+        assert(tfile.resultmsg.success);
+        bench_sink += tfile.token_count;
+        lexer_FreeFileTokens(&tfile);
+        result_FreeContents(&tfile.resultmsg);
+        uri32_Free(uinfo);
+        k++;
+    }
+    free(uri);
+    remove(LEXER_SOURCE_FILE);
+}
+
+BENCH_MAIN(BENCH(bench_lexer_parsefile))
@@ -0,0 +1,52 @@
+// Copyright (c) 2020-2021, ellie/@ell1e & Horse64 Team (see AUTHORS.md),
+// also see LICENSE.md file.
+// SPDX-License-Identifier: BSD-2-Clause
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "poolalloc.h"
+
+#include "benchmain.h"
+
+#define CHURN_ITEMS 1024
+
+static void bench_poolalloc_allocfree(int64_t iterations) {
+    // Single allocation and free, as for short lived temporaries:
+    poolalloc *heap = poolalloc_New(64);
+    assert(heap != NULL);
+    int64_t i = 0;
+    while (i < iterations) {
+        void *p = poolalloc_malloc(heap, 0);
+        assert(p != NULL);
+        bench_sink += (intptr_t)p;
+        poolalloc_free(heap, p);
+        i++;
+    }
+    poolalloc_Destroy(heap);
+}
+
+static void bench_poolalloc_churn(int64_t iterations) {
+    // Fill up a batch, then free every other item and refill:
+    poolalloc *heap = poolalloc_New(64);
+    assert(heap != NULL);
+    void *items[CHURN_ITEMS] = {0};
+    int64_t i = 0;
+    while (i < iterations) {
+        int k = (int)(i % CHURN_ITEMS);
+        if (items[k]) {
+            poolalloc_free(heap, items[k]);
+            items[k] = NULL;
+        }
+        k = (int)((i * 2 + 1) % CHURN_ITEMS);
+        if (!items[k]) {
+            items[k] = poolalloc_malloc(heap, 0);
+            assert(items[k] != NULL);
+        }
+        i++;
+    }
+    poolalloc_Destroy(heap);
+}
+
+BENCH_MAIN(BENCH(bench_poolalloc_allocfree), BENCH(bench_poolalloc_churn))
@@ -0,0 +1,65 @@
+// Copyright (c) 2020-2021, ellie/@ell1e & Horse64 Team (see AUTHORS.md),
+// also see LICENSE.md file.
+// SPDX-License-Identifier: BSD-2-Clause
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "widechar.h"
+
+#include "benchmain.h"
+
+#define TEXT_REPEAT 64
+
+static char *_make_text(const char *part, int64_t *out_len) {
+    size_t partlen = strlen(part);
+    char *text = malloc(partlen * TEXT_REPEAT + 1);
+    assert(text != NULL);
+    int i = 0;
+    while (i < TEXT_REPEAT) {
+        memcpy(text + partlen * i, part, partlen);
+        i++;
+    }
+    text[partlen * TEXT_REPEAT] = '\0';
+    *out_len = partlen * TEXT_REPEAT;
+    return text;
+}
+
+static void _bench_roundtrip(const char *part, int64_t iterations) {
+    int64_t textlen = 0;
+    char *text = _make_text(part, &textlen);
+    char *back = malloc(textlen * 2 + 1);
+    assert(back != NULL);
+    int64_t i = 0;
+    while (i < iterations) {
+        int64_t u32len = 0;
+        h64wchar *u32 = utf8_to_utf32(
+            text, textlen, NULL, NULL, &u32len
+        );
+        assert(u32 != NULL);
+        int64_t backlen = 0;
+        int result = utf32_to_utf8(
+            u32, u32len, back, textlen * 2 + 1, &backlen, 1, 0
+        );
+        assert(result && backlen == textlen);
+        bench_sink += backlen;
+        free(u32);
+        i++;
+    }
+    free(back);
+    free(text);
+}
+
+static void bench_widechar_ascii(int64_t iterations) {
+    _bench_roundtrip("The quick brown fox jumps over the lazy dog. ",
+        iterations);
+}
+
+static void bench_widechar_mixed(int64_t iterations) {
+    _bench_roundtrip("Gr\xc3\xbc\xc3\x9f""e, \xe4\xb8\x96\xe7\x95\x8c "
+        "\xf0\x9f\x90\xb4 horse ", iterations);
+}
+
+BENCH_MAIN(BENCH(bench_widechar_ascii), BENCH(bench_widechar_mixed))
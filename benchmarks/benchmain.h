@@ -0,0 +1,133 @@
+// Copyright (c) 2020-2021, ellie/@ell1e & Horse64 Team (see AUTHORS.md),
+// also see LICENSE.md file.
+// SPDX-License-Identifier: BSD-2-Clause
+
+// Shared harness for the C micro benchmarks in this folder. Each
+// benchmark is a function that runs its workload the given number of
+// times. The harness doubles the count until a run takes long enough
+// to time reliably, then reports the median of several runs. Every
+// result line looks like this, which tools/run-benchmarks.py parses:
+//
+//     bench_name: 123.45 ns/op, 2.00 allocs/op (1048576 iterations)
+//
+// Allocations are counted by linking with -Wl,--wrap=malloc,... for
+// each allocation function horse64 uses (see the Makefile), so they
+// only include calls made from horse64's own code.
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_MIN_RUN_NS (100LL * 1000LL * 1000LL)
+#define BENCH_REPEAT 5
+
+typedef struct h64benchmark {
+    const char *name;
+    void (*func)(int64_t iterations);
+} h64benchmark;
+
+#define BENCH(f) {#f, f}
+
+static volatile int64_t _bench_allocs = 0;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size) {
+    _bench_allocs++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size) {
+    _bench_allocs++;
+    return __real_calloc(nmemb, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+    _bench_allocs++;
+    return __real_realloc(ptr, size);
+}
+
+// Used by poolalloc.c for its areas:
+#if defined(_WIN32) || defined(_WIN64)
+void *__real__aligned_malloc(size_t size, size_t alignment);
+
+void *__wrap__aligned_malloc(size_t size, size_t alignment) {
+    _bench_allocs++;
+    return __real__aligned_malloc(size, alignment);
+}
+#else
+int __real_posix_memalign(void **memptr, size_t alignment, size_t size);
+
+int __wrap_posix_memalign(void **memptr, size_t alignment, size_t size) {
+    _bench_allocs++;
+    return __real_posix_memalign(memptr, alignment, size);
+}
+#endif
+
+// Keeps the compiler from dropping a benchmark's result:
+static volatile int64_t bench_sink = 0;
+
+static int64_t _bench_NowNS() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + (int64_t)ts.tv_nsec;
+}
+
+static int _bench_CompareDouble(const void *a, const void *b) {
+    double d1 = *(const double *)a;
+    double d2 = *(const double *)b;
+    return (d1 < d2 ? -1 : (d1 > d2 ? 1 : 0));
+}
+
+static void _bench_Run(const h64benchmark *b, const char *filter) {
+    if (filter && !strstr(b->name, filter))
+        return;
+    // Find an iteration count that runs long enough:
+    int64_t iterations = 1;
+    while (1) {
+        int64_t start = _bench_NowNS();
+        b->func(iterations);
+        int64_t duration = _bench_NowNS() - start;
+        if (duration >= BENCH_MIN_RUN_NS ||
+                iterations >= (INT64_MAX / 4))
+            break;
+        iterations *= 2;
+    }
+    // Now time it for real:
+    double nsperop[BENCH_REPEAT];
+    int64_t allocs = 0;
+    int i = 0;
+    while (i < BENCH_REPEAT) {
+        int64_t allocs_before = _bench_allocs;
+        int64_t start = _bench_NowNS();
+        b->func(iterations);
+        int64_t duration = _bench_NowNS() - start;
+        allocs = _bench_allocs - allocs_before;
+        nsperop[i] = (double)duration / (double)iterations;
+        i++;
+    }
+    qsort(nsperop, BENCH_REPEAT, sizeof(*nsperop), _bench_CompareDouble);
+    printf("%s: %.2f ns/op, %.2f allocs/op (%" PRId64 " iterations)\n",
+        b->name, nsperop[BENCH_REPEAT / 2],
+        (double)allocs / (double)iterations, iterations);
+    fflush(stdout);
+}
+
+// Optional first argument: only run benchmarks with this in their name.
+#define BENCH_MAIN(...) \
+int main(int argc, char **argv) {\
+    static const h64benchmark benchmarks[] = {__VA_ARGS__};\
+    const char *filter = (argc > 1 ? argv[1] : NULL);\
+    size_t i = 0;\
+    while (i < sizeof(benchmarks) / sizeof(benchmarks[0])) {\
+        _bench_Run(&benchmarks[i], filter);\
+        i++;\
+    }\
+    return 0;\
+}
@@ -25,6 +25,7 @@
 #include "sockets.h"
 #include "threading.h"
 #include "vmexec.h"
+#include "vmstats.h"
 #include "widechar.h"
 
 
@@ -533,6 +534,8 @@ int asyncjob_RequestAsync(
     }
     jobs[jobs_count] = job;
     jobs_count++;
+    VMSTATS_INC(asyncjob_queued_count);
+    VMSTATS_MAX(asyncjob_queue_depth_max, jobs_count);
     if (async_worker_count < ASYNCSYSJOB_WORKER_COUNT) {
         if (!async_worker) {
             async_worker = malloc(
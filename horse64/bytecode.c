@@ -14,14 +14,18 @@
 #include "bytecode.h"
 #include "debugsymbols.h"
 #include "compiler/globallimits.h"
+#include "compiler/operator.h"
 #include "corelib/errors.h"
 #include "corelib/moduleless.h"
 #include "gcvalue.h"
 #include "hash.h"
 #include "nonlocale.h"
+#include "poolalloc.h"
 #include "uri32.h"
 #include "vmexec.h"
+#include "vmgc.h"
 #include "vmstrings.h"
+#include "vmvector.h"
 
 
 static char _name_itype_invalid[] = "invalid_instruction";
@@ -65,6 +69,30 @@ static char _name_itype_awaititem[] = "awaititem";
 static char _name_itype_hasattrjump[] = "hasattrjump";
 static char _name_itype_raise[] = "raise";
 static char _name_itype_raisebyref[] = "raisebyref";
+static char _name_itype_binopcondjump[] = "binopcondjump";
+static char _name_itype_setconstbinop[] = "setconstbinop";
+static char _name_itype_getattrcallsettop[] = "getattrcallsettop";
+static char _name_itype_addint[] = "addint";
+static char _name_itype_subint[] = "subint";
+static char _name_itype_mulint[] = "mulint";
+static char _name_itype_modint[] = "modint";
+static char _name_itype_eqint[] = "eqint";
+static char _name_itype_neint[] = "neint";
+static char _name_itype_ltint[] = "ltint";
+static char _name_itype_leint[] = "leint";
+static char _name_itype_gtint[] = "gtint";
+static char _name_itype_geint[] = "geint";
+static char _name_itype_addfloat[] = "addfloat";
+static char _name_itype_subfloat[] = "subfloat";
+static char _name_itype_mulfloat[] = "mulfloat";
+static char _name_itype_divfloat[] = "divfloat";
+static char _name_itype_ltfloat[] = "ltfloat";
+static char _name_itype_lefloat[] = "lefloat";
+static char _name_itype_gtfloat[] = "gtfloat";
+static char _name_itype_gefloat[] = "gefloat";
+static char _name_itype_getobjvarattr[] = "getobjvarattr";
+static char _name_itype_iteratelist[] = "iteratelist";
+static char _name_itype_callknownfunc[] = "callknownfunc";
 
 
 const char *bytecode_InstructionTypeToStr(instructiontype itype) {
@@ -151,6 +179,54 @@ const char *bytecode_InstructionTypeToStr(instructiontype itype) {
         return _name_itype_raise;
     case H64INST_RAISEBYREF:
         return _name_itype_raisebyref;
+    case H64INST_BINOPCONDJUMP:
+        return _name_itype_binopcondjump;
+    case H64INST_SETCONSTBINOP:
+        return _name_itype_setconstbinop;
+    case H64INST_GETATTRCALLSETTOP:
+        return _name_itype_getattrcallsettop;
+    case H64INST_ADDINT:
+        return _name_itype_addint;
+    case H64INST_SUBINT:
+        return _name_itype_subint;
+    case H64INST_MULINT:
+        return _name_itype_mulint;
+    case H64INST_MODINT:
+        return _name_itype_modint;
+    case H64INST_EQINT:
+        return _name_itype_eqint;
+    case H64INST_NEINT:
+        return _name_itype_neint;
+    case H64INST_LTINT:
+        return _name_itype_ltint;
+    case H64INST_LEINT:
+        return _name_itype_leint;
+    case H64INST_GTINT:
+        return _name_itype_gtint;
+    case H64INST_GEINT:
+        return _name_itype_geint;
+    case H64INST_ADDFLOAT:
+        return _name_itype_addfloat;
+    case H64INST_SUBFLOAT:
+        return _name_itype_subfloat;
+    case H64INST_MULFLOAT:
+        return _name_itype_mulfloat;
+    case H64INST_DIVFLOAT:
+        return _name_itype_divfloat;
+    case H64INST_LTFLOAT:
+        return _name_itype_ltfloat;
+    case H64INST_LEFLOAT:
+        return _name_itype_lefloat;
+    case H64INST_GTFLOAT:
+        return _name_itype_gtfloat;
+    case H64INST_GEFLOAT:
+        return _name_itype_gefloat;
+    case H64INST_GETOBJVARATTR:
+        return _name_itype_getobjvarattr;
+    case H64INST_ITERATELIST:
+        return _name_itype_iteratelist;
+    case H64INST_CALLKNOWNFUNC:
+        return _name_itype_callknownfunc;
     default:
         h64fprintf(stderr, "bytecode_InstructionTypeToStr: called "
                 "on invalid value %d\n", itype);
@@ -158,6 +234,37 @@ const char *bytecode_InstructionTypeToStr(instructiontype itype) {
     }
 }
 
+instructiontype bytecode_SpecializedBinopType(int optype, int valtype) {
+    if (valtype == H64VALTYPE_INT64) {
+        switch (optype) {
+        case H64OP_MATH_ADD: return H64INST_ADDINT;
+        case H64OP_MATH_SUBSTRACT: return H64INST_SUBINT;
+        case H64OP_MATH_MULTIPLY: return H64INST_MULINT;
+        case H64OP_MATH_MODULO: return H64INST_MODINT;
+        case H64OP_CMP_EQUAL: return H64INST_EQINT;
+        case H64OP_CMP_NOTEQUAL: return H64INST_NEINT;
+        case H64OP_CMP_SMALLER: return H64INST_LTINT;
+        case H64OP_CMP_SMALLEROREQUAL: return H64INST_LEINT;
+        case H64OP_CMP_LARGER: return H64INST_GTINT;
+        case H64OP_CMP_LARGEROREQUAL: return H64INST_GEINT;
+        default: return H64INST_BINOP;
+        }
+    } else if (valtype == H64VALTYPE_FLOAT64) {
+        switch (optype) {
+        case H64OP_MATH_ADD: return H64INST_ADDFLOAT;
+        case H64OP_MATH_SUBSTRACT: return H64INST_SUBFLOAT;
+        case H64OP_MATH_MULTIPLY: return H64INST_MULFLOAT;
+        case H64OP_MATH_DIVIDE: return H64INST_DIVFLOAT;
+        case H64OP_CMP_SMALLER: return H64INST_LTFLOAT;
+        case H64OP_CMP_SMALLEROREQUAL: return H64INST_LEFLOAT;
+        case H64OP_CMP_LARGER: return H64INST_GTFLOAT;
+        case H64OP_CMP_LARGEROREQUAL: return H64INST_GEFLOAT;
+        default: return H64INST_BINOP;
+        }
+    }
+    return H64INST_BINOP;
+}
+
 h64program *h64program_New() {
     h64program *p = malloc(sizeof(*p));
     if (!p)
@@ -458,6 +565,42 @@ attridx_t h64program_LookupClassAttribute(
     return -1;
 }
 
+int h64program_AllocAttributeCaches(h64program *p) {
+    assert(p->attrcache == NULL);
+    if (p->attrcache_count <= 0)
+        return 1;
+    p->attrcache = calloc(p->attrcache_count, sizeof(*p->attrcache));
+    if (!p->attrcache)
+        return 0;
+    return 1;
+}
+
+int32_t h64program_AddKwargPermutation(
+        h64program *p, funcid_t func_id,
+        int kwarg_count, const int32_t *target_index
+        ) {
+    assert(func_id >= 0 && func_id < p->func_count);
+    assert(kwarg_count > 0);
+    if (p->kwargperm_count + 2 + kwarg_count > INT32_MAX)
+        return 0;  // out of space, just don't use one
+    int32_t *newperm = realloc(
+        p->kwargperm, sizeof(*newperm) *
+        (p->kwargperm_count + 2 + kwarg_count)
+    );
+    if (!newperm)
+        return -1;
+    p->kwargperm = newperm;
+    int32_t offset = p->kwargperm_count;
+    p->kwargperm[offset] = func_id;
+    p->kwargperm[offset + 1] = kwarg_count;
+    memcpy(
+        &p->kwargperm[offset + 2], target_index,
+        sizeof(*target_index) * kwarg_count
+    );
+    p->kwargperm_count += 2 + kwarg_count;
+    return offset + 1;
+}
+
 attridx_t h64program_LookupClassAttributeByName(
         h64program *p, classid_t class_id, const char *name
         ) {
@@ -479,6 +622,10 @@ void h64program_PrintBytecodeStats(h64program *p) {
            _prefix, (int64_t)p->globalvar_count);
     h64printf("%s bytecode class count: %" PRId64 "\n",
            _prefix, (int64_t)p->classes_count);
+    int64_t total_bytes = 0;
+    int64_t total_unoptimized_bytes = 0;
+    int64_t total_stack = 0;
+    int64_t total_unoptimized_stack = 0;
     {
         funcid_t i = 0;
         while (i < p->func_count) {
@@ -501,12 +648,32 @@ void h64program_PrintBytecodeStats(h64program *p) {
                     " (CLASS: %d)", p->func[i].associated_class_index
                 );
             }
-            char instructioninfo[64] = "";
-            if (!p->func[i].iscfunc && p->func[i].instructions_bytes > 0) {
+            char instructioninfo[128] = "";
+            if (!p->func[i].iscfunc && p->func[i].instructions_bytes > 0 &&
+                    p->func[i].unoptimized_instructions_bytes > 0) {
+                h64snprintf(instructioninfo, sizeof(instructioninfo),
+                    " code: %" PRId64 "B (unoptimized: %" PRId64 "B)"
+                    " stack: %d (unoptimized: %d)",
+                    (int64_t)p->func[i].instructions_bytes,
+                    (int64_t)p->func[i].unoptimized_instructions_bytes,
+                    p->func[i].inner_stack_size,
+                    p->func[i].unoptimized_inner_stack_size);
+            } else if (!p->func[i].iscfunc &&
+                    p->func[i].instructions_bytes > 0) {
                 h64snprintf(instructioninfo, sizeof(instructioninfo),
                     " code: %" PRId64 "B",
                     (int64_t)p->func[i].instructions_bytes);
             }
+            if (!p->func[i].iscfunc) {
+                total_bytes += p->func[i].instructions_bytes;
+                total_unoptimized_bytes += (
+                    p->func[i].unoptimized_instructions_bytes
+                );
+                total_stack += p->func[i].inner_stack_size;
+                total_unoptimized_stack += (
+                    p->func[i].unoptimized_inner_stack_size
+                );
+            }
             h64printf(
                 "%s bytecode func id=%" PRId64 " "
                 "name: \"%s\" cfunction: %d%s%s%s\n",
@@ -518,6 +685,12 @@ void h64program_PrintBytecodeStats(h64program *p) {
             i++;
         }
     }
+    h64printf("%s bytecode total code size: %" PRId64 "B "
+           "(unoptimized: %" PRId64 "B)\n",
+           _prefix, total_bytes, total_unoptimized_bytes);
+    h64printf("%s bytecode total inner stack slots: %" PRId64 " "
+           "(unoptimized: %" PRId64 ")\n",
+           _prefix, total_stack, total_unoptimized_stack);
     {
         classid_t i = 0;
         while (i < p->classes_count) {
@@ -557,31 +730,13 @@ HOTSPOT void valuecontent_Free_Do(
                 gcval->heapreferencecount > 0)) {
             return;
         }
-        if (gcval->type == H64GCVALUETYPE_OBJINSTANCE) {
-            if (unlikely(maxrecurse <= 0)) {
-                // Let the GC clean it up later.
-            }
-            const int64_t c = (
-                vmthread->vmexec_owner->program->classes[
-                    gcval->class_id
-                ].varattr_count
-            );
-            maxrecurse--;
-            int64_t i = 0;
-            while (i < c) {
-                DELREF_HEAP(&gcval->varattr[i]);
-                valuecontent_Free_Do(
-                    vmthread, &gcval->varattr[i],
-                    maxrecurse
-                );
-                i++;
-            }
-            free(gcval->varattr);
-            return;
-        } else if (gcval->type == H64GCVALUETYPE_STRING) {
-            vmstrings_Free(vmthread, &gcval->str_val);
+        if (unlikely(!vmthread) ||
+                !poolalloc_OwnsPtr(vmthread->heap, gcval))
             return;
-        }
+        vmgc_ReleaseValue(vmthread, gcval, maxrecurse);
+    } else if (content->type == H64VALTYPE_VECTOR) {
+        if (content->vector_values->refcount <= 0)
+            vmvector_Free(content->vector_values);
     }
 
 }
@@ -589,7 +744,9 @@ HOTSPOT void valuecontent_Free_Do(
 HOTSPOT void valuecontent_Free(
         h64vmthread *vmthread, valuecontent *content
         ) {
-    return valuecontent_Free_Do(vmthread, content, 10);
+    valuecontent_Free_Do(vmthread, content, VMGC_RELEASE_MAXRECURSE);
+    if (unlikely(vmthread && vmthread->releasequeue_count > 0))
+        vmgc_ReleaseQueued(vmthread);
 }
 
 void h64program_FreeInstructions(
@@ -602,7 +759,8 @@ void h64program_FreeInstructions(
         assert(p != NULL);
         size_t nextelement = h64program_PtrToInstructionSize(p);
         h64instructionany *inst = (h64instructionany*)p;
-        if (inst->type == H64INST_SETCONST) {
+        if (inst->type == H64INST_SETCONST ||
+                inst->type == H64INST_SETCONSTBINOP) {
             h64instruction_setconst *instsetconst = (void *)p;
             #pragma GCC diagnostic push
             #pragma GCC diagnostic ignored "-Waddress-of-packed-member"
@@ -703,6 +861,37 @@ size_t h64program_PtrToInstructionSize(char *ptr) {
         return sizeof(h64instruction_raise);
     case H64INST_RAISEBYREF:
         return sizeof(h64instruction_raisebyref);
+    case H64INST_BINOPCONDJUMP:
+        return sizeof(h64instruction_binop);
+    case H64INST_SETCONSTBINOP:
+        return sizeof(h64instruction_setconst);
+    case H64INST_GETATTRCALLSETTOP:
+        return sizeof(h64instruction_getattributebyname);
+    case H64INST_ADDINT:
+    case H64INST_SUBINT:
+    case H64INST_MULINT:
+    case H64INST_MODINT:
+    case H64INST_EQINT:
+    case H64INST_NEINT:
+    case H64INST_LTINT:
+    case H64INST_LEINT:
+    case H64INST_GTINT:
+    case H64INST_GEINT:
+    case H64INST_ADDFLOAT:
+    case H64INST_SUBFLOAT:
+    case H64INST_MULFLOAT:
+    case H64INST_DIVFLOAT:
+    case H64INST_LTFLOAT:
+    case H64INST_LEFLOAT:
+    case H64INST_GTFLOAT:
+    case H64INST_GEFLOAT:
+        return sizeof(h64instruction_binop);
+    case H64INST_GETOBJVARATTR:
+        return sizeof(h64instruction_getattributebyname);
+    case H64INST_ITERATELIST:
+        return sizeof(h64instruction_iterate);
+    case H64INST_CALLKNOWNFUNC:
+        return sizeof(h64instruction_call);
     default:
         h64fprintf(
             stderr, "Invalid inst type for "
@@ -760,6 +949,8 @@ void h64program_Free(h64program *p) {
                 );
             }
             free(p->func[i].kwargnameindexes);
+            free(p->func[i].decoded_instructions);
+            free(p->func[i].decoded_map);
             i++;
         }
     }
@@ -772,6 +963,8 @@ void h64program_Free(h64program *p) {
         i++;
     }
     free(p->globalvar);
+    free(p->attrcache);
+    free(p->kwargperm);
     if (p->container_indexes.func_count > 0) {
         free(p->container_indexes.func_idx);
         int i = 0;
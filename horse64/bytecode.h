@@ -75,9 +75,54 @@ typedef enum instructiontype {
     H64INST_HASATTRJUMP,
     H64INST_RAISE,
     H64INST_RAISEBYREF,
+    // Superinstructions, only produced by peephole_FuseInstructions().
+    // Each uses the struct of its first half, and the second half
+    // follows in full right after it:
+    H64INST_BINOPCONDJUMP,
+    H64INST_SETCONSTBINOP,
+    H64INST_GETATTRCALLSETTOP,
+    // Type specialized binops, produced by peephole_OptimizeFunc() and
+    // by the VM's quickening. Each uses h64instruction_binop with its
+    // original optype, so it can fall back to the regular binop if the
+    // operand types differ:
+    H64INST_ADDINT,
+    H64INST_SUBINT,
+    H64INST_MULINT,
+    H64INST_MODINT,
+    H64INST_EQINT,
+    H64INST_NEINT,
+    H64INST_LTINT,
+    H64INST_LEINT,
+    H64INST_GTINT,
+    H64INST_GEINT,
+    H64INST_ADDFLOAT,
+    H64INST_SUBFLOAT,
+    H64INST_MULFLOAT,
+    H64INST_DIVFLOAT,
+    H64INST_LTFLOAT,
+    H64INST_LEFLOAT,
+    H64INST_GTFLOAT,
+    H64INST_GEFLOAT,
+    // Quickened variants, never in compiled code. The VM rewrites its
+    // pre-decoded copy of an instruction to these at runtime once it
+    // kept seeing the same class, container or call target there.
+    // Each uses the struct of the instruction it replaces:
+    H64INST_GETOBJVARATTR,
+    H64INST_ITERATELIST,
+    H64INST_CALLKNOWNFUNC,
     H64INST_TOTAL_COUNT
 } instructiontype;
 
+#define IS_SPECIALIZED_BINOP(x) (\
+    (x) >= H64INST_ADDINT && (x) <= H64INST_GEFLOAT)
+#define IS_SPECIALIZED_INT_BINOP(x) (\
+    (x) >= H64INST_ADDINT && (x) <= H64INST_GEINT)
+
+instructiontype bytecode_SpecializedBinopType(int optype, int valtype);
+    // Returns the specialized binop for the given operator with both
+    // operands of the given H64VALTYPE_INT64 or H64VALTYPE_FLOAT64 type,
+    // or H64INST_BINOP if there is none.
+
 const char *bytecode_InstructionTypeToStr(instructiontype itype);
 
 typedef enum storagetype {
@@ -194,6 +239,7 @@ typedef struct h64instruction_call {
     int16_t returnto, slotcalledfrom;
     uint8_t flags;
     int16_t posargs, kwargs;
+    int32_t kwargperm;  // see h64program.kwargperm, 0 if none
 } _INSTPACKATTR h64instruction_call;
 
 typedef struct h64instruction_callignoreifnone {
@@ -201,6 +247,7 @@ typedef struct h64instruction_callignoreifnone {
     int16_t returnto, slotcalledfrom;
     uint8_t flags;
     int16_t posargs, kwargs;
+    int32_t kwargperm;  // see h64program.kwargperm, 0 if none
 } _INSTPACKATTR h64instruction_callignoreifnone;
 
 typedef struct h64instruction_settop {
@@ -291,6 +338,7 @@ typedef struct h64instruction_getattributebyname {
     int16_t slotto;
     int16_t objslotfrom;
     int64_t nameidx;
+    int32_t cacheidx;  // index into h64program.attrcache
 } _INSTPACKATTR h64instruction_getattributebyname;
 
 typedef struct h64instruction_getattributebyidx {
@@ -366,6 +414,17 @@ typedef struct h64instruction_raisebyref {
 #define H64CLASS_HASH_SIZE 32
 #define H64CLASS_METHOD_OFFSET (H64LIMIT_MAX_CLASS_VARATTRS)
 
+// Inline cache of the class attributes a lookup instruction resolved,
+// so that a hit costs only the class id check. Each entry is stored as
+// (class_id << 32) | (attr_index + 1) so that it can be read and written
+// atomically by parallel threads, and 0 marks a free entry. Once all
+// entries are used up the lookup is megamorphic and nothing is replaced.
+#define H64ATTRCACHE_WAYS 4
+
+typedef struct h64attrcache {
+    _Atomic volatile uint64_t entry[H64ATTRCACHE_WAYS];
+} h64attrcache;
+
 typedef struct h64classattributeinfo {
     int64_t nameid;
     attridx_t methodorvaridx;  // vars have H64CLASS_METHOD_OFFSET offset
@@ -393,6 +452,12 @@ typedef struct h64class {
     funcid_t varinitfuncidx;
 } h64class;
 
+// Pairs up the offset of an instruction in h64func.instructions with
+// the offset of its pre-decoded form in h64func.decoded_instructions:
+typedef struct h64decodedoffset {
+    int64_t offset, decoded_offset;
+} h64decodedoffset;
+
 typedef struct h64func {
     int input_stack_size, inner_stack_size;
     int iscfunc, is_threadable, user_set_parallel;
@@ -404,6 +469,16 @@ typedef struct h64func {
 
     classid_t associated_class_index;
 
+    // Compile-time stats of the peephole pass, not serialized:
+    int unoptimized_instructions_bytes, unoptimized_inner_stack_size;
+
+    // Pre-decoded copy of the instructions the VM runs from, set up
+    // when the program starts (see vmexec_PredecodeProgram()):
+    char *decoded_instructions;
+    int64_t decoded_instructions_bytes;
+    int64_t decoded_map_count;
+    h64decodedoffset *decoded_map;
+
     union {
         struct {
             int instructions_bytes;
@@ -456,6 +531,16 @@ typedef struct h64program {
     globalvarid_t globalvar_count;
     h64globalvar *globalvar;
 
+    // Only the count is serialized, the caches start out empty:
+    int64_t attrcache_count;
+    h64attrcache *attrcache;
+
+    // Keyword argument order precomputed for calls to a known function.
+    // Each entry is [func_id, kwarg count, callee kwarg index for each
+    // passed keyword argument...], and a call refers to one by offset + 1:
+    int64_t kwargperm_count;
+    int32_t *kwargperm;
+
     h64debugsymbols *symbols;
 } h64program;
 
@@ -489,6 +574,11 @@ HOTSPOT void valuecontent_Free(
     h64vmthread *vmthread, valuecontent *content
 );
 
+HOTSPOT void valuecontent_Free_Do(
+    h64vmthread *vmthread, valuecontent *content,
+    int maxrecurse
+);
+
 void h64program_FreeInstructions(
     char *instructionbytes, int instructionbytes_len
 );
@@ -497,6 +587,13 @@ attridx_t h64program_LookupClassAttribute(
     h64program *p, classid_t class_id, int64_t nameid
 );
 
+int h64program_AllocAttributeCaches(h64program *p);
+
+int32_t h64program_AddKwargPermutation(
+    h64program *p, funcid_t func_id,
+    int kwarg_count, const int32_t *target_index
+);
+
 attridx_t h64program_LookupClassAttributeByName(
     h64program *p, classid_t class_id, const char *name
 );
@@ -577,6 +674,8 @@ ATTR_UNUSED static inline void DELREF_NONHEAP(valuecontent *content) {
     } else if (content->type == H64VALTYPE_ERROR) {
         if (content->einfo)
             content->einfo->refcount--;
+    } else if (content->type == H64VALTYPE_VECTOR) {
+        content->vector_values->refcount--;
     }
 }
 
@@ -588,6 +687,8 @@ ATTR_UNUSED static inline void ADDREF_NONHEAP(valuecontent *content) {
     } else if (content->type == H64VALTYPE_ERROR) {
         if (content->einfo)
             content->einfo->refcount++;
+    } else if (content->type == H64VALTYPE_VECTOR) {
+        content->vector_values->refcount++;
     }
 }
 
@@ -599,6 +700,8 @@ ATTR_UNUSED static inline void DELREF_HEAP(valuecontent *content) {
     } else if (content->type == H64VALTYPE_ERROR) {
         if (content->einfo)
             content->einfo->refcount--;
+    } else if (content->type == H64VALTYPE_VECTOR) {
+        content->vector_values->refcount--;
     }
 }
 
@@ -610,6 +713,8 @@ ATTR_UNUSED static inline void ADDREF_HEAP(valuecontent *content) {
     } else if (content->type == H64VALTYPE_ERROR) {
         if (content->einfo)
             content->einfo->refcount++;
+    } else if (content->type == H64VALTYPE_VECTOR) {
+        content->vector_values->refcount++;
     }
 }
 
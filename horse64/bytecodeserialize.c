@@ -182,6 +182,11 @@ int h64program_Dump(h64program *p, char **out, int64_t *out_len) {
     _DUMP(p->_io_file_class_idx);
     _DUMP(p->_net_stream_class_idx);
     _DUMP(p->_urilib_uri_class_idx);
+    _DUMP(p->attrcache_count);
+    _DUMP(p->kwargperm_count);
+    _DUMPSIZE(
+        p->kwargperm, sizeof(*p->kwargperm) * p->kwargperm_count
+    );
 
     _DUMP(p->globalvar_count);
     {
@@ -462,6 +467,17 @@ int h64program_Restore(
     _LOAD(p->_io_file_class_idx);
     _LOAD(p->_net_stream_class_idx);
     _LOAD(p->_urilib_uri_class_idx);
+    _LOAD(p->attrcache_count);
+    if (p->attrcache_count < 0 || !h64program_AllocAttributeCaches(p))
+        goto loadfail;
+    _LOAD(p->kwargperm_count);
+    if (p->kwargperm_count < 0 || p->kwargperm_count > INT32_MAX)
+        goto loadfail;
+    if (p->kwargperm_count > 0) {
+        _LOADSIZEALLOC(
+            p->kwargperm, sizeof(*p->kwargperm) * p->kwargperm_count
+        );
+    }
 
     _LOAD(p->globalvar_count);
     {
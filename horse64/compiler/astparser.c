@@ -2589,9 +2589,9 @@ int ast_ParseExprInline(
                     if (i < max_tokens_touse &&
                             tokens[i].type == H64TK_CONSTANT_INT &&
                             !vectorusesletters &&
-                            tokens[i].int_value >= 0 &&
+                            tokens[i].int_value >= 1 &&
                             tokens[i].int_value < INT32_MAX) {
-                        foundidx = tokens[i].int_value;
+                        foundidx = tokens[i].int_value - 1;
                     }
                     if (foundidx < 0 ||
                             foundidx != expr->constructorvector.entry_count
@@ -2599,7 +2599,8 @@ int ast_ParseExprInline(
                         char buf[512]; char describebuf[64];
                         char expect1dec[32];
                         snprintf(expect1dec, sizeof(expect1dec) - 1,
-                            "\"%d\"", expr->constructorvector.entry_count);
+                            "\"%d\"",
+                            expr->constructorvector.entry_count + 1);
                         char expect2dec[32] = {0};
                         if (vectorusesletters) {
                             if (expr->constructorvector.entry_count < 3)
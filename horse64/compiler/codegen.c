@@ -19,6 +19,7 @@
 #include "compiler/compileproject.h"
 #include "compiler/lexer.h"
 #include "compiler/main.h"
+#include "compiler/peephole.h"
 #include "compiler/varstorage.h"
 #include "corelib/errors.h"
 #include "hash.h"
@@ -553,6 +554,43 @@ static int _compare_kw_args(void *item1, void *item2) {
     return 0;
 }
 
+static int32_t _codegen_kwargpermutation(
+        h64program *pr, funcid_t func_id,
+        kwargsortinfo *kwinfo, int kwargcount
+        ) {
+    // Map each passed kw arg to the callee's kw arg slot. Both are
+    // sorted by name index, so one forward pass is enough. Returns 0
+    // if a name isn't known, to leave the runtime error to the VM.
+    h64func *f = &pr->func[func_id];
+    int32_t _map_buf[32];
+    int32_t *map = _map_buf;
+    if (kwargcount > 32) {
+        map = malloc(sizeof(*map) * kwargcount);
+        if (!map)
+            return -1;
+    }
+    int32_t result = 0;
+    int k = 0;
+    int i = 0;
+    while (i < kwargcount) {
+        while (k < f->kwarg_count &&
+                f->kwargnameindexes[k] != kwinfo[i].kwnameindex)
+            k++;
+        if (k >= f->kwarg_count)
+            goto done;
+        map[i] = k;
+        k++;
+        i++;
+    }
+    result = h64program_AddKwargPermutation(
+        pr, func_id, kwargcount, map
+    );
+    done:
+    if (map != _map_buf)
+        free(map);
+    return result;
+}
+
 static int _codegen_call_to(
         asttransforminfo *rinfo, h64expression *func,
         h64expression *callexpr,
@@ -797,6 +835,28 @@ static int _codegen_call_to(
         }
         i++;
     }
+    // If we know what func is called, precompute the kw args order:
+    int32_t kwargperm = 0;
+    if (kwargcount > 0 &&
+            callexpr->inlinecall.value->type ==
+                H64EXPRTYPE_IDENTIFIERREF &&
+            callexpr->inlinecall.value->storage.set &&
+            callexpr->inlinecall.value->storage.ref.type ==
+                H64STORETYPE_GLOBALFUNCSLOT) {
+        kwargperm = _codegen_kwargpermutation(
+            rinfo->pr->program,
+            callexpr->inlinecall.value->storage.ref.id,
+            &arg_kwsortinfo[
+                callexpr->inlinecall.arguments.arg_count - kwargcount
+            ], kwargcount
+        );
+        if (kwargperm < 0) {
+            rinfo->hadoutofmemory = 1;
+            if (alloc_heap)
+                free(arg_kwsortinfo);
+            return 0;
+        }
+    }
     if (alloc_heap)
         free(arg_kwsortinfo);
     arg_kwsortinfo = NULL;
@@ -820,6 +880,7 @@ static int _codegen_call_to(
         ) | (callexpr->inlinecall.is_async ? CALLFLAG_ASYNC : 0);
         inst_call.posargs = posargcount;
         inst_call.kwargs = kwargcount;
+        inst_call.kwargperm = kwargperm;
         if (!appendinst(
                 rinfo->pr->program, func, callexpr, &inst_call
                 )) {
@@ -833,6 +894,7 @@ static int _codegen_call_to(
         inst_call.slotcalledfrom = calledexprstoragetemp;
         inst_call.posargs = posargcount;
         inst_call.kwargs = kwargcount;
+        inst_call.kwargperm = kwargperm;
         inst_call.flags = 0 | (
             expandlastposarg ? CALLFLAG_UNPACKLASTPOSARG : 0
         ) | (callexpr->inlinecall.is_async ? CALLFLAG_ASYNC : 0);
@@ -879,6 +941,12 @@ int codegen_FinalBytecodeTransform(
         assert(pr->func[i].instructions != NULL ||
                pr->func[i].instructions_bytes == 0);
 
+        // Clean up the code while jump targets are still around:
+        if (!peephole_OptimizeFunc(pr, i)) {
+            free(jump_info);
+            return 0;
+        }
+
         // Remove jumptarget instructions while extracting offsets:
         int64_t k = 0;
         while (k < pr->func[i].instructions_bytes) {
@@ -1137,6 +1205,13 @@ int codegen_FinalBytecodeTransform(
             size_t instsize = (
                 h64program_PtrToInstructionSize((char*)inst)
             );
+            if (inst->type == H64INST_GETATTRIBUTEBYNAME) {
+                // Give each attribute lookup its own inline cache:
+                ((h64instruction_getattributebyname *)inst)->cacheidx = (
+                    pr->attrcache_count
+                );
+                pr->attrcache_count++;
+            }
             if (k + (int)instsize >= pr->func[i2].instructions_bytes &&
                     inst->type == H64INST_RETURNVALUE) {
                 func_ends_in_return = 1;
@@ -1160,11 +1235,18 @@ int codegen_FinalBytecodeTransform(
             if (!appendinstbyfuncid(pr, i2, NULL, &inst_return)) {
                 return 0;
             }
+            if (pr->func[i2].unoptimized_instructions_bytes > 0)
+                pr->func[i2].unoptimized_instructions_bytes += (
+                    sizeof(inst_setnone) + sizeof(inst_return)
+                );
         }
+        peephole_FuseInstructions(pr, i2);
 
         i2++;
     }
     free(jump_info);
+    if (!h64program_AllocAttributeCaches(pr))
+        return 0;
     return 1;
 }
 
@@ -1381,7 +1463,8 @@ int _codegencallback_DoCodegen_visit_out(
             expr->constructorvector.entry_count
         );
         int keytmp = -1;
-        if (ismap) {
+        if (!ismap && entry_count > 0) {
+            // For the vector entry index:
             keytmp = new1linetemp(
                 func, expr, 0
             );
@@ -1410,7 +1493,13 @@ int _codegencallback_DoCodegen_visit_out(
                 instsc.type = H64INST_SETCONST;
                 instsc.slot = key_slot;
                 instsc.content.type = H64VALTYPE_INT64;
-                instsc.content.int_value = i;
+                instsc.content.int_value = i + 1;
+                if (!appendinst(
+                        rinfo->pr->program, func, expr, &instsc
+                        )) {
+                    rinfo->hadoutofmemory = 1;
+                    return 0;
+                }
             }
             h64instruction_setbyindexexpr instbyindexexpr = {0};
             instbyindexexpr.type = H64INST_SETBYINDEXEXPR;
@@ -4392,8 +4481,19 @@ int _codegencallback_DoCodegen_visit_in(
         func->funcdef._storageinfo->jump_targets_used++;
 
         struct h64ifstmt *current_clause = &expr->ifstmt;
-        assert(current_clause->conditional != NULL);
         while (current_clause != NULL) {
+            if (current_clause->conditional != NULL &&
+                    current_clause->conditional->type ==
+                        H64EXPRTYPE_LITERAL &&
+                    current_clause->conditional->literal.type ==
+                        H64TK_CONSTANT_BOOL &&
+                    !current_clause->conditional->literal.int_value &&
+                    current_clause->stmt_count == 0 &&
+                    current_clause->followup_clause != NULL) {
+                // Emptied by the optimizer since it can never run:
+                current_clause = current_clause->followup_clause;
+                continue;
+            }
             int32_t jumpid_nextclause = -1;
             if (current_clause->followup_clause) {
                 jumpid_nextclause = (
@@ -264,7 +264,8 @@ int disassembler_PrintInstruction(
         dinfo *di, h64instructionany *inst, ptrdiff_t offset
         ) {
     switch (inst->type) {
-    case H64INST_SETCONST: {
+    case H64INST_SETCONST:
+    case H64INST_SETCONSTBINOP: {
         h64instruction_setconst *inst_setconst =
             (h64instruction_setconst*)inst;
         // Note: we manually align ->content to 8 bytes inside
@@ -388,7 +389,26 @@ int disassembler_PrintInstruction(
         }
         break;
     }
-    case H64INST_BINOP: {
+    case H64INST_BINOP:
+    case H64INST_BINOPCONDJUMP:
+    case H64INST_ADDINT:
+    case H64INST_SUBINT:
+    case H64INST_MULINT:
+    case H64INST_MODINT:
+    case H64INST_EQINT:
+    case H64INST_NEINT:
+    case H64INST_LTINT:
+    case H64INST_LEINT:
+    case H64INST_GTINT:
+    case H64INST_GEINT:
+    case H64INST_ADDFLOAT:
+    case H64INST_SUBFLOAT:
+    case H64INST_MULFLOAT:
+    case H64INST_DIVFLOAT:
+    case H64INST_LTFLOAT:
+    case H64INST_LEFLOAT:
+    case H64INST_GTFLOAT:
+    case H64INST_GEFLOAT: {
         h64instruction_binop *inst_binop =
             (h64instruction_binop *)inst;
         if (!disassembler_Write(di,
@@ -415,17 +435,19 @@ int disassembler_PrintInstruction(
         }
         break;
     }
-    case H64INST_CALL: {
+    case H64INST_CALL:
+    case H64INST_CALLKNOWNFUNC: {
         h64instruction_call *inst_call =
             (h64instruction_call *)inst;
         if (!disassembler_Write(di,
-                "    %s t%d t%d %d %d %d",
+                "    %s t%d t%d %d %d %d %d",
                 bytecode_InstructionTypeToStr(inst->type),
                 (int)inst_call->returnto,
                 (int)inst_call->slotcalledfrom,
                 (int)inst_call->posargs,
                 (int)inst_call->kwargs,
-                (int)inst_call->flags)) {
+                (int)inst_call->flags,
+                (int)inst_call->kwargperm)) {
             return 0;
         }
         break;
@@ -434,13 +456,14 @@ int disassembler_PrintInstruction(
         h64instruction_callignoreifnone *inst_calliin =
             (h64instruction_callignoreifnone *)inst;
         if (!disassembler_Write(di,
-                "    %s t%d t%d %d %d %d",
+                "    %s t%d t%d %d %d %d %d",
                 bytecode_InstructionTypeToStr(inst->type),
                 (int)inst_calliin->returnto,
                 (int)inst_calliin->slotcalledfrom,
                 (int)inst_calliin->posargs,
                 (int)inst_calliin->kwargs,
-                (int)inst_calliin->flags)) {
+                (int)inst_calliin->flags,
+                (int)inst_calliin->kwargperm)) {
             return 0;
         }
         break;
@@ -540,7 +563,8 @@ int disassembler_PrintInstruction(
         }
         break;
     }
-    case H64INST_ITERATE: {
+    case H64INST_ITERATE:
+    case H64INST_ITERATELIST: {
         h64instruction_iterate* inst_iterate =
             (h64instruction_iterate *)inst;
         if (!disassembler_Write(di,
@@ -554,7 +578,9 @@ int disassembler_PrintInstruction(
         }
         break;
     }
-    case H64INST_GETATTRIBUTEBYNAME: {
+    case H64INST_GETATTRIBUTEBYNAME:
+    case H64INST_GETATTRCALLSETTOP:
+    case H64INST_GETOBJVARATTR: {
         h64instruction_getattributebyname *inst_getattributebyname =
             (h64instruction_getattributebyname *)inst;
         if (!disassembler_Write(di,
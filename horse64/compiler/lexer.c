@@ -1220,7 +1220,7 @@ h64tokenizedfile lexer_ParseFromFile(
 
         // Arithmetic-style operators and -> dict assign:
         if (c == '+' || c == '%' || c == '|' || c == '&' ||
-                c == '^' || c == '.' ||
+                c == '^' || c == '~' || c == '.' ||
                 (c == '!' && i + 1 < (int)size && buffer[i + 1] == '=') ||
                 c == '/' || c == '<' || c == '>' || c == '*' ||
                 (c == '-' && (i + 1 >= (int)size ||
@@ -1265,8 +1265,8 @@ h64tokenizedfile lexer_ParseFromFile(
                 } else if (i + 1 < (int)size && buffer[i + 1] == '>') {
                     if (i + 2 < (int)size && buffer[i + 2] == '=') {
                         optype = H64OP_ASSIGNMATH_BINSHIFTRIGHT;
-                        i++;
-                        column++;
+                        i += 2;
+                        column += 2;
                     } else {
                         optype = H64OP_MATH_BINSHIFTRIGHT;
                         i++;
@@ -1284,8 +1284,8 @@ h64tokenizedfile lexer_ParseFromFile(
                 } else if (i + 1 < (int)size && buffer[i + 1] == '<') {
                     if (i + 2 < (int)size && buffer[i + 2] == '=') {
                         optype = H64OP_ASSIGNMATH_BINSHIFTLEFT;
-                        i++;
-                        column++;
+                        i += 2;
+                        column += 2;
                     } else {
                         optype = H64OP_MATH_BINSHIFTLEFT;
                         i++;
@@ -1351,6 +1351,15 @@ h64tokenizedfile lexer_ParseFromFile(
                     optype = H64OP_MATH_BINOR;
                 }
                 break;
+            case '&':
+                if (i + 1 < (int)size && buffer[i + 1] == '=') {
+                    optype = H64OP_ASSIGNMATH_BINAND;
+                    i++;
+                    column++;
+                } else {
+                    optype = H64OP_MATH_BINAND;
+                }
+                break;
             case '~':
                 if (i + 1 < (int)size && buffer[i + 1] == '=') {
                     optype = H64OP_ASSIGNMATH_BINNOT;
@@ -1358,6 +1367,7 @@ h64tokenizedfile lexer_ParseFromFile(
                     column++;
                 } else {
                     optype = H64OP_MATH_BINNOT;
+                    tokentype = H64TK_UNOPSYMBOL;
                 }
                 break;
             case '^':
@@ -173,6 +173,12 @@ static int _compileargparse(
             h64printf(    "  --compile-project-debug:  "
                 "Print compile project info\n");
             if (strcmp(cmd, "run") == 0 || strcmp(cmd, "exec") == 0) {
+                h64printf(
+                    "  --profile=<file>:        Sample where time is spent, "
+                    "write folded\n"
+                    "                           stacks to file and print "
+                    "a summary at exit\n"
+                );
                 h64printf(
                     "  --vmasyncjobs-debug:     Print async job "
                     "debug info\n"
@@ -181,6 +187,14 @@ static int _compileargparse(
                     "  --vmexec-debug:          Print instructions "
                     "as they run\n"
                 );
+                h64printf(
+                    "  --vmgc-stats:            Print cycle collector "
+                    "stats at exit\n"
+                );
+                h64printf(
+                    "  --vmstats=<file>:        Write VM execution "
+                    "counters as JSON at exit\n"
+                );
                 h64printf(
                     "  --vmsched-debug:         Print info about "
                     "horsevm scheduling\n"
@@ -302,6 +316,50 @@ static int _compileargparse(
                 "output for --vmexec-debug not compiled in\n", cmd
             );
             #endif
+        } else if ((strcmp(cmd, "run") == 0 ||
+                strcmp(cmd, "exec") == 0) &&
+                argvlen[i] >= (int64_t)strlen("--profile=") &&
+                h64cmp_u32u8(argv[i], strlen("--profile="),
+                    "--profile=") == 0) {
+            if (argvlen[i] == (int64_t)strlen("--profile=")) {
+                h64fprintf(stderr, "horsec: error: %s: "
+                    "--profile= needs file argument\n", cmd);
+                goto failquit;
+            }
+            miscoptions->profile_output = (
+                argv[i] + strlen("--profile=")
+            );
+            miscoptions->profile_output_len = (
+                argvlen[i] - (int64_t)strlen("--profile=")
+            );
+        } else if ((strcmp(cmd, "run") == 0 ||
+                strcmp(cmd, "exec") == 0) &&
+                argvlen[i] >= (int64_t)strlen("--vmstats=") &&
+                h64cmp_u32u8(argv[i], strlen("--vmstats="),
+                    "--vmstats=") == 0) {
+            if (argvlen[i] == (int64_t)strlen("--vmstats=")) {
+                h64fprintf(stderr, "horsec: error: %s: "
+                    "--vmstats= needs file argument\n", cmd);
+                goto failquit;
+            }
+            miscoptions->vmstats_output = (
+                argv[i] + strlen("--vmstats=")
+            );
+            miscoptions->vmstats_output_len = (
+                argvlen[i] - (int64_t)strlen("--vmstats=")
+            );
+            #if !defined(H64VM_STATS)
+            h64fprintf(
+                stderr, "horsec: warning: %s: compiled without "
+                "H64VM_STATS, counters for --vmstats not compiled in\n",
+                cmd
+            );
+            #endif
+        } else if ((strcmp(cmd, "run") == 0 ||
+                strcmp(cmd, "exec") == 0) &&
+                h64cmp_u32u8(argv[i], argvlen[i],
+                    "--vmgc-stats") == 0) {
+            miscoptions->vmgc_stats = 1;
         } else if ((strcmp(cmd, "run") == 0 ||
                 strcmp(cmd, "exec") == 0) &&
                 h64cmp_u32u8(argv[i], argvlen[i],
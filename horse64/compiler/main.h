@@ -70,7 +70,12 @@ typedef struct h64misccompileroptions {
     int vmscheduler_debug, vmscheduler_verbose_debug;
     int vmsockets_debug;
     int vmasyncjobs_debug;
+    int vmgc_stats;
     int compile_project_debug;
+    const h64wchar *profile_output;  // points into argv, NULL if unset
+    int64_t profile_output_len;
+    const h64wchar *vmstats_output;  // points into argv, NULL if unset
+    int64_t vmstats_output_len;
 } h64misccompileroptions;
 
 #endif  // HORSE64_COMPILER_MAIN_H_
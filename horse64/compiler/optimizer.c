@@ -2,25 +2,626 @@
 // also see LICENSE.md file.
 // SPDX-License-Identifier: BSD-2-Clause
 
+/// This module folds expressions that only depend on literals into a
+/// single literal, propagates the literal values of simple global
+/// constants into their uses, and drops if/elseif branches whose
+/// condition is a known "yes" or "no". It runs on a resolved AST before
+/// any local storage is assigned.
+///
+/// All folding must give exactly what the VM would compute at runtime,
+/// see vmexec_inst_unopbinop_INCLUDE.c. Anything that would raise an
+/// error at runtime (overflow, division by zero, wrong types) is left
+/// alone, so the error still happens when and where expected.
+
+#include "compileconfig.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include "compiler/ast.h"
 #include "compiler/astparser.h"
 #include "compiler/asttransform.h"
 #include "compiler/compileproject.h"
 #include "compiler/optimizer.h"
 
+#define OPTIMIZER_MAX_CONSTNESTING 16
+
+typedef struct optimizerinfo {
+    int constnesting;
+} optimizerinfo;
+
+int _resolvercallback_PreevaluateConstants_visit_out(
+    h64expression *expr, h64expression *parent, void *ud
+);
+
+static int _optimizer_IsLiteral(h64expression *expr, h64tokentype type) {
+    return (expr != NULL && expr->type == H64EXPRTYPE_LITERAL &&
+            expr->literal.type == type);
+}
+
+static int _optimizer_KnownBool(h64expression *expr, int *value) {
+    if (!_optimizer_IsLiteral(expr, H64TK_CONSTANT_BOOL))
+        return 0;
+    *value = (expr->literal.int_value != 0);
+    return 1;
+}
+
+static int _optimizer_FindDefinitionsVisit(
+        h64expression *expr, ATTR_UNUSED h64expression *parent, void *ud
+        ) {
+    if (expr->type == H64EXPRTYPE_FUNCDEF_STMT ||
+            expr->type == H64EXPRTYPE_INLINEFUNCDEF ||
+            expr->type == H64EXPRTYPE_CLASSDEF_STMT)
+        *((int *)ud) = 1;
+    return 1;
+}
+
+static int _optimizer_CanDrop(h64expression *expr) {
+    // Funcs and classes were already registered with the program, and
+    // own scopes others may point into, so they must stay around:
+    if (!expr)
+        return 1;
+    int found = 0;
+    int result = ast_VisitExpression(
+        expr, NULL, &_optimizer_FindDefinitionsVisit, NULL, NULL, &found
+    );
+    assert(result != 0);
+    return !found;
+}
+
+static int _optimizer_CanDropClause(struct h64ifstmt *clause) {
+    if (!_optimizer_CanDrop(clause->conditional))
+        return 0;
+    int i = 0;
+    while (i < clause->stmt_count) {
+        if (!_optimizer_CanDrop(clause->stmt[i]))
+            return 0;
+        i++;
+    }
+    return 1;
+}
+
+static void _optimizer_ClearClauseStatements(struct h64ifstmt *clause) {
+    int i = 0;
+    while (i < clause->stmt_count) {
+        ast_MarkExprDestroyed(clause->stmt[i]);
+        i++;
+    }
+    free(clause->stmt);
+    clause->stmt = NULL;
+    clause->stmt_count = 0;
+}
+
+static void _optimizer_FreeClause(struct h64ifstmt *clause) {
+    // For any clause but the first one, which is part of the statement.
+    ast_MarkExprDestroyed(clause->conditional);
+    clause->conditional = NULL;
+    _optimizer_ClearClauseStatements(clause);
+    scope_FreeData(&clause->scope);
+    free(clause);
+}
+
+static void _optimizer_TurnIntoLiteral(
+        h64expression *expr, h64tokentype type
+        ) {
+    // Any values needed from the old children must be copied out first.
+    if (expr->type == H64EXPRTYPE_BINARYOP ||
+            expr->type == H64EXPRTYPE_UNARYOP) {
+        ast_MarkExprDestroyed(expr->op.value1);
+        if (expr->type == H64EXPRTYPE_BINARYOP)
+            ast_MarkExprDestroyed(expr->op.value2);
+    } else if (expr->type == H64EXPRTYPE_GIVEN) {
+        ast_MarkExprDestroyed(expr->given.condition);
+        ast_MarkExprDestroyed(expr->given.valueyes);
+        ast_MarkExprDestroyed(expr->given.valueno);
+    } else {
+        assert(expr->type == H64EXPRTYPE_IDENTIFIERREF ||
+               expr->type == H64EXPRTYPE_LITERAL);
+    }
+    ast_FreeExprNonpoolMembers(expr);
+    expr->type = H64EXPRTYPE_LITERAL;
+    memset(&expr->storage, 0, sizeof(expr->storage));
+    memset(&expr->literal, 0, sizeof(expr->literal));
+    expr->literal.type = type;
+}
+
+static int _optimizer_CopyLiteral(
+        h64expression *expr, h64expression *literal
+        ) {
+    assert(literal->type == H64EXPRTYPE_LITERAL);
+    char *str_value = NULL;
+    if (literal->literal.type == H64TK_CONSTANT_STRING ||
+            literal->literal.type == H64TK_CONSTANT_BYTES) {
+        str_value = malloc(literal->literal.str_value_len + 1);
+        if (!str_value)
+            return 0;
+        memcpy(str_value, literal->literal.str_value,
+               literal->literal.str_value_len);
+        str_value[literal->literal.str_value_len] = '\0';
+    }
+    h64tokentype type = literal->literal.type;
+    int64_t int_value = literal->literal.int_value;
+    double float_value = literal->literal.float_value;
+    int str_value_len = literal->literal.str_value_len;
+    _optimizer_TurnIntoLiteral(expr, type);
+    if (type == H64TK_CONSTANT_FLOAT) {
+        expr->literal.float_value = float_value;
+    } else if (str_value) {
+        expr->literal.str_value = str_value;
+        expr->literal.str_value_len = str_value_len;
+    } else {
+        expr->literal.int_value = int_value;
+    }
+    return 1;
+}
+
+static int _optimizer_ReparentVisit(
+        h64expression *expr, h64expression *parent,
+        ATTR_UNUSED void *ud
+        ) {
+    if (parent)
+        expr->parent = parent;
+    return 1;
+}
+
+static void _optimizer_ReplaceWithChild(
+        h64expression *expr, h64expression *child
+        ) {
+    // Moves the child into the place of expr. The child must not contain
+    // any scopes, since those can't be moved in memory.
+    assert(_optimizer_CanDrop(child));
+    h64expression *parent = expr->parent;
+    memcpy(expr, child, sizeof(*expr));
+    expr->parent = parent;
+    child->destroyed = 1;  // members are owned by expr now
+    int result = ast_VisitExpression(
+        expr, parent, &_optimizer_ReparentVisit, NULL, NULL, NULL
+    );
+    assert(result != 0);
+}
+
+static int _optimizer_FoldIntBinop(
+        h64optype optype, int64_t v1, int64_t v2, h64expression *expr
+        ) {
+    int64_t result = 0;
+    switch (optype) {
+    case H64OP_MATH_ADD:
+        if (__builtin_add_overflow(v1, v2, &result))
+            return 0;
+        break;
+    case H64OP_MATH_SUBSTRACT:
+        if (__builtin_sub_overflow(v1, v2, &result))
+            return 0;
+        break;
+    case H64OP_MATH_MULTIPLY:
+        if (__builtin_mul_overflow(v1, v2, &result))
+            return 0;
+        break;
+    case H64OP_MATH_DIVIDE:
+        if (v2 == 0 || (v1 == INT64_MIN && v2 == -1))
+            return 0;
+        if (v1 % v2 != 0) {
+            // The VM goes through floats here:
+            double f = (double)v1 / (double)v2;
+            int64_t intval = f;
+            _optimizer_TurnIntoLiteral(expr, H64TK_CONSTANT_FLOAT);
+            expr->literal.float_value = f;
+            if ((double)intval == f) {
+                expr->literal.type = H64TK_CONSTANT_INT;
+                expr->literal.int_value = intval;
+            }
+            return 1;
+        }
+        result = v1 / v2;
+        break;
+    case H64OP_MATH_MODULO:
+        if (v2 == 0 || (v1 == INT64_MIN && v2 == -1))
+            return 0;
+        result = v1 % v2;
+        break;
+    case H64OP_MATH_BINAND:
+        result = v1 & v2;
+        break;
+    case H64OP_MATH_BINOR:
+        result = v1 | v2;
+        break;
+    case H64OP_MATH_BINXOR:
+        result = v1 ^ v2;
+        break;
+    case H64OP_MATH_BINSHIFTLEFT:
+        if (v2 < 0 || v2 >= 64)
+            return 0;  // the VM raises a ValueError
+        result = (int64_t)((uint64_t)v1 << v2);
+        break;
+    case H64OP_MATH_BINSHIFTRIGHT:
+        if (v2 < 0 || v2 >= 64)
+            return 0;
+        result = (v1 < 0 ? ~(~v1 >> v2) : (v1 >> v2));
+        break;
+    case H64OP_CMP_EQUAL:
+    case H64OP_CMP_NOTEQUAL:
+    case H64OP_CMP_LARGER:
+    case H64OP_CMP_SMALLER:
+    case H64OP_CMP_LARGEROREQUAL:
+    case H64OP_CMP_SMALLEROREQUAL: {
+        int b = 0;
+        if (optype == H64OP_CMP_EQUAL) b = (v1 == v2);
+        else if (optype == H64OP_CMP_NOTEQUAL) b = (v1 != v2);
+        else if (optype == H64OP_CMP_LARGER) b = (v1 > v2);
+        else if (optype == H64OP_CMP_SMALLER) b = (v1 < v2);
+        else if (optype == H64OP_CMP_LARGEROREQUAL) b = (v1 >= v2);
+        else b = (v1 <= v2);
+        _optimizer_TurnIntoLiteral(expr, H64TK_CONSTANT_BOOL);
+        expr->literal.int_value = b;
+        return 1;
+    }
+    default:
+        return 0;
+    }
+    _optimizer_TurnIntoLiteral(expr, H64TK_CONSTANT_INT);
+    expr->literal.int_value = result;
+    return 1;
+}
+
+static int _optimizer_FoldFloatBinop(
+        h64optype optype, double v1, double v2, int mixed,
+        h64expression *expr
+        ) {
+    double result = 0;
+    int backtoint = 0;
+    switch (optype) {
+    case H64OP_MATH_ADD:
+        // Mixed int/float add and substract have extra rounding rules
+        // in the VM, so these are left to runtime.
+        if (mixed)
+            return 0;
+        result = v1 + v2;
+        if (!isfinite(result) || result >= (double)INT64_MAX ||
+                result < (double)INT64_MIN)
+            return 0;
+        backtoint = 1;
+        break;
+    case H64OP_MATH_SUBSTRACT:
+        if (mixed)
+            return 0;
+        result = v1 - v2;
+        if (!isfinite(result) || result > (double)INT64_MAX ||
+                result < (double)INT64_MIN)
+            return 0;
+        break;
+    case H64OP_MATH_MULTIPLY:
+        result = v1 * v2;
+        if (!isfinite(result) || result > (double)INT64_MAX ||
+                result < (double)INT64_MIN)
+            return 0;
+        break;
+    case H64OP_MATH_DIVIDE:
+        if (v2 == 0)
+            return 0;
+        result = v1 / v2;
+        if (!isfinite(result) || result > (double)INT64_MAX ||
+                result < (double)INT64_MIN)
+            return 0;
+        backtoint = 1;
+        break;
+    case H64OP_CMP_LARGER:
+    case H64OP_CMP_SMALLER:
+    case H64OP_CMP_LARGEROREQUAL:
+    case H64OP_CMP_SMALLEROREQUAL: {
+        if (mixed)
+            return 0;
+        int b = 0;
+        if (optype == H64OP_CMP_LARGER) b = (v1 > v2);
+        else if (optype == H64OP_CMP_SMALLER) b = (v1 < v2);
+        else if (optype == H64OP_CMP_LARGEROREQUAL) b = (v1 >= v2);
+        else b = (v1 <= v2);
+        _optimizer_TurnIntoLiteral(expr, H64TK_CONSTANT_BOOL);
+        expr->literal.int_value = b;
+        return 1;
+    }
+    default:
+        return 0;
+    }
+    _optimizer_TurnIntoLiteral(expr, H64TK_CONSTANT_FLOAT);
+    expr->literal.float_value = result;
+    if (backtoint) {
+        int64_t intval = result;
+        if ((double)intval == result) {
+            expr->literal.type = H64TK_CONSTANT_INT;
+            expr->literal.int_value = intval;
+        }
+    }
+    return 1;
+}
+
+static int _optimizer_FoldBinop(
+        asttransforminfo *atinfo, h64expression *expr
+        ) {
+    h64expression *v1 = expr->op.value1;
+    h64expression *v2 = expr->op.value2;
+    h64optype optype = expr->op.optype;
+
+    // Boolean short-circuit only needs the left side to be known:
+    int b1, b2;
+    if ((optype == H64OP_BOOLCOND_AND || optype == H64OP_BOOLCOND_OR) &&
+            _optimizer_KnownBool(v1, &b1)) {
+        if ((optype == H64OP_BOOLCOND_AND && !b1) ||
+                (optype == H64OP_BOOLCOND_OR && b1)) {
+            if (!_optimizer_CanDrop(v2))
+                return 1;
+            _optimizer_TurnIntoLiteral(expr, H64TK_CONSTANT_BOOL);
+            expr->literal.int_value = b1;
+        } else if (_optimizer_KnownBool(v2, &b2)) {
+            _optimizer_TurnIntoLiteral(expr, H64TK_CONSTANT_BOOL);
+            expr->literal.int_value = b2;
+        }
+        return 1;
+    }
+
+    if (v1->type != H64EXPRTYPE_LITERAL ||
+            v2->type != H64EXPRTYPE_LITERAL)
+        return 1;
+    h64tokentype t1 = v1->literal.type;
+    h64tokentype t2 = v2->literal.type;
+    if (t1 == H64TK_CONSTANT_INT && t2 == H64TK_CONSTANT_INT) {
+        _optimizer_FoldIntBinop(
+            optype, v1->literal.int_value, v2->literal.int_value, expr
+        );
+        return 1;
+    }
+    if ((t1 == H64TK_CONSTANT_INT || t1 == H64TK_CONSTANT_FLOAT) &&
+            (t2 == H64TK_CONSTANT_INT || t2 == H64TK_CONSTANT_FLOAT)) {
+        if (optype == H64OP_MATH_MODULO)
+            return 1;  // float modulo has its own sign rules in the VM
+        if ((optype == H64OP_CMP_EQUAL ||
+                optype == H64OP_CMP_NOTEQUAL) && t1 != t2)
+            return 1;
+        if (optype == H64OP_CMP_EQUAL || optype == H64OP_CMP_NOTEQUAL) {
+            int b = (v1->literal.float_value == v2->literal.float_value);
+            _optimizer_TurnIntoLiteral(expr, H64TK_CONSTANT_BOOL);
+            expr->literal.int_value = (
+                optype == H64OP_CMP_EQUAL ? b : !b
+            );
+            return 1;
+        }
+        _optimizer_FoldFloatBinop(
+            optype,
+            (t1 == H64TK_CONSTANT_FLOAT ? v1->literal.float_value :
+             (double)v1->literal.int_value),
+            (t2 == H64TK_CONSTANT_FLOAT ? v2->literal.float_value :
+             (double)v2->literal.int_value),
+            (t1 != t2), expr
+        );
+        return 1;
+    }
+    if (t1 == H64TK_CONSTANT_STRING && t2 == H64TK_CONSTANT_STRING &&
+            optype == H64OP_MATH_ADD) {
+        int len1 = v1->literal.str_value_len;
+        int len2 = v2->literal.str_value_len;
+        char *s = malloc(len1 + len2 + 1);
+        if (!s) {
+            atinfo->hadoutofmemory = 1;
+            return 0;
+        }
+        memcpy(s, v1->literal.str_value, len1);
+        memcpy(s + len1, v2->literal.str_value, len2);
+        s[len1 + len2] = '\0';
+        _optimizer_TurnIntoLiteral(expr, H64TK_CONSTANT_STRING);
+        expr->literal.str_value = s;
+        expr->literal.str_value_len = len1 + len2;
+        return 1;
+    }
+    if (t1 == H64TK_CONSTANT_BYTES && t2 == H64TK_CONSTANT_BYTES &&
+            (optype == H64OP_MATH_BINAND || optype == H64OP_MATH_BINOR ||
+             optype == H64OP_MATH_BINXOR)) {
+        int len = v1->literal.str_value_len;
+        if (len != v2->literal.str_value_len)
+            return 1;  // the VM raises a ValueError
+        char *s = malloc(len + 1);
+        if (!s) {
+            atinfo->hadoutofmemory = 1;
+            return 0;
+        }
+        int i = 0;
+        while (i < len) {
+            if (optype == H64OP_MATH_BINAND)
+                s[i] = v1->literal.str_value[i] & v2->literal.str_value[i];
+            else if (optype == H64OP_MATH_BINOR)
+                s[i] = v1->literal.str_value[i] | v2->literal.str_value[i];
+            else
+                s[i] = v1->literal.str_value[i] ^ v2->literal.str_value[i];
+            i++;
+        }
+        s[len] = '\0';
+        _optimizer_TurnIntoLiteral(expr, H64TK_CONSTANT_BYTES);
+        expr->literal.str_value = s;
+        expr->literal.str_value_len = len;
+        return 1;
+    }
+    if (t1 == t2 && (optype == H64OP_CMP_EQUAL ||
+            optype == H64OP_CMP_NOTEQUAL) && (
+            t1 == H64TK_CONSTANT_BOOL || t1 == H64TK_CONSTANT_NONE ||
+            t1 == H64TK_CONSTANT_STRING || t1 == H64TK_CONSTANT_BYTES)) {
+        int b = 1;
+        if (t1 == H64TK_CONSTANT_BOOL) {
+            b = ((v1->literal.int_value != 0) ==
+                 (v2->literal.int_value != 0));
+        } else if (t1 != H64TK_CONSTANT_NONE) {
+            b = (v1->literal.str_value_len ==
+                    v2->literal.str_value_len &&
+                 memcmp(v1->literal.str_value, v2->literal.str_value,
+                        v1->literal.str_value_len) == 0);
+        }
+        _optimizer_TurnIntoLiteral(expr, H64TK_CONSTANT_BOOL);
+        expr->literal.int_value = (
+            optype == H64OP_CMP_EQUAL ? b : !b
+        );
+        return 1;
+    }
+    return 1;
+}
+
+static int _optimizer_FoldUnop(h64expression *expr) {
+    h64expression *v1 = expr->op.value1;
+    if (v1->type != H64EXPRTYPE_LITERAL)
+        return 1;
+    if (expr->op.optype == H64OP_BOOLCOND_NOT &&
+            v1->literal.type == H64TK_CONSTANT_BOOL) {
+        int b = (v1->literal.int_value == 0);
+        _optimizer_TurnIntoLiteral(expr, H64TK_CONSTANT_BOOL);
+        expr->literal.int_value = b;
+    } else if (expr->op.optype == H64OP_MATH_BINNOT &&
+            v1->literal.type == H64TK_CONSTANT_INT) {
+        int64_t value = ~v1->literal.int_value;
+        _optimizer_TurnIntoLiteral(expr, H64TK_CONSTANT_INT);
+        expr->literal.int_value = value;
+    } else if (expr->op.optype == H64OP_MATH_UNARYSUBSTRACT) {
+        if (v1->literal.type == H64TK_CONSTANT_INT &&
+                v1->literal.int_value != INT64_MIN) {
+            int64_t value = -v1->literal.int_value;
+            _optimizer_TurnIntoLiteral(expr, H64TK_CONSTANT_INT);
+            expr->literal.int_value = value;
+        } else if (v1->literal.type == H64TK_CONSTANT_FLOAT) {
+            double value = -v1->literal.float_value;
+            _optimizer_TurnIntoLiteral(expr, H64TK_CONSTANT_FLOAT);
+            expr->literal.float_value = value;
+        }
+    }
+    return 1;
+}
+
+static int _optimizer_PropagateConstant(
+        asttransforminfo *atinfo, h64expression *expr,
+        h64expression *parent
+        ) {
+    h64scopedef *def = expr->identifierref.resolved_to_def;
+    if (!def || !def->declarationexpr || !def->scope ||
+            !def->scope->is_global ||
+            def->declarationexpr->type != H64EXPRTYPE_VARDEF_STMT ||
+            !def->declarationexpr->vardef.is_const ||
+            def->declarationexpr->vardef.value == NULL)
+        return 1;
+    if (parent && parent->type == H64EXPRTYPE_ASSIGN_STMT &&
+            parent->assignstmt.lvalue == expr)
+        return 1;
+    h64expression *value = def->declarationexpr->vardef.value;
+    if (value->type != H64EXPRTYPE_LITERAL) {
+        // It may simply not have been visited yet, so try folding it:
+        optimizerinfo *oinfo = atinfo->userdata;
+        if (oinfo->constnesting >= OPTIMIZER_MAX_CONSTNESTING)
+            return 1;
+        oinfo->constnesting++;
+        int result = ast_VisitExpression(
+            value, def->declarationexpr, NULL,
+            &_resolvercallback_PreevaluateConstants_visit_out,
+            NULL, atinfo
+        );
+        oinfo->constnesting--;
+        if (!result)
+            return 0;
+        value = def->declarationexpr->vardef.value;
+        if (value->type != H64EXPRTYPE_LITERAL)
+            return 1;
+    }
+    if (!_optimizer_CopyLiteral(expr, value)) {
+        atinfo->hadoutofmemory = 1;
+        return 0;
+    }
+    return 1;
+}
+
+static void _optimizer_PruneIf(h64expression *expr) {
+    struct h64ifstmt *first = &expr->ifstmt;
+    struct h64ifstmt *prev = NULL;
+    struct h64ifstmt *clause = first;
+    while (clause) {
+        int known = 0;
+        int value = 0;
+        if (clause->conditional == NULL) {
+            known = 1;  // "else" clause
+            value = 1;
+        } else {
+            known = _optimizer_KnownBool(clause->conditional, &value);
+        }
+        if (known && value) {
+            // No need to check, and nothing after it can be reached:
+            ast_MarkExprDestroyed(clause->conditional);
+            clause->conditional = NULL;
+            while (clause->followup_clause &&
+                    _optimizer_CanDropClause(clause->followup_clause)) {
+                struct h64ifstmt *next = clause->followup_clause;
+                clause->followup_clause = next->followup_clause;
+                _optimizer_FreeClause(next);
+            }
+            break;
+        }
+        if (known && !value && _optimizer_CanDropClause(clause)) {
+            if (clause != first) {
+                assert(prev != NULL);
+                prev->followup_clause = clause->followup_clause;
+                _optimizer_FreeClause(clause);
+                clause = prev->followup_clause;
+                continue;
+            }
+            // The first clause is part of the statement itself, so just
+            // empty it. Codegen skips it based on the "no" conditional.
+            _optimizer_ClearClauseStatements(clause);
+        }
+        prev = clause;
+        clause = clause->followup_clause;
+    }
+}
+
 int _resolvercallback_PreevaluateConstants_visit_out(
         h64expression *expr, h64expression *parent, void *ud
         ) {
+    asttransforminfo *atinfo = (asttransforminfo *)ud;
+    if (expr->destroyed)
+        return 1;
+    if (expr->type == H64EXPRTYPE_IDENTIFIERREF) {
+        return _optimizer_PropagateConstant(atinfo, expr, parent);
+    } else if (expr->type == H64EXPRTYPE_BINARYOP &&
+            expr->op.value1 != NULL && expr->op.value2 != NULL) {
+        return _optimizer_FoldBinop(atinfo, expr);
+    } else if (expr->type == H64EXPRTYPE_UNARYOP &&
+            expr->op.value1 != NULL) {
+        return _optimizer_FoldUnop(expr);
+    } else if (expr->type == H64EXPRTYPE_GIVEN) {
+        int value = 0;
+        if (!_optimizer_KnownBool(expr->given.condition, &value))
+            return 1;
+        h64expression *keep = (
+            value ? expr->given.valueyes : expr->given.valueno
+        );
+        h64expression *drop = (
+            value ? expr->given.valueno : expr->given.valueyes
+        );
+        if (!keep || !_optimizer_CanDrop(keep) ||
+                !_optimizer_CanDrop(drop))
+            return 1;
+        ast_MarkExprDestroyed(expr->given.condition);
+        ast_MarkExprDestroyed(drop);
+        _optimizer_ReplaceWithChild(expr, keep);
+        return 1;
+    } else if (expr->type == H64EXPRTYPE_IF_STMT) {
+        _optimizer_PruneIf(expr);
+        return 1;
+    }
     return 1;
 }
 
 int optimizer_PreevaluateConstants(
         h64compileproject *pr, h64ast *ast
         ) {
+    optimizerinfo oinfo;
+    memset(&oinfo, 0, sizeof(oinfo));
     int result = asttransform_Apply(
         pr, ast, NULL,
         &_resolvercallback_PreevaluateConstants_visit_out,
-        NULL
+        &oinfo
     );
     if (!result)
         return 0;
@@ -0,0 +1,1286 @@
+// Copyright (c) 2020-2021, ellie/@ell1e & Horse64 Team (see AUTHORS.md),
+// also see LICENSE.md file.
+// SPDX-License-Identifier: BSD-2-Clause
+
+/// This module cleans up a func's final bytecode right before the jump
+/// targets are resolved to offsets: jumps to jumps are threaded, jumps
+/// to the next instruction and unreachable code are dropped, unused
+/// jump targets are stripped, and value copies through temporaries
+/// that are never used again are forwarded. Afterwards, the func's
+/// inner stack size is shrunk to the slots that are actually used.
+///
+/// Anything that moves values between slots needs liveness info, which
+/// can't be computed reliably in funcs that use rescue frames (since
+/// the VM can enter the rescue and finally code from anywhere), so
+/// those only get the jump clean-ups.
+///
+/// Then, binops get a type specialized variant if the operand types are
+/// known from constants and earlier math, or at least one of them is.
+/// The VM still checks the types for these, so guessing wrong is safe.
+///
+/// Once all jumps are resolved, common instruction pairs are marked as
+/// superinstructions by changing the type of their first half. Nothing
+/// moves, so jumps into the second half still find it intact, and the
+/// VM can fall back to the first half's regular handler at any time.
+
+#include "compileconfig.h"
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bytecode.h"
+#include "compiler/operator.h"
+#include "compiler/peephole.h"
+#include "debugsymbols.h"
+
+#define PEEPHOLE_MAX_ROUNDS 8
+#define PEEPHOLE_MAX_JUMPCHAIN 32
+#define PEEPHOLE_MAX_LIVENESSWORDS (1024 * 1024 * 4)
+#define PEEPHOLE_MAX_TYPEROUNDS 16
+#define PEEPHOLE_MAX_TYPESTATEBYTES (1024 * 1024 * 16)
+
+#define PEEPHOLE_FLAG_PURE 0x1  // no side effects and can't raise
+#define PEEPHOLE_FLAG_RETARGETABLE 0x2  // output slot may be changed
+#define PEEPHOLE_FLAG_NOFALLTHROUGH 0x4
+#define PEEPHOLE_FLAG_MAYWRITE 0x8  // output isn't written on every path
+#define PEEPHOLE_FLAG_CALL 0x10  // also reads args set up by callsettop
+#define PEEPHOLE_FLAG_RESCUE 0x20
+#define PEEPHOLE_FLAG_UNKNOWN 0x40
+
+// What is known about a slot's value type at some point in the code:
+#define PEEPHOLE_TYPE_UNVISITED 0  // no path got there yet
+#define PEEPHOLE_TYPE_UNKNOWN 1
+#define PEEPHOLE_TYPE_INT 2
+#define PEEPHOLE_TYPE_FLOAT 3
+#define PEEPHOLE_TYPE_BOOL 4
+
+typedef struct peepholeinstinfo {
+    int read_ofs[3];
+    int read_count;
+    int write_ofs;
+    int jump_ofs[2];
+    int jump_count;
+    int size_ofs;  // for callsettop/settop, -1 otherwise
+    int flags;
+} peepholeinstinfo;
+
+typedef struct peepholestate {
+    h64func *f;
+    int64_t inst_count;
+    int64_t *offset;
+    uint8_t *removed;
+    int32_t jumpid_count;
+    int64_t *label_index;
+    int32_t *label_refs;
+    int slot_count;
+    int64_t words;
+    uint64_t *live_in;
+    uint64_t *scratch;
+    int has_rescue;
+} peepholestate;
+
+#define _READ(s, field) \
+    info->read_ofs[info->read_count++] = (int)offsetof(s, field)
+#define _WRITE(s, field) \
+    info->write_ofs = (int)offsetof(s, field)
+#define _JUMP(s, field) \
+    info->jump_ofs[info->jump_count++] = (int)offsetof(s, field)
+
+static void _peephole_InstInfo(char *inst, peepholeinstinfo *info) {
+    memset(info, 0, sizeof(*info));
+    info->write_ofs = -1;
+    info->size_ofs = -1;
+    switch (((h64instructionany *)inst)->type) {
+    case H64INST_SETCONST:
+        _WRITE(h64instruction_setconst, slot);
+        info->flags = PEEPHOLE_FLAG_PURE | PEEPHOLE_FLAG_RETARGETABLE;
+        break;
+    case H64INST_SETGLOBAL:
+        _READ(h64instruction_setglobal, slotfrom);
+        break;
+    case H64INST_GETGLOBAL:
+        _WRITE(h64instruction_getglobal, slotto);
+        info->flags = PEEPHOLE_FLAG_RETARGETABLE;
+        break;
+    case H64INST_SETBYINDEXEXPR:
+        _READ(h64instruction_setbyindexexpr, slotobjto);
+        _READ(h64instruction_setbyindexexpr, slotindexto);
+        _READ(h64instruction_setbyindexexpr, slotvaluefrom);
+        break;
+    case H64INST_SETBYATTRIBUTENAME:
+        _READ(h64instruction_setbyattributename, slotobjto);
+        _READ(h64instruction_setbyattributename, slotvaluefrom);
+        break;
+    case H64INST_SETBYATTRIBUTEIDX:
+        _READ(h64instruction_setbyattributeidx, slotobjto);
+        _READ(h64instruction_setbyattributeidx, slotvaluefrom);
+        break;
+    case H64INST_GETFUNC:
+        _WRITE(h64instruction_getfunc, slotto);
+        info->flags = PEEPHOLE_FLAG_PURE | PEEPHOLE_FLAG_RETARGETABLE;
+        break;
+    case H64INST_GETCLASS:
+        _WRITE(h64instruction_getclass, slotto);
+        info->flags = PEEPHOLE_FLAG_PURE | PEEPHOLE_FLAG_RETARGETABLE;
+        break;
+    case H64INST_VALUECOPY:
+        _READ(h64instruction_valuecopy, slotfrom);
+        _WRITE(h64instruction_valuecopy, slotto);
+        info->flags = PEEPHOLE_FLAG_PURE | PEEPHOLE_FLAG_RETARGETABLE;
+        break;
+    case H64INST_BINOP:
+    case H64INST_ADDINT:
+    case H64INST_SUBINT:
+    case H64INST_MULINT:
+    case H64INST_MODINT:
+    case H64INST_EQINT:
+    case H64INST_NEINT:
+    case H64INST_LTINT:
+    case H64INST_LEINT:
+    case H64INST_GTINT:
+    case H64INST_GEINT:
+    case H64INST_ADDFLOAT:
+    case H64INST_SUBFLOAT:
+    case H64INST_MULFLOAT:
+    case H64INST_DIVFLOAT:
+    case H64INST_LTFLOAT:
+    case H64INST_LEFLOAT:
+    case H64INST_GTFLOAT:
+    case H64INST_GEFLOAT:
+        _READ(h64instruction_binop, arg1slotfrom);
+        _READ(h64instruction_binop, arg2slotfrom);
+        _WRITE(h64instruction_binop, slotto);
+        info->flags = PEEPHOLE_FLAG_RETARGETABLE;
+        break;
+    case H64INST_UNOP:
+        _READ(h64instruction_unop, argslotfrom);
+        _WRITE(h64instruction_unop, slotto);
+        info->flags = PEEPHOLE_FLAG_RETARGETABLE;
+        break;
+    case H64INST_CALL:
+        _READ(h64instruction_call, slotcalledfrom);
+        _WRITE(h64instruction_call, returnto);
+        info->flags = PEEPHOLE_FLAG_CALL;
+        break;
+    case H64INST_CALLIGNOREIFNONE:
+        _READ(h64instruction_callignoreifnone, slotcalledfrom);
+        _WRITE(h64instruction_callignoreifnone, returnto);
+        info->flags = PEEPHOLE_FLAG_CALL;
+        break;
+    case H64INST_SETTOP:
+        info->size_ofs = (int)offsetof(h64instruction_settop, topto);
+        break;
+    case H64INST_CALLSETTOP:
+        info->size_ofs = (int)offsetof(h64instruction_callsettop, topto);
+        break;
+    case H64INST_RETURNVALUE:
+        _READ(h64instruction_returnvalue, returnslotfrom);
+        info->flags = PEEPHOLE_FLAG_NOFALLTHROUGH;
+        break;
+    case H64INST_JUMPTARGET:
+        break;
+    case H64INST_CONDJUMP:
+        _READ(h64instruction_condjump, conditionalslot);
+        _JUMP(h64instruction_condjump, jumpbytesoffset);
+        break;
+    case H64INST_CONDJUMPEX:
+        _READ(h64instruction_condjumpex, conditionalslot);
+        _JUMP(h64instruction_condjumpex, jumpbytesoffset);
+        break;
+    case H64INST_JUMP:
+        _JUMP(h64instruction_jump, jumpbytesoffset);
+        info->flags = PEEPHOLE_FLAG_NOFALLTHROUGH;
+        break;
+    case H64INST_NEWITERATOR:
+        _READ(h64instruction_newiterator, slotcontainerfrom);
+        _WRITE(h64instruction_newiterator, slotiteratorto);
+        break;
+    case H64INST_ITERATE:
+        _READ(h64instruction_iterate, slotiteratorfrom);
+        _WRITE(h64instruction_iterate, slotvalueto);
+        _JUMP(h64instruction_iterate, jumponend);
+        info->flags = PEEPHOLE_FLAG_MAYWRITE;
+        break;
+    case H64INST_PUSHRESCUEFRAME: {
+        // The jump fields are only used depending on the mode:
+        h64instruction_pushrescueframe *pushframe = (
+            (h64instruction_pushrescueframe *)inst
+        );
+        if ((pushframe->mode & RESCUEMODE_JUMPONRESCUE) != 0)
+            _JUMP(h64instruction_pushrescueframe, jumponrescue);
+        if ((pushframe->mode & RESCUEMODE_JUMPONFINALLY) != 0)
+            _JUMP(h64instruction_pushrescueframe, jumponfinally);
+        if (pushframe->sloterrorto >= 0)
+            _WRITE(h64instruction_pushrescueframe, sloterrorto);
+        info->flags = PEEPHOLE_FLAG_RESCUE | PEEPHOLE_FLAG_MAYWRITE;
+        break;
+    }
+    case H64INST_ADDRESCUETYPEBYREF:
+        _READ(h64instruction_addrescuetypebyref, slotfrom);
+        info->flags = PEEPHOLE_FLAG_RESCUE;
+        break;
+    case H64INST_ADDRESCUETYPE:
+    case H64INST_POPRESCUEFRAME:
+    case H64INST_JUMPTOFINALLY:
+        info->flags = PEEPHOLE_FLAG_RESCUE;
+        break;
+    case H64INST_GETATTRIBUTEBYNAME:
+        _READ(h64instruction_getattributebyname, objslotfrom);
+        _WRITE(h64instruction_getattributebyname, slotto);
+        info->flags = PEEPHOLE_FLAG_RETARGETABLE;
+        break;
+    case H64INST_GETATTRIBUTEBYIDX:
+        _READ(h64instruction_getattributebyidx, objslotfrom);
+        _WRITE(h64instruction_getattributebyidx, slotto);
+        info->flags = PEEPHOLE_FLAG_RETARGETABLE;
+        break;
+    case H64INST_NEWLIST:
+        _WRITE(h64instruction_newlist, slotto);
+        info->flags = PEEPHOLE_FLAG_PURE | PEEPHOLE_FLAG_RETARGETABLE;
+        break;
+    case H64INST_NEWSET:
+        _WRITE(h64instruction_newset, slotto);
+        info->flags = PEEPHOLE_FLAG_PURE | PEEPHOLE_FLAG_RETARGETABLE;
+        break;
+    case H64INST_NEWMAP:
+        _WRITE(h64instruction_newmap, slotto);
+        info->flags = PEEPHOLE_FLAG_PURE | PEEPHOLE_FLAG_RETARGETABLE;
+        break;
+    case H64INST_NEWVECTOR:
+        _WRITE(h64instruction_newvector, slotto);
+        info->flags = PEEPHOLE_FLAG_PURE | PEEPHOLE_FLAG_RETARGETABLE;
+        break;
+    case H64INST_NEWINSTANCEBYREF:
+        _READ(h64instruction_newinstancebyref, classtypeslotfrom);
+        _WRITE(h64instruction_newinstancebyref, slotto);
+        break;
+    case H64INST_NEWINSTANCE:
+        _WRITE(h64instruction_newinstance, slotto);
+        break;
+    case H64INST_GETCONSTRUCTOR:
+        _READ(h64instruction_getconstructor, objslotfrom);
+        _WRITE(h64instruction_getconstructor, slotto);
+        break;
+    case H64INST_AWAITITEM:
+        _READ(h64instruction_awaititem, objslotawait);
+        break;
+    case H64INST_HASATTRJUMP:
+        _READ(h64instruction_hasattrjump, slotvaluecheck);
+        _JUMP(h64instruction_hasattrjump, jumpbytesoffset);
+        break;
+    case H64INST_RAISE:
+        _READ(h64instruction_raise, sloterrormsgobj);
+        info->flags = PEEPHOLE_FLAG_NOFALLTHROUGH;
+        break;
+    case H64INST_RAISEBYREF:
+        _READ(h64instruction_raisebyref, sloterrorclassrefobj);
+        _READ(h64instruction_raisebyref, sloterrormsgobj);
+        info->flags = PEEPHOLE_FLAG_NOFALLTHROUGH;
+        break;
+    default:
+        info->flags = PEEPHOLE_FLAG_UNKNOWN;
+        break;
+    }
+}
+
+#undef _READ
+#undef _WRITE
+#undef _JUMP
+
+static char *_peephole_Inst(peepholestate *st, int64_t i) {
+    return st->f->instructions + st->offset[i];
+}
+
+static int _peephole_Type(peepholestate *st, int64_t i) {
+    return ((h64instructionany *)_peephole_Inst(st, i))->type;
+}
+
+static int16_t _peephole_GetField(
+        peepholestate *st, int64_t i, int ofs
+        ) {
+    int16_t value;
+    memcpy(&value, _peephole_Inst(st, i) + ofs, sizeof(value));
+    return value;
+}
+
+static void _peephole_SetField(
+        peepholestate *st, int64_t i, int ofs, int16_t value
+        ) {
+    memcpy(_peephole_Inst(st, i) + ofs, &value, sizeof(value));
+}
+
+static int64_t _peephole_Next(peepholestate *st, int64_t i) {
+    i++;
+    while (i < st->inst_count && st->removed[i])
+        i++;
+    return (i < st->inst_count ? i : -1);
+}
+
+static int64_t _peephole_NextNonLabel(peepholestate *st, int64_t i) {
+    i = _peephole_Next(st, i);
+    while (i >= 0 && _peephole_Type(st, i) == H64INST_JUMPTARGET)
+        i = _peephole_Next(st, i);
+    return i;
+}
+
+static void _peephole_Remove(peepholestate *st, int64_t i) {
+    assert(!st->removed[i]);
+    if (_peephole_Type(st, i) == H64INST_SETCONST) {
+        h64instruction_setconst *instsetconst = (
+            (void *)_peephole_Inst(st, i)
+        );
+        #pragma GCC diagnostic push
+        #pragma GCC diagnostic ignored "-Waddress-of-packed-member"
+        // Silence gcc false positive, see h64program_FreeInstructions.
+        valuecontent_Free(NULL, &instsetconst->content);
+        #pragma GCC diagnostic pop
+        memset(&instsetconst->content, 0, sizeof(instsetconst->content));
+    }
+    st->removed[i] = 1;
+}
+
+static int _peephole_CountLabels(peepholestate *st) {
+    // Returns 0 if a jump refers to a target that doesn't exist.
+    memset(st->label_refs, 0, sizeof(*st->label_refs) * st->jumpid_count);
+    int32_t k = 0;
+    while (k < st->jumpid_count) {
+        st->label_index[k] = -1;
+        k++;
+    }
+    int64_t i = 0;
+    while (i < st->inst_count) {
+        if (!st->removed[i] &&
+                _peephole_Type(st, i) == H64INST_JUMPTARGET) {
+            h64instruction_jumptarget *jt = (
+                (h64instruction_jumptarget *)_peephole_Inst(st, i)
+            );
+            assert(jt->jumpid >= 0 && jt->jumpid < st->jumpid_count);
+            st->label_index[jt->jumpid] = i;
+        }
+        i++;
+    }
+    i = 0;
+    while (i < st->inst_count) {
+        if (st->removed[i]) {
+            i++;
+            continue;
+        }
+        peepholeinstinfo info;
+        _peephole_InstInfo(_peephole_Inst(st, i), &info);
+        int j = 0;
+        while (j < info.jump_count) {
+            int16_t jumpid = _peephole_GetField(st, i, info.jump_ofs[j]);
+            if (jumpid < 0 || jumpid >= st->jumpid_count ||
+                    st->label_index[jumpid] < 0)
+                return 0;
+            st->label_refs[jumpid]++;
+            j++;
+        }
+        i++;
+    }
+    return 1;
+}
+
+static int _peephole_ThreadJumps(peepholestate *st) {
+    int changed = 0;
+    int64_t i = 0;
+    while (i < st->inst_count) {
+        if (st->removed[i]) {
+            i++;
+            continue;
+        }
+        int type = _peephole_Type(st, i);
+        if (type != H64INST_JUMP && type != H64INST_CONDJUMP &&
+                type != H64INST_CONDJUMPEX &&
+                type != H64INST_HASATTRJUMP &&
+                type != H64INST_ITERATE) {
+            i++;
+            continue;
+        }
+        peepholeinstinfo info;
+        _peephole_InstInfo(_peephole_Inst(st, i), &info);
+        assert(info.jump_count == 1);
+        int16_t jumpid = _peephole_GetField(st, i, info.jump_ofs[0]);
+        int16_t newjumpid = jumpid;
+        int chain = 0;
+        while (chain < PEEPHOLE_MAX_JUMPCHAIN) {
+            int64_t target = _peephole_NextNonLabel(
+                st, st->label_index[newjumpid]
+            );
+            if (target < 0 || target == i ||
+                    _peephole_Type(st, target) != H64INST_JUMP)
+                break;
+            int16_t nextjumpid = _peephole_GetField(
+                st, target, (int)offsetof(
+                    h64instruction_jump, jumpbytesoffset
+                )
+            );
+            if (nextjumpid == newjumpid)
+                break;
+            newjumpid = nextjumpid;
+            chain++;
+        }
+        if (newjumpid != jumpid) {
+            _peephole_SetField(st, i, info.jump_ofs[0], newjumpid);
+            st->label_refs[jumpid]--;
+            st->label_refs[newjumpid]++;
+            changed = 1;
+        }
+        i++;
+    }
+    return changed;
+}
+
+static int _peephole_RemoveJumpsAndLabels(peepholestate *st) {
+    int changed = 0;
+    int64_t i = 0;
+    while (i < st->inst_count) {
+        if (st->removed[i]) {
+            i++;
+            continue;
+        }
+        int type = _peephole_Type(st, i);
+        if (type == H64INST_JUMPTARGET) {
+            h64instruction_jumptarget *jt = (
+                (h64instruction_jumptarget *)_peephole_Inst(st, i)
+            );
+            if (st->label_refs[jt->jumpid] == 0) {
+                _peephole_Remove(st, i);
+                st->label_index[jt->jumpid] = -1;
+                changed = 1;
+            }
+            i++;
+            continue;
+        }
+        if (type == H64INST_JUMP) {
+            // See if the target is right after us anyway:
+            int16_t jumpid = _peephole_GetField(
+                st, i, (int)offsetof(h64instruction_jump, jumpbytesoffset)
+            );
+            int64_t k = _peephole_Next(st, i);
+            while (k >= 0 && _peephole_Type(st, k) == H64INST_JUMPTARGET) {
+                if (k == st->label_index[jumpid]) {
+                    _peephole_Remove(st, i);
+                    st->label_refs[jumpid]--;
+                    changed = 1;
+                    break;
+                }
+                k = _peephole_Next(st, k);
+            }
+            if (st->removed[i]) {
+                i++;
+                continue;
+            }
+        }
+        if (!st->has_rescue) {
+            // Drop code that can't be reached, up to the next target:
+            peepholeinstinfo info;
+            _peephole_InstInfo(_peephole_Inst(st, i), &info);
+            if ((info.flags & PEEPHOLE_FLAG_NOFALLTHROUGH) != 0) {
+                int64_t k = _peephole_Next(st, i);
+                while (k >= 0) {
+                    if (_peephole_Type(st, k) == H64INST_JUMPTARGET) {
+                        h64instruction_jumptarget *jt = (
+                            (h64instruction_jumptarget *)
+                            _peephole_Inst(st, k)
+                        );
+                        if (st->label_refs[jt->jumpid] > 0)
+                            break;
+                        st->label_index[jt->jumpid] = -1;
+                    } else {
+                        peepholeinstinfo kinfo;
+                        _peephole_InstInfo(_peephole_Inst(st, k), &kinfo);
+                        int j = 0;
+                        while (j < kinfo.jump_count) {
+                            st->label_refs[_peephole_GetField(
+                                st, k, kinfo.jump_ofs[j]
+                            )]--;
+                            j++;
+                        }
+                    }
+                    _peephole_Remove(st, k);
+                    changed = 1;
+                    k = _peephole_Next(st, k);
+                }
+            }
+        }
+        i++;
+    }
+    return changed;
+}
+
+static int _peephole_CallArgs(
+        peepholestate *st, int64_t i, int *argsfrom, int *argsto
+        ) {
+    // Find the slots holding the call args, which were set up after the
+    // callsettop that codegen always emits right before.
+    int posargs, kwargs;
+    if (_peephole_Type(st, i) == H64INST_CALL) {
+        h64instruction_call *inst = (
+            (h64instruction_call *)_peephole_Inst(st, i)
+        );
+        posargs = inst->posargs;
+        kwargs = inst->kwargs;
+    } else {
+        h64instruction_callignoreifnone *inst = (
+            (h64instruction_callignoreifnone *)_peephole_Inst(st, i)
+        );
+        posargs = inst->posargs;
+        kwargs = inst->kwargs;
+    }
+    int64_t k = i - 1;
+    while (k >= 0) {
+        if (st->removed[k]) {
+            k--;
+            continue;
+        }
+        int type = _peephole_Type(st, k);
+        if (type == H64INST_CALLSETTOP) {
+            int topto = _peephole_GetField(st, k, (int)offsetof(
+                h64instruction_callsettop, topto
+            ));
+            *argsto = topto;
+            *argsfrom = topto - (posargs + kwargs * 2);
+            if (*argsfrom < 0)
+                *argsfrom = 0;
+            return 1;
+        }
+        peepholeinstinfo info;
+        _peephole_InstInfo(_peephole_Inst(st, k), &info);
+        if (type == H64INST_JUMPTARGET || info.jump_count > 0 ||
+                (info.flags & PEEPHOLE_FLAG_CALL) != 0)
+            break;
+        k--;
+    }
+    return 0;
+}
+
+static void _peephole_SetBit(uint64_t *set, int slot) {
+    set[slot / 64] |= ((uint64_t)1) << (slot % 64);
+}
+
+static void _peephole_ClearBit(uint64_t *set, int slot) {
+    set[slot / 64] &= ~(((uint64_t)1) << (slot % 64));
+}
+
+static int _peephole_GetBit(uint64_t *set, int slot) {
+    return (set[slot / 64] & (((uint64_t)1) << (slot % 64))) != 0;
+}
+
+static void _peephole_LiveOut(
+        peepholestate *st, int64_t i, uint64_t *out
+        ) {
+    memset(out, 0, sizeof(*out) * st->words);
+    peepholeinstinfo info;
+    _peephole_InstInfo(_peephole_Inst(st, i), &info);
+    int64_t succ[3];
+    int succ_count = 0;
+    if ((info.flags & PEEPHOLE_FLAG_NOFALLTHROUGH) == 0)
+        succ[succ_count++] = _peephole_Next(st, i);
+    int j = 0;
+    while (j < info.jump_count) {
+        succ[succ_count++] = st->label_index[
+            _peephole_GetField(st, i, info.jump_ofs[j])
+        ];
+        j++;
+    }
+    j = 0;
+    while (j < succ_count) {
+        if (succ[j] >= 0) {
+            uint64_t *in = &st->live_in[succ[j] * st->words];
+            int64_t w = 0;
+            while (w < st->words) {
+                out[w] |= in[w];
+                w++;
+            }
+        }
+        j++;
+    }
+}
+
+static void _peephole_LiveIn(
+        peepholestate *st, int64_t i, uint64_t *result
+        ) {
+    _peephole_LiveOut(st, i, result);
+    peepholeinstinfo info;
+    _peephole_InstInfo(_peephole_Inst(st, i), &info);
+    if (info.write_ofs >= 0 &&
+            (info.flags & PEEPHOLE_FLAG_MAYWRITE) == 0) {
+        int16_t slot = _peephole_GetField(st, i, info.write_ofs);
+        if (slot >= 0)
+            _peephole_ClearBit(result, slot);
+    }
+    int j = 0;
+    while (j < info.read_count) {
+        int16_t slot = _peephole_GetField(st, i, info.read_ofs[j]);
+        if (slot >= 0)
+            _peephole_SetBit(result, slot);
+        j++;
+    }
+    if ((info.flags & PEEPHOLE_FLAG_CALL) != 0) {
+        int argsfrom, argsto;
+        if (!_peephole_CallArgs(st, i, &argsfrom, &argsto)) {
+            argsfrom = 0;
+            argsto = st->slot_count;
+        }
+        while (argsfrom < argsto && argsfrom < st->slot_count) {
+            _peephole_SetBit(result, argsfrom);
+            argsfrom++;
+        }
+    }
+}
+
+static void _peephole_ComputeLiveness(peepholestate *st) {
+    memset(st->live_in, 0,
+           sizeof(*st->live_in) * st->words * st->inst_count);
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+        int64_t i = st->inst_count - 1;
+        while (i >= 0) {
+            if (st->removed[i]) {
+                i--;
+                continue;
+            }
+            _peephole_LiveIn(st, i, st->scratch);
+            uint64_t *in = &st->live_in[i * st->words];
+            if (memcmp(in, st->scratch,
+                       sizeof(*in) * st->words) != 0) {
+                memcpy(in, st->scratch, sizeof(*in) * st->words);
+                changed = 1;
+            }
+            i--;
+        }
+    }
+}
+
+static int _peephole_ReadsSlot(
+        peepholestate *st, int64_t i, peepholeinstinfo *info, int slot
+        ) {
+    int j = 0;
+    while (j < info->read_count) {
+        if (_peephole_GetField(st, i, info->read_ofs[j]) == slot)
+            return 1;
+        j++;
+    }
+    return 0;
+}
+
+static int _peephole_ForwardCopies(peepholestate *st) {
+    // Needs up-to-date liveness info. Every rewrite here only ever
+    // makes values live for shorter, so the info stays a safe guess
+    // for the rest of the scan.
+    int changed = 0;
+    int64_t i = 0;
+    while (i < st->inst_count) {
+        if (st->removed[i]) {
+            i++;
+            continue;
+        }
+        peepholeinstinfo info;
+        _peephole_InstInfo(_peephole_Inst(st, i), &info);
+        int16_t out = -1;
+        if (info.write_ofs >= 0)
+            out = _peephole_GetField(st, i, info.write_ofs);
+
+        // A copy to itself does nothing:
+        if (_peephole_Type(st, i) == H64INST_VALUECOPY &&
+                out == _peephole_GetField(st, i, info.read_ofs[0])) {
+            _peephole_Remove(st, i);
+            changed = 1;
+            i++;
+            continue;
+        }
+
+        // Drop values that are never used:
+        if ((info.flags & PEEPHOLE_FLAG_PURE) != 0 && out >= 0) {
+            _peephole_LiveOut(st, i, st->scratch);
+            if (!_peephole_GetBit(st->scratch, out)) {
+                _peephole_Remove(st, i);
+                changed = 1;
+                i++;
+                continue;
+            }
+        }
+
+        int64_t next = _peephole_Next(st, i);
+        if (next < 0)
+            break;
+        int nexttype = _peephole_Type(st, next);
+
+        // Write directly to the copy's target, e.g. for
+        //   binop t = a + b; valuecopy x = t
+        if ((info.flags & PEEPHOLE_FLAG_RETARGETABLE) != 0 &&
+                out >= 0 && nexttype == H64INST_VALUECOPY) {
+            h64instruction_valuecopy *vc = (
+                (h64instruction_valuecopy *)_peephole_Inst(st, next)
+            );
+            int16_t target = vc->slotto;
+            if (vc->slotfrom == out && target != out &&
+                    !_peephole_ReadsSlot(st, i, &info, target)) {
+                _peephole_LiveOut(st, next, st->scratch);
+                if (!_peephole_GetBit(st->scratch, out)) {
+                    _peephole_SetField(st, i, info.write_ofs, target);
+                    _peephole_Remove(st, next);
+                    changed = 1;
+                    i = next + 1;
+                    continue;
+                }
+            }
+        }
+
+        // Read from the copy's source instead, e.g. for
+        //   valuecopy t = x; condjump t
+        if (_peephole_Type(st, i) == H64INST_VALUECOPY &&
+                nexttype != H64INST_JUMPTARGET) {
+            int16_t source = _peephole_GetField(st, i, info.read_ofs[0]);
+            peepholeinstinfo nextinfo;
+            _peephole_InstInfo(_peephole_Inst(st, next), &nextinfo);
+            int16_t nextout = -1;
+            if (nextinfo.write_ofs >= 0)
+                nextout = _peephole_GetField(
+                    st, next, nextinfo.write_ofs
+                );
+            int ok = _peephole_ReadsSlot(st, next, &nextinfo, out);
+            if (ok && (nextinfo.flags & PEEPHOLE_FLAG_CALL) != 0) {
+                int argsfrom, argsto;
+                if (!_peephole_CallArgs(st, next, &argsfrom, &argsto) ||
+                        (out >= argsfrom && out < argsto))
+                    ok = 0;
+            }
+            if (ok && nextout == source &&
+                    nexttype != H64INST_BINOP &&
+                    nexttype != H64INST_UNOP &&
+                    nexttype != H64INST_VALUECOPY)
+                ok = 0;  // might not read before writing
+            if (ok && (nextout != out ||
+                    (nextinfo.flags & PEEPHOLE_FLAG_MAYWRITE) != 0)) {
+                _peephole_LiveOut(st, next, st->scratch);
+                if (_peephole_GetBit(st->scratch, out))
+                    ok = 0;
+            }
+            if (ok) {
+                int j = 0;
+                while (j < nextinfo.read_count) {
+                    if (_peephole_GetField(
+                            st, next, nextinfo.read_ofs[j]) == out)
+                        _peephole_SetField(
+                            st, next, nextinfo.read_ofs[j], source
+                        );
+                    j++;
+                }
+                // The source now lives until here, so keep the info
+                // for earlier instructions a safe guess:
+                uint64_t *previn = &st->live_in[i * st->words];
+                uint64_t *nextin = &st->live_in[next * st->words];
+                int64_t w = 0;
+                while (w < st->words) {
+                    nextin[w] |= previn[w];
+                    w++;
+                }
+                _peephole_Remove(st, i);
+                changed = 1;
+                i = next + 1;
+                continue;
+            }
+        }
+        i++;
+    }
+    return changed;
+}
+
+static uint8_t _peephole_MergeType(uint8_t t1, uint8_t t2) {
+    if (t1 == PEEPHOLE_TYPE_UNVISITED)
+        return t2;
+    if (t2 == PEEPHOLE_TYPE_UNVISITED || t1 == t2)
+        return t1;
+    return PEEPHOLE_TYPE_UNKNOWN;
+}
+
+static int _peephole_MergeTypes(
+        peepholestate *st, uint8_t *into, const uint8_t *from
+        ) {
+    int changed = 0;
+    int k = 0;
+    while (k < st->slot_count) {
+        uint8_t t = _peephole_MergeType(into[k], from[k]);
+        if (t != into[k]) {
+            into[k] = t;
+            changed = 1;
+        }
+        k++;
+    }
+    return changed;
+}
+
+static uint8_t _peephole_BinopResultType(
+        int optype, uint8_t t1, uint8_t t2
+        ) {
+    switch (optype) {
+    case H64OP_CMP_EQUAL:
+    case H64OP_CMP_NOTEQUAL:
+    case H64OP_CMP_LARGEROREQUAL:
+    case H64OP_CMP_SMALLEROREQUAL:
+    case H64OP_CMP_LARGER:
+    case H64OP_CMP_SMALLER:
+        return PEEPHOLE_TYPE_BOOL;
+    case H64OP_MATH_ADD:
+    case H64OP_MATH_SUBSTRACT:
+    case H64OP_MATH_MULTIPLY:
+        // (Overflows raise an error, so ints never turn into floats.)
+        if (t1 == PEEPHOLE_TYPE_INT && t2 == PEEPHOLE_TYPE_INT)
+            return PEEPHOLE_TYPE_INT;
+        // Float addition goes back to int if the result is integral,
+        // so only the other two are known to stay float:
+        if (t1 == PEEPHOLE_TYPE_FLOAT && t2 == PEEPHOLE_TYPE_FLOAT &&
+                optype != H64OP_MATH_ADD)
+            return PEEPHOLE_TYPE_FLOAT;
+        return PEEPHOLE_TYPE_UNKNOWN;
+    case H64OP_MATH_MODULO:
+        if (t1 == PEEPHOLE_TYPE_INT && t2 == PEEPHOLE_TYPE_INT)
+            return PEEPHOLE_TYPE_INT;
+        return PEEPHOLE_TYPE_UNKNOWN;
+    default:
+        return PEEPHOLE_TYPE_UNKNOWN;
+    }
+}
+
+static int _peephole_SpecializedBinopType(
+        int optype, uint8_t t1, uint8_t t2
+        ) {
+    // Specialize if both operands are known to fit, but also if just
+    // one is and the other is unknown. The VM checks the types anyway
+    // and falls back to the regular binop, so a wrong guess is safe:
+    if (t1 == PEEPHOLE_TYPE_UNVISITED)
+        t1 = PEEPHOLE_TYPE_UNKNOWN;
+    if (t2 == PEEPHOLE_TYPE_UNVISITED)
+        t2 = PEEPHOLE_TYPE_UNKNOWN;
+    if ((t1 == PEEPHOLE_TYPE_INT || t2 == PEEPHOLE_TYPE_INT) &&
+            (t1 == PEEPHOLE_TYPE_INT || t1 == PEEPHOLE_TYPE_UNKNOWN) &&
+            (t2 == PEEPHOLE_TYPE_INT || t2 == PEEPHOLE_TYPE_UNKNOWN))
+        return bytecode_SpecializedBinopType(optype, H64VALTYPE_INT64);
+    if ((t1 == PEEPHOLE_TYPE_FLOAT || t2 == PEEPHOLE_TYPE_FLOAT) &&
+            (t1 == PEEPHOLE_TYPE_FLOAT || t1 == PEEPHOLE_TYPE_UNKNOWN) &&
+            (t2 == PEEPHOLE_TYPE_FLOAT || t2 == PEEPHOLE_TYPE_UNKNOWN))
+        return bytecode_SpecializedBinopType(optype, H64VALTYPE_FLOAT64);
+    return H64INST_BINOP;
+}
+
+static void _peephole_ClearTypes(
+        peepholestate *st, uint8_t *types, int from
+        ) {
+    if (from < 0)
+        from = 0;
+    if (from < st->slot_count)
+        memset(types + from, PEEPHOLE_TYPE_UNKNOWN,
+               st->slot_count - from);
+}
+
+static void _peephole_TypeTransfer(
+        peepholestate *st, int64_t i, peepholeinstinfo *info,
+        uint8_t *types
+        ) {
+    char *inst = _peephole_Inst(st, i);
+    int type = _peephole_Type(st, i);
+    if (type == H64INST_SETCONST) {
+        h64instruction_setconst *sc = (h64instruction_setconst *)inst;
+        uint8_t t = PEEPHOLE_TYPE_UNKNOWN;
+        if (sc->content.type == H64VALTYPE_INT64)
+            t = PEEPHOLE_TYPE_INT;
+        else if (sc->content.type == H64VALTYPE_FLOAT64)
+            t = PEEPHOLE_TYPE_FLOAT;
+        else if (sc->content.type == H64VALTYPE_BOOL)
+            t = PEEPHOLE_TYPE_BOOL;
+        types[sc->slot] = t;
+        return;
+    } else if (type == H64INST_VALUECOPY) {
+        h64instruction_valuecopy *vc = (h64instruction_valuecopy *)inst;
+        types[vc->slotto] = types[vc->slotfrom];
+        return;
+    } else if (type == H64INST_BINOP || IS_SPECIALIZED_BINOP(type)) {
+        h64instruction_binop *binop = (h64instruction_binop *)inst;
+        types[binop->slotto] = _peephole_BinopResultType(
+            binop->optype, types[binop->arg1slotfrom],
+            types[binop->arg2slotfrom]
+        );
+        return;
+    }
+    if ((info->flags & PEEPHOLE_FLAG_CALL) != 0) {
+        int argsfrom, argsto;
+        if (!_peephole_CallArgs(st, i, &argsfrom, &argsto))
+            argsfrom = 0;
+        _peephole_ClearTypes(st, types, argsfrom);
+    }
+    if (info->size_ofs >= 0)
+        _peephole_ClearTypes(
+            st, types, _peephole_GetField(st, i, info->size_ofs)
+        );
+    if (info->write_ofs >= 0) {
+        int16_t slot = _peephole_GetField(st, i, info->write_ofs);
+        if (slot >= 0)
+            types[slot] = PEEPHOLE_TYPE_UNKNOWN;
+    }
+}
+
+static int _peephole_WalkTypes(
+        peepholestate *st, uint8_t *label_types, uint8_t *cur,
+        int blocklocal, int specialize
+        ) {
+    // Walks all code once, merging the known types into each jump
+    // target. Returns 1 if that changed any target's types, in which
+    // case another walk is needed. Code with rescue frames can enter
+    // its targets from anywhere, so there every target starts over
+    // without any known types.
+    int changed = 0;
+    memset(cur, PEEPHOLE_TYPE_UNKNOWN, st->slot_count);
+    int64_t i = 0;
+    while (i < st->inst_count) {
+        if (st->removed[i]) {
+            i++;
+            continue;
+        }
+        int type = _peephole_Type(st, i);
+        if (type == H64INST_JUMPTARGET) {
+            if (blocklocal) {
+                memset(cur, PEEPHOLE_TYPE_UNKNOWN, st->slot_count);
+            } else {
+                h64instruction_jumptarget *jt = (
+                    (h64instruction_jumptarget *)_peephole_Inst(st, i)
+                );
+                uint8_t *lt = &label_types[
+                    (int64_t)jt->jumpid * st->slot_count
+                ];
+                if (_peephole_MergeTypes(st, lt, cur))
+                    changed = 1;
+                memcpy(cur, lt, st->slot_count);
+            }
+            i++;
+            continue;
+        }
+        if (specialize && type == H64INST_BINOP) {
+            h64instruction_binop *binop = (
+                (h64instruction_binop *)_peephole_Inst(st, i)
+            );
+            binop->type = _peephole_SpecializedBinopType(
+                binop->optype, cur[binop->arg1slotfrom],
+                cur[binop->arg2slotfrom]
+            );
+        }
+        peepholeinstinfo info;
+        _peephole_InstInfo(_peephole_Inst(st, i), &info);
+        _peephole_TypeTransfer(st, i, &info, cur);
+        if (!blocklocal) {
+            int j = 0;
+            while (j < info.jump_count) {
+                int16_t jumpid = _peephole_GetField(
+                    st, i, info.jump_ofs[j]
+                );
+                if (_peephole_MergeTypes(
+                        st, &label_types[
+                            (int64_t)jumpid * st->slot_count
+                        ], cur))
+                    changed = 1;
+                j++;
+            }
+        }
+        if ((info.flags & PEEPHOLE_FLAG_NOFALLTHROUGH) != 0)
+            memset(cur, PEEPHOLE_TYPE_UNVISITED, st->slot_count);
+        i++;
+    }
+    return changed;
+}
+
+static int _peephole_SpecializeBinops(peepholestate *st) {
+    // Returns 0 on out of memory.
+    if (st->slot_count <= 0)
+        return 1;
+    int blocklocal = st->has_rescue;
+    if ((int64_t)st->jumpid_count * st->slot_count >
+            PEEPHOLE_MAX_TYPESTATEBYTES)
+        blocklocal = 1;
+    uint8_t *cur = malloc(st->slot_count);
+    uint8_t *label_types = NULL;
+    if (!blocklocal && st->jumpid_count > 0)
+        label_types = malloc((int64_t)st->jumpid_count * st->slot_count);
+    if (!cur || (!blocklocal && st->jumpid_count > 0 && !label_types)) {
+        free(cur);
+        free(label_types);
+        return 0;
+    }
+    if (label_types)
+        memset(label_types, PEEPHOLE_TYPE_UNVISITED,
+               (int64_t)st->jumpid_count * st->slot_count);
+    int converged = blocklocal;
+    int round = 0;
+    while (!converged && round < PEEPHOLE_MAX_TYPEROUNDS) {
+        if (!_peephole_WalkTypes(st, label_types, cur, blocklocal, 0))
+            converged = 1;
+        round++;
+    }
+    if (converged)
+        _peephole_WalkTypes(st, label_types, cur, blocklocal, 1);
+    free(cur);
+    free(label_types);
+    return 1;
+}
+
+static void _peephole_Compact(peepholestate *st) {
+    int64_t newbytes = 0;
+    int64_t i = 0;
+    while (i < st->inst_count) {
+        int64_t size = (
+            (i + 1 < st->inst_count ? st->offset[i + 1] :
+             st->f->instructions_bytes) - st->offset[i]
+        );
+        if (!st->removed[i]) {
+            if (newbytes != st->offset[i])
+                memmove(st->f->instructions + newbytes,
+                        st->f->instructions + st->offset[i], size);
+            newbytes += size;
+        }
+        i++;
+    }
+    st->f->instructions_bytes = newbytes;
+}
+
+static void _peephole_ShrinkStack(
+        h64program *pr, funcid_t func_id, h64func *f
+        ) {
+    int used = 0;
+    int64_t k = 0;
+    while (k < f->instructions_bytes) {
+        char *inst = f->instructions + k;
+        peepholeinstinfo info;
+        _peephole_InstInfo(inst, &info);
+        int16_t value;
+        int j = 0;
+        while (j < info.read_count) {
+            memcpy(&value, inst + info.read_ofs[j], sizeof(value));
+            if (value + 1 > used)
+                used = value + 1;
+            j++;
+        }
+        if (info.write_ofs >= 0) {
+            memcpy(&value, inst + info.write_ofs, sizeof(value));
+            if (value + 1 > used)
+                used = value + 1;
+        }
+        if (info.size_ofs >= 0) {
+            memcpy(&value, inst + info.size_ofs, sizeof(value));
+            if (value > used)
+                used = value;
+        }
+        k += (int64_t)h64program_PtrToInstructionSize(inst);
+    }
+    int inner = used - f->input_stack_size;
+    if (inner < 0)
+        inner = 0;
+    if (inner >= f->inner_stack_size)
+        return;
+    f->inner_stack_size = inner;
+    if (pr->symbols) {
+        h64funcsymbol *fsymbol = h64debugsymbols_GetFuncSymbolById(
+            pr->symbols, func_id
+        );
+        if (fsymbol)
+            fsymbol->stack_temporaries_count = inner;
+    }
+}
+
+int peephole_OptimizeFunc(h64program *pr, funcid_t func_id) {
+    assert(func_id >= 0 && func_id < pr->func_count);
+    h64func *f = &pr->func[func_id];
+    assert(!f->iscfunc);
+
+    peepholestate st;
+    memset(&st, 0, sizeof(st));
+    st.f = f;
+    int result = 0;
+
+    // Index all instructions, and see what we're dealing with:
+    int unknown = 0;
+    int64_t labelbytes = 0;
+    int64_t k = 0;
+    while (k < f->instructions_bytes) {
+        char *inst = f->instructions + k;
+        peepholeinstinfo info;
+        _peephole_InstInfo(inst, &info);
+        if ((info.flags & PEEPHOLE_FLAG_UNKNOWN) != 0) {
+            unknown = 1;
+            break;
+        }
+        if ((info.flags & PEEPHOLE_FLAG_RESCUE) != 0)
+            st.has_rescue = 1;
+        if (((h64instructionany *)inst)->type == H64INST_JUMPTARGET) {
+            int32_t jumpid = ((h64instruction_jumptarget *)inst)->jumpid;
+            if (jumpid + 1 > st.jumpid_count)
+                st.jumpid_count = jumpid + 1;
+            labelbytes += sizeof(h64instruction_jumptarget);
+        }
+        int j = 0;
+        while (j < info.read_count) {
+            int16_t slot;
+            memcpy(&slot, inst + info.read_ofs[j], sizeof(slot));
+            if (slot + 1 > st.slot_count)
+                st.slot_count = slot + 1;
+            j++;
+        }
+        if (info.write_ofs >= 0) {
+            int16_t slot;
+            memcpy(&slot, inst + info.write_ofs, sizeof(slot));
+            if (slot + 1 > st.slot_count)
+                st.slot_count = slot + 1;
+        }
+        if (info.size_ofs >= 0) {
+            int16_t topto;
+            memcpy(&topto, inst + info.size_ofs, sizeof(topto));
+            if (topto > st.slot_count)
+                st.slot_count = topto;
+        }
+        st.inst_count++;
+        k += (int64_t)h64program_PtrToInstructionSize(inst);
+    }
+    if (unknown)
+        return 1;
+    f->unoptimized_instructions_bytes = (
+        f->instructions_bytes - labelbytes
+    );
+    f->unoptimized_inner_stack_size = f->inner_stack_size;
+    if (st.inst_count == 0)
+        return 1;
+
+    st.offset = malloc(sizeof(*st.offset) * st.inst_count);
+    st.removed = calloc(st.inst_count, sizeof(*st.removed));
+    st.label_index = malloc(
+        sizeof(*st.label_index) * (st.jumpid_count + 1)
+    );
+    st.label_refs = malloc(
+        sizeof(*st.label_refs) * (st.jumpid_count + 1)
+    );
+    if (!st.offset || !st.removed || !st.label_index || !st.label_refs)
+        goto cleanup;
+    k = 0;
+    int64_t i = 0;
+    while (k < f->instructions_bytes) {
+        st.offset[i] = k;
+        k += (int64_t)h64program_PtrToInstructionSize(
+            f->instructions + k
+        );
+        i++;
+    }
+    if (!_peephole_CountLabels(&st)) {
+        // Broken jumps, leave it to the jump resolution to complain.
+        result = 1;
+        goto cleanup;
+    }
+
+    int do_liveness = (!st.has_rescue);
+    st.words = (st.slot_count + 63) / 64;
+    if (st.words == 0 ||
+            st.words * st.inst_count > PEEPHOLE_MAX_LIVENESSWORDS)
+        do_liveness = 0;
+    if (do_liveness) {
+        st.live_in = malloc(
+            sizeof(*st.live_in) * st.words * st.inst_count
+        );
+        st.scratch = malloc(sizeof(*st.scratch) * st.words);
+        if (!st.live_in || !st.scratch)
+            goto cleanup;
+    }
+
+    int round = 0;
+    while (round < PEEPHOLE_MAX_ROUNDS) {
+        int changed = 0;
+        if (_peephole_ThreadJumps(&st))
+            changed = 1;
+        if (_peephole_RemoveJumpsAndLabels(&st))
+            changed = 1;
+        if (do_liveness) {
+            _peephole_ComputeLiveness(&st);
+            if (_peephole_ForwardCopies(&st))
+                changed = 1;
+        }
+        if (!changed)
+            break;
+        round++;
+    }
+    if (!_peephole_SpecializeBinops(&st))
+        goto cleanup;
+    _peephole_Compact(&st);
+    _peephole_ShrinkStack(pr, func_id, f);
+    result = 1;
+
+    cleanup:
+    free(st.offset);
+    free(st.removed);
+    free(st.label_index);
+    free(st.label_refs);
+    free(st.live_in);
+    free(st.scratch);
+    return result;
+}
+
+static int _peephole_IsSpecialAttrName(h64program *pr, int64_t nameidx) {
+    return (nameidx < 0 ||
+        nameidx == pr->as_str_name_index ||
+        nameidx == pr->as_bytes_name_index ||
+        nameidx == pr->len_name_index ||
+        nameidx == pr->is_a_name_index ||
+        nameidx == pr->init_name_index ||
+        nameidx == pr->on_cloned_name_index ||
+        nameidx == pr->on_destroy_name_index);
+}
+
+void peephole_FuseInstructions(h64program *pr, funcid_t func_id) {
+    h64func *f = &pr->func[func_id];
+    if (f->iscfunc || !f->instructions)
+        return;
+    char *p = f->instructions;
+    char *pend = f->instructions + f->instructions_bytes;
+    while (p < pend) {
+        size_t size = h64program_PtrToInstructionSize(p);
+        if (size == 0 || p + size >= pend)
+            break;
+        h64instructionany *inst = (h64instructionany *)p;
+        h64instructionany *next = (h64instructionany *)(p + size);
+        if ((inst->type == H64INST_BINOP ||
+                IS_SPECIALIZED_INT_BINOP(inst->type)) &&
+                next->type == H64INST_CONDJUMP) {
+            h64instruction_binop *binop = (h64instruction_binop *)inst;
+            h64instruction_condjump *cjump = (
+                (h64instruction_condjump *)next
+            );
+            if ((binop->optype == H64OP_CMP_EQUAL ||
+                    binop->optype == H64OP_CMP_NOTEQUAL ||
+                    binop->optype == H64OP_CMP_LARGEROREQUAL ||
+                    binop->optype == H64OP_CMP_SMALLEROREQUAL ||
+                    binop->optype == H64OP_CMP_LARGER ||
+                    binop->optype == H64OP_CMP_SMALLER) &&
+                    cjump->conditionalslot == binop->slotto)
+                inst->type = H64INST_BINOPCONDJUMP;
+        } else if (inst->type == H64INST_SETCONST &&
+                (next->type == H64INST_BINOP ||
+                 next->type == H64INST_ADDINT ||
+                 next->type == H64INST_SUBINT)) {
+            h64instruction_setconst *sc = (h64instruction_setconst *)inst;
+            h64instruction_binop *binop = (h64instruction_binop *)next;
+            if (sc->content.type == H64VALTYPE_INT64 &&
+                    (binop->optype == H64OP_MATH_ADD ||
+                     binop->optype == H64OP_MATH_SUBSTRACT) &&
+                    (binop->arg1slotfrom == sc->slot ||
+                     binop->arg2slotfrom == sc->slot))
+                inst->type = H64INST_SETCONSTBINOP;
+        } else if (inst->type == H64INST_GETATTRIBUTEBYNAME &&
+                next->type == H64INST_CALLSETTOP) {
+            h64instruction_getattributebyname *getattr = (
+                (h64instruction_getattributebyname *)inst
+            );
+            if (!_peephole_IsSpecialAttrName(pr, getattr->nameidx))
+                inst->type = H64INST_GETATTRCALLSETTOP;
+        }
+        p += size;
+    }
+}
@@ -0,0 +1,16 @@
+// Copyright (c) 2020-2021, ellie/@ell1e & Horse64 Team (see AUTHORS.md),
+// also see LICENSE.md file.
+// SPDX-License-Identifier: BSD-2-Clause
+
+#ifndef HORSE64_COMPILER_PEEPHOLE_H_
+#define HORSE64_COMPILER_PEEPHOLE_H_
+
+#include "compileconfig.h"
+
+#include "bytecode.h"
+
+int peephole_OptimizeFunc(h64program *pr, funcid_t func_id);
+
+void peephole_FuseInstructions(h64program *pr, funcid_t func_id);
+
+#endif  // HORSE64_COMPILER_PEEPHOLE_H_
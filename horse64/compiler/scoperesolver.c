@@ -2307,7 +2307,13 @@ int scoperesolver_ResolveAST(
     if (!transformresult)
         return 0;
 
-    // If so far we didn't have an error, do local storage:
+    // If so far we didn't have an error, fold constants and then
+    // do local storage:
+    if (pr->resultmsg->success &&
+            unresolved_ast->resultmsg.success) {
+        if (!optimizer_PreevaluateConstants(pr, unresolved_ast))
+            return 0;
+    }
     if (pr->resultmsg->success &&
             unresolved_ast->resultmsg.success) {
         if (!varstorage_AssignLocalStorage(
@@ -9,6 +9,7 @@
 #include <stdint.h>
 
 #include "compiler/lexer.h"
+#include "compiler/operator.h"
 #include "mainpreinit.h"
 #include "uri32.h"
 #include "vfs.h"
@@ -111,6 +112,37 @@ START_TEST (test_unaryminus)
 }
 END_TEST
 
+START_TEST (test_bitwiseops)
+{
+    main_PreInit();
+
+    h64compilewarnconfig wconfig;
+    memset(&wconfig, 0, sizeof(wconfig));
+    warningconfig_Init(&wconfig);
+
+    FILE *f = fopen(".testdata.txt", "wb");
+    ck_assert(f != NULL);
+    char s[] = "~a & b | c ^ d << 2 >> 1";
+    ck_assert(fwrite(s, 1, strlen(s), f));
+    fclose(f);
+
+    h64tokenizedfile tfile = lexer_ParseFromFile(
+        _parseURI8(".testdata.txt"), &wconfig
+    );
+    ck_assert(tfile.token_count == 12);
+    ck_assert(tfile.token[0].type == H64TK_UNOPSYMBOL);
+    ck_assert(tfile.token[0].int_value == H64OP_MATH_BINNOT);
+    ck_assert(tfile.token[2].type == H64TK_BINOPSYMBOL);
+    ck_assert(tfile.token[2].int_value == H64OP_MATH_BINAND);
+    ck_assert(tfile.token[4].int_value == H64OP_MATH_BINOR);
+    ck_assert(tfile.token[6].int_value == H64OP_MATH_BINXOR);
+    ck_assert(tfile.token[8].int_value == H64OP_MATH_BINSHIFTLEFT);
+    ck_assert(tfile.token[10].int_value == H64OP_MATH_BINSHIFTRIGHT);
+    lexer_FreeFileTokens(&tfile);
+    result_FreeContents(&tfile.resultmsg);
+}
+END_TEST
+
 START_TEST (test_utf8_literal)
 {
     main_PreInit();
@@ -269,4 +301,4 @@ START_TEST (test_stringliterals)
 }
 END_TEST
 
-TESTS_MAIN(test_intliterals, test_separation, test_utf8_literal, test_unaryminus, test_stringliterals)
+TESTS_MAIN(test_intliterals, test_separation, test_utf8_literal, test_unaryminus, test_stringliterals, test_bitwiseops)
@@ -0,0 +1,338 @@
+// Copyright (c) 2020-2021, ellie/@ell1e & Horse64 Team (see AUTHORS.md),
+// also see LICENSE.md file.
+// SPDX-License-Identifier: BSD-2-Clause
+
+#include <assert.h>
+#include <check.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bytecode.h"
+#include "compiler/operator.h"
+#include "compiler/peephole.h"
+
+#include "testmain.h"
+
+static void _addinst(h64func *f, void *inst) {
+    size_t len = h64program_PtrToInstructionSize(inst);
+    char *newinstructions = realloc(
+        f->instructions, f->instructions_bytes + len
+    );
+    ck_assert(newinstructions != NULL);
+    f->instructions = newinstructions;
+    memcpy(f->instructions + f->instructions_bytes, inst, len);
+    f->instructions_bytes += len;
+}
+
+static h64instructionany *_getinst(h64func *f, int index) {
+    int64_t k = 0;
+    while (k < f->instructions_bytes) {
+        if (index == 0)
+            return (h64instructionany *)(f->instructions + k);
+        k += (int64_t)h64program_PtrToInstructionSize(
+            f->instructions + k
+        );
+        index--;
+    }
+    return NULL;
+}
+
+static int _instcount(h64func *f) {
+    int count = 0;
+    while (_getinst(f, count) != NULL)
+        count++;
+    return count;
+}
+
+START_TEST (test_peephole_forwardcopy)
+{
+    // func(a, b) { var x = a + b; return x } with a temporary in between:
+    h64func f = {0};
+    f.input_stack_size = 2;
+    f.inner_stack_size = 2;
+    h64program pr = {0};
+    pr.func = &f;
+    pr.func_count = 1;
+
+    h64instruction_binop binop = {0};
+    binop.type = H64INST_BINOP;
+    binop.optype = H64OP_MATH_ADD;
+    binop.slotto = 3;
+    binop.arg1slotfrom = 0;
+    binop.arg2slotfrom = 1;
+    _addinst(&f, &binop);
+    h64instruction_valuecopy vc = {0};
+    vc.type = H64INST_VALUECOPY;
+    vc.slotto = 2;
+    vc.slotfrom = 3;
+    _addinst(&f, &vc);
+    h64instruction_returnvalue ret = {0};
+    ret.type = H64INST_RETURNVALUE;
+    ret.returnslotfrom = 2;
+    _addinst(&f, &ret);
+
+    ck_assert(peephole_OptimizeFunc(&pr, 0));
+    ck_assert(_instcount(&f) == 2);
+    h64instruction_binop *newbinop = (
+        (h64instruction_binop *)_getinst(&f, 0)
+    );
+    ck_assert(newbinop->type == H64INST_BINOP);
+    ck_assert(newbinop->slotto == 2);
+    ck_assert(_getinst(&f, 1)->type == H64INST_RETURNVALUE);
+    ck_assert(f.inner_stack_size == 1);
+    ck_assert(f.unoptimized_inner_stack_size == 2);
+    ck_assert(f.unoptimized_instructions_bytes > f.instructions_bytes);
+    free(f.instructions);
+}
+END_TEST
+
+START_TEST (test_peephole_jumps)
+{
+    // condjump to a jump, followed by jumps that end up going nowhere:
+    h64func f = {0};
+    f.input_stack_size = 1;
+    f.inner_stack_size = 0;
+    h64program pr = {0};
+    pr.func = &f;
+    pr.func_count = 1;
+
+    h64instruction_condjump cjump = {0};
+    cjump.type = H64INST_CONDJUMP;
+    cjump.conditionalslot = 0;
+    cjump.jumpbytesoffset = 0;
+    _addinst(&f, &cjump);
+    h64instruction_jump jump = {0};
+    jump.type = H64INST_JUMP;
+    jump.jumpbytesoffset = 1;
+    _addinst(&f, &jump);
+    h64instruction_jumptarget target = {0};
+    target.type = H64INST_JUMPTARGET;
+    target.jumpid = 0;
+    _addinst(&f, &target);
+    _addinst(&f, &jump);
+    target.jumpid = 1;
+    _addinst(&f, &target);
+    h64instruction_returnvalue ret = {0};
+    ret.type = H64INST_RETURNVALUE;
+    ret.returnslotfrom = 0;
+    _addinst(&f, &ret);
+
+    ck_assert(peephole_OptimizeFunc(&pr, 0));
+    ck_assert(_instcount(&f) == 3);
+    h64instruction_condjump *newcjump = (
+        (h64instruction_condjump *)_getinst(&f, 0)
+    );
+    ck_assert(newcjump->type == H64INST_CONDJUMP);
+    ck_assert(newcjump->jumpbytesoffset == 1);
+    h64instruction_jumptarget *newtarget = (
+        (h64instruction_jumptarget *)_getinst(&f, 1)
+    );
+    ck_assert(newtarget->type == H64INST_JUMPTARGET);
+    ck_assert(newtarget->jumpid == 1);
+    ck_assert(_getinst(&f, 2)->type == H64INST_RETURNVALUE);
+    free(f.instructions);
+}
+END_TEST
+
+START_TEST (test_peephole_keepslive)
+{
+    // A temporary read again after a jump must keep its copy:
+    h64func f = {0};
+    f.input_stack_size = 1;
+    f.inner_stack_size = 2;
+    h64program pr = {0};
+    pr.func = &f;
+    pr.func_count = 1;
+
+    h64instruction_setconst sc = {0};
+    sc.type = H64INST_SETCONST;
+    sc.slot = 2;
+    sc.content.type = H64VALTYPE_INT64;
+    sc.content.int_value = 5;
+    _addinst(&f, &sc);
+    h64instruction_valuecopy vc = {0};
+    vc.type = H64INST_VALUECOPY;
+    vc.slotto = 1;
+    vc.slotfrom = 2;
+    _addinst(&f, &vc);
+    h64instruction_condjump cjump = {0};
+    cjump.type = H64INST_CONDJUMP;
+    cjump.conditionalslot = 0;
+    cjump.jumpbytesoffset = 0;
+    _addinst(&f, &cjump);
+    h64instruction_returnvalue ret = {0};
+    ret.type = H64INST_RETURNVALUE;
+    ret.returnslotfrom = 1;
+    _addinst(&f, &ret);
+    h64instruction_jumptarget target = {0};
+    target.type = H64INST_JUMPTARGET;
+    target.jumpid = 0;
+    _addinst(&f, &target);
+    ret.returnslotfrom = 2;
+    _addinst(&f, &ret);
+
+    ck_assert(peephole_OptimizeFunc(&pr, 0));
+    ck_assert(_instcount(&f) == 6);
+    h64instruction_setconst *newsc = (
+        (h64instruction_setconst *)_getinst(&f, 0)
+    );
+    ck_assert(newsc->slot == 2);
+    ck_assert(f.inner_stack_size == 2);
+    free(f.instructions);
+}
+END_TEST
+
+START_TEST (test_peephole_fuse)
+{
+    // i + 1 < a as a loop condition, with resolved jump offsets:
+    h64func f = {0};
+    f.input_stack_size = 2;
+    f.inner_stack_size = 2;
+    h64program pr = {0};
+    pr.func = &f;
+    pr.func_count = 1;
+
+    h64instruction_setconst sc = {0};
+    sc.type = H64INST_SETCONST;
+    sc.slot = 2;
+    sc.content.type = H64VALTYPE_INT64;
+    sc.content.int_value = 1;
+    _addinst(&f, &sc);
+    h64instruction_binop binop = {0};
+    binop.type = H64INST_BINOP;
+    binop.optype = H64OP_MATH_ADD;
+    binop.slotto = 0;
+    binop.arg1slotfrom = 0;
+    binop.arg2slotfrom = 2;
+    _addinst(&f, &binop);
+    binop.optype = H64OP_CMP_SMALLER;
+    binop.slotto = 3;
+    binop.arg1slotfrom = 0;
+    binop.arg2slotfrom = 1;
+    _addinst(&f, &binop);
+    h64instruction_condjump cjump = {0};
+    cjump.type = H64INST_CONDJUMP;
+    cjump.conditionalslot = 3;
+    cjump.jumpbytesoffset = sizeof(cjump);
+    _addinst(&f, &cjump);
+    h64instruction_returnvalue ret = {0};
+    ret.type = H64INST_RETURNVALUE;
+    ret.returnslotfrom = 0;
+    _addinst(&f, &ret);
+    int64_t oldbytes = f.instructions_bytes;
+
+    peephole_FuseInstructions(&pr, 0);
+    ck_assert(f.instructions_bytes == oldbytes);
+    ck_assert(_instcount(&f) == 5);
+    ck_assert(_getinst(&f, 0)->type == H64INST_SETCONSTBINOP);
+    ck_assert(_getinst(&f, 1)->type == H64INST_BINOP);
+    ck_assert(_getinst(&f, 2)->type == H64INST_BINOPCONDJUMP);
+    ck_assert(_getinst(&f, 3)->type == H64INST_CONDJUMP);
+    ck_assert(_getinst(&f, 4)->type == H64INST_RETURNVALUE);
+    free(f.instructions);
+}
+END_TEST
+
+START_TEST (test_peephole_specialize)
+{
+    // func(n) { var i = 0; while i < n { i = i + 1; n * n }; return i }
+    h64func f = {0};
+    f.input_stack_size = 1;
+    f.inner_stack_size = 3;
+    h64program pr = {0};
+    pr.func = &f;
+    pr.func_count = 1;
+
+    h64instruction_setconst sc = {0};
+    sc.type = H64INST_SETCONST;
+    sc.slot = 1;
+    sc.content.type = H64VALTYPE_INT64;
+    sc.content.int_value = 0;
+    _addinst(&f, &sc);
+    h64instruction_jumptarget target = {0};
+    target.type = H64INST_JUMPTARGET;
+    target.jumpid = 0;
+    _addinst(&f, &target);
+    h64instruction_binop binop = {0};
+    binop.type = H64INST_BINOP;
+    binop.optype = H64OP_CMP_SMALLER;
+    binop.slotto = 2;
+    binop.arg1slotfrom = 1;
+    binop.arg2slotfrom = 0;
+    _addinst(&f, &binop);
+    h64instruction_condjump cjump = {0};
+    cjump.type = H64INST_CONDJUMP;
+    cjump.conditionalslot = 2;
+    cjump.jumpbytesoffset = 1;
+    _addinst(&f, &cjump);
+    sc.slot = 3;
+    sc.content.int_value = 1;
+    _addinst(&f, &sc);
+    binop.optype = H64OP_MATH_ADD;
+    binop.slotto = 1;
+    binop.arg1slotfrom = 1;
+    binop.arg2slotfrom = 3;
+    _addinst(&f, &binop);
+    binop.optype = H64OP_MATH_MULTIPLY;
+    binop.slotto = 2;
+    binop.arg1slotfrom = 0;
+    binop.arg2slotfrom = 0;
+    _addinst(&f, &binop);
+    h64instruction_jump jump = {0};
+    jump.type = H64INST_JUMP;
+    jump.jumpbytesoffset = 0;
+    _addinst(&f, &jump);
+    target.jumpid = 1;
+    _addinst(&f, &target);
+    h64instruction_returnvalue ret = {0};
+    ret.type = H64INST_RETURNVALUE;
+    ret.returnslotfrom = 1;
+    _addinst(&f, &ret);
+
+    // i is an int at the loop start on both paths, n is unknown:
+    ck_assert(peephole_OptimizeFunc(&pr, 0));
+    ck_assert(_instcount(&f) == 10);
+    ck_assert(_getinst(&f, 2)->type == H64INST_LTINT);
+    ck_assert(_getinst(&f, 5)->type == H64INST_ADDINT);
+    ck_assert(_getinst(&f, 6)->type == H64INST_BINOP);
+    free(f.instructions);
+
+    // If the loop makes i a float, the start can't know its type:
+    f.instructions = NULL;
+    f.instructions_bytes = 0;
+    f.inner_stack_size = 3;
+    sc.slot = 1;
+    sc.content.int_value = 0;
+    _addinst(&f, &sc);
+    target.jumpid = 0;
+    _addinst(&f, &target);
+    binop.optype = H64OP_CMP_SMALLER;
+    binop.slotto = 2;
+    binop.arg1slotfrom = 1;
+    binop.arg2slotfrom = 0;
+    _addinst(&f, &binop);
+    _addinst(&f, &cjump);
+    sc.slot = 3;
+    sc.content.type = H64VALTYPE_FLOAT64;
+    sc.content.float_value = 0.5;
+    _addinst(&f, &sc);
+    binop.optype = H64OP_MATH_ADD;
+    binop.slotto = 1;
+    binop.arg1slotfrom = 1;
+    binop.arg2slotfrom = 3;
+    _addinst(&f, &binop);
+    _addinst(&f, &jump);
+    target.jumpid = 1;
+    _addinst(&f, &target);
+    _addinst(&f, &ret);
+
+    ck_assert(peephole_OptimizeFunc(&pr, 0));
+    ck_assert(_getinst(&f, 2)->type == H64INST_BINOP);
+    ck_assert(_getinst(&f, 5)->type == H64INST_ADDFLOAT);
+    free(f.instructions);
+}
+END_TEST
+
+TESTS_MAIN(test_peephole_forwardcopy, test_peephole_jumps,
+           test_peephole_keepslive, test_peephole_fuse,
+           test_peephole_specialize)
@@ -33,6 +33,7 @@
 #include "process.h"
 #include "stack.h"
 #include "vmexec.h"
+#include "vmgc.h"
 #include "vmlist.h"
 #include "widechar.h"
 
@@ -353,6 +354,35 @@ int builtininternals_sqrt(h64vmthread *vmthread) {
     return 1;
 }
 
+int builtininternals_gc_values_freed(h64vmthread *vmthread) {
+    // Returns how many values the cycle collector of this vmthread has
+    // freed so far. (For tests, plain refcounting isn't counted.)
+    assert(STACK_TOP(vmthread->stack) >= 0);
+
+    if (STACK_TOP(vmthread->stack) == 0) {
+        int result = stack_ToSize(
+            vmthread->stack, vmthread,
+            vmthread->stack->entry_count + 1, 0
+        );
+        if (!result)
+            return vmexec_ReturnFuncError(vmthread,
+                H64STDERROR_OUTOFMEMORYERROR,
+                "out of memory when returning value"
+            );
+    }
+
+    h64gcstats stats = {0};
+    vmgc_GetStats(vmthread->gc, &stats);
+
+    valuecontent *vresult = STACK_ENTRY(vmthread->stack, 0);
+    DELREF_NONHEAP(vresult);
+    valuecontent_Free(vmthread, vresult);
+    memset(vresult, 0, sizeof(*vresult));
+    vresult->type = H64VALTYPE_INT64;
+    vresult->int_value = stats.values_freed;
+    return 1;
+}
+
 int builtininternalslib_RegisterFuncsAndModules(h64program *p) {
     int64_t idx;
 
@@ -392,5 +422,17 @@ int builtininternalslib_RegisterFuncsAndModules(h64program *p) {
     if (idx < 0)
         return 0;
 
+    // builtininternals.gc_values_freed:
+    const char *builtininternals_gc_values_freed_kw_arg_name[] = {
+        NULL
+    };
+    idx = h64program_RegisterCFunction(
+        p, "gc_values_freed", &builtininternals_gc_values_freed,
+        NULL, 0, 0, builtininternals_gc_values_freed_kw_arg_name,
+        "builtininternals", "core.horse64.org", 1, -1
+    );
+    if (idx < 0)
+        return 0;
+
     return 1;
 }
@@ -62,6 +62,9 @@ int _open_osfhandle(intptr_t osfhandle, int flags);
 #define FILEOBJ_FLAGS_CACHEDUNSENTERROR 0x20
 #define FILEOBJ_FLAGS_IGNOREENCODINGERROR 0x40
 
+// Most bytes iolib_fileread() asks fread() for at once:
+#define FILEREAD_CHUNKSIZE (64 * 1024)
+
 /// @module io A module for manipulation files and directories
 ///     on disk, using whatever filesystems your computer provides.
 
@@ -795,87 +798,6 @@ int iolib_filewrite(
     }
 }
 
-void _count_actual_letters_in_raw(
-        const uint8_t *raw, int64_t rawlen,
-        h64wchar *decodebuf,
-        int64_t consider_all_valid_upto,
-        int64_t *codepoints, int64_t *letters,
-        int *last_codepoint_was_incomplete,
-        int *endsinmultipleinvalid
-        ) {
-    *last_codepoint_was_incomplete = 0;
-    *endsinmultipleinvalid = 0;
-    int64_t cpcount = 0;
-    int64_t lettercount = 0;
-    int64_t i = 0;
-    int previouswasinvalid = 0;
-    while (i < rawlen) {
-        int charlen = utf8_char_len(
-            (const uint8_t *)(raw + i)
-        );
-        h64wchar cp = 0;
-        if (charlen <= 0)
-            charlen = 1;
-        if (charlen + i > rawlen) {
-            charlen = 1;
-            *last_codepoint_was_incomplete = 1;
-        }
-        uint8_t *p = (uint8_t *)(raw + i);
-        if (charlen <= 1 && *p > 127) {
-            // Invalid byte, surrogate escape:
-            cp = (0xDC80ULL + (
-                (h64wchar)((uint8_t)*p)
-            ));
-            decodebuf[cpcount] = cp;
-            cpcount++;
-            i += 1;
-            while (i < rawlen) {  // Finish incomplete code point:
-                uint8_t *p = (uint8_t *)(raw + i);
-                cp = (0xDC80ULL + (
-                    (h64wchar)((uint8_t)*p)
-                ));
-                decodebuf[cpcount] = cp;
-                cpcount++;
-                i += 1;
-            }
-            *endsinmultipleinvalid = previouswasinvalid;
-            break;
-        } else if (charlen == 1) {
-            cp = *p;
-            assert(cp <= 127);
-            previouswasinvalid = 0;
-        } else {
-            int out_len = 0;
-            int cpresult = get_utf8_codepoint(
-                p, charlen, &cp, &out_len
-            );
-            if (!cpresult) {
-                assert(*((uint8_t*)p) > 127);
-                charlen = 1;
-                previouswasinvalid = (
-                    i > consider_all_valid_upto
-                );
-                cp = (0xDC80ULL + (
-                    (h64wchar)((uint8_t)*p)
-                ));
-            } else {
-                previouswasinvalid = 0;
-                assert(out_len == charlen);
-            }
-        }
-        decodebuf[cpcount] = cp;
-        cpcount++;
-        i += charlen;
-    }
-    if (cpcount > 0) {
-        lettercount = utf32_letters_count(
-            decodebuf, cpcount
-        );
-    }
-    *codepoints = cpcount;
-    *letters = lettercount;
-}
-
 int iolib_fileread(
         h64vmthread *vmthread
         ) {
@@ -969,9 +891,12 @@ int iolib_fileread(
 
     char _stackdecodebuf[1024];
     h64wchar *decodebuf = (h64wchar *)_stackdecodebuf;
-    int decodebufsize = 1024 / sizeof(*decodebuf);
-    int decodebuffill = 0;
+    int64_t decodebufsize = 1024 / sizeof(*decodebuf);
+    int64_t decodebuffill = 0;
     int decodebufheap = 0;
+    int textdecoded = 0;  // if set, decodebuf holds the text to return
+    int64_t letters = 0;  // letters in decodebuf, if textdecoded is set
+    int64_t firstinvalid = -1;  // index of first invalid byte in decodebuf
 
     if (ferror(f)) {
         clearerr(f);
@@ -989,13 +914,15 @@ int iolib_fileread(
     // Read from file up to requested amount:
     if (amount < 0) {
         while (1) {
-            int64_t readbytes = 512;
+            int64_t readbytes = FILEREAD_CHUNKSIZE;
             if (readbytes + readbuffill + 1 >
                     readbufsize) {
                 char *newbuf = NULL;
                 int64_t newreadbufsize = (
                     readbytes + readbuffill + 1024 * 5
                 );
+                if (newreadbufsize < readbufsize * 2)
+                    newreadbufsize = readbufsize * 2;
                 if (!readbufheap) {
                     newbuf = malloc(newreadbufsize);
                     if (newbuf) {
@@ -1048,68 +975,74 @@ int iolib_fileread(
         }
     } else if (!readbinary) {
         assert(amount >= 0);
-        int64_t complete_guaranteed_letters_count = 0;
-        int complete_guaranteed_letters_count_at = 0;
+        // Decode as we go, and feed the code points into a letter stream
+        // to find out where letters end. This way, every byte is decoded
+        // exactly once no matter how many reads it takes to get enough:
+        textdecoded = 1;
+        utf32letterstream ls = {0};
+        int64_t decodedupto = 0;
+        int64_t cutat = -1;  // byte offset where letter amount + 1 starts
         int hadeof = 0;
         int haderror = 0;
         while (1) {
-            // If we read beyond what we determined to be "complete",
-            // take stock of how much completed letters we have:
-            if (readbuffill > complete_guaranteed_letters_count_at) {
-                int64_t k = readbuffill;
-                while (k > complete_guaranteed_letters_count_at) {
-                    // See how much letters we got at this index:
-                    int64_t _codepoints, _letters;
-                    int _lastincomplete, _endsmultipleinvalid;
-                    _count_actual_letters_in_raw(
-                        (const uint8_t *)readbuf +
-                            complete_guaranteed_letters_count_at,
-                        k - complete_guaranteed_letters_count_at,
-                        decodebuf, 0, &_codepoints, &_letters,
-                        &_lastincomplete, &_endsmultipleinvalid
+            while (decodedupto < readbuffill) {
+                const uint8_t *p = (
+                    (const uint8_t *)readbuf + decodedupto
+                );
+                int64_t left = readbuffill - decodedupto;
+                if (*p < 0x80 && letters < amount) {
+                    int64_t run = utf32_letterstream_feedascii(
+                        &ls, p, (left < amount - letters ?
+                                 left : amount - letters),
+                        decodebuf + decodebuffill
                     );
-                    if (_letters <= 1)
+                    letters += run;
+                    decodebuffill += run;
+                    decodedupto += run;
+                    if (run > 0)
+                        continue;
+                }
+                h64wchar cp = *p;
+                int cpbytes = 1;
+                if (*p >= 0x80) {
+                    int charlen = utf8_char_len(p);
+                    if (charlen >= left && !hadeof && !haderror) {
+                        // Wait for the rest, and for the byte after it
+                        // which get_utf8_codepoint() also looks at:
                         break;
-                    if (!_lastincomplete || _endsmultipleinvalid) {
-                        // See where we drop below this letter count:
-                        int64_t k2 = k - 1;
-                        while (k2 > complete_guaranteed_letters_count) {
-                            int64_t _codepoints2, _letters2;
-                            int _lastincomplete2, _endsmultipleinvalid2;
-                            _count_actual_letters_in_raw(
-                                (const uint8_t *)readbuf +
-                                    complete_guaranteed_letters_count_at,
-                                k2 - complete_guaranteed_letters_count_at,
-                                decodebuf, 0, &_codepoints2, &_letters2,
-                                &_lastincomplete2, &_endsmultipleinvalid2
-                            );
-                            if (_letters2 < _letters) {
-                                complete_guaranteed_letters_count_at = (
-                                    k2
-                                );
-                                complete_guaranteed_letters_count += (
-                                    _letters2
-                                );
-                                break;
-                            }
-                            k2--;
-                        }
+                    }
+                    if (!get_utf8_codepoint(
+                            p, (left > 8 ? 8 : (int)left),
+                            &cp, &cpbytes)) {
+                        // Invalid byte, surrogate escape:
+                        cp = (0xDC80ULL + (h64wchar)*p);
+                        cpbytes = 1;
+                        if (firstinvalid < 0)
+                            firstinvalid = decodebuffill;
+                    }
+                }
+                if (utf32_letterstream_feed(&ls, cp)) {
+                    if (letters >= amount) {
+                        cutat = decodedupto;
                         break;
                     }
-                    k--;
+                    letters++;
                 }
+                decodebuf[decodebuffill] = cp;
+                decodebuffill++;
+                decodedupto += cpbytes;
             }
-            if (complete_guaranteed_letters_count >= amount ||
-                    hadeof || haderror) {
+            if (cutat >= 0 || hadeof || haderror) {
                 // We reached what we wanted, or encountered an error.
                 break;  // done.
             }
             // Read more bytes:
-            int64_t readbytes = (
-                amount - complete_guaranteed_letters_count
-            ) * 1.5;  // just a wild guess how much we might need
-            if (readbytes < 16) {
-                readbytes = 16;
+            int64_t readbytes = FILEREAD_CHUNKSIZE;
+            if (amount - letters < FILEREAD_CHUNKSIZE / 2) {
+                // Just a wild guess how much we might need:
+                readbytes = (amount - letters) * 1.5;
+                if (readbytes < 16)
+                    readbytes = 16;
             }
             // Make sure our buffer is large enough:
             if (readbytes + readbuffill + 1 >
@@ -1118,6 +1051,8 @@ int iolib_fileread(
                 int64_t newreadbufsize = (
                     readbytes + readbuffill + 1024 * 5
                 );
+                if (newreadbufsize < readbufsize * 2)
+                    newreadbufsize = readbufsize * 2;
                 if (!readbufheap) {
                     newbuf = malloc(newreadbufsize);
                     if (newbuf) {
@@ -1140,22 +1075,21 @@ int iolib_fileread(
                 readbuf = newbuf;
                 readbufsize = newreadbufsize;
             }
-            // Make sure decode buffer is large enough:
-            if (readbytes + decodebuffill + 1 >
+            // Make sure decode buffer is large enough, which needs at
+            // most one code point per byte:
+            if (readbytes + readbuffill + 1 >
                     decodebufsize) {
                 h64wchar *newbuf = NULL;
-                int64_t newdecodebusize = (
-                    readbytes + decodebuffill + 512
-                );
+                int64_t newdecodebufsize = readbufsize;
                 if (!decodebufheap) {
-                    newbuf = malloc(newdecodebusize * sizeof(*newbuf));
+                    newbuf = malloc(newdecodebufsize * sizeof(*newbuf));
                     if (newbuf) {
                         memcpy(newbuf, decodebuf,
                             decodebuffill * sizeof(*newbuf));
                     }
                 } else {
                     newbuf = realloc(
-                        decodebuf, newdecodebusize * sizeof(*newbuf)
+                        decodebuf, newdecodebufsize * sizeof(*newbuf)
                     );
                 }
                 if (!newbuf) {
@@ -1170,7 +1104,7 @@ int iolib_fileread(
                 }
                 decodebufheap = 1;
                 decodebuf = newbuf;
-                decodebufsize = newdecodebusize;
+                decodebufsize = newdecodebufsize;
             }
             // Do the reading:
             size_t amountread = fread(
@@ -1186,37 +1120,23 @@ int iolib_fileread(
                 readbuffill += amountread;
             }
         }
-        // Figure out the buffer bytes to return that actually
-        // make up the requested letters.
-        int64_t letterssofar = 0;
-        int64_t i = 0;
-        while (i < readbuffill && letterssofar < amount) {
-            int64_t bytes = utf32_next_letter_byteslen_in_utf8(
-                readbuf + i, readbuffill - i
-            );
-            if (bytes < 0) {
-                if (readbufheap)
-                    free(readbuf);
-                if (decodebufheap)
-                    free(decodebuf);
-                return vmexec_ReturnFuncError(
-                    vmthread, H64STDERROR_OUTOFMEMORYERROR,
-                    "out of memory determining read buf reverse"
-                );
-            }
-            if (bytes <= 0)
-                break;
-            letterssofar++;
-            i += bytes;
+        if (cutat < 0) {
+            // We hit the end, so everything decoded is complete:
+            assert(decodedupto == readbuffill);
+            cutat = decodedupto;
         }
         if (!haderror) {
             // We want to seek back what we overshot.
             int64_t overshotbytes = (
-                readbuffill - i
+                readbuffill - cutat
             );
             if (overshotbytes > 0) {
                 if (fseek64(f, -overshotbytes, SEEK_CUR) != 0) {
                     clearerr(f);
+                    if (readbufheap)
+                        free(readbuf);
+                    if (decodebufheap)
+                        free(decodebuf);
                     return vmexec_ReturnFuncError(
                         vmthread, H64STDERROR_RESOURCEERROR,
                         "unexpected I/O error reading file"
@@ -1226,7 +1146,7 @@ int iolib_fileread(
         }
         if (haderror) {
             clearerr(f);
-            if (i <= 0) {
+            if (cutat <= 0) {
                 if (readbufheap)
                     free(readbuf);
                 if (decodebufheap)
@@ -1238,7 +1158,7 @@ int iolib_fileread(
             }
             cdata->flags |= FILEOBJ_FLAGS_CACHEDUNSENTERROR;
         }
-        readbuffill = i;  // Truncate to what we want to return.
+        readbuffill = cutat;  // Truncate to what we want to return.
     } else {
         assert(amount > 0);
         if (amount > readbufsize) {
@@ -1246,7 +1166,7 @@ int iolib_fileread(
                 free(readbuf);
             readbufheap = 1;
             readbuf = malloc(
-                sizeof(*readbuf) * readbufsize
+                sizeof(*readbuf) * amount
             );
             if (!readbuf) {
                 if (decodebufheap)
@@ -1277,9 +1197,10 @@ int iolib_fileread(
         }
         readbuffill = _didread;
     }
-    if (decodebufheap) {
+    if (decodebufheap && (!textdecoded || readbuffill == 0)) {
         free(decodebuf);
         decodebuf = NULL;
+        decodebufheap = 0;
     }
 
     valuecontent *vresult = STACK_ENTRY(vmthread->stack, 0);
@@ -1297,39 +1218,59 @@ int iolib_fileread(
         char _convertedbuf[1024];
         h64wchar* converted = (h64wchar*)_convertedbuf;
         int64_t convertedlen = 0;
-        int abortedinvalid = 0;
-        int abortedoom = 0;
-        converted = utf8_to_utf32_ex(
-            readbuf, readbuffill,
-            (char*)converted, sizeof(_convertedbuf),
-            NULL, NULL, &convertedlen,
-            ((cdata->flags & FILEOBJ_FLAGS_IGNOREENCODINGERROR) != 0),
-            0, &abortedinvalid, &abortedoom
-        );
-        if (abortedinvalid) {
-            assert(!converted);
+        int convertedonheap = 0;
+        if (textdecoded) {
+            // Already decoded while looking for the letter boundaries:
             if (readbufheap)
                 free(readbuf);
-            return vmexec_ReturnFuncError(
-                vmthread, H64STDERROR_ENCODINGERROR,
-                "invalid encoded character in file"
+            if (firstinvalid >= 0 && firstinvalid < decodebuffill &&
+                    (cdata->flags &
+                     FILEOBJ_FLAGS_IGNOREENCODINGERROR) == 0) {
+                if (decodebufheap)
+                    free(decodebuf);
+                return vmexec_ReturnFuncError(
+                    vmthread, H64STDERROR_ENCODINGERROR,
+                    "invalid encoded character in file"
+                );
+            }
+            converted = decodebuf;
+            convertedlen = decodebuffill;
+            convertedonheap = decodebufheap;
+        } else {
+            int abortedinvalid = 0;
+            int abortedoom = 0;
+            converted = utf8_to_utf32_ex(
+                readbuf, readbuffill,
+                (char*)converted, sizeof(_convertedbuf),
+                NULL, NULL, &convertedlen,
+                ((cdata->flags & FILEOBJ_FLAGS_IGNOREENCODINGERROR) != 0),
+                0, &abortedinvalid, &abortedoom
             );
-        }
-        if (abortedoom) {
-            assert(!converted);
+            if (abortedinvalid) {
+                assert(!converted);
+                if (readbufheap)
+                    free(readbuf);
+                return vmexec_ReturnFuncError(
+                    vmthread, H64STDERROR_ENCODINGERROR,
+                    "invalid encoded character in file"
+                );
+            }
+            if (abortedoom) {
+                assert(!converted);
+                if (readbufheap)
+                    free(readbuf);
+                return vmexec_ReturnFuncError(
+                    vmthread, H64STDERROR_OUTOFMEMORYERROR,
+                    "decode buffer alloc failure"
+                );
+            }
+            assert(converted != NULL);
             if (readbufheap)
                 free(readbuf);
-            return vmexec_ReturnFuncError(
-                vmthread, H64STDERROR_OUTOFMEMORYERROR,
-                "decode buffer alloc failure"
+            convertedonheap = (
+                (char*)converted != _convertedbuf
             );
         }
-        assert(converted != NULL);
-        if (readbufheap)
-            free(readbuf);
-        int convertedonheap = (
-            (char*)converted != _convertedbuf
-        );
         vresult->type = H64VALTYPE_GCVAL;
         vresult->ptr_value = poolalloc_malloc(
             vmthread->heap, 0
@@ -1367,6 +1308,8 @@ int iolib_fileread(
             free(converted);
         gcval->str_val.refcount = 1;
         gcval->externalreferencecount = 1;
+        if (textdecoded)
+            gcval->str_val.letterlen = letters;
         vmstrings_RequireLetterLen(
             &gcval->str_val
         );
@@ -11,11 +11,15 @@
 #include "corelib/moduleless.h"
 #include "corelib/moduleless_containers.h"
 #include "debugsymbols.h"
+#include "gcvalue.h"
+#include "poolalloc.h"
 #include "stack.h"
 #include "valuecontentstruct.h"
 #include "vmexec.h"
 #include "vmlist.h"
 #include "vmmap.h"
+#include "vmset.h"
+#include "vmvector.h"
 
 
 int corelib_containeradd(  // $$builtin.$$container_add
@@ -35,6 +39,22 @@ int corelib_containeradd(  // $$builtin.$$container_add
                 "alloc failure extending container"
             );
         }
+    } else if (gcvalue->type == H64GCVALUETYPE_SET) {
+        if (valuecontent_IsMutable(STACK_ENTRY(vmthread->stack, 0))) {
+            return vmexec_ReturnFuncError(
+                vmthread, H64STDERROR_TYPEERROR,
+                "set value must be immutable value"
+            );
+        }
+        if (!vmset_Add(
+                vmthread, gcvalue->set_values,
+                STACK_ENTRY(vmthread->stack, 0)
+                )) {
+            return vmexec_ReturnFuncError(
+                vmthread, H64STDERROR_OUTOFMEMORYERROR,
+                "alloc failure extending container"
+            );
+        }
     } else {
         return vmexec_ReturnFuncError(
             vmthread, H64STDERROR_TYPEERROR,
@@ -45,6 +65,223 @@ int corelib_containeradd(  // $$builtin.$$container_add
     return 1;
 }
 
+static int _corelib_vectorfuncresult(
+        h64vmthread *vmthread, int ok,
+        valuecontent *result, vmvectorerror error
+        ) {
+    if (!ok) {
+        if (error == VMVECTOR_ERROR_OUTOFMEMORY) {
+            return vmexec_ReturnFuncError(
+                vmthread, H64STDERROR_OUTOFMEMORYERROR,
+                "out of memory computing vector result"
+            );
+        } else if (error == VMVECTOR_ERROR_OVERFLOW) {
+            return vmexec_ReturnFuncError(
+                vmthread, H64STDERROR_OVERFLOWERROR,
+                "number range overflow"
+            );
+        } else if (error == VMVECTOR_ERROR_LENMISMATCH) {
+            return vmexec_ReturnFuncError(
+                vmthread, H64STDERROR_VALUEERROR,
+                "vectors must have the same length"
+            );
+        } else if (error == VMVECTOR_ERROR_EMPTY) {
+            return vmexec_ReturnFuncError(
+                vmthread, H64STDERROR_VALUEERROR,
+                "vector is empty"
+            );
+        }
+        return vmexec_ReturnFuncError(
+            vmthread, H64STDERROR_TYPEERROR,
+            "invalid vector operation"
+        );
+    }
+    valuecontent *vresult = STACK_ENTRY(vmthread->stack, 0);
+    DELREF_NONHEAP(vresult);
+    valuecontent_Free(vmthread, vresult);
+    memcpy(vresult, result, sizeof(*result));
+    return 1;
+}
+
+int corelib_vectordot(  // $$builtin.$$vector_dot
+        h64vmthread *vmthread
+        ) {
+    assert(STACK_TOP(vmthread->stack) >= 2);
+
+    valuecontent *vc = STACK_ENTRY(vmthread->stack, 1);
+    assert(vc->type == H64VALTYPE_VECTOR);
+    valuecontent *vother = STACK_ENTRY(vmthread->stack, 0);
+    if (vother->type != H64VALTYPE_VECTOR) {
+        return vmexec_ReturnFuncError(
+            vmthread, H64STDERROR_TYPEERROR,
+            "argument must be a vector"
+        );
+    }
+    valuecontent result = {0};
+    vmvectorerror error = VMVECTOR_ERROR_NONE;
+    int ok = vmvector_Dot(
+        vc->vector_values, vother->vector_values, &result, &error
+    );
+    return _corelib_vectorfuncresult(vmthread, ok, &result, error);
+}
+
+int corelib_vectorsum(  // $$builtin.$$vector_sum
+        h64vmthread *vmthread
+        ) {
+    assert(STACK_TOP(vmthread->stack) >= 1);
+
+    valuecontent *vc = STACK_ENTRY(vmthread->stack, 0);
+    assert(vc->type == H64VALTYPE_VECTOR);
+    valuecontent result = {0};
+    vmvectorerror error = VMVECTOR_ERROR_NONE;
+    int ok = vmvector_Sum(vc->vector_values, &result, &error);
+    return _corelib_vectorfuncresult(vmthread, ok, &result, error);
+}
+
+int corelib_vectormin(  // $$builtin.$$vector_min
+        h64vmthread *vmthread
+        ) {
+    assert(STACK_TOP(vmthread->stack) >= 1);
+
+    valuecontent *vc = STACK_ENTRY(vmthread->stack, 0);
+    assert(vc->type == H64VALTYPE_VECTOR);
+    valuecontent result = {0};
+    vmvectorerror error = VMVECTOR_ERROR_NONE;
+    int ok = vmvector_Min(vc->vector_values, &result, &error);
+    return _corelib_vectorfuncresult(vmthread, ok, &result, error);
+}
+
+int corelib_vectormax(  // $$builtin.$$vector_max
+        h64vmthread *vmthread
+        ) {
+    assert(STACK_TOP(vmthread->stack) >= 1);
+
+    valuecontent *vc = STACK_ENTRY(vmthread->stack, 0);
+    assert(vc->type == H64VALTYPE_VECTOR);
+    valuecontent result = {0};
+    vmvectorerror error = VMVECTOR_ERROR_NONE;
+    int ok = vmvector_Max(vc->vector_values, &result, &error);
+    return _corelib_vectorfuncresult(vmthread, ok, &result, error);
+}
+
+int corelib_containerremove(  // $$builtin.$$container_remove
+        h64vmthread *vmthread
+        ) {
+    assert(STACK_TOP(vmthread->stack) >= 2);
+
+    valuecontent *vc = STACK_ENTRY(vmthread->stack, 1);
+    assert(vc->type == H64VALTYPE_GCVAL);
+    h64gcvalue *gcvalue = (h64gcvalue *)vc->ptr_value;
+    int result = 0;
+    int inneroom = 0;
+    if (gcvalue->type == H64GCVALUETYPE_SET) {
+        result = vmset_Remove(vmthread, gcvalue->set_values,
+            STACK_ENTRY(vmthread->stack, 0), &inneroom
+        );
+    } else if (gcvalue->type == H64GCVALUETYPE_MAP) {
+        result = vmmap_Remove(vmthread, gcvalue->map_values,
+            STACK_ENTRY(vmthread->stack, 0), &inneroom
+        );
+    } else {
+        return vmexec_ReturnFuncError(
+            vmthread, H64STDERROR_TYPEERROR,
+            "cannot .remove() on this container type"
+        );
+    }
+    if (!result && inneroom) {
+        return vmexec_ReturnFuncError(
+            vmthread, H64STDERROR_OUTOFMEMORYERROR,
+            "out of memory while removing from container"
+        );
+    }
+
+    valuecontent *vresult = STACK_ENTRY(vmthread->stack, 0);
+    DELREF_NONHEAP(vresult);
+    valuecontent_Free(vmthread, vresult);
+    memset(vresult, 0, sizeof(*vresult));
+    vresult->type = H64VALTYPE_BOOL;
+    vresult->int_value = result;
+    return 1;
+}
+
+static int _corelib_containersetop(
+        h64vmthread *vmthread, int intersect
+        ) {
+    assert(STACK_TOP(vmthread->stack) >= 2);
+
+    valuecontent *vc = STACK_ENTRY(vmthread->stack, 1);
+    assert(vc->type == H64VALTYPE_GCVAL);
+    h64gcvalue *gcvalue = (h64gcvalue *)vc->ptr_value;
+    valuecontent *vother = STACK_ENTRY(vmthread->stack, 0);
+    if (gcvalue->type != H64GCVALUETYPE_SET ||
+            vother->type != H64VALTYPE_GCVAL ||
+            ((h64gcvalue *)vother->ptr_value)->type !=
+                H64GCVALUETYPE_SET) {
+        return vmexec_ReturnFuncError(
+            vmthread, H64STDERROR_TYPEERROR,
+            "set operation requires two sets"
+        );
+    }
+    genericset *other = ((h64gcvalue *)vother->ptr_value)->set_values;
+
+    valuecontent vresult = {0};
+    vresult.type = H64VALTYPE_GCVAL;
+    vresult.ptr_value = poolalloc_malloc(vmthread->heap, 0);
+    if (!vresult.ptr_value) {
+        oom: ;
+        return vmexec_ReturnFuncError(
+            vmthread, H64STDERROR_OUTOFMEMORYERROR,
+            "out of memory computing set result"
+        );
+    }
+    h64gcvalue *gcresult = (h64gcvalue *)vresult.ptr_value;
+    memset(gcresult, 0, sizeof(*gcresult));
+    gcresult->type = H64GCVALUETYPE_SET;
+    gcresult->externalreferencecount = 1;
+    gcresult->set_values = vmset_New();
+    if (!gcresult->set_values) {
+        poolalloc_free(vmthread->heap, gcresult);
+        goto oom;
+    }
+    int result;
+    if (intersect) {
+        result = vmset_AddIntersection(
+            vmthread, gcresult->set_values, gcvalue->set_values, other
+        );
+    } else {
+        result = (
+            vmset_AddAll(
+                vmthread, gcresult->set_values, gcvalue->set_values
+            ) && vmset_AddAll(vmthread, gcresult->set_values, other)
+        );
+    }
+    if (!result) {
+        DELREF_NONHEAP(&vresult);
+        vmset_Free(vmthread, gcresult->set_values);
+        poolalloc_free(vmthread->heap, gcresult);
+        goto oom;
+    }
+
+    valuecontent *vtarget = STACK_ENTRY(vmthread->stack, 0);
+    DELREF_NONHEAP(vtarget);
+    valuecontent_Free(vmthread, vtarget);
+    memcpy(vtarget, &vresult, sizeof(vresult));
+    return 1;
+}
+
+int corelib_containerunion(  // $$builtin.$$container_union
+        h64vmthread *vmthread
+        ) {
+    return _corelib_containersetop(vmthread, 0);
+}
+
+int corelib_containerintersection(
+        // $$builtin.$$container_intersection
+        h64vmthread *vmthread
+        ) {
+    return _corelib_containersetop(vmthread, 1);
+}
+
 typedef struct _containerjoin_map_iteratedata {
     genericmap *map;
     h64wchar *result;
@@ -424,6 +661,10 @@ int corelib_containercontains(  // $$builtin.$$container_contains
         result = vmmap_Contains(vmthread, gcvalue->map_values,
             STACK_ENTRY(vmthread->stack, 0), &inneroom
         );
+    } else if (gcvalue->type == H64GCVALUETYPE_SET) {
+        result = vmset_Contains(vmthread, gcvalue->set_values,
+            STACK_ENTRY(vmthread->stack, 0), &inneroom
+        );
     }
     if (!result && inneroom) {
         return vmexec_ReturnFuncError(
@@ -498,9 +739,29 @@ funcid_t corelib_GetContainerFuncIdx(
     int i = 0;
     while (i < p->container_indexes.func_count) {
         if (p->container_indexes.func_name_idx[i] == nameidx) {
+            int isvectorfunc = (
+                strcmp(p->container_indexes.func_name[i], "dot") == 0 ||
+                strcmp(p->container_indexes.func_name[i], "sum") == 0 ||
+                strcmp(p->container_indexes.func_name[i], "min") == 0 ||
+                strcmp(p->container_indexes.func_name[i], "max") == 0
+            );
+            if ((container_type == CORELIB_CONTAINERTYPE_VECTOR) !=
+                    isvectorfunc)
+                return -1;  // vectors only have these, and vice versa
             if (container_type == H64GCVALUETYPE_MAP &&
                     strcmp(p->container_indexes.func_name[i], "add") == 0)
                 return -1;  // maps have no .add()
+            if (container_type != H64GCVALUETYPE_MAP &&
+                    container_type != H64GCVALUETYPE_SET &&
+                    strcmp(p->container_indexes.func_name[i],
+                        "remove") == 0)
+                return -1;  // only maps and sets have .remove()
+            if (container_type != H64GCVALUETYPE_SET && (
+                    strcmp(p->container_indexes.func_name[i],
+                        "union") == 0 ||
+                    strcmp(p->container_indexes.func_name[i],
+                        "intersection") == 0))
+                return -1;  // only sets have these
             if (strcmp(p->container_indexes.func_name[i],
                     "join") == 0) {
                 if (container_type == H64GCVALUETYPE_MAP &&
@@ -551,6 +812,83 @@ int corelib_RegisterContainerFuncs(h64program *p) {
     if (!corelib_RegisterContainersFunc(p, "contains", idx))
         return 0;
 
+    // '$$container_remove' function:
+    idx = h64program_RegisterCFunction(
+        p, "$$container_remove", &corelib_containerremove,
+        NULL, 0, 1, NULL, NULL, NULL, 1, -1
+    );
+    if (idx < 0)
+        return 0;
+    p->func[idx].input_stack_size++;  // for 'self'
+    if (!corelib_RegisterContainersFunc(p, "remove", idx))
+        return 0;
+
+    // '$$container_union' function:
+    idx = h64program_RegisterCFunction(
+        p, "$$container_union", &corelib_containerunion,
+        NULL, 0, 1, NULL, NULL, NULL, 1, -1
+    );
+    if (idx < 0)
+        return 0;
+    p->func[idx].input_stack_size++;  // for 'self'
+    if (!corelib_RegisterContainersFunc(p, "union", idx))
+        return 0;
+
+    // '$$container_intersection' function:
+    idx = h64program_RegisterCFunction(
+        p, "$$container_intersection", &corelib_containerintersection,
+        NULL, 0, 1, NULL, NULL, NULL, 1, -1
+    );
+    if (idx < 0)
+        return 0;
+    p->func[idx].input_stack_size++;  // for 'self'
+    if (!corelib_RegisterContainersFunc(p, "intersection", idx))
+        return 0;
+
+    // '$$vector_dot' function:
+    idx = h64program_RegisterCFunction(
+        p, "$$vector_dot", &corelib_vectordot,
+        NULL, 0, 1, NULL, NULL, NULL, 1, -1
+    );
+    if (idx < 0)
+        return 0;
+    p->func[idx].input_stack_size++;  // for 'self'
+    if (!corelib_RegisterContainersFunc(p, "dot", idx))
+        return 0;
+
+    // '$$vector_sum' function:
+    idx = h64program_RegisterCFunction(
+        p, "$$vector_sum", &corelib_vectorsum,
+        NULL, 0, 0, NULL, NULL, NULL, 1, -1
+    );
+    if (idx < 0)
+        return 0;
+    p->func[idx].input_stack_size++;  // for 'self'
+    if (!corelib_RegisterContainersFunc(p, "sum", idx))
+        return 0;
+
+    // '$$vector_min' function:
+    idx = h64program_RegisterCFunction(
+        p, "$$vector_min", &corelib_vectormin,
+        NULL, 0, 0, NULL, NULL, NULL, 1, -1
+    );
+    if (idx < 0)
+        return 0;
+    p->func[idx].input_stack_size++;  // for 'self'
+    if (!corelib_RegisterContainersFunc(p, "min", idx))
+        return 0;
+
+    // '$$vector_max' function:
+    idx = h64program_RegisterCFunction(
+        p, "$$vector_max", &corelib_vectormax,
+        NULL, 0, 0, NULL, NULL, NULL, 1, -1
+    );
+    if (idx < 0)
+        return 0;
+    p->func[idx].input_stack_size++;  // for 'self'
+    if (!corelib_RegisterContainersFunc(p, "max", idx))
+        return 0;
+
     // '$$container_join_map' function:
     idx = h64program_RegisterCFunction(
         p, "$$container_join_map", &corelib_containerjoin_map,
@@ -15,7 +15,9 @@ int corelib_RegisterContainerFuncs(h64program *p);
 
 funcid_t corelib_GetContainerFuncIdx(
     h64program *p, int64_t nameidx, int container_type
-);
+);  // container_type is a H64GCVALUETYPE_* value, or the following:
+
+#define CORELIB_CONTAINERTYPE_VECTOR (-1)  // for H64VALTYPE_VECTOR
 
 typedef struct h64moduleless_containers_indexes {
     int func_count;
@@ -15,6 +15,7 @@
 #include "nonlocale.h"
 #include "poolalloc.h"
 #include "stack.h"
+#include "strsearch.h"
 #include "valuecontentstruct.h"
 #include "vmexec.h"
 #include "vmlist.h"
@@ -118,22 +119,46 @@ static int _contains_or_find(
 
         // Return result:
         if (likely(paramlen) > 0) {
+            // Search by code points, then make sure the match starts
+            // at a letter boundary. The cursor only ever moves forward,
+            // so the letter walk is linear overall:
             int64_t found_at = -1;
-            int64_t charidx = 0;
-            int64_t i = 0;
-            while (i < slen) {
-                charidx++;
-                int charlen = utf32_letter_len(s + i, slen - i);
-                assert(charlen > 0);
-                if ((uint64_t)(paramlen) > (uint64_t)(slen - i))
+            int64_t cursor = 0;
+            int64_t cursorletter = 0;
+            int64_t pos = 0;
+            while (pos <= slen - paramlen) {
+                int64_t p = strsearch_FindU32(
+                    s + pos, slen - pos, params, paramlen
+                );
+                if (p < 0)
                     break;
-                if (memcmp(s + i, params,
-                        paramlen * sizeof(*params)
-                        ) == 0) {
-                    found_at = charidx;
+                p += pos;
+                if (iscontains && (p == 0 ||
+                        (s[p - 1] < 0x80 && s[p] < 0x80))) {
+                    // No ASCII pair is ever part of the same letter.
+                    found_at = 1;
                     break;
                 }
-                i += charlen;
+                while (cursor < p) {
+                    if (s[cursor] < 0x80 && (cursor + 1 >= slen ||
+                            s[cursor + 1] < 0x80)) {
+                        cursor++;
+                    } else {
+                        int64_t letterlen = utf32_letter_len(
+                            s + cursor, slen - cursor
+                        );
+                        assert(letterlen > 0);
+                        cursor += letterlen;
+                    }
+                    cursorletter++;
+                }
+                if (cursor == p) {
+                    found_at = cursorletter + 1;
+                    break;
+                }
+                // Match starts in the middle of a letter, so anything
+                // before the next letter does too:
+                pos = cursor;
             }
             if (found_at >= 0) {
                 valuecontent *vcresult = STACK_ENTRY(vmthread->stack, 0);
@@ -197,19 +222,9 @@ static int _contains_or_find(
 
         // Return result:
         if (likely(paramlen) > 0) {
-            int64_t found_at = -1;
-            int64_t i = 0;
-            while (i < slen) {
-                if ((uint64_t)(paramlen) >
-                        (uint64_t)(slen - i))
-                    break;
-                if (memcmp(s + i, params, paramlen
-                        ) == 0) {
-                    found_at = i;
-                    break;
-                }
-                i++;
-            }
+            int64_t found_at = strsearch_FindBytes(
+                s, slen, params, paramlen
+            );
             if (found_at >= 0) {
                 valuecontent *vcresult = STACK_ENTRY(vmthread->stack, 0);
                 DELREF_NONHEAP(vcresult);
@@ -342,158 +357,104 @@ int corelib_stringsplitlines(  // $$builtin.$$string_splitlines
         vc->type == H64VALTYPE_SHORTBYTES
     );
 
-    if (vc->type == H64VALTYPE_SHORTSTR || (
-            vc->type == H64VALTYPE_GCVAL &&
-            ((h64gcvalue *)vc->ptr_value)->type == H64GCVALUETYPE_STRING)) {
-        h64wchar *s = NULL;
-        int64_t slen = 0;
-        if (vc->type == H64VALTYPE_GCVAL) {
-            assert(((h64gcvalue *)vc->ptr_value)->type ==
-                   H64GCVALUETYPE_STRING);
-            s = ((h64gcvalue *)vc->ptr_value)->str_val.s;
-            slen = ((h64gcvalue *)vc->ptr_value)->str_val.len;
-        } else {
-            assert(vc->type == H64VALTYPE_SHORTSTR);
-            s = vc->shortstr_value;
-            slen = vc->shortstr_len;
-        }
-
-        // Compute split result as h64wchar * string array:
-        int64_t lines_count = 0;
-        h64wchar **lines_s = NULL;
-        int64_t *lines_slen = NULL;
-        int64_t current_line_start = 0;
-        int64_t i = 0;
-        while (i <= slen) {
-            if (i == slen || s[i] == '\r' || s[i] == '\n') {
-                int64_t linelen = i - current_line_start;
-                h64wchar *line = malloc(
-                    sizeof(*line) * (linelen > 0 ? linelen : 1)
-                );
-                if (!line) {
-                    oomstrsplit:
-                    free(line);
-                    int64_t i2 = 0;
-                    while (i2 < lines_count) {
-                        free(lines_s[i2]);
-                        i2++;
-                    }
-                    free(lines_s);
-                    free(lines_slen);
-                    return vmexec_ReturnFuncError(
-                        vmthread, H64STDERROR_OUTOFMEMORYERROR,
-                        "out of memory computing split result"
-                    );
-                }
-                if (linelen > 0)
-                    memcpy(line, &s[current_line_start],
-                        sizeof(*s) * linelen);
-                h64wchar **newlines_s = realloc(
-                    lines_s, sizeof(*newlines_s) * (lines_count + 1)
-                );
-                if (!newlines_s)
-                    goto oomstrsplit;
-                lines_s = newlines_s;
-                int64_t *newlines_slen = realloc(
-                    lines_slen, sizeof(*lines_slen) * (lines_count + 1)
-                );
-                if (!newlines_slen)
-                    goto oomstrsplit;
-                lines_slen = newlines_slen;
-                newlines_s[lines_count] = line;
-                newlines_slen[lines_count] = linelen;
-                line = NULL;
-                lines_count++;
-                if (i >= slen) {
-                    break;
-                }
-                i++;
-                if (s[i - 1] == '\r' && i < slen &&
-                        s[i] == '\n') {
-                    i++;
-                }
-                current_line_start = i;
-                continue;
-            }
-            i++;
-        }
+    // The result replaces our input on the stack, so keep our own
+    // reference to it while the lines are being copied out:
+    valuecontent vsource = *vc;
+    ADDREF_NONHEAP(&vsource);
+    int isbytes = 0;
+    h64wchar *s = NULL;
+    char *sbytes = NULL;
+    int64_t slen = 0;
+    if (vsource.type == H64VALTYPE_GCVAL &&
+            ((h64gcvalue *)vsource.ptr_value)->type ==
+                H64GCVALUETYPE_STRING) {
+        s = ((h64gcvalue *)vsource.ptr_value)->str_val.s;
+        slen = ((h64gcvalue *)vsource.ptr_value)->str_val.len;
+    } else if (vsource.type == H64VALTYPE_SHORTSTR) {
+        s = vsource.shortstr_value;
+        slen = vsource.shortstr_len;
+    } else if (vsource.type == H64VALTYPE_GCVAL) {
+        isbytes = 1;
+        sbytes = ((h64gcvalue *)vsource.ptr_value)->bytes_val.s;
+        slen = ((h64gcvalue *)vsource.ptr_value)->bytes_val.len;
+    } else {
+        isbytes = 1;
+        sbytes = vsource.shortbytes_value;
+        slen = vsource.shortbytes_len;
+    }
 
-        // Create an actual list type to return:
-        valuecontent *vcresult = STACK_ENTRY(vmthread->stack, 0);
-        DELREF_NONHEAP(vcresult);
-        valuecontent_Free(vmthread, vcresult);
-        vcresult->type = H64VALTYPE_GCVAL;
-        vcresult->ptr_value = poolalloc_malloc(
-            vmthread->heap, 0
+    // Create the list to return:
+    valuecontent *vcresult = STACK_ENTRY(vmthread->stack, 0);
+    DELREF_NONHEAP(vcresult);
+    valuecontent_Free(vmthread, vcresult);
+    memset(vcresult, 0, sizeof(*vcresult));
+    vcresult->type = H64VALTYPE_NONE;
+    h64gcvalue *gcval = poolalloc_malloc(
+        vmthread->heap, 0
+    );
+    if (!gcval) {
+        oomsplit:
+        DELREF_NONHEAP(&vsource);
+        valuecontent_Free(vmthread, &vsource);
+        return vmexec_ReturnFuncError(
+            vmthread, H64STDERROR_OUTOFMEMORYERROR,
+            "out of memory computing split result"
         );
-        if (!vcresult->ptr_value) {
-            oomstrfinalresult: ;
-            int64_t k = 0;
-            while (k < lines_count) {
-                free(lines_s[k]);
-                k++;
-            }
-            free(lines_s);
-            free(lines_slen);
-            return vmexec_ReturnFuncError(
-                vmthread, H64STDERROR_OUTOFMEMORYERROR,
-                "out of memory computing split result"
-            );
-        }
-        h64gcvalue *gcval = ((h64gcvalue *)vcresult->ptr_value);
-        memset(gcval, 0, sizeof(*gcval));
-        gcval->type = H64GCVALUETYPE_LIST;
-        gcval->heapreferencecount = 0;
-        gcval->externalreferencecount = 1;
-        gcval->list_values = vmlist_New();
-        if (!gcval->list_values) {
-            goto oomstrfinalresult;
-        }
-        // Add all our manual h64wchar * entries to the list:
-        genericlist *l = gcval->list_values;
-        int64_t k = 0;
-        while (k < lines_count) {
-            valuecontent vstring = {0};
-            if (!valuecontent_SetStringU32(
-                    vmthread, &vstring, lines_s[k], lines_slen[k]
-                    )) {
-                goto oomstrfinalresult;
-            }
-            ADDREF_NONHEAP(&vstring);
-            if (!vmlist_Set(l, k + 1, &vstring)) {
-                DELREF_NONHEAP(&vstring);
-                valuecontent_Free(vmthread, &vstring);
-                goto oomstrfinalresult;
-            }
-            DELREF_NONHEAP(&vstring);
-            valuecontent_Free(vmthread, &vstring);
-            k++;
-        }
-        // Free our manual list we no longer need:
-        k = 0;
-        while (k < lines_count) {
-            free(lines_s[k]);
-            k++;
-        }
-        free(lines_s);
-        free(lines_slen);
-        // Return result:
-        return 1;
-    } else {
-        char *s = NULL;
-        int64_t slen = 0;
-        if (vc->type == H64VALTYPE_GCVAL) {
-            assert(((h64gcvalue *)vc->ptr_value)->type ==
-                   H64GCVALUETYPE_BYTES);
-            s = ((h64gcvalue *)vc->ptr_value)->bytes_val.s;
-            slen = ((h64gcvalue *)vc->ptr_value)->bytes_val.len;
-        } else {
-            assert(vc->type == H64VALTYPE_SHORTBYTES);
-            s = vc->shortbytes_value;
-            slen = vc->shortbytes_len;
+    }
+    memset(gcval, 0, sizeof(*gcval));
+    gcval->type = H64GCVALUETYPE_LIST;
+    gcval->heapreferencecount = 0;
+    gcval->externalreferencecount = 1;
+    gcval->list_values = vmlist_New();
+    if (!gcval->list_values) {
+        poolalloc_free(vmthread->heap, gcval);
+        goto oomsplit;
+    }
+    vcresult->type = H64VALTYPE_GCVAL;
+    vcresult->ptr_value = gcval;
+
+    // Add the lines, breaking at "\r", "\n", or "\r\n":
+    genericlist *l = gcval->list_values;
+    int64_t lines_count = 0;
+    int64_t i = 0;
+    while (1) {
+        int64_t linelen = (
+            isbytes ? strsearch_FindLineBreakBytes(
+                sbytes + i, slen - i
+            ) : strsearch_FindLineBreakU32(s + i, slen - i)
+        );
+        if (linelen < 0)
+            linelen = slen - i;
+        valuecontent vline = {0};
+        if (!(isbytes ? valuecontent_SetBytesU8(
+                    vmthread, &vline, (uint8_t *)sbytes + i, linelen
+                ) : valuecontent_SetStringU32(
+                    vmthread, &vline, s + i, linelen
+                )))
+            goto oomsplit;
+        ADDREF_NONHEAP(&vline);
+        if (!vmlist_Set(l, lines_count + 1, &vline)) {
+            DELREF_NONHEAP(&vline);
+            valuecontent_Free(vmthread, &vline);
+            goto oomsplit;
         }
-        assert(0);  // FIXME
+        DELREF_NONHEAP(&vline);
+        valuecontent_Free(vmthread, &vline);
+        lines_count++;
+        i += linelen;
+        if (i >= slen)
+            break;
+        int isreturn = (
+            isbytes ? (sbytes[i] == '\r') : (s[i] == '\r')
+        );
+        i++;
+        if (isreturn && i < slen &&
+                (isbytes ? (sbytes[i] == '\n') : (s[i] == '\n')))
+            i++;
     }
+    DELREF_NONHEAP(&vsource);
+    valuecontent_Free(vmthread, &vsource);
+    return 1;
 }
 
 int corelib_stringsub(  // $$builtin.$$string_sub
@@ -541,10 +502,12 @@ int corelib_stringsub(  // $$builtin.$$string_sub
         h64wchar *s = NULL;
         int64_t slen = 0;
         int64_t sletters = 0;
+        h64stringval *gcstr = NULL;
         if (vc->type == H64VALTYPE_GCVAL) {
             assert(((h64gcvalue *)vc->ptr_value)->type ==
                    H64GCVALUETYPE_STRING);
             h64gcvalue *gcv = ((h64gcvalue *)vc->ptr_value);
+            gcstr = &gcv->str_val;
             vmstrings_RequireLetterLen(&gcv->str_val);
             s = gcv->str_val.s;
             slen = gcv->str_val.len;
@@ -571,21 +534,19 @@ int corelib_stringsub(  // $$builtin.$$string_sub
             vcresult->shortstr_len = 0;
             return 1;
         }
-        int64_t scopylen = 0;
-        h64wchar *scopy = malloc(
-            (slen > 1 ? slen : 1) * sizeof(*scopy)
-        );
-        if (!scopy)
-            return vmexec_ReturnFuncError(
-                vmthread, H64STDERROR_OUTOFMEMORYERROR,
-                "out of memory returning substring"
-            );
-        if (startindex == 1 && endindex == sletters) {
-            memcpy(scopy, s, slen * sizeof(*scopy));
-            scopylen = slen;
-        } else {
-            int16_t startcodepoint = 0;
-            {
+        int64_t startcodepoint = 0;
+        int64_t endcodepoint = slen;
+        if (startindex != 1 || endindex != sletters) {
+            endcodepoint = 0;
+            if (gcstr != NULL) {
+                // Long strings have a letter index to skip ahead:
+                startcodepoint = vmstrings_LetterToCodepointOffset(
+                    gcstr, startindex - 1
+                );
+                endcodepoint = vmstrings_LetterToCodepointOffset(
+                    gcstr, endindex
+                );
+            } else {
                 const h64wchar *p = s;
                 int64_t plen = slen;
                 int64_t k = startindex;
@@ -598,12 +559,8 @@ int corelib_stringsub(  // $$builtin.$$string_sub
                     p += letterlen;
                     plen -= letterlen;
                 }
-            }
-            int16_t endcodepoint = 0;
-            {
-                const h64wchar *p = s;
-                int64_t plen = slen;
-                int64_t k = endindex;
+                endcodepoint = startcodepoint;
+                k = endindex - startindex + 1;
                 while (k > 0 && plen > 0) {  // k > 0 -> EXCLUSIVE end
                     int letterlen = utf32_letter_len(
                         p, plen
@@ -614,22 +571,18 @@ int corelib_stringsub(  // $$builtin.$$string_sub
                     plen -= letterlen;
                 }
             }
-            memcpy(
-                scopy, s + startcodepoint,
-                (endcodepoint - startcodepoint) * sizeof(*scopy)
-            );
-            scopylen = (endcodepoint - startcodepoint);
         }
+        // (The result is copied right from the original, which
+        // is a different stack slot.)
         if (!valuecontent_SetStringU32(
-                vmthread, vcresult, scopy, scopylen
+                vmthread, vcresult, s + startcodepoint,
+                endcodepoint - startcodepoint
                 )) {
-            free(scopy);
             return vmexec_ReturnFuncError(
                 vmthread, H64STDERROR_OUTOFMEMORYERROR,
                 "out of memory returning substring"
             );
         }
-        free(scopy);
         ADDREF_NONHEAP(vcresult);
         return 1;
     } else {
@@ -29,6 +29,26 @@ uint64_t datetime_Ticks() {
     #endif
 }
 
+uint64_t datetime_MicroTicks() {
+    #if defined(_WIN32) || defined(_WIN64)
+    LARGE_INTEGER freq, count;
+    if (!QueryPerformanceFrequency(&freq) ||
+            !QueryPerformanceCounter(&count) || freq.QuadPart <= 0)
+        return GetTickCount64() * 1000ULL;
+    return (
+        ((uint64_t)count.QuadPart / (uint64_t)freq.QuadPart) * 1000000ULL +
+        (((uint64_t)count.QuadPart % (uint64_t)freq.QuadPart) *
+         1000000ULL) / (uint64_t)freq.QuadPart
+    );
+    #else
+    struct timespec spec;
+    clock_gettime(CLOCK_MONOTONIC, &spec);
+    uint64_t us1 = ((uint64_t)spec.tv_sec) * 1000000ULL;
+    uint64_t us2 = ((uint64_t)spec.tv_nsec) / 1000ULL;
+    return us1 + us2;
+    #endif
+}
+
 mutex *_nosuspendticksmutex = NULL;
 int64_t _nosuspendlastticks = 0;
 int64_t _nosuspendoffset = 0;
@@ -456,6 +456,20 @@ uint64_t hash_ByteHash(
     return hashval;
 }
 
+uint64_t hash_Int64Hash(uint64_t value) {
+    uint64_t k0, k1;
+    memcpy(&k0, global_hashsecret, sizeof(k0));
+    memcpy(&k1, global_hashsecret + sizeof(k0), sizeof(k1));
+    // splitmix64 finalizer, with the secret mixed in on both ends:
+    uint64_t x = value ^ k0;
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x ^ k1;
+}
+
 void hash_ClearMap(hashmap *map) {
     if (!map)
         return;
@@ -16,6 +16,10 @@ uint64_t hash_ByteHash(
     const char *bytes, uint64_t byteslen, uint8_t *hash
 );
 
+uint64_t hash_Int64Hash(uint64_t value);
+    // Keyed with the same global secret as hash_ByteHash(), but
+    // much cheaper for a single number.
+
 
 void hash_FreeMap(hashmap *map);
 
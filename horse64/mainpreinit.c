@@ -22,8 +22,6 @@
 #include "packageversion.h"
 #include "vfs.h"
 
-void _load_unicode_data();  // widechar.c
-
 static int _didpreinit = 0;
 
 void main_PreInit() {
@@ -38,9 +36,6 @@ void main_PreInit() {
     #endif
 
     vfs_Init();
-
-    // Load up unicode tables for widechar.c:
-    _load_unicode_data();
 }
 
 void main_OutputVersionLong() {
@@ -2,97 +2,182 @@
 // also see LICENSE.md file.
 // SPDX-License-Identifier: BSD-2-Clause
 
+#include "compileconfig.h"
+
 #include <assert.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#if defined(_WIN32) || defined(_WIN64)
+#include <malloc.h>
+#endif
 
 #include "poolalloc.h"
+#include "vmstats.h"
+
+// Pool areas are allocated at an alignment equal to their size, such
+// that the owning area header of any item can be found by masking the
+// item address. Free slots are chained into an intrusive per-area free
+// list, and a bitmap over all areas tracks which have free slots left.
 
 #define FIRSTPOOLSIZE 256
+#define POOLAREA_MINBYTES (64 * 1024)
+#define POOLAREA_HEADERALIGN 16
 
-typedef struct pool {
-    int item_count;
-    char *poolarea;
-    int *slotused;
-    int possiblyfreeindex;
-} pool;
+typedef struct poolarea {
+    poolalloc *owner;
+    int32_t index;
+    int32_t item_count, used_count;
+    int32_t untouched_offset;  // slots from here on were never used
+    char *items;
+    void *freelist;
+    uint64_t slotused[];  // one bit per slot
+} poolarea;
 
 typedef struct poolalloc {
     int allocsize;
-    int pools_count;
-    pool *pools;
-    int lastusedareaindex;
+    int32_t area_item_count;
+    size_t area_bytes;
+
+    int areas_count, areas_alloc;
+    poolarea **areas;
+    uint64_t *areahasfree;  // one bit per area index
+    int areahasfree_lowestword;
+    poolarea *lastusedarea;
 
     int64_t totalitems;
     int64_t freeitems;
 } poolalloc;
 
 
-int poolalloc_AddArea(poolalloc *poolac) {
-    pool *new_areas = realloc(
-        poolac->pools, sizeof(*poolac->pools) * (
-        poolac->pools_count + 1));
-    if (!new_areas)
-        return 0;
-    poolac->pools = new_areas;
-    poolac->pools_count++;
-    memset(
-        &poolac->pools[poolac->pools_count - 1], 0,
-        sizeof(*poolac->pools)
+static void *_poolalloc_AllocAligned(size_t bytes) {
+    #if defined(_WIN32) || defined(_WIN64)
+    return _aligned_malloc(bytes, bytes);
+    #else
+    void *result = NULL;
+    if (posix_memalign(&result, bytes, bytes) != 0)
+        return NULL;
+    return result;
+    #endif
+}
+
+static void _poolalloc_FreeAligned(void *ptr) {
+    #if defined(_WIN32) || defined(_WIN64)
+    _aligned_free(ptr);
+    #else
+    free(ptr);
+    #endif
+}
+
+static size_t _poolalloc_AreaHeaderSize(int32_t item_count) {
+    size_t header = sizeof(poolarea) + sizeof(uint64_t) * (
+        ((size_t)item_count + 63) / 64
     );
-    int pool_size = FIRSTPOOLSIZE;
-    if (poolac->pools_count > 1) {
-        assert(
-            poolac->pools[poolac->pools_count - 2].
-            item_count > 0
-        );
-        pool_size = poolac->pools[poolac->pools_count - 2].
-            item_count * 2;
-    }
-    assert(pool_size > 0);
-    poolac->pools[poolac->pools_count - 1].item_count = pool_size;
-    poolac->pools[poolac->pools_count - 1].poolarea = malloc(
-        pool_size * poolac->allocsize
+    return (
+        (header + POOLAREA_HEADERALIGN - 1) /
+        POOLAREA_HEADERALIGN
+    ) * POOLAREA_HEADERALIGN;
+}
+
+static ATTR_UNUSED inline poolarea *_poolalloc_PtrToArea(
+        poolalloc *poolac, void *ptr
+        ) {
+    return (poolarea *)(
+        (uintptr_t)ptr & ~((uintptr_t)poolac->area_bytes - 1)
     );
-    if (!poolac->pools[poolac->pools_count - 1].poolarea) {
-        poolac->pools_count--;
-        return 0;
+}
+
+static inline void _poolalloc_MarkAreaHasFree(
+        poolalloc *poolac, int32_t index
+        ) {
+    poolac->areahasfree[index / 64] |= ((uint64_t)1) << (index % 64);
+    if (index / 64 < poolac->areahasfree_lowestword)
+        poolac->areahasfree_lowestword = index / 64;
+}
+
+static inline void _poolalloc_MarkAreaFull(
+        poolalloc *poolac, int32_t index
+        ) {
+    poolac->areahasfree[index / 64] &= ~(((uint64_t)1) << (index % 64));
+}
+
+static poolarea *_poolalloc_FindAreaWithFree(poolalloc *poolac) {
+    const int words = (poolac->areas_alloc + 63) / 64;
+    int i = poolac->areahasfree_lowestword;
+    while (i < words) {
+        if (poolac->areahasfree[i] != 0) {
+            poolac->areahasfree_lowestword = i;
+            int32_t index = i * 64 + __builtin_ctzll(
+                poolac->areahasfree[i]
+            );
+            assert(index < poolac->areas_count);
+            return poolac->areas[index];
+        }
+        i++;
     }
-    poolac->pools[poolac->pools_count - 1].slotused = malloc(
-        sizeof(*poolac->pools[poolac->pools_count - 1].slotused) *
-        pool_size
-    );
-    if (!poolac->pools[poolac->pools_count - 1].slotused) {
-        free(poolac->pools[poolac->pools_count - 1].poolarea);
-        poolac->pools_count--;
-        return 0;
+    poolac->areahasfree_lowestword = words;
+    return NULL;
+}
+
+int poolalloc_AddArea(poolalloc *poolac) {
+    if (poolac->areas_count >= poolac->areas_alloc) {
+        int new_alloc = (
+            poolac->areas_alloc < 64 ? 64 : poolac->areas_alloc * 2
+        );
+        poolarea **new_areas = realloc(
+            poolac->areas, sizeof(*new_areas) * new_alloc
+        );
+        if (!new_areas)
+            return 0;
+        poolac->areas = new_areas;
+        uint64_t *new_hasfree = realloc(
+            poolac->areahasfree, sizeof(*new_hasfree) * (new_alloc / 64)
+        );
+        if (!new_hasfree)
+            return 0;
+        memset(
+            &new_hasfree[poolac->areas_alloc / 64], 0,
+            sizeof(*new_hasfree) * (
+                (new_alloc - poolac->areas_alloc) / 64
+            )
+        );
+        poolac->areahasfree = new_hasfree;
+        poolac->areas_alloc = new_alloc;
     }
-    memset(
-        poolac->pools[poolac->pools_count - 1].slotused, 0,
-        sizeof(*poolac->pools[poolac->pools_count - 1].slotused) *
-        pool_size
+    poolarea *area = _poolalloc_AllocAligned(poolac->area_bytes);
+    if (!area)
+        return 0;
+    const size_t header = _poolalloc_AreaHeaderSize(
+        poolac->area_item_count
     );
-    assert(pool_size > 0);
-    poolac->freeitems += pool_size;
-    poolac->totalitems += pool_size;
-    poolac->lastusedareaindex = poolac->pools_count - 1;
+    memset(area, 0, header);
+    area->owner = poolac;
+    area->index = poolac->areas_count;
+    area->item_count = poolac->area_item_count;
+    area->items = (char *)area + header;
+    assert(area->items + (size_t)area->item_count * poolac->allocsize <=
+           (char *)area + poolac->area_bytes);
+    poolac->areas[poolac->areas_count] = area;
+    poolac->areas_count++;
+    VMSTATS_INC(poolalloc_area_count);
+    _poolalloc_MarkAreaHasFree(poolac, area->index);
+    poolac->freeitems += area->item_count;
+    poolac->totalitems += area->item_count;
+    poolac->lastusedarea = area;
     return 1;
 }
 
 void poolalloc_Destroy(poolalloc *poolac) {
     if (!poolac)
         return;
-    if (poolac->pools) {
-        int i = 0;
-        while (i < poolac->pools_count) {
-            free(poolac->pools[i].poolarea);
-            free(poolac->pools[i].slotused);
-            i++;
-        }
-        free(poolac->pools);
+    int i = 0;
+    while (i < poolac->areas_count) {
+        _poolalloc_FreeAligned(poolac->areas[i]);
+        i++;
     }
+    free(poolac->areas);
+    free(poolac->areahasfree);
     free(poolac);
 }
 
@@ -103,7 +188,24 @@ poolalloc *poolalloc_New(int itemsize) {
     if (!poolac)
         return NULL;
     memset(poolac, 0, sizeof(*poolac));
+
+    // Free slots hold the free list pointer, so round up to that:
+    if (itemsize % sizeof(void *) != 0)
+        itemsize += sizeof(void *) - (itemsize % sizeof(void *));
     poolac->allocsize = itemsize;
+
+    // Pick a power of two area size that fits at least FIRSTPOOLSIZE:
+    poolac->area_bytes = POOLAREA_MINBYTES;
+    while (_poolalloc_AreaHeaderSize(FIRSTPOOLSIZE) +
+            (size_t)FIRSTPOOLSIZE * itemsize > poolac->area_bytes)
+        poolac->area_bytes *= 2;
+    int32_t count = (poolac->area_bytes - sizeof(poolarea)) / itemsize;
+    while (_poolalloc_AreaHeaderSize(count) +
+            (size_t)count * itemsize > poolac->area_bytes)
+        count--;
+    assert(count >= FIRSTPOOLSIZE);
+    poolac->area_item_count = count;
+
     if (!poolalloc_AddArea(poolac)) {
         poolalloc_Destroy(poolac);
         return NULL;
@@ -112,32 +214,26 @@ poolalloc *poolalloc_New(int itemsize) {
 }
 
 void poolalloc_free(poolalloc *poolac, void *ptr) {
-    int j = 0;
-    while (j < poolac->pools_count) {
-        const int c = poolac->pools[j].item_count;
-        int k = 0;
-        while (k < c) {
-            if ((char*)ptr >= poolac->pools[j].poolarea &&
-                    (char*)ptr < poolac->pools[j].poolarea +
-                    poolac->allocsize * c) {
-                int64_t offset = (
-                    ((char*)ptr - poolac->pools[j].poolarea)
-                );
-                offset /= poolac->allocsize;
-                assert(offset >= 0 && offset < c);
-                assert(poolac->pools[j].slotused[offset]);
-                poolac->pools[j].slotused[offset] = 0;
-                poolac->pools[j].possiblyfreeindex = offset;
-                poolac->lastusedareaindex = j;
-                poolac->freeitems++;
-                assert(poolac->freeitems <= poolac->totalitems);
-                return;
-            }
-            k++;
-        }
-        j++;
-    }
-    assert(0 && "failed to process free of poolalloc ptr");
+    poolarea *area = _poolalloc_PtrToArea(poolac, ptr);
+    assert(area->owner == poolac &&
+           "failed to process free of poolalloc ptr");
+    assert((char *)ptr >= area->items);
+    const int32_t slot = (int32_t)(
+        ((char *)ptr - area->items) / poolac->allocsize
+    );
+    assert(slot >= 0 && slot < area->untouched_offset);
+    assert(area->items + (size_t)slot * poolac->allocsize == ptr);
+    assert(area->slotused[slot / 64] & (((uint64_t)1) << (slot % 64)));
+    area->slotused[slot / 64] &= ~(((uint64_t)1) << (slot % 64));
+
+    *(void **)ptr = area->freelist;
+    area->freelist = ptr;
+    if (area->used_count == area->item_count)
+        _poolalloc_MarkAreaHasFree(poolac, area->index);
+    area->used_count--;
+    assert(area->used_count >= 0);
+    poolac->freeitems++;
+    assert(poolac->freeitems <= poolac->totalitems);
 }
 
 void *poolalloc_malloc(poolalloc *poolac,
@@ -150,58 +246,72 @@ void *poolalloc_malloc(poolalloc *poolac,
     if (poolac->freeitems <= 0)  // Adding new free items failed
         return 0;
 
-    if (poolac->lastusedareaindex >= 0 &&
-            poolac->lastusedareaindex < poolac->pools_count) {
-        // Try to add into last used pool area:
-        const int c = poolac->pools[poolac->lastusedareaindex].item_count;
-        int k = poolac->pools[poolac->lastusedareaindex].possiblyfreeindex;
-        if (k >= 0 && k < c &&
-                !poolac->pools[poolac->lastusedareaindex].slotused[k]) {
-            poolac->freeitems--;
-            assert(poolac->freeitems >= 0);
-            poolac->pools[poolac->lastusedareaindex].slotused[k] = 1;
-            poolac->pools[poolac->lastusedareaindex].
-                possiblyfreeindex = k + 1;
-            return poolac->pools[poolac->lastusedareaindex].poolarea + (
-                poolac->allocsize * k
-            );
-        }
-        k = 0;
-        while (k < c) {
-            if (!poolac->pools[poolac->lastusedareaindex].slotused[k]) {
-                poolac->freeitems--;
-                assert(poolac->freeitems >= 0);
-                poolac->pools[poolac->lastusedareaindex].slotused[k] = 1;
-                poolac->pools[poolac->lastusedareaindex].
-                    possiblyfreeindex = k + 1;
-                return poolac->pools[poolac->lastusedareaindex].poolarea + (
-                    poolac->allocsize * k
-                );
-            }
-            k++;
-        }
+    // Find an area with free slots, preferring the last one used:
+    poolarea *area = poolac->lastusedarea;
+    if (unlikely(!area || area->used_count >= area->item_count)) {
+        area = _poolalloc_FindAreaWithFree(poolac);
+        assert(area != NULL && "invalid pool, item used count is below"
+               " total but no area with free slots found");
+        poolac->lastusedarea = area;
+    }
+
+    // Take slot from the free list, or from the never used tail:
+    char *result;
+    int32_t slot;
+    if (area->freelist) {
+        result = area->freelist;
+        area->freelist = *(void **)result;
+        slot = (int32_t)(
+            (result - area->items) / poolac->allocsize
+        );
+    } else {
+        assert(area->untouched_offset < area->item_count);
+        slot = area->untouched_offset;
+        result = area->items + (size_t)slot * poolac->allocsize;
+        area->untouched_offset++;
     }
-    // See what pool area we can add this to:
-    int j = 0;
-    while (j < poolac->pools_count) {
-        const int c = poolac->pools[j].item_count;
-        int k = 0;
-        while (k < c) {
-            if (!poolac->pools[j].slotused[k]) {
-                poolac->freeitems--;
-                assert(poolac->freeitems >= 0);
-                poolac->lastusedareaindex = j;
-                poolac->pools[j].slotused[k] = 1;
-                poolac->pools[j].possiblyfreeindex = k + 1;
-                return poolac->pools[j].poolarea + (
-                    poolac->allocsize * k
-                );
+    assert(!(area->slotused[slot / 64] & (((uint64_t)1) << (slot % 64))));
+    area->slotused[slot / 64] |= ((uint64_t)1) << (slot % 64);
+    area->used_count++;
+    if (area->used_count == area->item_count)
+        _poolalloc_MarkAreaFull(poolac, area->index);
+    poolac->freeitems--;
+    assert(poolac->freeitems >= 0);
+    return result;
+}
+
+int poolalloc_OwnsPtr(poolalloc *poolac, void *ptr) {
+    if (!ptr)
+        return 0;
+    poolarea *area = _poolalloc_PtrToArea(poolac, ptr);
+    return (area->owner == poolac);
+}
+
+void *poolalloc_IterateUsed(poolalloc *poolac, int64_t *cursor) {
+    int64_t pos = *cursor;
+    if (pos < 0)
+        pos = 0;
+    int32_t areaindex = (int32_t)(pos / poolac->area_item_count);
+    int32_t slot = (int32_t)(pos % poolac->area_item_count);
+    while (areaindex < poolac->areas_count) {
+        poolarea *area = poolac->areas[areaindex];
+        while (slot < area->untouched_offset) {
+            uint64_t word = area->slotused[slot / 64] >> (slot % 64);
+            if (word == 0) {
+                slot = (slot / 64 + 1) * 64;
+                continue;
             }
-            k++;
+            slot += __builtin_ctzll(word);
+            if (slot >= area->untouched_offset)
+                break;
+            *cursor = (
+                (int64_t)areaindex * poolac->area_item_count + slot + 1
+            );
+            return area->items + (size_t)slot * poolac->allocsize;
         }
-        j++;
+        areaindex++;
+        slot = 0;
     }
-    assert(0 && "invalid pool, item used count is below"
-           " total but no slot found");
+    *cursor = 0;
     return NULL;
 }
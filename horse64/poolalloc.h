@@ -5,6 +5,8 @@
 #ifndef HORSE64_POOLALLOC_H_
 #define HORSE64_POOLALLOC_H_
 
+#include <stdint.h>
+
 typedef struct poolalloc poolalloc;
 
 poolalloc *poolalloc_New(int itemsize);
@@ -16,4 +18,12 @@ void *poolalloc_malloc(poolalloc *poolac,
 
 void poolalloc_free(poolalloc *poolac, void *ptr);
 
+void *poolalloc_IterateUsed(poolalloc *poolac, int64_t *cursor);
+    // Returns next allocated item at or after *cursor (start with 0),
+    // and advances *cursor past it. Returns NULL and resets *cursor
+    // to 0 once the end is reached.
+
+int poolalloc_OwnsPtr(poolalloc *poolac, void *ptr);
+    // Only valid for ptr obtained from any pool of the same item size.
+
 #endif  // HORSE64_POOLALLOC_H_
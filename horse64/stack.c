@@ -15,6 +15,7 @@
 #include "nonlocale.h"
 #include "vmlist.h"
 #include "stack.h"
+#include "vmstats.h"
 
 
 h64stack *stack_New() {
@@ -50,23 +51,36 @@ void stack_Free(h64stack *st, h64vmthread *vmthread) {
 void stack_Shrink(
         h64stack *st, h64vmthread *vmthread, int64_t total_entries
         ) {
+    // Note: this doesn't release any memory, so that calls and returns
+    // around some stack size don't keep reallocating. See stack_Trim().
     int64_t i = st->entry_count;
     while (i > total_entries) {
         stack_FreeEntry(st, vmthread, i - 1);
         i--;
     }
     st->entry_count = i;
-    if (st->alloc_count - ALLOC_MAXOVERSHOOT > st->entry_count) {
-        int64_t new_alloc = st->entry_count + ALLOC_OVERSHOOT;
-        valuecontent *new_entries = realloc(
-            st->entry, sizeof(*new_entries) * new_alloc
-        );
-        if (!new_entries) {
-            return;
-        }
-        st->entry = new_entries;
-        st->alloc_count = new_alloc;
-    }
+}
+
+void stack_Trim(h64stack *st) {
+    // Only give memory back if the stack stayed well below its
+    // allocation ever since the last trim, and then keep half of it:
+    int64_t peak = st->peak_entry_count;
+    if (peak < st->entry_count)
+        peak = st->entry_count;
+    st->peak_entry_count = st->entry_count;
+    if (st->alloc_count <= ALLOC_MINTRIMSIZE ||
+            (peak + ALLOC_OVERSHOOT) * 4 > st->alloc_count)
+        return;
+    int64_t new_alloc = st->alloc_count / 2;
+    if (new_alloc < ALLOC_MINTRIMSIZE)
+        new_alloc = ALLOC_MINTRIMSIZE;
+    valuecontent *new_entries = realloc(
+        st->entry, sizeof(*new_entries) * new_alloc
+    );
+    if (!new_entries)
+        return;
+    st->entry = new_entries;
+    st->alloc_count = new_alloc;
 }
 
 void stack_PrintDebug(h64stack *st) {
@@ -131,28 +145,26 @@ int stack_IncreaseAlloc(
     int alloc_optional_margin = alloc_needed_margin;
     if (alloc_optional_margin == 0)
         alloc_optional_margin = ALLOC_EMERGENCY_MARGIN;
+    // Grow geometrically, such that deep recursion is amortized O(1):
+    int64_t new_alloc = st->alloc_count * 2;
+    if (new_alloc < total_entries + alloc_optional_margin +
+            ALLOC_OVERSHOOT)
+        new_alloc = total_entries + alloc_optional_margin +
+            ALLOC_OVERSHOOT;
     valuecontent *new_entries = realloc(
-        st->entry, sizeof(*new_entries) *
-            (total_entries + alloc_optional_margin + ALLOC_OVERSHOOT)
+        st->entry, sizeof(*new_entries) * new_alloc
     );
     if (!new_entries) {
-        if (alloc_needed_margin > 0)
+        // Retry without the optional margin or overshoot:
+        new_alloc = total_entries + alloc_needed_margin;
+        new_entries = realloc(
+            st->entry, sizeof(*new_entries) * new_alloc
+        );
+        if (!new_entries)
             return 0;
-        if (total_entries > st->alloc_count) {
-            // Retry without the margin or overshoot:
-            valuecontent *new_entries = realloc(
-                st->entry, sizeof(*new_entries) *
-                    (total_entries)
-            );
-            if (!new_entries)
-                return 0;
-        }
     }
-    assert(new_entries != NULL);
+    VMSTATS_INC(stack_realloc_count);
     st->entry = new_entries;
-    st->alloc_count = (
-        total_entries + alloc_needed_margin + ALLOC_OVERSHOOT
-    );
+    st->alloc_count = new_alloc;
     return 1;
 }
-
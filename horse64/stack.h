@@ -15,12 +15,13 @@ typedef struct valuecontent valuecontent;
 typedef struct h64vmthread h64vmthread;
 
 #define ALLOC_OVERSHOOT 32
-#define ALLOC_MAXOVERSHOOT 4096
+#define ALLOC_MINTRIMSIZE 4096
 #define ALLOC_EMERGENCY_MARGIN 6
 
 
 typedef struct h64stack {
     int64_t entry_count, alloc_count;
+    int64_t peak_entry_count;  // highest entry_count since stack_Trim()
     int64_t current_func_floor;
     valuecontent *entry;
 } h64stack;
@@ -37,6 +38,8 @@ void stack_Shrink(
     h64stack *st, h64vmthread *vmthread, int64_t total_entries
 );
 
+void stack_Trim(h64stack *st);
+
 ATTR_UNUSED HOTSPOT static inline int stack_ToSize(
         h64stack *st, h64vmthread *vmthread,
         int64_t total_entries,
@@ -65,6 +68,8 @@ ATTR_UNUSED HOTSPOT static inline int stack_ToSize(
             sizeof(st->entry[st->entry_count]) * (
                 total_entries - st->entry_count
             ));
+        if (unlikely(total_entries > st->peak_entry_count))
+            st->peak_entry_count = total_entries;
     }
     st->entry_count = total_entries;
     return 1;
@@ -0,0 +1,305 @@
+// Copyright (c) 2020-2021, ellie/@ell1e & Horse64 Team (see AUTHORS.md),
+// also see LICENSE.md file.
+// SPDX-License-Identifier: BSD-2-Clause
+
+#include "compileconfig.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(USE_SSE_KERNELS) && defined(__GNUC__) && ( \
+    defined(__x86_64__) || defined(__i386__))
+#define STRSEARCH_X86
+#include <immintrin.h>
+#endif
+
+#include "strsearch.h"
+#include "widechar.h"
+
+// The substring search is the Two-Way algorithm, which is linear time
+// but compares one element at a time. Most windows get rejected on the
+// first comparison though, so it skips ahead to the next candidate with
+// a scan for a single element instead, which is what these kernels do.
+// Like in vmvector.c, the x86 kernels use per-function target
+// attributes and get picked at runtime.
+
+typedef struct strsearchkernels {
+    const char *name;
+    int64_t (*findchr_u32)(const h64wchar *s, int64_t slen, h64wchar c);
+    int64_t (*findlinebreak_u32)(const h64wchar *s, int64_t slen);
+    int64_t (*findlinebreak_u8)(const uint8_t *s, int64_t slen);
+} strsearchkernels;
+
+static int64_t _scalar_findchr_u32(
+        const h64wchar *s, int64_t slen, h64wchar c
+        ) {
+    int64_t i = 0;
+    while (i < slen) {
+        if (s[i] == c)
+            return i;
+        i++;
+    }
+    return -1;
+}
+
+static int64_t _scalar_findlinebreak_u32(
+        const h64wchar *s, int64_t slen
+        ) {
+    int64_t i = 0;
+    while (i < slen) {
+        if (s[i] == '\r' || s[i] == '\n')
+            return i;
+        i++;
+    }
+    return -1;
+}
+
+static int64_t _scalar_findlinebreak_u8(
+        const uint8_t *s, int64_t slen
+        ) {
+    int64_t i = 0;
+    while (i < slen) {
+        if (s[i] == '\r' || s[i] == '\n')
+            return i;
+        i++;
+    }
+    return -1;
+}
+
+static const strsearchkernels _strsearch_scalarkernels = {
+    "scalar", _scalar_findchr_u32, _scalar_findlinebreak_u32,
+    _scalar_findlinebreak_u8
+};
+
+#if defined(STRSEARCH_X86)
+#define SSE2_ATTR __attribute__((target("sse2")))
+#define AVX2_ATTR __attribute__((target("avx2")))
+
+SSE2_ATTR static int64_t _sse2_findchr_u32(
+        const h64wchar *s, int64_t slen, h64wchar c
+        ) {
+    const __m128i needle = _mm_set1_epi32((int)c);
+    int64_t i = 0;
+    while (i + 4 <= slen) {
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi32(
+            _mm_loadu_si128((const __m128i *)(s + i)), needle
+        ));
+        if (mask != 0)
+            return i + __builtin_ctz(mask) / 4;
+        i += 4;
+    }
+    int64_t rest = _scalar_findchr_u32(s + i, slen - i, c);
+    return (rest >= 0 ? i + rest : -1);
+}
+
+SSE2_ATTR static int64_t _sse2_findlinebreak_u32(
+        const h64wchar *s, int64_t slen
+        ) {
+    const __m128i cr = _mm_set1_epi32('\r');
+    const __m128i lf = _mm_set1_epi32('\n');
+    int64_t i = 0;
+    while (i + 4 <= slen) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+        int mask = _mm_movemask_epi8(_mm_or_si128(
+            _mm_cmpeq_epi32(v, cr), _mm_cmpeq_epi32(v, lf)
+        ));
+        if (mask != 0)
+            return i + __builtin_ctz(mask) / 4;
+        i += 4;
+    }
+    int64_t rest = _scalar_findlinebreak_u32(s + i, slen - i);
+    return (rest >= 0 ? i + rest : -1);
+}
+
+SSE2_ATTR static int64_t _sse2_findlinebreak_u8(
+        const uint8_t *s, int64_t slen
+        ) {
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i lf = _mm_set1_epi8('\n');
+    int64_t i = 0;
+    while (i + 16 <= slen) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+        int mask = _mm_movemask_epi8(_mm_or_si128(
+            _mm_cmpeq_epi8(v, cr), _mm_cmpeq_epi8(v, lf)
+        ));
+        if (mask != 0)
+            return i + __builtin_ctz(mask);
+        i += 16;
+    }
+    int64_t rest = _scalar_findlinebreak_u8(s + i, slen - i);
+    return (rest >= 0 ? i + rest : -1);
+}
+
+static const strsearchkernels _strsearch_sse2kernels = {
+    "sse2", _sse2_findchr_u32, _sse2_findlinebreak_u32,
+    _sse2_findlinebreak_u8
+};
+
+AVX2_ATTR static int64_t _avx2_findchr_u32(
+        const h64wchar *s, int64_t slen, h64wchar c
+        ) {
+    const __m256i needle = _mm256_set1_epi32((int)c);
+    int64_t i = 0;
+    while (i + 8 <= slen) {
+        int mask = _mm256_movemask_epi8(_mm256_cmpeq_epi32(
+            _mm256_loadu_si256((const __m256i *)(s + i)), needle
+        ));
+        if (mask != 0)
+            return i + __builtin_ctz(mask) / 4;
+        i += 8;
+    }
+    int64_t rest = _sse2_findchr_u32(s + i, slen - i, c);
+    return (rest >= 0 ? i + rest : -1);
+}
+
+AVX2_ATTR static int64_t _avx2_findlinebreak_u32(
+        const h64wchar *s, int64_t slen
+        ) {
+    const __m256i cr = _mm256_set1_epi32('\r');
+    const __m256i lf = _mm256_set1_epi32('\n');
+    int64_t i = 0;
+    while (i + 8 <= slen) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(s + i));
+        int mask = _mm256_movemask_epi8(_mm256_or_si256(
+            _mm256_cmpeq_epi32(v, cr), _mm256_cmpeq_epi32(v, lf)
+        ));
+        if (mask != 0)
+            return i + __builtin_ctz(mask) / 4;
+        i += 8;
+    }
+    int64_t rest = _sse2_findlinebreak_u32(s + i, slen - i);
+    return (rest >= 0 ? i + rest : -1);
+}
+
+AVX2_ATTR static int64_t _avx2_findlinebreak_u8(
+        const uint8_t *s, int64_t slen
+        ) {
+    const __m256i cr = _mm256_set1_epi8('\r');
+    const __m256i lf = _mm256_set1_epi8('\n');
+    int64_t i = 0;
+    while (i + 32 <= slen) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(s + i));
+        unsigned int mask = (unsigned int)_mm256_movemask_epi8(
+            _mm256_or_si256(
+                _mm256_cmpeq_epi8(v, cr), _mm256_cmpeq_epi8(v, lf)
+            ));
+        if (mask != 0)
+            return i + __builtin_ctz(mask);
+        i += 32;
+    }
+    int64_t rest = _sse2_findlinebreak_u8(s + i, slen - i);
+    return (rest >= 0 ? i + rest : -1);
+}
+
+static const strsearchkernels _strsearch_avx2kernels = {
+    "avx2", _avx2_findchr_u32, _avx2_findlinebreak_u32,
+    _avx2_findlinebreak_u8
+};
+#endif  // STRSEARCH_X86
+
+static const strsearchkernels *_strsearch_kernels = NULL;
+
+static const strsearchkernels *_strsearch_GetKernels() {
+    if (likely(_strsearch_kernels != NULL))
+        return _strsearch_kernels;
+    const strsearchkernels *k = &_strsearch_scalarkernels;
+    #if defined(STRSEARCH_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        k = &_strsearch_avx2kernels;
+    else if (__builtin_cpu_supports("sse2"))
+        k = &_strsearch_sse2kernels;
+    #endif
+    // Note: racing threads all pick the same, so this is harmless.
+    _strsearch_kernels = k;
+    return k;
+}
+
+const char *strsearch_KernelsName() {
+    return _strsearch_GetKernels()->name;
+}
+
+int strsearch_ForceKernels(const char *name) {
+    if (strcmp(name, "scalar") == 0) {
+        _strsearch_kernels = &_strsearch_scalarkernels;
+        return 1;
+    }
+    #if defined(STRSEARCH_X86)
+    __builtin_cpu_init();
+    if (strcmp(name, "sse2") == 0 && __builtin_cpu_supports("sse2")) {
+        _strsearch_kernels = &_strsearch_sse2kernels;
+        return 1;
+    }
+    if (strcmp(name, "avx2") == 0 && __builtin_cpu_supports("avx2")) {
+        _strsearch_kernels = &_strsearch_avx2kernels;
+        return 1;
+    }
+    #endif
+    return 0;
+}
+
+int64_t strsearch_FindCharU32(
+        const h64wchar *s, int64_t slen, h64wchar c
+        ) {
+    return _strsearch_GetKernels()->findchr_u32(s, slen, c);
+}
+
+int64_t strsearch_FindLineBreakU32(
+        const h64wchar *s, int64_t slen
+        ) {
+    return _strsearch_GetKernels()->findlinebreak_u32(s, slen);
+}
+
+int64_t strsearch_FindLineBreakBytes(
+        const char *s, int64_t slen
+        ) {
+    return _strsearch_GetKernels()->findlinebreak_u8(
+        (const uint8_t *)s, slen
+    );
+}
+
+static int64_t _strsearch_FindChrU8(
+        const uint8_t *s, int64_t slen, uint8_t c
+        ) {
+    // The C library's memchr() is already vectorized everywhere:
+    const uint8_t *p = memchr(s, c, slen);
+    return (p != NULL ? (p - s) : -1);
+}
+
+#define TWOWAY_FUNC _strsearch_TwoWayU32
+#define TWOWAY_FACTORIZEFUNC _strsearch_FactorizeU32
+#define TWOWAY_TYPE h64wchar
+#define TWOWAY_FINDCHR strsearch_FindCharU32
+#include "strsearch_twoway_INCLUDE.c"
+#undef TWOWAY_FUNC
+#undef TWOWAY_FACTORIZEFUNC
+#undef TWOWAY_TYPE
+#undef TWOWAY_FINDCHR
+
+#define TWOWAY_FUNC _strsearch_TwoWayU8
+#define TWOWAY_FACTORIZEFUNC _strsearch_FactorizeU8
+#define TWOWAY_TYPE uint8_t
+#define TWOWAY_FINDCHR _strsearch_FindChrU8
+#include "strsearch_twoway_INCLUDE.c"
+#undef TWOWAY_FUNC
+#undef TWOWAY_FACTORIZEFUNC
+#undef TWOWAY_TYPE
+#undef TWOWAY_FINDCHR
+
+int64_t strsearch_FindU32(
+        const h64wchar *s, int64_t slen,
+        const h64wchar *find, int64_t findlen
+        ) {
+    return _strsearch_TwoWayU32(s, slen, find, findlen);
+}
+
+int64_t strsearch_FindBytes(
+        const char *s, int64_t slen,
+        const char *find, int64_t findlen
+        ) {
+    return _strsearch_TwoWayU8(
+        (const uint8_t *)s, slen, (const uint8_t *)find, findlen
+    );
+}
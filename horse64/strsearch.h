@@ -0,0 +1,52 @@
+// Copyright (c) 2020-2021, ellie/@ell1e & Horse64 Team (see AUTHORS.md),
+// also see LICENSE.md file.
+// SPDX-License-Identifier: BSD-2-Clause
+
+#ifndef HORSE64_STRSEARCH_H_
+#define HORSE64_STRSEARCH_H_
+
+#include "compileconfig.h"
+
+#include <stdint.h>
+
+#include "widechar.h"
+
+int64_t strsearch_FindU32(
+    const h64wchar *s, int64_t slen,
+    const h64wchar *find, int64_t findlen
+);
+    // Returns the code point offset of the first occurrence of find
+    // in s, or -1 if there is none. An empty find matches at 0. This
+    // uses the Two-Way algorithm, so it is linear time even for
+    // nasty inputs, and a SIMD scan skips ahead between candidates.
+    // Note this knows nothing about letters, callers that care need
+    // to check the match starts at a letter boundary.
+
+int64_t strsearch_FindBytes(
+    const char *s, int64_t slen,
+    const char *find, int64_t findlen
+);
+    // Same as strsearch_FindU32(), but for bytes.
+
+int64_t strsearch_FindCharU32(
+    const h64wchar *s, int64_t slen, h64wchar c
+);
+    // Like memchr(), returns the offset of c in s or -1.
+
+int64_t strsearch_FindLineBreakU32(
+    const h64wchar *s, int64_t slen
+);
+    // Returns the offset of the first '\r' or '\n' in s, or -1.
+
+int64_t strsearch_FindLineBreakBytes(
+    const char *s, int64_t slen
+);
+    // Returns the offset of the first '\r' or '\n' in s, or -1.
+
+const char *strsearch_KernelsName();
+    // Name of the kernel set in use: "avx2", "sse2", or "scalar".
+
+int strsearch_ForceKernels(const char *name);
+    // For testing, returns 0 if not supported on this CPU.
+
+#endif  // HORSE64_STRSEARCH_H_
@@ -0,0 +1,141 @@
+// Copyright (c) 2020-2021, ellie/@ell1e & Horse64 Team (see AUTHORS.md),
+// also see LICENSE.md file.
+// SPDX-License-Identifier: BSD-2-Clause
+
+// The Two-Way string search (Crochemore & Perrin, 1991), included by
+// strsearch.c once per element type. Before including, define:
+//
+//   TWOWAY_FUNC: name of the search function to define
+//   TWOWAY_FACTORIZEFUNC: name of the helper function to define
+//   TWOWAY_TYPE: element type, e.g. h64wchar
+//   TWOWAY_FINDCHR(s, slen, c): offset of c in s, or -1
+//
+// The needle is split at a critical factorization into a left and a
+// right half. Every window compares the right half forward first and
+// the left half backward after, and a mismatch shifts the window in
+// a way that never needs to look at a haystack element twice except
+// for the periodic case, which remembers the already matched prefix.
+
+static int64_t TWOWAY_FACTORIZEFUNC(
+        const TWOWAY_TYPE *find, int64_t findlen, int64_t *period
+        ) {
+    if (findlen < 3) {
+        *period = 1;
+        return findlen - 1;
+    }
+
+    // Maximal suffix for the "<" ordering:
+    int64_t maxsuffix = -1;
+    int64_t j = 0;
+    int64_t k = 1;
+    int64_t p = 1;
+    while (j + k < findlen) {
+        TWOWAY_TYPE a = find[j + k];
+        TWOWAY_TYPE b = find[maxsuffix + k];
+        if (a < b) {
+            j += k;
+            k = 1;
+            p = j - maxsuffix;
+        } else if (a == b) {
+            if (k != p) {
+                k++;
+            } else {
+                j += p;
+                k = 1;
+            }
+        } else {
+            maxsuffix = j;
+            j++;
+            k = p = 1;
+        }
+    }
+    *period = p;
+
+    // Maximal suffix for the ">" ordering:
+    int64_t maxsuffixrev = -1;
+    j = 0;
+    k = p = 1;
+    while (j + k < findlen) {
+        TWOWAY_TYPE a = find[j + k];
+        TWOWAY_TYPE b = find[maxsuffixrev + k];
+        if (b < a) {
+            j += k;
+            k = 1;
+            p = j - maxsuffixrev;
+        } else if (a == b) {
+            if (k != p) {
+                k++;
+            } else {
+                j += p;
+                k = 1;
+            }
+        } else {
+            maxsuffixrev = j;
+            j++;
+            k = p = 1;
+        }
+    }
+
+    // The critical factorization is the longer of the two:
+    if (maxsuffixrev < maxsuffix)
+        return maxsuffix + 1;
+    *period = p;
+    return maxsuffixrev + 1;
+}
+
+static int64_t TWOWAY_FUNC(
+        const TWOWAY_TYPE *s, int64_t slen,
+        const TWOWAY_TYPE *find, int64_t findlen
+        ) {
+    if (findlen <= 0)
+        return 0;
+    if (findlen > slen)
+        return -1;
+    int64_t period = 1;
+    const int64_t suffix = TWOWAY_FACTORIZEFUNC(find, findlen, &period);
+    assert(suffix >= 0 && suffix < findlen);
+    const TWOWAY_TYPE suffixfirst = find[suffix];
+    const int periodic = (
+        suffix + period <= findlen &&
+        memcmp(find, find + period, sizeof(*find) * suffix) == 0
+    );
+    if (!periodic) {
+        // The halves are distinct, so any mismatch allows a maximal
+        // shift and no memory is needed:
+        period = (suffix > findlen - suffix ? suffix : findlen - suffix) + 1;
+    }
+    int64_t memory = 0;
+    int64_t j = 0;
+    while (j <= slen - findlen) {
+        if (memory == 0 && s[j + suffix] != suffixfirst) {
+            // The right half would mismatch right away, which would
+            // shift by just one. Instead, skip to the next spot where
+            // it doesn't:
+            int64_t skip = TWOWAY_FINDCHR(
+                s + j + suffix, slen - findlen - j + 1, suffixfirst
+            );
+            if (skip < 0)
+                return -1;
+            j += skip;
+        }
+        // Compare right half:
+        int64_t i = (suffix > memory ? suffix : memory);
+        while (i < findlen && find[i] == s[i + j])
+            i++;
+        if (i < findlen) {
+            j += i - suffix + 1;
+            memory = 0;
+            continue;
+        }
+        // Compare left half:
+        i = suffix - 1;
+        while (i >= memory && find[i] == s[i + j])
+            i--;
+        if (i < memory)
+            return j;
+        j += period;
+        if (periodic)
+            memory = findlen - period;
+    }
+    return -1;
+}
@@ -0,0 +1,149 @@
+// Copyright (c) 2020-2021, ellie/@ell1e & Horse64 Team (see AUTHORS.md),
+// also see LICENSE.md file.
+// SPDX-License-Identifier: BSD-2-Clause
+
+#include <assert.h>
+#include <check.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "poolalloc.h"
+
+#include "testmain.h"
+
+START_TEST (test_poolalloc)
+{
+    poolalloc *poolac = poolalloc_New(24);
+    ck_assert(poolac != NULL);
+
+    // Fill up well beyond a single pool area:
+    const int count = 100000;
+    char **items = malloc(sizeof(*items) * count);
+    ck_assert(items != NULL);
+    int i = 0;
+    while (i < count) {
+        items[i] = poolalloc_malloc(poolac, 0);
+        ck_assert(items[i] != NULL);
+        memset(items[i], (i % 200) + 1, 24);
+        i++;
+    }
+
+    // Free every other item, and make sure the others are intact:
+    i = 0;
+    while (i < count) {
+        poolalloc_free(poolac, items[i]);
+        items[i] = NULL;
+        i += 2;
+    }
+    i = 1;
+    while (i < count) {
+        int k = 0;
+        while (k < 24) {
+            ck_assert(items[i][k] == (char)((i % 200) + 1));
+            k++;
+        }
+        i += 2;
+    }
+
+    // Allocate again, which must not clobber the remaining items:
+    i = 0;
+    while (i < count) {
+        items[i] = poolalloc_malloc(poolac, 0);
+        ck_assert(items[i] != NULL);
+        memset(items[i], 0, 24);
+        i += 2;
+    }
+    i = 1;
+    while (i < count) {
+        ck_assert(items[i][0] == (char)((i % 200) + 1));
+        ck_assert(items[i][23] == (char)((i % 200) + 1));
+        i += 2;
+    }
+
+    // Free everything in reverse order:
+    i = count - 1;
+    while (i >= 0) {
+        poolalloc_free(poolac, items[i]);
+        i--;
+    }
+    free(items);
+    poolalloc_Destroy(poolac);
+}
+END_TEST
+
+START_TEST (test_poolalloc_largeitems)
+{
+    poolalloc *poolac = poolalloc_New(4000);
+    ck_assert(poolac != NULL);
+    void *items[600];
+    int i = 0;
+    while (i < 600) {
+        items[i] = poolalloc_malloc(poolac, 0);
+        ck_assert(items[i] != NULL);
+        ck_assert(((uintptr_t)items[i]) % sizeof(void *) == 0);
+        memset(items[i], 0xAB, 4000);
+        i++;
+    }
+    i = 0;
+    while (i < 600) {
+        poolalloc_free(poolac, items[i]);
+        i++;
+    }
+    poolalloc_Destroy(poolac);
+}
+END_TEST
+
+START_TEST (test_poolalloc_iterateused)
+{
+    poolalloc *poolac = poolalloc_New(48);
+    ck_assert(poolac != NULL);
+    const int count = 5000;
+    void **items = malloc(sizeof(*items) * count);
+    ck_assert(items != NULL);
+    int i = 0;
+    while (i < count) {
+        items[i] = poolalloc_malloc(poolac, 0);
+        ck_assert(items[i] != NULL);
+        ck_assert(poolalloc_OwnsPtr(poolac, items[i]));
+        i++;
+    }
+    i = 0;
+    while (i < count) {
+        if (i % 3 != 0)
+            poolalloc_free(poolac, items[i]);
+        i++;
+    }
+
+    // Every remaining item must be visited exactly once:
+    int64_t cursor = 0;
+    int visited = 0;
+    void *item;
+    while ((item = poolalloc_IterateUsed(poolac, &cursor)) != NULL) {
+        int found = 0;
+        i = 0;
+        while (i < count) {
+            if (items[i] == item) {
+                ck_assert(i % 3 == 0);
+                found = 1;
+                break;
+            }
+            i++;
+        }
+        ck_assert(found);
+        visited++;
+    }
+    ck_assert(visited == (count + 2) / 3);
+    ck_assert(cursor == 0);
+
+    poolalloc *otherpoolac = poolalloc_New(48);
+    ck_assert(otherpoolac != NULL);
+    ck_assert(!poolalloc_OwnsPtr(otherpoolac, items[0]));
+    poolalloc_Destroy(otherpoolac);
+
+    free(items);
+    poolalloc_Destroy(poolac);
+}
+END_TEST
+
+TESTS_MAIN(test_poolalloc, test_poolalloc_largeitems,
+           test_poolalloc_iterateused)
@@ -30,4 +30,46 @@ START_TEST (test_stack)
 }
 END_TEST
 
-TESTS_MAIN(test_stack)
+START_TEST (test_stack_growth)
+{
+    main_PreInit();
+
+    h64stack *stack = stack_New();
+
+    // Growing one by one must only reallocate a few times:
+    int reallocs = 0;
+    int64_t last_alloc = STACK_ALLOC_SIZE(stack);
+    int64_t i = 1;
+    while (i <= 100000) {
+        ck_assert(stack_ToSize(stack, NULL, i, 0));
+        if (STACK_ALLOC_SIZE(stack) != last_alloc) {
+            last_alloc = STACK_ALLOC_SIZE(stack);
+            reallocs++;
+        }
+        i++;
+    }
+    ck_assert(reallocs < 20);
+
+    // Oscillating up and down must not reallocate at all:
+    ck_assert(stack_ToSize(stack, NULL, 10, 0));
+    i = 0;
+    while (i < 100) {
+        ck_assert(stack_ToSize(stack, NULL, 5000, 0));
+        ck_assert(stack_ToSize(stack, NULL, 10, 0));
+        ck_assert(STACK_ALLOC_SIZE(stack) == last_alloc);
+        i++;
+    }
+
+    // Trimming only happens once the peak was low for a while:
+    stack_Trim(stack);
+    ck_assert(STACK_ALLOC_SIZE(stack) == last_alloc);
+    stack_Trim(stack);
+    ck_assert(STACK_ALLOC_SIZE(stack) < last_alloc);
+    ck_assert(STACK_ALLOC_SIZE(stack) >= ALLOC_MINTRIMSIZE);
+    ck_assert(STACK_TOTALSIZE(stack) == 10);
+
+    stack_Free(stack, NULL);
+}
+END_TEST
+
+TESTS_MAIN(test_stack, test_stack_growth)
@@ -0,0 +1,144 @@
+// Copyright (c) 2020-2021, ellie/@ell1e & Horse64 Team (see AUTHORS.md),
+// also see LICENSE.md file.
+// SPDX-License-Identifier: BSD-2-Clause
+
+#include <assert.h>
+#include <check.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "strsearch.h"
+#include "widechar.h"
+
+#include "testmain.h"
+
+static const char *kernelnames[] = {"scalar", "sse2", "avx2", NULL};
+
+static int64_t _naivefind(
+        const h64wchar *s, int64_t slen,
+        const h64wchar *find, int64_t findlen
+        ) {
+    int64_t i = 0;
+    while (i + findlen <= slen) {
+        if (memcmp(s + i, find, sizeof(*s) * findlen) == 0)
+            return i;
+        i++;
+    }
+    return -1;
+}
+
+START_TEST (test_strsearch_find)
+{
+    // Small alphabets give lots of periodic and near-miss needles:
+    h64wchar s[200];
+    h64wchar find[12];
+    char sbytes[200];
+    char findbytes[12];
+    uint64_t seed = 12345;
+    int k = 0;
+    while (kernelnames[k]) {
+        if (!strsearch_ForceKernels(kernelnames[k])) {
+            k++;
+            continue;
+        }
+        int round = 0;
+        while (round < 3000) {
+            int alphabet = 2 + round % 3;
+            int64_t slen = (round * 7) % 200;
+            int64_t findlen = 1 + (round % 11);
+            int64_t i = 0;
+            while (i < slen) {
+                seed = seed * 6364136223846793005ULL + 1;
+                s[i] = 0x1F600 + (seed >> 33) % alphabet;
+                sbytes[i] = (char)(0xF0 + (s[i] & 0xF));
+                i++;
+            }
+            i = 0;
+            while (i < findlen) {
+                seed = seed * 6364136223846793005ULL + 1;
+                find[i] = 0x1F600 + (seed >> 33) % alphabet;
+                findbytes[i] = (char)(0xF0 + (find[i] & 0xF));
+                i++;
+            }
+            if (round % 4 == 0 && slen >= findlen) {
+                // Make sure there is a match, sometimes at the end:
+                int64_t at = (round % 8 == 0 ? slen - findlen :
+                              (round * 13) % (slen - findlen + 1));
+                memcpy(s + at, find, sizeof(*s) * findlen);
+                memcpy(sbytes + at, findbytes, findlen);
+            }
+            int64_t expected = _naivefind(s, slen, find, findlen);
+            ck_assert(strsearch_FindU32(s, slen, find, findlen) ==
+                      expected);
+            ck_assert(strsearch_FindBytes(
+                sbytes, slen, findbytes, findlen
+            ) == expected);
+            round++;
+        }
+
+        // The classic bad case for naive search must still work:
+        h64wchar *big = malloc(sizeof(*big) * 100000);
+        ck_assert(big != NULL);
+        int64_t i = 0;
+        while (i < 100000) {
+            big[i] = 'a';
+            i++;
+        }
+        h64wchar needle[1000];
+        i = 0;
+        while (i < 1000) {
+            needle[i] = 'a';
+            i++;
+        }
+        needle[0] = 'b';
+        ck_assert(strsearch_FindU32(big, 100000, needle, 1000) == -1);
+        big[99000] = 'b';
+        ck_assert(strsearch_FindU32(big, 100000, needle, 1000) == 99000);
+        free(big);
+
+        ck_assert(strsearch_FindU32(s, 0, find, 0) == 0);
+        ck_assert(strsearch_FindBytes("abc", 3, "", 0) == 0);
+        ck_assert(strsearch_FindBytes("abc", 3, "abcd", 4) == -1);
+        k++;
+    }
+}
+END_TEST
+
+START_TEST (test_strsearch_linebreak)
+{
+    int k = 0;
+    while (kernelnames[k]) {
+        if (!strsearch_ForceKernels(kernelnames[k])) {
+            k++;
+            continue;
+        }
+        h64wchar s[70];
+        char sbytes[70];
+        int64_t len = 0;
+        while (len < 70) {
+            int64_t at = 0;
+            while (at <= len) {
+                int64_t i = 0;
+                while (i < len) {
+                    s[i] = (i == at ? (i % 2 ? '\r' : '\n') : 'x');
+                    sbytes[i] = (char)s[i];
+                    i++;
+                }
+                int64_t expected = (at < len ? at : -1);
+                ck_assert(strsearch_FindLineBreakU32(s, len) == expected);
+                ck_assert(strsearch_FindLineBreakBytes(sbytes, len) ==
+                          expected);
+                ck_assert(strsearch_FindCharU32(s, len, 'x') ==
+                          (at == 0 && len > 1 ? 1 : (len > 0 &&
+                           at != 0 ? 0 : -1)));
+                at++;
+            }
+            len++;
+        }
+        k++;
+    }
+}
+END_TEST
+
+TESTS_MAIN (test_strsearch_find, test_strsearch_linebreak)
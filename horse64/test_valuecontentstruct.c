@@ -0,0 +1,63 @@
+// Copyright (c) 2020-2021, ellie/@ell1e & Horse64 Team (see AUTHORS.md),
+// also see LICENSE.md file.
+// SPDX-License-Identifier: BSD-2-Clause
+
+#include <assert.h>
+#include <check.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "bytecode.h"
+#include "valuecontentstruct.h"
+
+#include "testmain.h"
+
+START_TEST (test_valuecontent_hash)
+{
+    // Equal values of different representation must hash the same:
+    valuecontent vint = {0};
+    vint.type = H64VALTYPE_INT64;
+    vint.int_value = 5;
+    valuecontent vfloat = {0};
+    vfloat.type = H64VALTYPE_FLOAT64;
+    vfloat.float_value = 5.0;
+    ck_assert(valuecontent_Hash(&vint) == valuecontent_Hash(&vfloat));
+
+    valuecontent vprealloc = {0};
+    ck_assert(valuecontent_SetPreallocStringU8(NULL, &vprealloc, "abc"));
+    ck_assert(vprealloc.type == H64VALTYPE_CONSTPREALLOCSTR);
+    valuecontent vshort = {0};
+    vshort.type = H64VALTYPE_SHORTSTR;
+    memcpy(vshort.shortstr_value, vprealloc.constpreallocstr_value,
+           sizeof(h64wchar) * 3);
+    vshort.shortstr_len = 3;
+    ck_assert(valuecontent_Hash(&vprealloc) ==
+              valuecontent_Hash(&vshort));
+    valuecontent_Free(NULL, &vprealloc);
+
+    // Anagrams and strings past a common prefix must not all collide:
+    const char *similar[] = {
+        "abc", "bca", "cab",
+        "https://example.com/path/a",
+        "https://example.com/path/b",
+        "https://example.com/path/c",
+        NULL
+    };
+    uint32_t hashes[6];
+    int i = 0;
+    while (similar[i]) {
+        valuecontent v = {0};
+        ck_assert(valuecontent_SetPreallocStringU8(NULL, &v, similar[i]));
+        hashes[i] = valuecontent_Hash(&v);
+        valuecontent_Free(NULL, &v);
+        int k = 0;
+        while (k < i) {
+            ck_assert(hashes[k] != hashes[i]);
+            k++;
+        }
+        i++;
+    }
+}
+END_TEST
+
+TESTS_MAIN(test_valuecontent_hash)
@@ -0,0 +1,83 @@
+// Copyright (c) 2020-2021, ellie/@ell1e & Horse64 Team (see AUTHORS.md),
+// also see LICENSE.md file.
+// SPDX-License-Identifier: BSD-2-Clause
+
+#include <assert.h>
+#include <check.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mainpreinit.h"
+#include "vmstrings.h"
+#include "widechar.h"
+
+#include "testmain.h"
+
+START_TEST (test_letterindex)
+{
+    main_PreInit();
+
+    // A long string where every third letter is two code points:
+    int64_t letters = VMSTRINGS_LETTERINDEX_MINLEN * 3;
+    h64stringval v = {0};
+    v.s = malloc(sizeof(*v.s) * letters * 2);
+    ck_assert(v.s != NULL);
+    int64_t *starts = malloc(sizeof(*starts) * (letters + 1));
+    ck_assert(starts != NULL);
+    int64_t i = 0;
+    while (i < letters) {
+        starts[i] = v.len;
+        v.s[v.len] = 'a' + (i % 26);
+        v.len++;
+        if (i % 3 == 0) {
+            v.s[v.len] = 0x301;  // combining acute accent
+            v.len++;
+        }
+        i++;
+    }
+    starts[letters] = v.len;
+
+    // Going backwards, so that the index is built on the first lookup:
+    i = letters + 5;
+    while (i >= 0) {
+        int64_t expected = (i <= letters ? starts[i] : (int64_t)v.len);
+        ck_assert(vmstrings_LetterToCodepointOffset(&v, i) == expected);
+        i--;
+    }
+    ck_assert(v.letterindex != NULL);
+    ck_assert(v.letterlen == (uint64_t)letters);
+    free(v.letterindex);
+
+    // Without combining marks, no index is needed at all:
+    h64stringval plain = {0};
+    plain.s = v.s;
+    plain.len = VMSTRINGS_LETTERINDEX_MINLEN * 2;
+    i = 0;
+    while (i < (int64_t)plain.len) {
+        plain.s[i] = 'x';
+        i++;
+    }
+    ck_assert(vmstrings_LetterToCodepointOffset(&plain, 300) == 300);
+    ck_assert(vmstrings_LetterToCodepointOffset(&plain, 10000) ==
+              (int64_t)plain.len);
+    ck_assert(plain.letterindex == NULL);
+    ck_assert(plain.letterlen == plain.len);
+
+    // Short strings are simply walked:
+    h64stringval shortstr = {0};
+    shortstr.s = v.s;
+    shortstr.len = 3;
+    shortstr.s[0] = 'e';
+    shortstr.s[1] = 0x301;
+    shortstr.s[2] = 'f';
+    ck_assert(vmstrings_LetterToCodepointOffset(&shortstr, 1) == 2);
+    ck_assert(vmstrings_LetterToCodepointOffset(&shortstr, 2) == 3);
+    ck_assert(shortstr.letterindex == NULL);
+
+    free(v.s);
+    free(starts);
+}
+END_TEST
+
+TESTS_MAIN (test_letterindex)
@@ -0,0 +1,226 @@
+// Copyright (c) 2020-2021, ellie/@ell1e & Horse64 Team (see AUTHORS.md),
+// also see LICENSE.md file.
+// SPDX-License-Identifier: BSD-2-Clause
+
+#include <assert.h>
+#include <check.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vmvector.h"
+
+#include "testmain.h"
+
+static const char *kernelnames[] = {"scalar", "sse2", "avx2", NULL};
+
+static genericvector *_testvector(int64_t len, int is_float, int64_t seed) {
+    genericvector *v = vmvector_New(is_float);
+    ck_assert(v != NULL);
+    int64_t i = 1;
+    while (i <= len) {
+        valuecontent vc = {0};
+        if (is_float) {
+            vc.type = H64VALTYPE_FLOAT64;
+            vc.float_value = ((i * 7 + seed) % 23) * 0.5 - 3.0;
+        } else {
+            vc.type = H64VALTYPE_INT64;
+            vc.int_value = ((i * 7 + seed) % 23) - 11;
+        }
+        ck_assert(vmvector_Set(v, i, &vc));
+        i++;
+    }
+    ck_assert(v->len == len);
+    return v;
+}
+
+START_TEST (test_vmvector_kernels)
+{
+    // Every kernel set must give the same results, including for
+    // lengths that leave loop tails:
+    int k = 0;
+    while (kernelnames[k]) {
+        if (!vmvector_ForceKernels(kernelnames[k])) {
+            k++;
+            continue;
+        }
+        int64_t len = 0;
+        while (len < 19) {
+            genericvector *fa = _testvector(len, 1, 3);
+            genericvector *fb = _testvector(len, 1, 5);
+            genericvector *ia = _testvector(len, 0, 3);
+            genericvector *ib = _testvector(len, 0, 11);
+            valuecontent va = {0};
+            va.type = H64VALTYPE_VECTOR;
+            va.vector_values = fa;
+            valuecontent vb = {0};
+            vb.type = H64VALTYPE_VECTOR;
+            vb.vector_values = fb;
+            valuecontent via = {0};
+            via.type = H64VALTYPE_VECTOR;
+            via.vector_values = ia;
+            valuecontent vib = {0};
+            vib.type = H64VALTYPE_VECTOR;
+            vib.vector_values = ib;
+
+            valuecontent result = {0};
+            vmvectorerror error;
+            ck_assert(vmvector_Binop(
+                VMVECTOR_OP_ADD, &va, &vb, &result, &error
+            ));
+            ck_assert(result.vector_values->is_float);
+            int64_t i = 0;
+            while (i < len) {
+                ck_assert(result.vector_values->float_values[i] ==
+                          fa->float_values[i] + fb->float_values[i]);
+                i++;
+            }
+            vmvector_Free(result.vector_values);
+
+            ck_assert(vmvector_Binop(
+                VMVECTOR_OP_SUBSTRACT, &via, &vib, &result, &error
+            ));
+            ck_assert(!result.vector_values->is_float);
+            i = 0;
+            while (i < len) {
+                ck_assert(result.vector_values->int_values[i] ==
+                          ia->int_values[i] - ib->int_values[i]);
+                i++;
+            }
+            vmvector_Free(result.vector_values);
+
+            valuecontent dot = {0};
+            ck_assert(vmvector_Dot(ia, ib, &dot, &error));
+            int64_t expected_dot = 0;
+            i = 0;
+            while (i < len) {
+                expected_dot += ia->int_values[i] * ib->int_values[i];
+                i++;
+            }
+            ck_assert(dot.type == H64VALTYPE_INT64 &&
+                      dot.int_value == expected_dot);
+
+            valuecontent sum = {0};
+            ck_assert(vmvector_Sum(fa, &sum, &error));
+            double expected_sum = 0;
+            i = 0;
+            while (i < len) {
+                expected_sum += fa->float_values[i];
+                i++;
+            }
+            // (All test values are multiples of 0.5, so exact.)
+            ck_assert(sum.float_value == expected_sum);
+
+            valuecontent vmin = {0};
+            valuecontent vmax = {0};
+            if (len == 0) {
+                ck_assert(!vmvector_Min(ia, &vmin, &error));
+                ck_assert(error == VMVECTOR_ERROR_EMPTY);
+            } else {
+                ck_assert(vmvector_Min(ia, &vmin, &error));
+                ck_assert(vmvector_Max(fa, &vmax, &error));
+                int64_t imin = ia->int_values[0];
+                double fmax = fa->float_values[0];
+                i = 1;
+                while (i < len) {
+                    if (ia->int_values[i] < imin)
+                        imin = ia->int_values[i];
+                    if (fa->float_values[i] > fmax)
+                        fmax = fa->float_values[i];
+                    i++;
+                }
+                ck_assert(vmin.int_value == imin);
+                ck_assert(vmax.float_value == fmax);
+            }
+
+            vmvector_Free(fa);
+            vmvector_Free(fb);
+            vmvector_Free(ia);
+            vmvector_Free(ib);
+            len++;
+        }
+        k++;
+    }
+}
+END_TEST
+
+START_TEST (test_vmvector_errors)
+{
+    int k = 0;
+    while (kernelnames[k]) {
+        if (!vmvector_ForceKernels(kernelnames[k])) {
+            k++;
+            continue;
+        }
+        genericvector *a = _testvector(9, 0, 1);
+        genericvector *b = _testvector(9, 0, 2);
+        a->int_values[7] = INT64_MAX;
+        b->int_values[7] = 1;
+        valuecontent va = {0};
+        va.type = H64VALTYPE_VECTOR;
+        va.vector_values = a;
+        valuecontent vb = {0};
+        vb.type = H64VALTYPE_VECTOR;
+        vb.vector_values = b;
+        valuecontent result = {0};
+        vmvectorerror error;
+        ck_assert(!vmvector_Binop(
+            VMVECTOR_OP_ADD, &va, &vb, &result, &error
+        ));
+        ck_assert(error == VMVECTOR_ERROR_OVERFLOW);
+
+        // Division by a number broadcasts, and gives floats:
+        valuecontent num = {0};
+        num.type = H64VALTYPE_INT64;
+        num.int_value = 2;
+        ck_assert(vmvector_Binop(
+            VMVECTOR_OP_DIVIDE, &vb, &num, &result, &error
+        ));
+        ck_assert(result.vector_values->is_float);
+        ck_assert(result.vector_values->float_values[7] == 0.5);
+        vmvector_Free(result.vector_values);
+        num.int_value = 0;
+        ck_assert(!vmvector_Binop(
+            VMVECTOR_OP_DIVIDE, &vb, &num, &result, &error
+        ));
+        ck_assert(error == VMVECTOR_ERROR_DIVISIONBYZERO);
+
+        genericvector *c = _testvector(4, 0, 1);
+        ck_assert(!vmvector_Dot(a, c, &result, &error));
+        ck_assert(error == VMVECTOR_ERROR_LENMISMATCH);
+
+        vmvector_Free(a);
+        vmvector_Free(b);
+        vmvector_Free(c);
+        k++;
+    }
+}
+END_TEST
+
+START_TEST (test_vmvector_setpromotes)
+{
+    genericvector *v = _testvector(5, 0, 1);
+    genericvector *v2 = _testvector(5, 0, 1);
+    ck_assert(vmvector_CheckEquality(v, v2));
+    valuecontent vc = {0};
+    vc.type = H64VALTYPE_FLOAT64;
+    vc.float_value = 1.5;
+    ck_assert(vmvector_Set(v, 2, &vc));
+    ck_assert(v->is_float);
+    ck_assert(v->float_values[1] == 1.5);
+    ck_assert(v->float_values[4] == (double)v2->int_values[4]);
+    ck_assert(!vmvector_CheckEquality(v, v2));
+    vc.type = H64VALTYPE_INT64;
+    vc.int_value = v2->int_values[1];
+    ck_assert(vmvector_Set(v, 2, &vc));
+    ck_assert(vmvector_CheckEquality(v, v2));
+    valuecontent out = {0};
+    vmvector_Get(v, 5, &out);
+    ck_assert(out.type == H64VALTYPE_FLOAT64);
+    vmvector_Free(v);
+    vmvector_Free(v2);
+}
+END_TEST
+
+TESTS_MAIN(test_vmvector_kernels, test_vmvector_errors,
+           test_vmvector_setpromotes)
@@ -5,6 +5,7 @@
 #include <inttypes.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "mainpreinit.h"
 #include "widechar.h"
@@ -72,4 +73,123 @@ START_TEST (test_widechar)
 }
 END_TEST
 
-TESTS_MAIN (test_widechar)
+START_TEST (test_unicodetables)
+{
+    main_PreInit();
+
+    h64wchar s[] = {'A', 'z', 0xC4, 0x3A3, 0x10400, '1', 0x10FFFF};
+    utf32_tolower(s, 7);
+    ck_assert(s[0] == 'a' && s[1] == 'z' && s[2] == 0xE4);
+    ck_assert(s[3] == 0x3C3 && s[4] == 0x10428 && s[5] == '1');
+    ck_assert(s[6] == 0x10FFFF);
+    utf32_toupper(s, 7);
+    ck_assert(s[0] == 'A' && s[1] == 'Z' && s[2] == 0xC4);
+    ck_assert(s[3] == 0x3A3 && s[4] == 0x10400 && s[5] == '1');
+    ck_assert(s[6] == 0x10FFFF);
+
+    // Combining marks and hangul syllable parts join into one letter:
+    h64wchar combined[] = {'e', 0x301, 'x'};
+    ck_assert(utf32_letter_len(combined, 3) == 2);
+    h64wchar hangul[] = {0x1100, 0x1161, 0x11A8, 'x'};
+    ck_assert(utf32_letter_len(hangul, 4) == 3);
+    h64wchar crlf[] = {'\r', '\n', 'x'};
+    ck_assert(utf32_letter_len(crlf, 3) == 1);
+}
+END_TEST
+
+START_TEST (test_asciiruns)
+{
+    main_PreInit();
+
+    // Long enough to go through the SIMD kernels, with non-ASCII
+    // and invalid bytes in between:
+    char u8[] = (
+        "Hello World, this is a longer line of plain ASCII text \xc3\xb6 "
+        "followed by more ASCII, an invalid \xFF byte and more text."
+    );
+    int64_t u8len = strlen(u8);
+    int64_t out_len = 0;
+    h64wchar *s = utf8_to_utf32(u8, u8len, NULL, NULL, &out_len);
+    ck_assert(s != NULL);
+    ck_assert(out_len == u8len - 1);
+    ck_assert(s[0] == 'H' && s[54] == ' ' && s[55] == 0xF6);
+    ck_assert(s[56] == ' ' && s[92] == 0xDC80ULL + 0xFFULL);
+    ck_assert(s[out_len - 1] == '.');
+
+    char back[256];
+    int64_t back_len = 0;
+    ck_assert(utf32_to_utf8(
+        s, out_len, back, sizeof(back), &back_len, 1, 0
+    ));
+    ck_assert(back_len == u8len);
+    ck_assert(memcmp(back, u8, u8len) == 0);
+    ck_assert(back[back_len] == '\0');
+
+    // Too small buffers still fail rather than truncate:
+    ck_assert(!utf32_to_utf8(
+        s, out_len, back, 20, &back_len, 1, 0
+    ));
+    free(s);
+
+    uint8_t ascii[40];
+    h64wchar wide[40];
+    memset(ascii, 'a', sizeof(ascii));
+    ascii[35] = 0xC3;
+    ck_assert(utf8_ascii_run_to_utf32(ascii, 40, wide) == 35);
+    ck_assert(wide[0] == 'a' && wide[34] == 'a');
+    wide[20] = 0x100;
+    ck_assert(utf32_ascii_run_to_utf8(wide, 35, ascii) == 20);
+}
+END_TEST
+
+START_TEST (test_letterstream)
+{
+    main_PreInit();
+
+    // Feeding code points one by one must find the same letters as
+    // utf32_letter_len(), no matter where the input is split up:
+    h64wchar s[] = {
+        'a', 'e', 0x301, 0x1100, 0x1161, 0x11A8, '\r', '\n',
+        0x1F1E9, 0x1F1EA, 0x1F1E9, 'b', 'c', 0xDC80ULL + 0xC3ULL,
+        0xE0067, 'd'
+    };
+    int64_t slen = sizeof(s) / sizeof(*s);
+    utf32letterstream ls = {0};
+    int64_t i = 0;
+    int64_t letterstart = 0;
+    while (i < slen) {
+        int isnew = utf32_letterstream_feed(&ls, s[i]);
+        if (i == 0) {
+            ck_assert(isnew);
+        } else if (isnew) {
+            ck_assert(utf32_letter_len(
+                s + letterstart, slen - letterstart
+            ) == i - letterstart);
+            letterstart = i;
+        }
+        i++;
+    }
+    ck_assert(utf32_letter_len(
+        s + letterstart, slen - letterstart
+    ) == slen - letterstart);
+
+    // The ASCII fast path only kicks in after an ASCII code point:
+    memset(&ls, 0, sizeof(ls));
+    h64wchar out[8];
+    ck_assert(utf32_letterstream_feedascii(
+        &ls, (const uint8_t *)"abc", 3, out
+    ) == 0);
+    ck_assert(utf32_letterstream_feed(&ls, 'x'));
+    ck_assert(utf32_letterstream_feedascii(
+        &ls, (const uint8_t *)"abc\xc3", 4, out
+    ) == 3);
+    ck_assert(out[0] == 'a' && out[2] == 'c');
+    ck_assert(!utf32_letterstream_feed(&ls, 0x301));
+    ck_assert(utf32_letterstream_feedascii(
+        &ls, (const uint8_t *)"abc", 3, out
+    ) == 0);
+}
+END_TEST
+
+TESTS_MAIN (test_widechar, test_unicodetables, test_asciiruns,
+            test_letterstream)
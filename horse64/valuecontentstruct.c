@@ -18,7 +18,9 @@
 #include "vmexec.h"
 #include "vmlist.h"
 #include "vmmap.h"
+#include "vmset.h"
 #include "vmstrings.h"
+#include "vmvector.h"
 #include "widechar.h"
 
 
@@ -33,10 +35,9 @@ int valuecontent_SetBytesU8(
         v->type = H64VALTYPE_SHORTBYTES;
         if (byteslen > 0)
             memcpy(
-                v->shortbytes_value, bytes,
-                byteslen * sizeof(h64wchar)
+                v->shortbytes_value, bytes, byteslen
             );
-        v->shortstr_len = byteslen;
+        v->shortbytes_len = byteslen;
         return 1;
     }
 
@@ -183,29 +184,48 @@ int valuecontent_IsMutable(valuecontent *v) {
         return (gcval->type != H64GCVALUETYPE_BYTES &&
                 gcval->type != H64GCVALUETYPE_STRING);
     }
-    return 0;
+    return (v->type == H64VALTYPE_VECTOR);
+}
+
+static inline uint32_t _valuecontent_FoldHash(uint64_t h) {
+    return (uint32_t)(h ^ (h >> 32));
 }
 
+static inline uint32_t _valuecontent_NonzeroHash(uint64_t h) {
+    // For the gcval->hash cache, where 0 means not computed yet.
+    uint32_t result = _valuecontent_FoldHash(h);
+    return (result != 0 ? result : 1);
+}
+
+#define HASH_MAXDEPTH 2
+#define HASH_MAXLISTITEMS 32
+
 uint32_t _valuecontent_Hash_Do(
         valuecontent *v, int depth
         ) {
-    if (depth >= 2)
+    // Strings and bytes go through keyed SipHash over the full content,
+    // numbers and ids through a keyed 64-bit mix. Equal values must give
+    // equal hashes, see valuecontent_CheckEquality().
+    if (depth >= HASH_MAXDEPTH)
         return 0;
     if (v->type == H64VALTYPE_NONE ||
             v->type == H64VALTYPE_UNSPECIFIED_KWARG) {
         return 0;
     } else if (v->type == H64VALTYPE_INT64) {
-        return (v->int_value % INT32_MAX);
+        return _valuecontent_FoldHash(
+            hash_Int64Hash((uint64_t)v->int_value)
+        );
     } else if (v->type == H64VALTYPE_FLOAT64) {
-        // Split up into exponent & factor,
-        // the float is fac_f * (2 ^ exponent).
-        int exponent32 = 0;
-        double fac_f = frexp(v->float_value, &exponent32);
-        int64_t exponent = exponent32;
-        // fac_f is in -1.0...1.0, map to roughly 32bit int range:
-        int64_t fac = (int)(fac_f * (double)2147483648LL);
-        if (fac < 0) fac = -fac;
-        return ((exponent + fac) % INT32_MAX);
+        // Integral floats compare equal to ints, so hash them the same:
+        if (v->float_value >= (double)INT64_MIN &&
+                v->float_value < (double)INT64_MAX &&
+                v->float_value == (double)((int64_t)v->float_value))
+            return _valuecontent_FoldHash(
+                hash_Int64Hash((uint64_t)((int64_t)v->float_value))
+            );
+        uint64_t bits = 0;
+        memcpy(&bits, &v->float_value, sizeof(bits));
+        return _valuecontent_FoldHash(hash_Int64Hash(bits));
     } else if (v->type == H64VALTYPE_BOOL) {
         return (v->int_value != 0);
     } else if (v->type == H64VALTYPE_SHORTSTR ||
@@ -218,14 +238,9 @@ uint32_t _valuecontent_Hash_Do(
             v->type == H64VALTYPE_SHORTSTR ? v->shortstr_len :
             v->constpreallocstr_len
         );
-        uint64_t h = 0;
-        uint64_t i = 0;
-        while (i < slen && i < 16) {
-            h = (h + ((h64wchar *)s)[i]) % INT32_MAX;
-            i++;
-        }
-        h = (h + slen % INT32_MAX) % INT32_MAX;
-        return (h != 0 ? h : 1);
+        return _valuecontent_NonzeroHash(hash_ByteHash(
+            s, slen * sizeof(h64wchar), NULL
+        ));
     } else if (v->type == H64VALTYPE_SHORTBYTES ||
                v->type == H64VALTYPE_CONSTPREALLOCBYTES) {
         char *s = (
@@ -236,82 +251,100 @@ uint32_t _valuecontent_Hash_Do(
             v->type == H64VALTYPE_SHORTBYTES ? v->shortbytes_len :
             v->constpreallocbytes_len
         );
-        uint64_t h = 0;
-        uint64_t i = 0;
-        while (i < slen && i < 16) {
-            h = (h + s[i]) % INT32_MAX;
-            i++;
-        }
-        h = (h + slen % INT32_MAX) % INT32_MAX;
-        return (h != 0 ? h : 1);
+        return _valuecontent_NonzeroHash(hash_ByteHash(
+            s, slen, NULL
+        ));
     } else if (v->type == H64VALTYPE_GCVAL) {
         h64gcvalue *gcval = ((h64gcvalue *)v->ptr_value);
         if (gcval->hash != 0)
             return gcval->hash;
         if (gcval->type == H64GCVALUETYPE_FUNCREF_CLOSURE) {
-            uint64_t h = (
-                gcval->closure_info->closure_func_id %
-                INT32_MAX
-            );
-            return h;
+            return _valuecontent_FoldHash(hash_Int64Hash(
+                gcval->closure_info->closure_func_id
+            ));
         } else if (gcval->type == H64GCVALUETYPE_STRING) {
-            uint64_t h = 0;
-            uint64_t i = 0;
-            while (i < gcval->str_val.len && i < 16) {
-                h = (h + gcval->str_val.s[i]) % INT32_MAX;
-                i++;
-            }
-            h = (h + gcval->str_val.len % INT32_MAX) % INT32_MAX;
-            gcval->hash = (h != 0 ? h : 1);
+            gcval->hash = _valuecontent_NonzeroHash(hash_ByteHash(
+                (const char *)gcval->str_val.s,
+                gcval->str_val.len * sizeof(h64wchar), NULL
+            ));
             return gcval->hash;
         } else if (gcval->type == H64GCVALUETYPE_BYTES) {
-            uint64_t h = 0;
-            uint64_t i = 0;
-            while (i < gcval->bytes_val.len && i < 16) {
-                h = (h + gcval->bytes_val.s[i]) % INT32_MAX;
-                i++;
-            }
-            h = (h + gcval->bytes_val.len % INT32_MAX) % INT32_MAX;
-            gcval->hash = (h != 0 ? h : 1);
+            gcval->hash = _valuecontent_NonzeroHash(hash_ByteHash(
+                gcval->bytes_val.s, gcval->bytes_val.len, NULL
+            ));
             return gcval->hash;
-        } else if (gcval->type == H64GCVALUETYPE_LIST) {
-            uint64_t h = 0;
+        }
+        // Everything below is mutable, so the hash is never cached.
+        if (gcval->type == H64GCVALUETYPE_LIST) {
+            // Order matters here, so the first items are enough:
             uint64_t count = vmlist_Count(gcval->list_values);
-            uint64_t upto = count;
-            if (upto > 32)
-                upto = 32;
-            uint64_t i = 0;
-            while (i < upto) {
+            uint64_t h = hash_Int64Hash(count);
+            uint64_t i = 1;
+            while (i <= count && i <= HASH_MAXLISTITEMS) {
                 valuecontent *item = vmlist_Get(gcval->list_values, i);
-                if (valuecontent_IsMutable(item)) {
-                    i++;
-                    continue;
-                }
-                h = (h + _valuecontent_Hash_Do(
+                h = hash_Int64Hash(h ^ _valuecontent_Hash_Do(
                     item, depth + 1
-                ) % INT32_MAX) % INT32_MAX;
+                ));
                 i++;
             }
-            h = (h + upto % INT32_MAX) % INT32_MAX;
-            gcval->hash = h;
-            return gcval->hash;
+            return _valuecontent_FoldHash(h);
         } else if (gcval->type == H64GCVALUETYPE_SET) {
-            return 0;
+            // Iteration order differs for equal sets, so combine
+            // all items in an order-independent way:
+            uint64_t h = hash_Int64Hash(vmset_Count(gcval->set_values));
+            uint64_t pos = 0;
+            valuecontent *item;
+            while ((item = vmset_IterateNext(
+                    gcval->set_values, &pos)) != NULL) {
+                h += hash_Int64Hash(_valuecontent_Hash_Do(
+                    item, depth + 1
+                ));
+            }
+            return _valuecontent_FoldHash(h);
         } else if (gcval->type == H64GCVALUETYPE_MAP) {
-            return 0;
+            uint64_t h = hash_Int64Hash(vmmap_Count(gcval->map_values));
+            uint64_t pos = 0;
+            valuecontent *key, *value;
+            while (vmmap_IterateNext(
+                    gcval->map_values, &pos, &key, &value)) {
+                h += hash_Int64Hash(
+                    ((uint64_t)_valuecontent_Hash_Do(key, depth + 1)
+                        << 32) |
+                    (uint64_t)_valuecontent_Hash_Do(value, depth + 1)
+                );
+            }
+            return _valuecontent_FoldHash(h);
         } else if (gcval->type == H64GCVALUETYPE_OBJINSTANCE) {
-            return 0;
+            // Equal instances always share the class:
+            return _valuecontent_FoldHash(hash_Int64Hash(
+                (uint64_t)gcval->class_id
+            ));
         } else {
             assert(0);  // Should be unreachable
             return 0;
         }
     } else if (v->type ==  H64VALTYPE_FUNCREF ||
             v->type == H64VALTYPE_CLASSREF) {
-        uint64_t h = (v->int_value % INT32_MAX);
-        return h;
+        return _valuecontent_FoldHash(
+            hash_Int64Hash((uint64_t)v->int_value)
+        );
     } else if (v->type == H64VALTYPE_ERROR) {
-        uint64_t h = (v->error_class_id % INT32_MAX);
-        return h;
+        return _valuecontent_FoldHash(
+            hash_Int64Hash((uint64_t)v->error_class_id)
+        );
+    } else if (v->type == H64VALTYPE_VECTOR) {
+        genericvector *vec = v->vector_values;
+        uint64_t h = hash_Int64Hash(vmvector_Count(vec));
+        int64_t i = 1;
+        while (i <= vmvector_Count(vec) && i <= HASH_MAXLISTITEMS) {
+            valuecontent item;
+            vmvector_Get(vec, i, &item);
+            h = hash_Int64Hash(h ^ _valuecontent_Hash_Do(
+                &item, depth + 1
+            ));
+            i++;
+        }
+        return _valuecontent_FoldHash(h);
     } else {
         assert(0);  // Should be unreachable
         return 0;
@@ -515,70 +548,51 @@ int valuecontent_CheckContainerEquality(
             int64_t len = vmmap_Count(g1->map_values);
             if (len != vmmap_Count(g2->map_values))
                 goto notequal;
-            genericmap *m = g1->map_values;
             genericmap *m2 = g2->map_values;
-            if ((m->flags & GENERICMAP_FLAG_LINEAR) != 0) {
-                int64_t k = 0;
-                while (k < m->linear.entry_count) {
-                    valuecontent *v1 = &(
-                        m->linear.entry[k]
-                    );
-                    valuecontent v2s = {0};
-                    int inneroom = 0;
-                    int result = vmmap_Get(
-                        vmthread, m2, &m->linear.key[k],
-                        &v2s, &inneroom
-                    );
-                    if (!result) {
-                        if (!inneroom) {
-                            if (oom) *oom = 1;
+            uint64_t pos = 0;
+            valuecontent *key;
+            valuecontent *v1;
+            while (vmmap_IterateNext(
+                    g1->map_values, &pos, &key, &v1)) {
+                valuecontent v2s = {0};
+                int inneroom = 0;
+                if (!vmmap_Get(
+                        vmthread, m2, key, &v2s, &inneroom
+                        )) {
+                    if (inneroom) {
+                        if (oom) *oom = 1;
                         if (jobs_onheap) free(jobs);
                         hash_FreeMap(seen);
-                        }
-                        goto notequal;
+                        return 0;
                     }
-                    valuecontent *v2 = &v2s;
-                    _VALUECONTENTEQ_CMP(v1, v2);
-                    k++;
+                    goto notequal;
                 }
-            } else {
-                int64_t k = 0;
-                while (k < m->hashed.bucket_count) {
-                    genericmapbucket *bucket = &(
-                        m->hashed.bucket[k]
-                    );
-                    int64_t k2 = 0;
-                    while (k2 < bucket->entry_count) {
-                        valuecontent *v1 = &(
-                            bucket->entry[i]
-                        );
-                        valuecontent v2s = {0};
-                        int inneroom = 0;
-                        int result = vmmap_Get(
-                            vmthread, m2, &bucket->key[k2],
-                            &v2s, &inneroom
-                        );
-                        if (!result) {
-                            if (!inneroom) {
-                                if (oom) *oom = 1;
-                            if (jobs_onheap) free(jobs);
-                            hash_FreeMap(seen);
-                            }
-                            goto notequal;
-                        }
-                        valuecontent *v2 = &v2s;
-                        _VALUECONTENTEQ_CMP(v1, v2);
-                        k2++;
+                valuecontent *v2 = &v2s;
+                _VALUECONTENTEQ_CMP(v1, v2);
+            }
+        } else if (g1->type == H64GCVALUETYPE_SET) {
+            if (g2->type != H64GCVALUETYPE_SET ||
+                    vmset_Count(g1->set_values) !=
+                    vmset_Count(g2->set_values))
+                goto notequal;
+            // Same size, so equal if all of g1 is found in g2:
+            uint64_t pos = 0;
+            valuecontent *v1;
+            while ((v1 = vmset_IterateNext(
+                    g1->set_values, &pos)) != NULL) {
+                int inneroom = 0;
+                if (!vmset_Contains(
+                        vmthread, g2->set_values, v1, &inneroom
+                        )) {
+                    if (inneroom) {
+                        if (oom) *oom = 1;
+                        if (jobs_onheap) free(jobs);
+                        hash_FreeMap(seen);
+                        return 0;
                     }
-                    k++;
+                    goto notequal;
                 }
             }
-        } else if (g1->type == H64GCVALUETYPE_SET) {
-            fprintf(
-                stderr, "valuecontentstruct.c: "
-                "container comparison "
-                "not implemented"
-            );
         } else {
             goto notequal;
         }
@@ -657,6 +671,10 @@ HOTSPOT int valuecontent_CheckEquality(
                 return 1;
             } else if (v1->type == H64VALTYPE_UNSPECIFIED_KWARG) {
                 return (v2->type == H64VALTYPE_UNSPECIFIED_KWARG);
+            } else if (v1->type == H64VALTYPE_VECTOR) {
+                return vmvector_CheckEquality(
+                    v1->vector_values, v2->vector_values
+                );
             } else if (v1->type == H64VALTYPE_GCVAL && (
                     ((h64gcvalue *)v1->ptr_value)->type ==
                     H64GCVALUETYPE_LIST ||
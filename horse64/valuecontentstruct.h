@@ -39,7 +39,7 @@ typedef enum valuetype {
 
 typedef struct h64errorinfo h64errorinfo;
 typedef struct valuecontent valuecontent;
-typedef struct vectorentry vectorentry;
+typedef struct genericvector genericvector;
 typedef struct h64iteratorstruct h64iteratorstruct;
 
 typedef struct valuecontent {
@@ -72,9 +72,8 @@ typedef struct valuecontent {
             classid_t error_class_id;
             h64errorinfo *einfo;
         };
-        struct {  // 12 bytes
-            int32_t vector_len;
-            vectorentry *vector_values;
+        struct {  // 8 bytes
+            genericvector *vector_values;
         };
         struct {  // 12 bytes
             int suspend_type;
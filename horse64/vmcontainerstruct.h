@@ -17,12 +17,6 @@
 
 typedef struct listblock listblock;
 
-typedef struct vectorentry {
-    int64_t int_value;
-    double float_value;
-    uint8_t is_float;
-} vectorentry;
-
 typedef struct listblock {
     int entry_count;
     listblock *next_block;
@@ -47,43 +41,55 @@ typedef struct genericlist {
     int first_block_shrunk_size;
 } genericlist;
 
-typedef struct hashmap hashmap;
+typedef struct genericsetentry {
+    uint32_t hash;
+    uint32_t state;  // see GENERICSET_SLOT_*
+    valuecontent value;
+} genericsetentry;
+
+static const uint32_t GENERICSET_SLOT_EMPTY = 0;
+static const uint32_t GENERICSET_SLOT_USED = 1;
+static const uint32_t GENERICSET_SLOT_DELETED = 2;
 
 typedef struct genericset {
-    hashmap *values;
-    int64_t nonhashable_count;
-    valuecontent *nonhashable_value;
+    int64_t entry_count, deleted_count;
+    int64_t slot_count;  // always zero or a power of two
+    genericsetentry *slot;
     uint64_t contentrevisionid;
 } genericset;
 
 static const uint8_t GENERICMAP_FLAG_LINEAR = 0x1;
 
-typedef struct genericmapbucket {
-    int32_t entry_count;
-    valuecontent *key, *entry;
-    uint32_t *entry_hash;
-} genericmapbucket;
+typedef struct genericmapslot {
+    uint32_t hash;
+    uint32_t probe_dist;  // 0 = empty slot, otherwise distance + 1
+    valuecontent key, value;
+} genericmapslot;
 
 typedef struct genericmap {
     uint8_t flags;
     union {
         struct hashed {
             int64_t entry_count;
-            int32_t bucket_count;
-            genericmapbucket *bucket;
+            int64_t slot_count;  // always a power of two
+            genericmapslot *slot;
         } hashed;
         struct linear {
             int16_t entry_count, entry_alloc;
-            valuecontent *key, *entry;
-            uint32_t *entry_hash;
+            genericmapslot *slot;
         } linear;
-    };
+    };  // see vmmap.c
     uint64_t contentrevisionid;
 } genericmap;
 
 typedef struct genericvector {
-    int entries_count;
-    vectorentry *values;
+    int32_t refcount;
+    uint8_t is_float;
+    int64_t len, alloc;
+    union {
+        int64_t *int_values;
+        double *float_values;
+    };  // packed & homogeneous, see vmvector.c
 } genericvector;
 
 
@@ -32,12 +32,17 @@
 #include "stack.h"
 #include "valuecontentstruct.h"
 #include "vmexec.h"
+#include "vmgc.h"
 #include "vmiteratorstruct.h"
 #include "vmlist.h"
 #include "vmmap.h"
+#include "vmprofile.h"
 #include "vmschedule.h"
+#include "vmset.h"
+#include "vmstats.h"
 #include "vmstrings.h"
 #include "vmsuspendtypeenum.h"
+#include "vmvector.h"
 #include "widechar.h"
 
 #define DEBUGVMEXEC
@@ -222,6 +227,46 @@ static void vmexec_VerifyStack(
     }
 }
 
+static inline attridx_t _vmexec_CachedClassAttribute(
+        h64attrcache *cache, classid_t class_id
+        ) {
+    uint64_t key = ((uint64_t)(uint32_t)class_id) << 32;
+    int i = 0;
+    while (i < H64ATTRCACHE_WAYS) {
+        uint64_t entry = cache->entry[i];
+        if (likely((entry & 0xFFFFFFFF00000000ULL) == key && entry != 0))
+            return (attridx_t)((int64_t)(entry & 0xFFFFFFFFULL) - 1);
+        if (entry == 0)
+            break;
+        i++;
+    }
+    return -1;
+}
+
+static inline attridx_t _vmexec_LookupClassAttributeCached(
+        h64program *pr, h64attrcache *cache,
+        classid_t class_id, int64_t nameidx
+        ) {
+    attridx_t result = _vmexec_CachedClassAttribute(cache, class_id);
+    if (likely(result >= 0))
+        return result;
+    VMSTATS_INC(attrcache_miss_count);
+    result = h64program_LookupClassAttribute(pr, class_id, nameidx);
+    if (result < 0)
+        return result;
+    uint64_t key = ((uint64_t)(uint32_t)class_id) << 32;
+    int i = 0;
+    while (i < H64ATTRCACHE_WAYS) {
+        if (cache->entry[i] == 0) {
+            // If another thread raced us here, we'll just overwrite it:
+            cache->entry[i] = (key | ((uint64_t)result + 1));
+            break;
+        }
+        i++;
+    }
+    return result;
+}
+
 int _vmexec_CondExprValue(
         valuecontent *v, int *yesno
         ) {
@@ -240,6 +285,27 @@ int _vmexec_CondExprValue(
     return 0;
 }
 
+static inline int _vmexec_BitwiseIntValue(
+        valuecontent *v, int64_t *out, int *overflow
+        ) {
+    // Floats are rounded first, and need to fit into 64 bits then.
+    // *overflow is only ever set, so it can be shared by both operands.
+    if (likely(v->type == H64VALTYPE_INT64)) {
+        *out = v->int_value;
+        return 1;
+    } else if (v->type == H64VALTYPE_FLOAT64) {
+        double f = round(v->float_value);
+        if (unlikely(!isfinite(f) || f >= 9223372036854775808.0 ||
+                f < -9223372036854775808.0)) {
+            *overflow = 1;
+            return 1;
+        }
+        *out = (int64_t)f;
+        return 1;
+    }
+    return 0;
+}
+
 int vmexec_ValueEqualityCheck(
         ATTR_UNUSED h64vmthread *vt, valuecontent *v1,
         valuecontent *v2, int *result
@@ -272,6 +338,11 @@ h64vmthread *vmthread_New(h64vmexec *owner, int is_on_main_thread) {
             vmthread_Free(vmthread);
             return NULL;
         }
+        vmthread->gc = vmgc_New(vmthread->heap);
+        if (!vmthread->gc) {
+            vmthread_Free(vmthread);
+            return NULL;
+        }
     }
 
     vmthread->iteratorstruct_pile = poolalloc_New(
@@ -402,6 +473,7 @@ void vmexec_Free(h64vmexec *vmexec) {
         free(vmexec->suspend_overview);
     }
     vmschedule_FreeWorkerSet(vmexec->worker_overview);
+    vmprofile_Free(vmexec->profile);
     free(vmexec);
 }
 
@@ -434,6 +506,8 @@ void vmthread_Free(h64vmthread *vmthread) {
         i++;
     }
     free(vmthread->arg_reorder_space);
+    vmgc_Free(vmthread->gc);
+    free(vmthread->releasequeue);
     if (vmthread->heap && vmthread->heap != mainthread_shared_heap) {
         // Free items on heap, FIXME
 
@@ -446,7 +520,21 @@ void vmthread_Free(h64vmthread *vmthread) {
         stack_Free(vmthread->stack, vmthread);
     }
     free(vmthread->funcframe);
+    int i2 = 0;
+    while (i2 < vmthread->errorframe_count) {
+        if (vmthread->errorframe[i2].has_extra &&
+                vmthread->errorframeextra[i2].
+                    storeddelayederror.error_class_id >= 0)
+            free(vmthread->errorframeextra[i2].storeddelayederror.msg);
+        i2++;
+    }
     free(vmthread->errorframe);
+    i2 = 0;
+    while (i2 < vmthread->errorframeextra_alloc) {
+        free(vmthread->errorframeextra[i2].caught_types_more);
+        i2++;
+    }
+    free(vmthread->errorframeextra);
     free(vmthread->kwarg_index_track_map);
     if (vmthread->str_pile) {
         poolalloc_Destroy(vmthread->str_pile);
@@ -460,6 +548,67 @@ void vmthread_Free(h64vmthread *vmthread) {
     free(vmthread);
 }
 
+static void _vmthread_TakeFramesFromPool(
+        h64vmthread *vmthread, h64vmworker *worker
+        ) {
+    h64vmframepool *pool = worker->framepool;
+    if (!pool || vmthread->funcframe_alloc > 0 ||
+            vmthread->errorframe_alloc > 0 ||
+            vmthread->errorframeextra_alloc > 0)
+        return;
+    vmthread->funcframe = pool->funcframe;
+    vmthread->funcframe_alloc = pool->funcframe_alloc;
+    vmthread->errorframe = pool->errorframe;
+    vmthread->errorframe_alloc = pool->errorframe_alloc;
+    vmthread->errorframeextra = pool->errorframeextra;
+    vmthread->errorframeextra_alloc = pool->errorframeextra_alloc;
+    memset(pool, 0, sizeof(*pool));
+}
+
+static void _vmthread_ReturnFramesToPool(
+        h64vmthread *vmthread, h64vmworker *worker
+        ) {
+    if (vmthread->funcframe_count > 0 ||
+            vmthread->errorframe_count > 0)
+        return;
+    if (!worker->framepool) {
+        worker->framepool = malloc(sizeof(*worker->framepool));
+        if (!worker->framepool)
+            return;
+        memset(worker->framepool, 0, sizeof(*worker->framepool));
+    }
+    h64vmframepool *pool = worker->framepool;
+    if (pool->funcframe_alloc > 0 || pool->errorframe_alloc > 0 ||
+            pool->errorframeextra_alloc > 0)
+        return;  // already holding the frames of another vmthread
+    pool->funcframe = vmthread->funcframe;
+    pool->funcframe_alloc = vmthread->funcframe_alloc;
+    pool->errorframe = vmthread->errorframe;
+    pool->errorframe_alloc = vmthread->errorframe_alloc;
+    pool->errorframeextra = vmthread->errorframeextra;
+    pool->errorframeextra_alloc = vmthread->errorframeextra_alloc;
+    vmthread->funcframe = NULL;
+    vmthread->funcframe_alloc = 0;
+    vmthread->errorframe = NULL;
+    vmthread->errorframe_alloc = 0;
+    vmthread->errorframeextra = NULL;
+    vmthread->errorframeextra_alloc = 0;
+}
+
+void vmexec_FreeFramePool(h64vmframepool *pool) {
+    if (!pool)
+        return;
+    free(pool->funcframe);
+    free(pool->errorframe);
+    int i = 0;
+    while (i < pool->errorframeextra_alloc) {
+        free(pool->errorframeextra[i].caught_types_more);
+        i++;
+    }
+    free(pool->errorframeextra);
+    free(pool);
+}
+
 void vmthread_WipeFuncStack(h64vmthread *vmthread) {
     assert(VMTHREAD_FUNCSTACKBOTTOM(vmthread) <=
            STACK_TOTALSIZE(vmthread->stack));
@@ -477,11 +626,388 @@ void vmthread_WipeFuncStack(h64vmthread *vmthread) {
     }
 }
 
+// Quickening (see below) rewrites the type byte of some instructions
+// while other workers may run them, so read it with this when it can
+// be one of those:
+static inline uint8_t _vmexec_InstType(const void *p) {
+    return __atomic_load_n(
+        &((const h64instructionany *)p)->type, __ATOMIC_RELAXED
+    );
+}
+
+#if defined(H64VM_PREDECODE)
+// Pre-decoded instructions keep their original bytes, but each starts
+// 8 byte aligned with its handler address right in front, and with
+// absolute pointers for any jump targets right after its padded bytes.
+// Instructions that can be quickened also get a 64-bit quicken slot
+// after that, see _vmexec_QuickenCount(). p always points at the
+// original bytes. INSTJUMPS() and INSTQUICKENS() must match
+// _vmexec_DecodedJumpCount() and _vmexec_DecodedQuickenCount() below.
+#define _DECODEDALIGN(x) (((x) + 7) & ~((size_t)7))
+#define INSTJUMPS(T) _Generic((T *)NULL,\
+    h64instruction_condjump *: 1,\
+    h64instruction_condjumpex *: 1,\
+    h64instruction_jump *: 1,\
+    h64instruction_iterate *: 1,\
+    h64instruction_pushrescueframe *: 2,\
+    h64instruction_hasattrjump *: 1,\
+    default: 0)
+#define INSTQUICKENS(T) _Generic((T *)NULL,\
+    h64instruction_binop *: 1,\
+    h64instruction_call *: 1,\
+    h64instruction_callignoreifnone *: 1,\
+    h64instruction_getattributebyname *: 1,\
+    h64instruction_iterate *: 1,\
+    default: 0)
+#define INSTSTRIDE(T) (\
+    _DECODEDALIGN(sizeof(T)) + sizeof(void *) * (INSTJUMPS(T) + 1) +\
+    sizeof(uint64_t) * INSTQUICKENS(T))
+#define INSTJUMPDEST(T, instp, field, k) (\
+    ((char **)((char *)(instp) + _DECODEDALIGN(sizeof(T))))[k])
+#define INSTQUICKENSLOT(T, instp) ((uint64_t *)(\
+    (char *)(instp) + _DECODEDALIGN(sizeof(T)) +\
+    sizeof(void *) * INSTJUMPS(T)))
+#define DISPATCH_INST() do { \
+    VMSTATS_INCIDX(inst_count, _vmexec_InstType(p)); \
+    goto **((void **)p - 1); \
+    } while (0)
+#define FUNCCODE(fid) (pr->func[fid].decoded_instructions)
+#define FUNCCODESIZE(fid) (pr->func[fid].decoded_instructions_bytes)
+
+static int64_t _vmexec_MapOffset(
+        const h64decodedoffset *map, int64_t count,
+        int64_t offset, int todecoded
+        ) {
+    // Find last entry at or before the given offset:
+    int64_t lo = 0;
+    int64_t hi = count - 1;
+    while (lo < hi) {
+        int64_t mid = lo + (hi - lo + 1) / 2;
+        int64_t midoffset = (
+            todecoded ? map[mid].offset : map[mid].decoded_offset
+        );
+        if (midoffset <= offset)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    return (todecoded ? map[lo].decoded_offset : map[lo].offset);
+}
+
+static int64_t _vmexec_ExecToBytecodeOffset(
+        h64program *pr, int64_t fid, int64_t offset
+        ) {
+    if (fid < 0 || !pr->func[fid].decoded_map)
+        return offset;
+    return _vmexec_MapOffset(
+        pr->func[fid].decoded_map, pr->func[fid].decoded_map_count,
+        offset, 0
+    );
+}
+
+static int64_t _vmexec_BytecodeToExecOffset(
+        h64program *pr, int64_t fid, int64_t offset
+        ) {
+    if (fid < 0 || !pr->func[fid].decoded_map)
+        return offset;
+    return _vmexec_MapOffset(
+        pr->func[fid].decoded_map, pr->func[fid].decoded_map_count,
+        offset, 1
+    );
+}
+
+static int _vmexec_DecodedJumpCount(int type) {
+    switch (type) {
+    case H64INST_CONDJUMP:
+    case H64INST_CONDJUMPEX:
+    case H64INST_JUMP:
+    case H64INST_ITERATE:
+    case H64INST_ITERATELIST:
+    case H64INST_HASATTRJUMP:
+        return 1;
+    case H64INST_PUSHRESCUEFRAME:
+        return 2;
+    default:
+        return 0;
+    }
+}
+
+static int _vmexec_DecodedQuickenCount(int type) {
+    // All instructions that use one of the structs in INSTQUICKENS(),
+    // since the stride only goes by the struct:
+    switch (type) {
+    case H64INST_BINOP:
+    case H64INST_BINOPCONDJUMP:
+    case H64INST_CALL:
+    case H64INST_CALLIGNOREIFNONE:
+    case H64INST_CALLKNOWNFUNC:
+    case H64INST_GETATTRIBUTEBYNAME:
+    case H64INST_GETATTRCALLSETTOP:
+    case H64INST_GETOBJVARATTR:
+    case H64INST_ITERATE:
+    case H64INST_ITERATELIST:
+        return 1;
+    default:
+        return (IS_SPECIALIZED_BINOP(type) ? 1 : 0);
+    }
+}
+
+// Quickening: the generic handlers of some instructions count how often
+// they saw the same key in a row, e.g. the operand types or call target,
+// in the instruction's quicken slot. Once that hits QUICKEN_THRESHOLD,
+// the instruction is rewritten in place to a variant that only checks
+// the key still holds, and that rewrites it back if it doesn't. The
+// decoded code is shared by all workers, so the slot is only accessed
+// atomically, and a worker racing with a rewrite just runs either
+// variant, which both handle any operands. Slot bits 0-11 hold the
+// count, 12-15 the reverts so far, and 16-63 the key. Keys are never 0
+// for a valid target, so a fresh slot can't be mistaken for one.
+#define QUICKEN_THRESHOLD 32
+#define QUICKEN_MAXREVERTS 8
+
+static inline int _vmexec_QuickenCount(uint64_t *slot, uint64_t key) {
+    uint64_t v = __atomic_load_n(slot, __ATOMIC_RELAXED);
+    uint64_t reverts = ((v >> 12) & 0xFULL);
+    if (reverts >= QUICKEN_MAXREVERTS)
+        return 0;  // gave up on this one
+    uint64_t count = ((v >> 16) == key ? (v & 0xFFFULL) + 1 : 1);
+    if (count > QUICKEN_THRESHOLD)
+        count = QUICKEN_THRESHOLD;
+    __atomic_store_n(
+        slot, (key << 16) | (reverts << 12) | count, __ATOMIC_RELAXED
+    );
+    return (count >= QUICKEN_THRESHOLD);
+}
+
+static inline uint64_t _vmexec_QuickenKey(uint64_t *slot) {
+    return (__atomic_load_n(slot, __ATOMIC_RELAXED) >> 16);
+}
+
+static inline void _vmexec_QuickenGiveUp(uint64_t *slot) {
+    uint64_t v = __atomic_load_n(slot, __ATOMIC_RELAXED);
+    __atomic_store_n(
+        slot, (v & ~0xFFFFULL) | ((uint64_t)QUICKEN_MAXREVERTS << 12),
+        __ATOMIC_RELAXED
+    );
+}
+
+static inline void _vmexec_QuickenReverted(uint64_t *slot) {
+    // Count the revert, and start over from zero:
+    uint64_t v = __atomic_load_n(slot, __ATOMIC_RELAXED);
+    uint64_t reverts = ((v >> 12) & 0xFULL) + 1;
+    if (reverts > QUICKEN_MAXREVERTS)
+        reverts = QUICKEN_MAXREVERTS;
+    __atomic_store_n(
+        slot, (v & ~0xFFFFULL) | (reverts << 12), __ATOMIC_RELAXED
+    );
+}
+
+static inline void _vmexec_RewriteInst(
+        char *p, uint8_t type, void *handler
+        ) {
+    // It is the handler address that decides what runs, but the type
+    // byte is still read by the stats, asserts and debug output:
+    __atomic_store_n(
+        &((h64instructionany *)p)->type, type, __ATOMIC_RELAXED
+    );
+    __atomic_store_n((void **)p - 1, handler, __ATOMIC_RELEASE);
+}
+
+static int _vmexec_InstJumpOffset(
+        h64instructionany *inst, int k, int64_t *out_offset
+        ) {
+    switch (inst->type) {
+    case H64INST_CONDJUMP:
+        *out_offset = ((h64instruction_condjump *)inst)->jumpbytesoffset;
+        return 1;
+    case H64INST_CONDJUMPEX:
+        *out_offset = (
+            ((h64instruction_condjumpex *)inst)->jumpbytesoffset
+        );
+        return 1;
+    case H64INST_JUMP:
+        *out_offset = ((h64instruction_jump *)inst)->jumpbytesoffset;
+        return 1;
+    case H64INST_ITERATE:
+    case H64INST_ITERATELIST:
+        *out_offset = ((h64instruction_iterate *)inst)->jumponend;
+        return 1;
+    case H64INST_HASATTRJUMP:
+        *out_offset = (
+            ((h64instruction_hasattrjump *)inst)->jumpbytesoffset
+        );
+        return 1;
+    case H64INST_PUSHRESCUEFRAME: {
+        h64instruction_pushrescueframe *pinst = (
+            (h64instruction_pushrescueframe *)inst
+        );
+        if (k == 0 && (pinst->mode & RESCUEMODE_JUMPONRESCUE) != 0) {
+            *out_offset = pinst->jumponrescue;
+            return 1;
+        } else if (k == 1 &&
+                (pinst->mode & RESCUEMODE_JUMPONFINALLY) != 0) {
+            *out_offset = pinst->jumponfinally;
+            return 1;
+        }
+        return 0;
+    }
+    default:
+        return 0;
+    }
+}
+
+static int _vmexec_PredecodeFunc(h64func *f, void **jumptable) {
+    assert(!f->iscfunc && f->decoded_instructions == NULL);
+    int64_t count = 0;
+    int64_t offset = 0;
+    while (offset < f->instructions_bytes) {
+        offset += h64program_PtrToInstructionSize(
+            f->instructions + offset
+        );
+        count++;
+    }
+    h64decodedoffset *map = malloc(sizeof(*map) * (count + 1));
+    if (!map)
+        return 0;
+
+    // Lay out all instructions, with an extra entry for the end:
+    int64_t decoded_bytes = 0;
+    offset = 0;
+    int64_t i = 0;
+    while (i < count) {
+        h64instructionany *inst = (
+            (h64instructionany *)(f->instructions + offset)
+        );
+        size_t size = h64program_PtrToInstructionSize((char *)inst);
+        map[i].offset = offset;
+        map[i].decoded_offset = decoded_bytes + sizeof(void *);
+        decoded_bytes += (
+            sizeof(void *) * (1 + _vmexec_DecodedJumpCount(inst->type)) +
+            _DECODEDALIGN(size) +
+            sizeof(uint64_t) * _vmexec_DecodedQuickenCount(inst->type)
+        );
+        offset += size;
+        i++;
+    }
+    map[count].offset = offset;
+    map[count].decoded_offset = decoded_bytes;
+    char *decoded = malloc(decoded_bytes > 0 ? decoded_bytes : 1);
+    if (!decoded) {
+        free(map);
+        return 0;
+    }
+
+    // Copy them over, and resolve handlers and jump targets:
+    i = 0;
+    while (i < count) {
+        h64instructionany *inst = (
+            (h64instructionany *)(f->instructions + map[i].offset)
+        );
+        size_t size = h64program_PtrToInstructionSize((char *)inst);
+        char *target = decoded + map[i].decoded_offset;
+        ((void **)target)[-1] = jumptable[inst->type];
+        memcpy(target, inst, size);
+        memset(target + size, 0, _DECODEDALIGN(size) - size);
+        char **jumpdest = (char **)(target + _DECODEDALIGN(size));
+        int k = 0;
+        while (k < _vmexec_DecodedJumpCount(inst->type)) {
+            jumpdest[k] = NULL;
+            int64_t jumpoffset = 0;
+            if (_vmexec_InstJumpOffset(inst, k, &jumpoffset)) {
+                int64_t destoffset = map[i].offset + jumpoffset;
+                int64_t decodeddest = _vmexec_MapOffset(
+                    map, count + 1, destoffset, 1
+                );
+                if (destoffset < 0 || _vmexec_MapOffset(
+                        map, count + 1, decodeddest, 0
+                        ) != destoffset) {
+                    // Not pointing at an instruction, corrupt code.
+                    free(decoded);
+                    free(map);
+                    return 0;
+                }
+                jumpdest[k] = decoded + decodeddest;
+            }
+            k++;
+        }
+        if (_vmexec_DecodedQuickenCount(inst->type) > 0)
+            memset(jumpdest + k, 0, sizeof(uint64_t));
+        i++;
+    }
+    f->decoded_instructions = decoded;
+    f->decoded_instructions_bytes = decoded_bytes;
+    f->decoded_map = map;
+    f->decoded_map_count = count + 1;
+    return 1;
+}
+
+static int _vmexec_PredecodeAll(h64program *pr, void **jumptable) {
+    funcid_t i = 0;
+    while (i < pr->func_count) {
+        if (!pr->func[i].iscfunc &&
+                pr->func[i].decoded_instructions == NULL &&
+                !_vmexec_PredecodeFunc(&pr->func[i], jumptable))
+            return 0;
+        i++;
+    }
+    return 1;
+}
+
+// For use inside _vmthread_RunFunction_NoPopFuncFrames. QUICKEN_ISPLAIN()
+// tells if the current instruction was dispatched to the given handler
+// directly, rather than falling back to it from a fused or quickened one:
+#define QUICKEN_ISPLAIN(label) (\
+    __atomic_load_n((void **)p - 1, __ATOMIC_ACQUIRE) == &&label)
+#define QUICKEN_COUNT(T, key) \
+    _vmexec_QuickenCount(INSTQUICKENSLOT(T, p), (key))
+#define QUICKEN_KEY(T) _vmexec_QuickenKey(INSTQUICKENSLOT(T, p))
+#define QUICKEN_GIVEUP(T) _vmexec_QuickenGiveUp(INSTQUICKENSLOT(T, p))
+#define QUICKEN_TO(newtype) do { \
+    VMSTATS_INC(quicken_count); \
+    _vmexec_RewriteInst(p, (newtype), jumptable[(newtype)]); \
+    } while (0)
+#define QUICKEN_REVERT(T, oldtype) do { \
+    VMSTATS_INC(quicken_revert_count); \
+    _vmexec_QuickenReverted(INSTQUICKENSLOT(T, p)); \
+    _vmexec_RewriteInst(p, (oldtype), jumptable[(oldtype)]); \
+    } while (0)
+#else
+#define INSTSTRIDE(T) sizeof(T)
+#define INSTJUMPDEST(T, instp, field, k) (\
+    (char *)(instp) + (ptrdiff_t)((T *)(instp))->field)
+#define DISPATCH_INST() do { \
+    VMSTATS_INCIDX(inst_count, ((h64instructionany *)p)->type); \
+    goto *jumptable[((h64instructionany *)p)->type]; \
+    } while (0)
+#define FUNCCODE(fid) (pr->func[fid].instructions)
+#define FUNCCODESIZE(fid) (pr->func[fid].instructions_bytes)
+#define _vmexec_ExecToBytecodeOffset(pr, fid, offset) (offset)
+#define _vmexec_BytecodeToExecOffset(pr, fid, offset) (offset)
+// Without the pre-decoded copy there is nowhere to keep counts, and
+// the bytecode itself isn't changed at runtime, so nothing is quickened:
+#define QUICKEN_ISPLAIN(label) 0
+#define QUICKEN_COUNT(T, key) 0
+#define QUICKEN_KEY(T) ((uint64_t)0)
+#define QUICKEN_GIVEUP(T) ((void)0)
+#define QUICKEN_TO(newtype) ((void)0)
+#define QUICKEN_REVERT(T, oldtype) ((void)0)
+#endif
+
 #if defined(DEBUGVMEXEC) && !defined(NDEBUG)
 static int vmthread_PrintExec(
         h64vmthread *vt, funcid_t fid, h64instructionany *inst
         ) {
-    char *_s = disassembler_InstructionToStr(inst);
+    h64program *pr = vt->vmexec_owner->program;
+    // Print a snapshot, since quickening may rewrite it meanwhile:
+    union {
+        h64instructionany inst;
+        char bytes[256];
+    } copy;
+    copy.inst.type = _vmexec_InstType(inst);
+    size_t size = h64program_PtrToInstructionSize(copy.bytes);
+    assert(size >= 1 && size <= sizeof(copy.bytes));
+    memcpy(copy.bytes + 1, (char *)inst + 1, size - 1);
+    char *_s = disassembler_InstructionToStr(&copy.inst);
     if (!_s) return 0;
     h64fprintf(
         stderr, "horsevm: debug: vmexec [t%p:%s] "
@@ -489,8 +1015,9 @@ static int vmthread_PrintExec(
         "o:%" PRId64 " st:%" PRId64 "/%" PRId64 " %s\n",
         vt, (vt->is_on_main_thread ? "nonparallel" : "parallel"),
         (int64_t)fid,
-        (int64_t)((char*)inst - (char*)vt->vmexec_owner->
-                  program->func[fid].instructions),
+        (int64_t)_vmexec_ExecToBytecodeOffset(
+            pr, fid, (char*)inst - FUNCCODE(fid)
+        ),
         (int64_t)vt->stack->current_func_floor,
         (int64_t)vt->stack->entry_count -
                  vt->stack->current_func_floor,
@@ -592,20 +1119,19 @@ static inline int pushfuncframe(
         );
     }
     #endif
-    if (vt->funcframe_count + 1 > vt->funcframe_alloc) {
+    if (unlikely(vt->funcframe_count + 1 > vt->funcframe_alloc)) {
+        int new_alloc = vt->funcframe_alloc * 2;
+        if (new_alloc < VMTHREAD_INITIAL_FUNCFRAMES)
+            new_alloc = VMTHREAD_INITIAL_FUNCFRAMES;
         h64vmfunctionframe *new_funcframe = realloc(
-            vt->funcframe, sizeof(*new_funcframe) *
-            (vt->funcframe_count * 2 + 6)
+            vt->funcframe, sizeof(*new_funcframe) * new_alloc
         );
         if (!new_funcframe)
             return 0;
         vt->funcframe = new_funcframe;
-        vt->funcframe_alloc = vt->funcframe_count * 2 + 6;
+        vt->funcframe_alloc = new_alloc;
     }
-    memset(
-        &vt->funcframe[vt->funcframe_count], 0,
-        sizeof(vt->funcframe[vt->funcframe_count])
-    );
+    // (All fields of the new frame are set below, no need to clear.)
     #ifndef NDEBUG
     if (vt->funcframe_count > 0) {
         assert(
@@ -673,61 +1199,109 @@ static inline int pushfuncframe(
     return 1;
 }
 
+static h64vmrescueframeextra *_rescueframeextra(
+        h64vmthread *vmthread, int frameslot
+        ) {
+    assert(frameslot >= 0 && frameslot < vmthread->errorframe_count);
+    if (frameslot >= vmthread->errorframeextra_alloc) {
+        int new_alloc = vmthread->errorframe_alloc;
+        assert(new_alloc > frameslot);
+        h64vmrescueframeextra *newextra = realloc(
+            vmthread->errorframeextra,
+            sizeof(*newextra) * new_alloc
+        );
+        if (!newextra)
+            return NULL;
+        memset(
+            &newextra[vmthread->errorframeextra_alloc], 0,
+            sizeof(*newextra) *
+            (new_alloc - vmthread->errorframeextra_alloc)
+        );
+        vmthread->errorframeextra = newextra;
+        vmthread->errorframeextra_alloc = new_alloc;
+    }
+    h64vmrescueframeextra *extra = (
+        &vmthread->errorframeextra[frameslot]
+    );
+    if (!vmthread->errorframe[frameslot].has_extra) {
+        // Reset the leftovers of an earlier frame in this slot, but
+        // keep its caught types buffer around for reuse:
+        vmthread->errorframe[frameslot].has_extra = 1;
+        memset(
+            &extra->storeddelayederror, 0,
+            sizeof(extra->storeddelayederror)
+        );
+        extra->storeddelayederror.error_class_id = -1;
+    }
+    return extra;
+}
+
+static inline h64errorinfo *_rescueframedelayederror(
+        h64vmthread *vmthread, int frameslot
+        ) {
+    if (!vmthread->errorframe[frameslot].has_extra ||
+            vmthread->errorframeextra[frameslot].
+                storeddelayederror.error_class_id < 0)
+        return NULL;
+    return &vmthread->errorframeextra[frameslot].storeddelayederror;
+}
+
 static int pusherrorframe(
         h64vmthread* vmthread, int frameid,
         int64_t catch_instruction_offset,
         int64_t finally_instruction_offset,
         int error_obj_temporary_slot
         ) {
-    int new_alloc = vmthread->errorframe_count * 2 + 10;
-    if (new_alloc > vmthread->errorframe_alloc ||
-            new_alloc < vmthread->errorframe_alloc - 20) {
+    if (unlikely(vmthread->errorframe_count + 1 >
+            vmthread->errorframe_alloc)) {
+        int new_alloc = vmthread->errorframe_alloc * 2;
+        if (new_alloc < VMTHREAD_INITIAL_RESCUEFRAMES)
+            new_alloc = VMTHREAD_INITIAL_RESCUEFRAMES;
         h64vmrescueframe *newframes = realloc(
             vmthread->errorframe,
             sizeof(*newframes) * new_alloc
         );
-        if (!newframes && vmthread->errorframe_count >
-                vmthread->errorframe_alloc) {
+        if (!newframes)
             return 0;
-        }
-        if (newframes) {
-            vmthread->errorframe = newframes;
-            vmthread->errorframe_alloc = new_alloc;
-        }
+        vmthread->errorframe = newframes;
+        vmthread->errorframe_alloc = new_alloc;
     }
     h64vmrescueframe *newframe = (
         &vmthread->errorframe[vmthread->errorframe_count]
     );
-    memset(newframe, 0, sizeof(*newframe));
     newframe->id = frameid;
-    newframe->storeddelayederror.error_class_id = -1;
     newframe->catch_instruction_offset = catch_instruction_offset;
     newframe->finally_instruction_offset = finally_instruction_offset;
     newframe->error_obj_temporary_id = error_obj_temporary_slot;
     newframe->func_frame_no = vmthread->funcframe_count - 1;
+    newframe->triggered_catch = 0;
+    newframe->triggered_finally = 0;
+    newframe->has_extra = 0;
+    newframe->caught_types_count = 0;
     vmthread->errorframe_count++;
+    if (finally_instruction_offset >= 0) {
+        // A finally block may need to hold on to an error while it
+        // runs, so make sure there is room for it before it happens:
+        if (!_rescueframeextra(
+                vmthread, vmthread->errorframe_count - 1
+                )) {
+            vmthread->errorframe_count--;
+            return 0;
+        }
+    }
     vmthread->call_settop_reverse = -1;
     return 1;
 }
 
 static void poperrorframe(h64vmthread *vmthread) {
-    assert(vmthread->errorframe_count >= 0);
-    if (vmthread->errorframe[
-            vmthread->errorframe_count - 1
-            ].storeddelayederror.error_class_id >= 0) {
-        free(vmthread->errorframe[
-            vmthread->errorframe_count - 1
-        ].storeddelayederror.msg);
-    }
-    if (vmthread->errorframe[
-            vmthread->errorframe_count - 1
-            ].caught_types_more) {
-        assert(vmthread->errorframe[
-            vmthread->errorframe_count - 1
-            ].caught_types_count > 5);
-        free(vmthread->errorframe[
-             vmthread->errorframe_count - 1
-             ].caught_types_more);
+    assert(vmthread->errorframe_count > 0);
+    h64errorinfo *delayederror = _rescueframedelayederror(
+        vmthread, vmthread->errorframe_count - 1
+    );
+    if (delayederror) {
+        free(delayederror->msg);
+        delayederror->msg = NULL;
+        delayederror->error_class_id = -1;
     }
     vmthread->errorframe_count--;
     vmthread->call_settop_reverse = -1;
@@ -741,9 +1315,9 @@ static void vmthread_errors_ProceedToFinally(
     assert(vmthread->errorframe_count > 0);
     assert(!vmthread->errorframe[
                vmthread->errorframe_count - 1
-           ].triggered_catch || vmthread->errorframe[
-               vmthread->errorframe_count - 1
-           ].storeddelayederror.error_class_id < 0);
+           ].triggered_catch || _rescueframedelayederror(
+               vmthread, vmthread->errorframe_count - 1
+           ) == NULL);
     assert(!vmthread->errorframe[
         vmthread->errorframe_count - 1
     ].triggered_finally);
@@ -766,17 +1340,22 @@ static void vmthread_errors_ProceedToFinally(
 }
 
 static int _framedoesntcatchtype(
-        h64program *p, h64vmrescueframe *frame, classid_t cid
+        h64program *p, h64vmthread *vmthread, int frameslot,
+        classid_t cid
         ) {
+    h64vmrescueframe *frame = &vmthread->errorframe[frameslot];
     int i = 0;
     while (i < frame->caught_types_count) {
         classid_t check_cid = cid;
         while (check_cid >= 0) {
-            if (i < 5 && frame->caught_types_firstfive[i] ==
-                    check_cid) {
+            if (i < VMTHREAD_RESCUEFRAME_INLINETYPES &&
+                    frame->caught_types_first[i] == check_cid) {
                 return 1;
-            } else if (i >= 5 &&
-                    frame->caught_types_more[i - 5] == check_cid) {
+            } else if (i >= VMTHREAD_RESCUEFRAME_INLINETYPES &&
+                    vmthread->errorframeextra[frameslot].
+                    caught_types_more[
+                        i - VMTHREAD_RESCUEFRAME_INLINETYPES
+                    ] == check_cid) {
                 return 1;
             }
             check_cid = p->classes[check_cid].base_class_global_id;
@@ -824,10 +1403,8 @@ static int vmthread_errors_Raise(
                         vmthread->errorframe_count - 1
                     ].catch_instruction_offset < 0 ||
                     !_framedoesntcatchtype(
-                        vmthread->vmexec_owner->program,
-                        &vmthread->errorframe[
-                            vmthread->errorframe_count - 1
-                        ], class_id)) {
+                        vmthread->vmexec_owner->program, vmthread,
+                        vmthread->errorframe_count - 1, class_id)) {
                 // Wait, we ran into 'rescue' already - or
                 // this doesn't catch our type.
                 // But what about finally?
@@ -919,7 +1496,10 @@ static int vmthread_errors_Raise(
     int k = 1;
     if (MAX_ERROR_STACK_FRAMES >= 1) {
         e.stack_frame_funcid[0] = *current_func_id;
-        e.stack_frame_byteoffset[0] = *current_exec_offset;
+        e.stack_frame_byteoffset[0] = _vmexec_ExecToBytecodeOffset(
+            vmthread->vmexec_owner->program, *current_func_id,
+            *current_exec_offset
+        );
     }
     assert(unroll_to_frame < vmthread->funcframe_count);
     int fataloom = 0;
@@ -929,7 +1509,9 @@ static int vmthread_errors_Raise(
             e.stack_frame_funcid[k] = (
                 vmthread->funcframe[i].return_to_func_id
             );
-            e.stack_frame_byteoffset[k] = (
+            e.stack_frame_byteoffset[k] = _vmexec_ExecToBytecodeOffset(
+                vmthread->vmexec_owner->program,
+                vmthread->funcframe[i].return_to_func_id,
                 vmthread->funcframe[i].return_to_execution_offset
             );
         }
@@ -1000,10 +1582,8 @@ static int vmthread_errors_Raise(
                 vmthread->errorframe_count - 1
             ].triggered_catch &&
             _framedoesntcatchtype(
-                vmthread->vmexec_owner->program,
-                &vmthread->errorframe[
-                    vmthread->errorframe_count - 1
-                ], class_id
+                vmthread->vmexec_owner->program, vmthread,
+                vmthread->errorframe_count - 1, class_id
             )) {
         // Go into rescue clause.
         assert(
@@ -1035,21 +1615,21 @@ static int vmthread_errors_Raise(
             vmthread->errorframe_count - 1
         ].finally_instruction_offset;
         if (bubble_up_error_later) {
-            assert(
-                vmthread->errorframe[
-                    vmthread->errorframe_count - 1
-                ].storeddelayederror.error_class_id < 0
-            );
+            // (Frames with finally got their extra info on push.)
+            assert(vmthread->errorframe[
+                vmthread->errorframe_count - 1
+            ].has_extra);
+            assert(_rescueframedelayederror(
+                vmthread, vmthread->errorframe_count - 1
+            ) == NULL);
             memcpy(
-                &vmthread->errorframe[
+                &vmthread->errorframeextra[
                     vmthread->errorframe_count - 1
                 ].storeddelayederror, &e, sizeof(e)
             );
-            assert(
-                vmthread->errorframe[
-                    vmthread->errorframe_count - 1
-                ].storeddelayederror.error_class_id >= 0
-            );
+            assert(_rescueframedelayederror(
+                vmthread, vmthread->errorframe_count - 1
+            ) != NULL);
         }
     }
     assert(*current_exec_offset > 0);
@@ -1101,23 +1681,14 @@ static void vmthread_errors_EndFinally(
             endedframeslot
         ].triggered_finally);
         // See if we have a delayed error that needs bubbling up:
-        if (vmthread->errorframe[
-                endedframeslot
-                ].storeddelayederror.error_class_id >= 0) {
+        h64errorinfo *delayederror = _rescueframedelayederror(
+            vmthread, endedframeslot
+        );
+        if (delayederror) {
             h64errorinfo e;
-            memcpy(
-                &e, &vmthread->errorframe[
-                endedframeslot
-                ].storeddelayederror, sizeof(e)
-            );
-            memset(
-                &vmthread->errorframe[
-                endedframeslot
-                ].storeddelayederror, 0, sizeof(e)
-            );
-            vmthread->errorframe[
-                endedframeslot
-            ].storeddelayederror.error_class_id = -1;
+            memcpy(&e, delayederror, sizeof(e));
+            memset(delayederror, 0, sizeof(e));
+            delayederror->error_class_id = -1;
             while (vmthread->errorframe_count > endedframeslot)
                 poperrorframe(vmthread);
             assert(e.error_class_id >= 0);
@@ -1212,7 +1783,7 @@ static void vmexec_PrintPostErrorInfo(
 // (int64_t class_id, const char *msg, ...args for msg's formatters...)
 #define RAISE_ERROR_EX(class_id, is_u32, ...) \
     {\
-    ptrdiff_t offset = (p - pr->func[func_id].instructions);\
+    ptrdiff_t offset = (p - FUNCCODE(func_id));\
     int returneduncaught = 0; \
     h64errorinfo uncaughterror = {0}; \
     uncaughterror.error_class_id = -1; \
@@ -1220,7 +1791,7 @@ static void vmexec_PrintPostErrorInfo(
             vmexec->moptions.vmexec_debug) {\
         vmexec_PrintPreErrorInfo(\
             vmthread, class_id, func_id,\
-            (p - pr->func[func_id].instructions)\
+            (p - FUNCCODE(func_id))\
         );\
     }\
     int raiseresult = vmthread_errors_Raise( \
@@ -1259,8 +1830,8 @@ static void vmexec_PrintPostErrorInfo(
             vmthread, class_id, func_id, offset\
         );\
     }\
-    assert(pr->func[func_id].instructions != NULL);\
-    p = (pr->func[func_id].instructions + offset);\
+    assert(FUNCCODE(func_id) != NULL);\
+    p = (FUNCCODE(func_id) + offset);\
     }
 
 // RAISE_ERROR is a shortcut to handle raising an error.
@@ -1296,7 +1867,9 @@ static void vmexec_PrintPostErrorInfo(
         ); \
     } \
     vmthread->upcoming_resume_info->byteoffset = ( \
-        p - pr->func[func_id].instructions \
+        _vmexec_ExecToBytecodeOffset( \
+            pr, func_id, p - FUNCCODE(func_id) \
+        ) \
     ); \
     vmthread->upcoming_resume_info->func_id = func_id; \
     vmthread->upcoming_resume_info->funcnestdepth = funcnestdepth; \
@@ -1320,6 +1893,16 @@ static void vmexec_PrintPostErrorInfo(
             start_thread->call_settop_reverse\
         );
 
+// Macro for taking a profiler sample when one is due, at calls, returns
+// and jumps inside _vmthread_RunFunction_NoPopFuncFrames:
+#define PROFILE_SAMPLE_POINT() \
+    do { \
+        if (unlikely(profile_due != NULL && *profile_due)) { \
+            *profile_due = 0; \
+            vmprofile_RecordSample(vmexec->profile, vmthread, func_id); \
+        } \
+    } while (0)
+
 HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
         h64vmexec *vmexec, h64vmthread *start_thread,
         vmthreadresumeinfo *rinfo, int worker_no,
@@ -1328,11 +1911,35 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
         int *returnedsuspend,
         vmthreadsuspendinfo *suspend_info
         ) {
-    if (!vmexec || !start_thread || !einfo)
+    if (!vmexec)
         return 0;
     h64program *pr = vmexec->program;
+    // The state the handlers use is all declared up here, so that the
+    // jump to the jump table set-up below doesn't skip its initialization:
+    int64_t func_id = -1;
+    int isresume = 0;
+    char *p = NULL;
+    char *pend = NULL;
+    void *jumptable[H64INST_TOTAL_COUNT];
+    void *op_jumptable[TOTAL_OP_COUNT];
+    memset(op_jumptable, 0, sizeof(*op_jumptable) * TOTAL_OP_COUNT);
+    h64stack *stack = NULL;
+    poolalloc *heap = NULL;
+    int64_t original_stack_size = 0;
+    int funcnestdepth = 0;
+    h64vmthread *vmthread = start_thread;
+    _Atomic volatile int *profile_due = NULL;
+    int callignoreifnone = 0;
+    classid_t _raise_error_class_id = -1;
+    int32_t _raise_msg_stack_slot = -1;
+    if (unlikely(!rinfo)) {
+        // Only set up the jump tables for vmexec_PredecodeProgram():
+        goto setupinterpreter;
+    }
+    if (!start_thread || !einfo)
+        return 0;
 
-    int64_t func_id = rinfo->func_id;
+    func_id = rinfo->func_id;
     #ifndef NDEBUG
     if (vmexec->moptions.vmexec_debug)
         h64fprintf(
@@ -1344,7 +1951,6 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
             (int)worker_no, func_id
         );
     #endif
-    int isresume = 0;
     if (!rinfo->run_from_start) {
         isresume = 1;
         #ifndef NDEBUG
@@ -1367,16 +1973,14 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
     }
     assert(func_id >= 0 && func_id < pr->func_count);
     assert(!pr->func[func_id].iscfunc);
-    char *p = pr->func[func_id].instructions;
+    assert(FUNCCODE(func_id) != NULL);
+    p = FUNCCODE(func_id);
+    pend = p + (intptr_t)FUNCCODESIZE(func_id);
     if (isresume)
-        p += rinfo->byteoffset;
-    char *pend = p + (intptr_t)pr->func[func_id].instructions_bytes;
-    void *jumptable[H64INST_TOTAL_COUNT];
-    void *op_jumptable[TOTAL_OP_COUNT];
-    memset(op_jumptable, 0, sizeof(*op_jumptable) * TOTAL_OP_COUNT);
-    h64stack *stack = start_thread->stack;
-    poolalloc *heap = start_thread->heap;
-    int64_t original_stack_size = (
+        p += _vmexec_BytecodeToExecOffset(pr, func_id, rinfo->byteoffset);
+    stack = start_thread->stack;
+    heap = start_thread->heap;
+    original_stack_size = (
         start_thread->upcoming_resume_info->precall_old_stack
         // NOTE: we do NOT want to get this from rinfo, since rinfo
         // is -1 on non-resume. Instead, this value will be set even when
@@ -1392,7 +1996,6 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
         );
     }
     #endif
-    int funcnestdepth = 0;
     if (isresume) {
         funcnestdepth = rinfo->funcnestdepth;
     } else {
@@ -1446,11 +2049,10 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
         );
     }
     #endif
-    h64vmthread *vmthread = start_thread;
     vmexec->active_thread = vmthread;
-    int callignoreifnone = 0;
-    classid_t _raise_error_class_id = -1;
-    int32_t _raise_msg_stack_slot = -1;
+    if (unlikely(vmexec->profile != NULL) &&
+            start_thread->run_by_worker != NULL)
+        profile_due = &start_thread->run_by_worker->profile_sample_due;
 
     goto setupinterpreter;
 
@@ -1465,7 +2067,7 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
         vmthread_AbortAsyncForegroundWork(vmthread);
         RAISE_ERROR(H64STDERROR_OUTOFMEMORYERROR,
                         "Allocation failure");
-        goto *jumptable[((h64instructionany *)p)->type];
+        DISPATCH_INST();
     }
     inst_setconst: {
         h64instruction_setconst *inst = (h64instruction_setconst *)p;
@@ -1570,8 +2172,8 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
         vmexec_VerifyStack(vmthread);
         #endif
 
-        p += sizeof(h64instruction_setconst);
-        goto *jumptable[((h64instructionany *)p)->type];
+        p += INSTSTRIDE(h64instruction_setconst);
+        DISPATCH_INST();
     }
     inst_setglobal: {
         h64instruction_setglobal *inst = (
@@ -1592,7 +2194,7 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
                 H64STDERROR_INVALIDNOASYNCRESOURCEERROR,
                 "cannot access globals from nonparallel function"
             );
-            goto *jumptable[((h64instructionany *)p)->type];
+            DISPATCH_INST();
         }
 
         valuecontent *vcfrom = STACK_ENTRY(
@@ -1606,8 +2208,8 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
         memcpy(vcto, vcfrom, sizeof(*vcto));
         ADDREF_NONHEAP(vcto);
 
-        p += sizeof(*inst);
-        goto *jumptable[((h64instructionany *)p)->type];
+        p += INSTSTRIDE(h64instruction_setglobal);
+        DISPATCH_INST();
     }
     inst_getglobal: {
         h64instruction_getglobal *inst = (
@@ -1629,7 +2231,7 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
                 H64STDERROR_INVALIDNOASYNCRESOURCEERROR,
                 "cannot access globals from nonparallel function"
             );
-            goto *jumptable[((h64instructionany *)p)->type];
+            DISPATCH_INST();
         }
 
         valuecontent *vcfrom = &(
@@ -1643,8 +2245,8 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
         memcpy(vcto, vcfrom, sizeof(*vcto));
         ADDREF_NONHEAP(vcto);
 
-        p += sizeof(*inst);
-        goto *jumptable[((h64instructionany *)p)->type];
+        p += INSTSTRIDE(h64instruction_getglobal);
+        DISPATCH_INST();
     }
     inst_setbyindexexpr: {
         h64instruction_setbyindexexpr *inst = (
@@ -1675,7 +2277,7 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
                 H64STDERROR_TYPEERROR,
                 "this value must be indexed with a number"
             );
-            goto *jumptable[((h64instructionany *)p)->type];
+            DISPATCH_INST();
         }
         int64_t index_value = -1;
         if (vc->type != H64VALTYPE_GCVAL ||
@@ -1696,7 +2298,7 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
                         H64STDERROR_INDEXERROR,
                         "index must not have fractional part"
                     );
-                    goto *jumptable[((h64instructionany *)p)->type];
+                    DISPATCH_INST();
                 }
                 index_value = rounded_value;
             }
@@ -1712,7 +2314,7 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
                     "index %" PRId64 " is out of range",
                     index_value
                 );
-                goto *jumptable[((h64instructionany *)p)->type];
+                DISPATCH_INST();
             }
             assert(vcset->type != H64VALTYPE_CONSTPREALLOCSTR &&
                    vcset->type != H64VALTYPE_CONSTPREALLOCBYTES);
@@ -1732,12 +2334,34 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
                     H64STDERROR_TYPEERROR,
                     "map key must be immutable value"
                 );
-                goto *jumptable[((h64instructionany *)p)->type];
+                DISPATCH_INST();
             }
             if (!vmmap_Set(vmthread,
                     gcval->map_values,
                     vcindex, vcset))
                 goto triggeroom;
+        } else if (vc->type == H64VALTYPE_VECTOR) {
+            if (index_value < 1 || index_value >
+                    vmvector_Count(vc->vector_values) + 1) {
+                RAISE_ERROR(
+                    H64STDERROR_INDEXERROR,
+                    "index %" PRId64 " is out of range",
+                    index_value
+                );
+                DISPATCH_INST();
+            }
+            if (vcset->type != H64VALTYPE_INT64 &&
+                    vcset->type != H64VALTYPE_FLOAT64) {
+                RAISE_ERROR(
+                    H64STDERROR_TYPEERROR,
+                    "vector can only hold numbers"
+                );
+                DISPATCH_INST();
+            }
+            // Note: vmvector_Set handles the appending case of
+            // index_value == len + 1 already.
+            if (!vmvector_Set(vc->vector_values, index_value, vcset))
+                goto triggeroom;
         } else if ((vc->type == H64VALTYPE_GCVAL &&
                 ((h64gcvalue*)vc->ptr_value)->type ==
                 H64GCVALUETYPE_STRING) ||
@@ -1746,16 +2370,16 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
                 H64STDERROR_TYPEERROR,
                 "can not index assign to strings since they are immutable"
             );
-            goto *jumptable[((h64instructionany *)p)->type];
+            DISPATCH_INST();
         } else {
             RAISE_ERROR(
                 H64STDERROR_TYPEERROR,
                 "given value cannot be indexed"
             );
-            goto *jumptable[((h64instructionany *)p)->type];
+            DISPATCH_INST();
         }
-        p += sizeof(h64instruction_setbyindexexpr);
-        goto *jumptable[((h64instructionany *)p)->type];
+        p += INSTSTRIDE(h64instruction_setbyindexexpr);
+        DISPATCH_INST();
     }
     inst_setbyattributename: {
         h64instruction_setbyattributename *inst = (
@@ -1779,7 +2403,7 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
                 H64STDERROR_ATTRIBUTEERROR,
                 "given attribute not present on this value"
             );
-            goto *jumptable[((h64instructionany *)p)->type];
+            DISPATCH_INST();
         }
         valuecontent *vfrom = STACK_ENTRY(stack, inst->slotvaluefrom);
 
@@ -1792,29 +2416,29 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
                 H64STDERROR_ATTRIBUTEERROR,
                 "given attribute not present on this value"
             );
-            goto *jumptable[((h64instructionany *)p)->type];
+            DISPATCH_INST();
         }
         if (aindex >= H64CLASS_METHOD_OFFSET) {
             RAISE_ERROR(
                 H64STDERROR_ATTRIBUTEERROR,
                 "cannot alter func attribute"
             );
-            goto *jumptable[((h64instructionany *)p)->type];
+            DISPATCH_INST();
         }
         assert(
             aindex >= 0 &&
             aindex < vmexec->program->classes[gcval->class_id].varattr_count
         );
 
-        DELREF_NONHEAP(&gcval->varattr[aindex]);
+        DELREF_HEAP(&gcval->varattr[aindex]);
         valuecontent_Free(vmthread, &gcval->varattr[aindex]);
         memcpy(
             &gcval->varattr[aindex], vfrom, sizeof(*vfrom)
         );
-        ADDREF_NONHEAP(&gcval->varattr[aindex]);
+        ADDREF_HEAP(&gcval->varattr[aindex]);
 
-        p += sizeof(*inst);
-        goto *jumptable[((h64instructionany *)p)->type];
+        p += INSTSTRIDE(h64instruction_setbyattributename);
+        DISPATCH_INST();
     }
     inst_setbyattributeidx: {
         h64instruction_setbyattributeidx *inst = (
@@ -1838,7 +2462,7 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
                 H64STDERROR_ATTRIBUTEERROR,
                 "given attribute not present on this value"
             );
-            goto *jumptable[((h64instructionany *)p)->type];
+            DISPATCH_INST();
         }
         valuecontent *vfrom = STACK_ENTRY(stack, inst->slotvaluefrom);
 
@@ -1851,18 +2475,18 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
                 H64STDERROR_ATTRIBUTEERROR,
                 "given attribute not present on this value"
             );
-            goto *jumptable[((h64instructionany *)p)->type];
+            DISPATCH_INST();
         }
 
-        DELREF_NONHEAP(&gcval->varattr[aindex]);
+        DELREF_HEAP(&gcval->varattr[aindex]);
         valuecontent_Free(vmthread, &gcval->varattr[aindex]);
         memcpy(
             &gcval->varattr[aindex], vfrom, sizeof(*vfrom)
         );
-        ADDREF_NONHEAP(&gcval->varattr[aindex]);
+        ADDREF_HEAP(&gcval->varattr[aindex]);
 
-        p += sizeof(*inst);
-        goto *jumptable[((h64instructionany *)p)->type];
+        p += INSTSTRIDE(h64instruction_setbyattributeidx);
+        DISPATCH_INST();
     }
     inst_getfunc: {
         h64instruction_getfunc *inst = (h64instruction_getfunc *)p;
@@ -1886,8 +2510,8 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
         vmexec_VerifyStack(vmthread);
         #endif
 
-        p += sizeof(h64instruction_getfunc);
-        goto *jumptable[((h64instructionany *)p)->type];
+        p += INSTSTRIDE(h64instruction_getfunc);
+        DISPATCH_INST();
     }
     inst_getclass: {
         h64instruction_getclass *inst = (h64instruction_getclass *)p;
@@ -1911,8 +2535,8 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
         vmexec_VerifyStack(vmthread);
         #endif
 
-        p += sizeof(h64instruction_getclass);
-        goto *jumptable[((h64instructionany *)p)->type];
+        p += INSTSTRIDE(h64instruction_getclass);
+        DISPATCH_INST();
     }
     inst_valuecopy: {
         h64instruction_valuecopy *inst = (h64instruction_valuecopy *)p;
@@ -1950,8 +2574,8 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
         vmexec_VerifyStack(vmthread);
         #endif
 
-        p += sizeof(h64instruction_valuecopy);
-        goto *jumptable[((h64instructionany *)p)->type];
+        p += INSTSTRIDE(h64instruction_valuecopy);
+        DISPATCH_INST();
     }
     #include "vmexec_inst_unopbinop_INCLUDE.c"
     inst_call: {
@@ -2031,15 +2655,15 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
             if (!callignoreifnone || vc->type != H64VALTYPE_NONE) {
                 RAISE_ERROR(H64STDERROR_TYPEERROR,
                             "not a callable object type");
-                goto *jumptable[((h64instructionany *)p)->type];
+                DISPATCH_INST();
             }
             valuecontent *vcreturnto = STACK_ENTRY(stack, inst->returnto);
             DELREF_NONHEAP(vcreturnto);
             valuecontent_Free(vmthread, vcreturnto);
             memset(vcreturnto, 0, sizeof(*vcreturnto));
             vcreturnto->type = H64VALTYPE_NONE;
-            p += sizeof(h64instruction_call);
-            goto *jumptable[((h64instructionany *)p)->type];
+            p += INSTSTRIDE(h64instruction_call);
+            DISPATCH_INST();
         }
 
         // Extract more info about what we're calling:
@@ -2075,7 +2699,7 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
                     H64STDERROR_TYPEERROR,
                     "unpack parameter must be a list"
                 );
-                goto *jumptable[((h64instructionany *)p)->type];
+                DISPATCH_INST();
             }
             effective_posarg_count += (
                 vmlist_Count(((h64gcvalue *)vc->ptr_value)->list_values)
@@ -2102,7 +2726,7 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
                     H64STDERROR_ARGUMENTERROR,
                     "called func requires more positional arguments"
                 );
-                goto *jumptable[((h64instructionany *)p)->type];
+                DISPATCH_INST();
             } else {
                 if (!vmthread_ResetCallTempStack(vmthread)) {
                     if (returneduncaughterror)
@@ -2113,7 +2737,7 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
                     H64STDERROR_ARGUMENTERROR,
                     "called func requires less positional arguments"
                 );
-                goto *jumptable[((h64instructionany *)p)->type];
+                DISPATCH_INST();
             }
         }
 
@@ -2124,9 +2748,18 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
         assert(stack->current_func_floor >= 0);
         assert(stack_args_bottom >= 0);
 
-        // Make sure keyword arguments are actually known to target,
-        // and do assert()s that keyword args are sorted:
-        if (unlikely(func_kwargs > 0)) {
+        // If the compiler precomputed the keyword argument order for
+        // this exact target, use it as is:
+        const int32_t *kwarg_map = NULL;
+        if (inst->kwargperm > 0 && pr->kwargperm[
+                inst->kwargperm - 1] == target_func_id) {
+            assert(pr->kwargperm[inst->kwargperm] == inst->kwargs);
+            kwarg_map = &pr->kwargperm[inst->kwargperm + 1];
+        }
+
+        // Otherwise, make sure keyword arguments are actually known to
+        // target, and do assert()s that keyword args are sorted:
+        if (unlikely(func_kwargs > 0) && !kwarg_map) {
             if (unlikely(vmthread->kwarg_index_track_count <
                     func_kwargs)) {
                 int oldcount = vmthread->kwarg_index_track_count;
@@ -2178,10 +2811,11 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
                         "called func does not recognize all passed "
                         "keyword arguments"
                     );
-                    goto *jumptable[((h64instructionany *)p)->type];
+                    DISPATCH_INST();
                 }
                 i += 2;
             }
+            kwarg_map = vmthread->kwarg_index_track_map;
         }
 
         // Evaluate fast-track:
@@ -2308,7 +2942,7 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
             }
             i = 0;
             while (i < inst->kwargs) {
-                int64_t target_slot = vmthread->kwarg_index_track_map[i];
+                int64_t target_slot = kwarg_map[i];
                 assert(temp_slots_kwarg_start + target_slot <
                        reformat_argslots);
                 valuecontent *kwarg_value = (
@@ -2339,6 +2973,7 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
             assert(result != 0);  // shrinks, so shouldn't fail
         } else if (unlikely(inst->kwargs > 0)) {
             // No re-order, but gotta strip out kw arg name indexes.
+            // (These are plain ints, so they need no freeing.)
             int64_t base = (
                 stack_args_bottom + inst->posargs +
                 stack->current_func_floor
@@ -2346,16 +2981,21 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
             int64_t top = stack->entry_count;
             int64_t i = 0;
             while (i < inst->kwargs) {
-                DELREF_NONHEAP(&stack->entry[base + i]);
-                valuecontent_Free(vmthread, &stack->entry[base + i]);
-                memmove(
+                assert(stack->entry[base + i * 2].type ==
+                       H64VALTYPE_INT64);
+                memcpy(
                     &stack->entry[base + i],
-                    &stack->entry[base + i + 1],
-                    (top - (i + base) - 1) * sizeof(valuecontent)
+                    &stack->entry[base + i * 2 + 1],
+                    sizeof(valuecontent)
                 );
-                stack->entry_count--;
                 i++;
             }
+            memmove(
+                &stack->entry[base + inst->kwargs],
+                &stack->entry[base + inst->kwargs * 2],
+                (top - base - inst->kwargs * 2) * sizeof(valuecontent)
+            );
+            stack->entry_count -= inst->kwargs;
         }
         // Ok, now we resize the stack to be what is actually needed:
         {
@@ -2681,7 +3321,7 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
                     // Handle suspend:
                     if (!unfinished_async_work) {
                         // Nothing unfinished, advance past call:
-                        p += sizeof(h64instruction_call);
+                        p += INSTSTRIDE(h64instruction_call);
                     }
                     // Restore possibly destroyed t0 slot:
                     int64_t retvaldestroyedslot = stack->current_func_floor;
@@ -2728,7 +3368,7 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
                 );  // FIXME: carry over inner stack trace
                 DELREF_NONHEAP(&retval);
                 valuecontent_Free(vmthread, &retval);
-                goto *jumptable[((h64instructionany *)p)->type];
+                DISPATCH_INST();
             } else {
                 vmthread_AbortAsyncForegroundWork(vmthread);
                 // Copy return value:
@@ -2761,8 +3401,8 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
             vmexec_VerifyStack(vmthread);
             #endif
 
-            p += sizeof(h64instruction_call);
-            goto *jumptable[((h64instructionany *)p)->type];
+            p += INSTSTRIDE(h64instruction_call);
+            DISPATCH_INST();
         } else {
             if ((inst->flags & CALLFLAG_ASYNC) != 0) {
                 // Async call. Need to set it up as separate execution
@@ -2783,7 +3423,7 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
                         "cannot call non-parallel func in this "
                         "context"
                     );
-                    goto *jumptable[((h64instructionany *)p)->type];
+                    DISPATCH_INST();
                 }
                 // Schedule call:
                 int result = vmschedule_AsyncScheduleFunc(
@@ -2800,14 +3440,23 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
                     goto triggeroom;
                 }
                 // Advance past call:
-                p += sizeof(h64instruction_call);
-                goto *jumptable[((h64instructionany *)p)->type];
+                p += INSTSTRIDE(h64instruction_call);
+                DISPATCH_INST();
             }
 
+            // If this plain call keeps going to the same func with
+            // nothing to reorder, quicken it to skip all the checks:
+            if (QUICKEN_ISPLAIN(inst_call) &&
+                    vc->type == H64VALTYPE_FUNCREF &&
+                    noargreorder && inst->kwargs == 0 &&
+                    QUICKEN_COUNT(h64instruction_call,
+                        (uint64_t)target_func_id + 1))
+                QUICKEN_TO(H64INST_CALLKNOWNFUNC);
+
             // Set execution to the new function:
             int64_t return_offset = (ptrdiff_t)(
-                p - pr->func[func_id].instructions
-            ) + sizeof(h64instruction_call);
+                p - FUNCCODE(func_id)
+            ) + INSTSTRIDE(h64instruction_call);
             if (!pushfuncframe(vmthread, target_func_id,
                     inst->returnto, func_id, return_offset,
                     new_func_floor
@@ -2825,11 +3474,90 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
             #endif
             func_id = target_func_id;
             vmthread->call_settop_reverse = -1;
-            p = pr->func[func_id].instructions;
-            pend = pr->func[func_id].instructions +
-                   (ptrdiff_t)pr->func[func_id].instructions_bytes;
-            goto *jumptable[((h64instructionany *)p)->type];
+            p = FUNCCODE(func_id);
+            pend = FUNCCODE(func_id) + (ptrdiff_t)FUNCCODESIZE(func_id);
+            PROFILE_SAMPLE_POINT();
+            DISPATCH_INST();
+        }
+    }
+    inst_callknownfunc: {
+        // A call quickened for the one h64 func it kept going to, with
+        // only positional args that need no reordering. The quicken key
+        // is the func id plus one:
+        h64instruction_call *inst = (h64instruction_call *)p;
+        #ifndef NDEBUG
+        if (vmthread->vmexec_owner->moptions.vmexec_debug &&
+                !vmthread_PrintExec(vmthread, func_id, (void*)inst))
+            goto triggeroom;
+        #endif
+
+        #ifndef NDEBUG
+        vmexec_VerifyStack(vmthread);
+        #endif
+
+        if (unlikely(rinfo->cfunc_resume.needs_cfunc_resume))
+            goto inst_call;  // resuming an earlier cfunc call from here
+        valuecontent *vc = STACK_ENTRY(stack, inst->slotcalledfrom);
+        if (unlikely(vc->type != H64VALTYPE_FUNCREF ||
+                (uint64_t)vc->int_value + 1 !=
+                    QUICKEN_KEY(h64instruction_call))) {
+            QUICKEN_REVERT(h64instruction_call, H64INST_CALL);
+            goto inst_call;
+        }
+        int64_t target_func_id = vc->int_value;
+        assert(!pr->func[target_func_id].iscfunc &&
+               pr->func[target_func_id].kwarg_count == 0 &&
+               pr->func[target_func_id].input_stack_size ==
+                   inst->posargs && inst->kwargs == 0);
+        if (vmthread->call_settop_reverse < 0) {
+            vmthread->call_settop_reverse = (
+                STACK_TOP(stack)
+            );
+        }
+        int64_t stack_args_bottom = STACK_TOP(stack) - inst->posargs;
+        assert(stack_args_bottom >= 0);
+        int64_t stack_target_size = (
+            stack_args_bottom +
+            pr->func[target_func_id].input_stack_size +
+            pr->func[target_func_id].inner_stack_size +
+            stack->current_func_floor
+        );
+        if (stack_target_size > STACK_TOTALSIZE(stack) &&
+                !stack_ToSize(stack, vmthread, stack_target_size, 0)) {
+            if (!vmthread_ResetCallTempStack(vmthread)) {
+                if (returneduncaughterror)
+                    *returneduncaughterror = 0;
+                return 0;
+            }
+            goto triggeroom;
         }
+        int64_t new_func_floor = (
+            stack->current_func_floor + stack_args_bottom
+        );
+        int64_t return_offset = (ptrdiff_t)(
+            p - FUNCCODE(func_id)
+        ) + INSTSTRIDE(h64instruction_call);
+        if (!pushfuncframe(vmthread, target_func_id,
+                inst->returnto, func_id, return_offset,
+                new_func_floor
+                )) {
+            goto triggeroom;
+        }
+        funcnestdepth++;
+        #ifndef NDEBUG
+        if (vmthread->vmexec_owner->moptions.vmexec_debug)
+            h64fprintf(
+                stderr, "horsevm: debug: vmexec jump into "
+                "h64 func %" PRId64 " (via quickened call)\n",
+                (int64_t)target_func_id
+            );
+        #endif
+        func_id = target_func_id;
+        vmthread->call_settop_reverse = -1;
+        p = FUNCCODE(func_id);
+        pend = FUNCCODE(func_id) + (ptrdiff_t)FUNCCODESIZE(func_id);
+        PROFILE_SAMPLE_POINT();
+        DISPATCH_INST();
     }
     inst_settop: {
         h64instruction_settop *inst = (h64instruction_settop *)p;
@@ -2853,8 +3581,8 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
         vmexec_VerifyStack(vmthread);
         #endif
 
-        p += sizeof(h64instruction_settop);
-        goto *jumptable[((h64instructionany *)p)->type];
+        p += INSTSTRIDE(h64instruction_settop);
+        DISPATCH_INST();
     }
     inst_callsettop: {
         h64instruction_callsettop *inst = (h64instruction_callsettop *)p;
@@ -2886,8 +3614,8 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
         vmexec_VerifyStack(vmthread);
         #endif
 
-        p += sizeof(h64instruction_settop);
-        goto *jumptable[((h64instructionany *)p)->type];
+        p += INSTSTRIDE(h64instruction_settop);
+        DISPATCH_INST();
     }
     inst_returnvalue: {
         h64instruction_returnvalue *inst = (h64instruction_returnvalue *)p;
@@ -3012,10 +3740,8 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
         funcid_t oldfuncid = func_id;
         func_id = returnfuncid;
         assert(func_id >= 0);
-        p = pr->func[func_id].instructions + returnoffset;
-        pend = pr->func[func_id].instructions + (
-            (ptrdiff_t)pr->func[func_id].instructions_bytes
-        );
+        p = FUNCCODE(func_id) + returnoffset;
+        pend = FUNCCODE(func_id) + (ptrdiff_t)FUNCCODESIZE(func_id);
         #ifndef NDEBUG
         if (vmthread->vmexec_owner->moptions.vmexec_debug) {
             h64fprintf(
@@ -3029,7 +3755,8 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
             );
         }
         #endif
-        goto *jumptable[((h64instructionany *)p)->type];
+        PROFILE_SAMPLE_POINT();
+        DISPATCH_INST();
     }
     inst_jumptarget: {
         h64fprintf(stderr, "jumptarget instruction "
@@ -3058,19 +3785,18 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
                 H64STDERROR_TYPEERROR,
                 "this value type cannot be evaluated as conditional"
             );
-            goto *jumptable[((h64instructionany *)p)->type];
+            DISPATCH_INST();
         }
         if (!jumpevalvalue) {  // jump if it is false
-            p += (
-                (ptrdiff_t)inst->jumpbytesoffset
+            p = INSTJUMPDEST(
+                h64instruction_condjump, inst, jumpbytesoffset, 0
             );
-            assert(p >= pr->func[func_id].instructions &&
-                   p < pend);
-            goto *jumptable[((h64instructionany *)p)->type];
+            assert(p >= FUNCCODE(func_id) && p < pend);
+            DISPATCH_INST();
         }
         
-        p += sizeof(h64instruction_condjump);
-        goto *jumptable[((h64instructionany *)p)->type];
+        p += INSTSTRIDE(h64instruction_condjump);
+        DISPATCH_INST();
     }
     inst_condjumpex: {
         h64instruction_condjumpex *inst = (
@@ -3096,7 +3822,7 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
                     "this value type cannot be "
                     "evaluated as conditional"
                 );
-                goto *jumptable[((h64instructionany *)p)->type];
+                DISPATCH_INST();
             }
             jumpevalvalue = ((
                 (inst->flags & CONDJUMPEX_FLAG_JUMPONTRUE)
@@ -3104,24 +3830,22 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
         }
         if ((inst->flags & CONDJUMPEX_FLAG_JUMPONTRUE) == 0 &&
                 !jumpevalvalue) {  // jump if it is false
-            p += (
-                (ptrdiff_t)inst->jumpbytesoffset
+            p = INSTJUMPDEST(
+                h64instruction_condjumpex, inst, jumpbytesoffset, 0
             );
-            assert(p >= pr->func[func_id].instructions &&
-                   p < pend);
-            goto *jumptable[((h64instructionany *)p)->type];
+            assert(p >= FUNCCODE(func_id) && p < pend);
+            DISPATCH_INST();
         } else if ((inst->flags & CONDJUMPEX_FLAG_JUMPONTRUE) != 0 &&
                 jumpevalvalue) {  // jump if it is true
-            p += (
-                (ptrdiff_t)inst->jumpbytesoffset
+            p = INSTJUMPDEST(
+                h64instruction_condjumpex, inst, jumpbytesoffset, 0
             );
-            assert(p >= pr->func[func_id].instructions &&
-                   p < pend);
-            goto *jumptable[((h64instructionany *)p)->type];
+            assert(p >= FUNCCODE(func_id) && p < pend);
+            DISPATCH_INST();
         }
 
-        p += sizeof(h64instruction_condjumpex);
-        goto *jumptable[((h64instructionany *)p)->type];
+        p += INSTSTRIDE(h64instruction_condjumpex);
+        DISPATCH_INST();
     }
     inst_jump: {
         h64instruction_jump *inst = (h64instruction_jump *)p;
@@ -3135,12 +3859,12 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
         vmexec_VerifyStack(vmthread);
         #endif
 
-        p += (
-            (ptrdiff_t)inst->jumpbytesoffset
+        p = INSTJUMPDEST(
+            h64instruction_jump, inst, jumpbytesoffset, 0
         );
-        assert(p >= pr->func[func_id].instructions &&
-               p < pend);
-        goto *jumptable[((h64instructionany *)p)->type];
+        assert(p >= FUNCCODE(func_id) && p < pend);
+        PROFILE_SAMPLE_POINT();
+        DISPATCH_INST();
     }
     inst_newiterator: {
         h64instruction_newiterator *inst = (
@@ -3169,7 +3893,7 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
                 vlist->type != H64VALTYPE_VECTOR)) {
             RAISE_ERROR(H64STDERROR_TYPEERROR,
                 "value iterated must be container");
-            goto *jumptable[((h64instructionany *)p)->type];
+            DISPATCH_INST();
         }
 
         valuecontent *v = STACK_ENTRY(stack, inst->slotiteratorto);
@@ -3183,7 +3907,7 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
             if (!v->iterator) {
                 RAISE_ERROR(H64STDERROR_OUTOFMEMORYERROR,
                     "out of memory creating iterator");
-                goto *jumptable[((h64instructionany *)p)->type];
+                DISPATCH_INST();
             }
             memset(v->iterator, 0, sizeof(*v->iterator));
             v->iterator->iterated_isgcvalue = 1;
@@ -3207,6 +3931,14 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
                 v->iterator->iterated_revision = vmmap_Revision(
                     ((h64gcvalue *)vlist->ptr_value)->map_values
                 );
+            } else if (((h64gcvalue *)vlist->ptr_value)->type ==
+                    H64GCVALUETYPE_SET) {
+                v->iterator->len = vmset_Count(
+                    ((h64gcvalue *)vlist->ptr_value)->set_values
+                );
+                v->iterator->iterated_revision = vmset_Revision(
+                    ((h64gcvalue *)vlist->ptr_value)->set_values
+                );
             } else {
                 h64fprintf(stderr, "container not implemented\n");
                 return 0;
@@ -3220,7 +3952,7 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
             if (!v->iterator) {
                 RAISE_ERROR(H64STDERROR_OUTOFMEMORYERROR,
                     "out of memory creating iterator");
-                goto *jumptable[((h64instructionany *)p)->type];
+                DISPATCH_INST();
             }
             memset(v->iterator, 0, sizeof(*v->iterator));
             v->iterator->iterated_isgcvalue = 0;
@@ -3229,12 +3961,11 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
                 vlist, sizeof(*vlist)
             );
             ADDREF_NONHEAP(&v->iterator->iterated_vector);
-            v->iterator->len = vlist->vector_len;
-            return 0;
+            v->iterator->len = vmvector_Count(vlist->vector_values);
         }
 
-        p += sizeof(h64instruction_newiterator);
-        goto *jumptable[((h64instructionany *)p)->type];
+        p += INSTSTRIDE(h64instruction_newiterator);
+        DISPATCH_INST();
     }
     inst_iterate: {
         h64instruction_iterate *inst = (
@@ -3256,7 +3987,7 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
         if (unlikely(viterated->type != H64VALTYPE_ITERATOR)) {
             RAISE_ERROR(H64STDERROR_TYPEERROR,
                 "value in iteration must be an iterator");
-            goto *jumptable[((h64instructionany *)p)->type];
+            DISPATCH_INST();
         }
         h64iteratorstruct *iter = viterated->iterator;
 
@@ -3272,6 +4003,11 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
                 need_rev = vmmap_Revision(
                     iter->iterated_gcvalue->map_values
                 );
+            } else if (iter->iterated_gcvalue->type ==
+                    H64GCVALUETYPE_SET) {
+                need_rev = vmset_Revision(
+                    iter->iterated_gcvalue->set_values
+                );
             } else {
                 h64fprintf(stderr, "container not implemented\n");
                 return 0;
@@ -3279,18 +4015,25 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
             if (need_rev != iter->iterated_revision) {
                 RAISE_ERROR(H64STDERROR_CONTAINERCHANGEDERROR,
                     "iterated container was altered");
-                goto *jumptable[((h64instructionany *)p)->type];
+                DISPATCH_INST();
+            }
+            if (QUICKEN_ISPLAIN(inst_iterate) &&
+                    QUICKEN_COUNT(h64instruction_iterate,
+                        (uint64_t)iter->iterated_gcvalue->type + 1)) {
+                if (iter->iterated_gcvalue->type == H64GCVALUETYPE_LIST)
+                    QUICKEN_TO(H64INST_ITERATELIST);
+                else
+                    QUICKEN_GIVEUP(h64instruction_iterate);
             }
         }
 
         iter->idx++;
         if (iter->idx > iter->len) {
-            p += (
-                (ptrdiff_t)inst->jumponend
+            p = INSTJUMPDEST(
+                h64instruction_iterate, inst, jumponend, 0
             );
-            assert(p >= pr->func[func_id].instructions &&
-                p < pend);
-            goto *jumptable[((h64instructionany *)p)->type];
+            assert(p >= FUNCCODE(func_id) && p < pend);
+            DISPATCH_INST();
         }
 
         valuecontent *vcresult = STACK_ENTRY(
@@ -3310,42 +4053,88 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
                 ADDREF_NONHEAP(vcresult);
             } else if (iter->iterated_gcvalue->type ==
                     H64GCVALUETYPE_MAP) {
-                int inneroom = 0;
-                int result = vmmap_Get(
-                    vmthread,
+                valuecontent *key = NULL;
+                valuecontent *v = NULL;
+                int result = vmmap_IterateNext(
                     iter->iterated_gcvalue->map_values,
-                    vmmap_GetKeyByIdx(
-                        iter->iterated_gcvalue->map_values,
-                        iter->idx
-                    ), vcresult, &inneroom
+                    &iter->container_pos, &key, &v
                 );
-                if (!result) {
-                    assert(inneroom != 0);
-                    RAISE_ERROR(H64STDERROR_OUTOFMEMORYERROR,
-                        "out of memory while iterating map");
-                    goto *jumptable[((h64instructionany *)p)->type];
-                }
-                assert(result != 0);
+                assert(result != 0 && v != NULL);
+                memcpy(vcresult, v, sizeof(*vcresult));
+                ADDREF_NONHEAP(vcresult);
+            } else if (iter->iterated_gcvalue->type ==
+                    H64GCVALUETYPE_SET) {
+                valuecontent *v = vmset_IterateNext(
+                    iter->iterated_gcvalue->set_values,
+                    &iter->container_pos
+                );
+                assert(v != NULL);
+                memcpy(vcresult, v, sizeof(*vcresult));
                 ADDREF_NONHEAP(vcresult);
             } else {
                 h64fprintf(stderr, "container not implemented\n");
                 return 0;
             }
         } else {
-            vectorentry *ve = &(
-                iter->iterated_vector.vector_values[iter->idx]
+            vmvector_Get(
+                iter->iterated_vector.vector_values, iter->idx,
+                vcresult
             );
-            if (ve->int_value) {
-                vcresult->type = H64VALTYPE_INT64;
-                vcresult->int_value = ve->int_value;
-            } else {
-                vcresult->type = H64VALTYPE_FLOAT64;
-                vcresult->int_value = ve->float_value;
-            }
         }
 
-        p += sizeof(h64instruction_iterate);
-        goto *jumptable[((h64instructionany *)p)->type];
+        p += INSTSTRIDE(h64instruction_iterate);
+        DISPATCH_INST();
+    }
+    inst_iteratelist: {
+        // An iteration quickened for always going over a list:
+        h64instruction_iterate *inst = (
+            (h64instruction_iterate *)p
+        );
+        #ifndef NDEBUG
+        if (vmthread->vmexec_owner->moptions.vmexec_debug &&
+                !vmthread_PrintExec(vmthread, func_id, (void*)inst))
+            goto triggeroom;
+        #endif
+
+        #ifndef NDEBUG
+        vmexec_VerifyStack(vmthread);
+        #endif
+
+        valuecontent *viterated = STACK_ENTRY(
+            stack, inst->slotiteratorfrom
+        );
+        if (unlikely(viterated->type != H64VALTYPE_ITERATOR ||
+                !viterated->iterator->iterated_isgcvalue ||
+                viterated->iterator->iterated_gcvalue->type !=
+                    H64GCVALUETYPE_LIST)) {
+            QUICKEN_REVERT(h64instruction_iterate, H64INST_ITERATE);
+            goto inst_iterate;
+        }
+        h64iteratorstruct *iter = viterated->iterator;
+        genericlist *l = iter->iterated_gcvalue->list_values;
+        if (unlikely(vmlist_Revision(l) != iter->iterated_revision))
+            goto inst_iterate;  // raises the error
+
+        iter->idx++;
+        if (iter->idx > iter->len) {
+            p = INSTJUMPDEST(
+                h64instruction_iterate, inst, jumponend, 0
+            );
+            assert(p >= FUNCCODE(func_id) && p < pend);
+            DISPATCH_INST();
+        }
+        valuecontent *v = vmlist_Get(l, iter->idx);
+        assert(v != NULL);
+        valuecontent *vcresult = STACK_ENTRY(
+            stack, inst->slotvalueto
+        );
+        DELREF_NONHEAP(vcresult);
+        valuecontent_Free(vmthread, vcresult);
+        memcpy(vcresult, v, sizeof(*vcresult));
+        ADDREF_NONHEAP(vcresult);
+
+        p += INSTSTRIDE(h64instruction_iterate);
+        DISPATCH_INST();
     }
     inst_pushrescueframe: {
         h64instruction_pushrescueframe *inst = (
@@ -3364,20 +4153,20 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
         #ifndef NDEBUG
         int previous_count = vmthread->errorframe_count;
         if ((inst->mode & RESCUEMODE_JUMPONRESCUE))
-            assert((p - pr->func[func_id].instructions) +
-                 (int64_t)inst->jumponrescue >= 0);
+            assert(INSTJUMPDEST(h64instruction_pushrescueframe,
+                inst, jumponrescue, 0) >= FUNCCODE(func_id));
         if ((inst->mode & RESCUEMODE_JUMPONFINALLY))
-            assert((p - pr->func[func_id].instructions) +
-                 (int64_t)inst->jumponfinally >= 0);
+            assert(INSTJUMPDEST(h64instruction_pushrescueframe,
+                inst, jumponfinally, 1) >= FUNCCODE(func_id));
         #endif
         if (!pusherrorframe(
                 vmthread, inst->frameid,
                 ((inst->mode & RESCUEMODE_JUMPONRESCUE) != 0 ?
-                 (p - pr->func[func_id].instructions) +
-                 (int64_t)inst->jumponrescue : -1),
+                 INSTJUMPDEST(h64instruction_pushrescueframe,
+                    inst, jumponrescue, 0) - FUNCCODE(func_id) : -1),
                 ((inst->mode & RESCUEMODE_JUMPONFINALLY) != 0 ?
-                 (p - pr->func[func_id].instructions) +
-                 (int64_t)inst->jumponfinally : -1),
+                 INSTJUMPDEST(h64instruction_pushrescueframe,
+                    inst, jumponfinally, 1) - FUNCCODE(func_id) : -1),
                 inst->sloterrorto)) {
             goto triggeroom;
         }
@@ -3386,7 +4175,7 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
                vmthread->errorframe_count > previous_count);
         #endif
 
-        p += sizeof(h64instruction_pushrescueframe);
+        p += INSTSTRIDE(h64instruction_pushrescueframe);
         while (((h64instructionany *)p)->type == H64INST_ADDRESCUETYPE ||
                 ((h64instructionany *)p)->type == H64INST_ADDRESCUETYPEBYREF
                 ) {
@@ -3422,34 +4211,44 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
             if (class_id < 0) {
                 RAISE_ERROR(H64STDERROR_TYPEERROR,
                                 "catch on non-Error type");
-                goto *jumptable[((h64instructionany *)p)->type];
+                DISPATCH_INST();
             }
             assert(vmthread->errorframe_count > 0);
             h64vmrescueframe *topframe = &(vmthread->
                 errorframe[vmthread->errorframe_count - 1]);
-            if (topframe->caught_types_count + 1 > 5) {
-                int64_t *caught_types_more_new = malloc(
-                    sizeof(*caught_types_more_new) *
-                    ((topframe->caught_types_count + 1) - 5)
-                );
-                if (!caught_types_more_new)
-                    goto triggeroom;
-                topframe->caught_types_more = caught_types_more_new;
-            }
             int index = topframe->caught_types_count;
-            if (index >= 5) {
-                topframe->caught_types_more[index - 5] = class_id;
+            if (likely(index < VMTHREAD_RESCUEFRAME_INLINETYPES)) {
+                topframe->caught_types_first[index] = class_id;
             } else {
-                topframe->caught_types_firstfive[index] = class_id;
+                h64vmrescueframeextra *extra = _rescueframeextra(
+                    vmthread, vmthread->errorframe_count - 1
+                );
+                if (!extra)
+                    goto triggeroom;
+                int moreindex = index - VMTHREAD_RESCUEFRAME_INLINETYPES;
+                if (moreindex >= extra->caught_types_more_alloc) {
+                    int new_alloc = extra->caught_types_more_alloc * 2;
+                    if (new_alloc < 4)
+                        new_alloc = 4;
+                    classid_t *caught_types_more_new = realloc(
+                        extra->caught_types_more,
+                        sizeof(*caught_types_more_new) * new_alloc
+                    );
+                    if (!caught_types_more_new)
+                        goto triggeroom;
+                    extra->caught_types_more = caught_types_more_new;
+                    extra->caught_types_more_alloc = new_alloc;
+                }
+                extra->caught_types_more[moreindex] = class_id;
             }
             topframe->caught_types_count++;
             if (((h64instructionany *)p)->type == H64INST_ADDRESCUETYPE) {
-                p += sizeof(h64instruction_addrescuetype);
+                p += INSTSTRIDE(h64instruction_addrescuetype);
             } else {
-                p += sizeof(h64instruction_addrescuetypebyref);
+                p += INSTSTRIDE(h64instruction_addrescuetypebyref);
             }
         }
-        goto *jumptable[((h64instructionany *)p)->type];
+        DISPATCH_INST();
     }
     inst_addrescuetypebyref: {
         h64fprintf(stderr, "INVALID isolated addrescuetypebyref!!\n");
@@ -3476,7 +4275,7 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
         // See if we got a finally block to terminate:
         assert(vmthread->errorframe_count > 0);
         {
-            int64_t offset = (p - pr->func[func_id].instructions);
+            int64_t offset = (p - FUNCCODE(func_id));
             int64_t oldoffset = offset;
             int exitwitherror = 0;
             h64errorinfo e = {0};
@@ -3496,12 +4295,12 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
                 return 1;
             }
             if (offset == oldoffset) {
-                offset += sizeof(h64instruction_poprescueframe);
+                offset += INSTSTRIDE(h64instruction_poprescueframe);
             }
-            p = (pr->func[func_id].instructions + offset);
+            p = (FUNCCODE(func_id) + offset);
         }
 
-        goto *jumptable[((h64instructionany *)p)->type];
+        DISPATCH_INST();
     }
     inst_getattributebyidx: {
         h64instruction_getattributebyidx *inst = (
@@ -3545,7 +4344,7 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
                     H64GCVALUETYPE_OBJINSTANCE) {
             RAISE_ERROR(H64STDERROR_TYPEERROR,
                         "can only get attribute from object instance");
-            goto *jumptable[((h64instructionany *)p)->type];
+            DISPATCH_INST();
         }
 
         attridx_t attr_index = inst->varattrfrom;
@@ -3556,7 +4355,7 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
                     attr_index >= pr->classes[cls].varattr_count) {
                 RAISE_ERROR(H64STDERROR_ATTRIBUTEERROR,
                     "invalid attribute index on object instance");
-                goto *jumptable[((h64instructionany *)p)->type];
+                DISPATCH_INST();
             }
             memcpy(
                 target, &vobjgc->varattr[attr_index],
@@ -3569,7 +4368,7 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
                     methodidx >= pr->classes[cls].funcattr_count) {
                 RAISE_ERROR(H64STDERROR_ATTRIBUTEERROR,
                     "invalid attribute index on object instance");
-                goto *jumptable[((h64instructionany *)p)->type];
+                DISPATCH_INST();
             }
             target->type = H64VALTYPE_GCVAL;
             target->ptr_value = poolalloc_malloc(
@@ -3625,8 +4424,8 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
         vmexec_VerifyStack(vmthread);
         #endif
 
-        p += sizeof(*inst);
-        goto *jumptable[((h64instructionany *)p)->type];
+        p += INSTSTRIDE(h64instruction_getattributebyidx);
+        DISPATCH_INST();
     }
     inst_getattributebyname: {
         h64instruction_getattributebyname *inst = (
@@ -3667,6 +4466,19 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
         attridx_t attr_index = -1;
         int64_t nameidx = inst->nameidx;
         funcid_t lookup_func_idx = -1;
+        assert(inst->cacheidx >= 0 &&
+               inst->cacheidx < pr->attrcache_count);
+        h64attrcache *cache = &pr->attrcache[inst->cacheidx];
+        if (likely(vc->type == H64VALTYPE_GCVAL &&
+                ((h64gcvalue *)vc->ptr_value)->type ==
+                    H64GCVALUETYPE_OBJINSTANCE &&
+                (attr_index = _vmexec_CachedClassAttribute(
+                    cache, ((h64gcvalue *)vc->ptr_value)->class_id
+                )) >= 0)) {
+            // Only cached after this went through all the special cases
+            // below for an object once, so they can't apply here:
+            goto getattr_objattribute;
+        }
         if (nameidx >= 0 &&
                 nameidx == vmexec->program->as_str_name_index
                 ) {  // .as_str
@@ -3680,8 +4492,8 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
                 // Special case, just re-reference string:
                 if (copyatend) {
                     // Just leave as is, target and source are the same
-                    p += sizeof(*inst);
-                    goto *jumptable[((h64instructionany *)p)->type];
+                    p += INSTSTRIDE(h64instruction_getattributebyname);
+                    DISPATCH_INST();
                 }
                 ((h64gcvalue *)vc->ptr_value)->
                     externalreferencecount++;
@@ -3720,7 +4532,7 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
                     "internal error: as_str not "
                     "implemented for this type"
                 );
-                goto *jumptable[((h64instructionany *)p)->type];
+                DISPATCH_INST();
             }
             // Actually set string value that we obtained:
             target->type = H64VALTYPE_NONE;
@@ -3756,8 +4568,8 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
                 // Special case, just re-reference the bytes:
                 if (copyatend) {
                     // Just leave as is, target and source are the same
-                    p += sizeof(*inst);
-                    goto *jumptable[((h64instructionany *)p)->type];
+                    p += INSTSTRIDE(h64instruction_getattributebyname);
+                    DISPATCH_INST();
                 }
                 ((h64gcvalue *)vc->ptr_value)->
                     externalreferencecount++;
@@ -3818,7 +4630,7 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
                     "internal error: .as_bytes not "
                     "implemented for this type"
                 );
-                goto *jumptable[((h64instructionany *)p)->type];
+                DISPATCH_INST();
             }
             // Actually set string value that we obtained:
             target->type = H64VALTYPE_GCVAL;
@@ -3926,6 +4738,11 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
                     len = vmmap_Count(
                         ((h64gcvalue *)vc->ptr_value)->map_values
                     );
+                } else if (((h64gcvalue *)vc->ptr_value)->type ==
+                        H64GCVALUETYPE_SET) {
+                    len = vmset_Count(
+                        ((h64gcvalue *)vc->ptr_value)->set_values
+                    );
                 }
             } else if (vc->type == H64VALTYPE_SHORTSTR) {
                 char *ptr = (char*)vc->shortstr_value;
@@ -3935,14 +4752,14 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
             } else if (vc->type == H64VALTYPE_SHORTBYTES) {
                 len = vc->shortbytes_len;
             } else if (vc->type == H64VALTYPE_VECTOR) {
-                len = vc->vector_len;
+                len = vmvector_Count(vc->vector_values);
             }
             if (len < 0) {
                 RAISE_ERROR(
                     H64STDERROR_ATTRIBUTEERROR,
                     "given attribute not present on this value"
                 );
-                goto *jumptable[((h64instructionany *)p)->type];
+                DISPATCH_INST();
             }
             target->type = H64VALTYPE_INT64;
             target->int_value = len;
@@ -3963,7 +4780,7 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
                 "this special func attribute is not "
                 "directly accessible"
             );
-            goto *jumptable[((h64instructionany *)p)->type];
+            DISPATCH_INST();
         } else if (vc->type == H64VALTYPE_GCVAL && (
                  ((h64gcvalue *)vc->ptr_value)->type ==
                      H64GCVALUETYPE_LIST ||
@@ -4005,6 +4822,53 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
                 (h64gcvalue *)vc->ptr_value
             );
             ADDREF_HEAP(vc);  // for ref by closure
+        } else if (vc->type == H64VALTYPE_VECTOR &&
+                (lookup_func_idx =
+                    corelib_GetContainerFuncIdx(
+                        pr, nameidx, CORELIB_CONTAINERTYPE_VECTOR
+                    )) >= 0
+                ) {  // vector func attr
+            target->type = H64VALTYPE_GCVAL;
+            target->ptr_value = poolalloc_malloc(
+                heap, 0
+            );
+            if (!target->ptr_value)
+                goto triggeroom;
+            h64gcvalue *gcval = (h64gcvalue *)target->ptr_value;
+            gcval->hash = 0;
+            gcval->type = H64GCVALUETYPE_FUNCREF_CLOSURE;
+            gcval->heapreferencecount = 0;
+            gcval->externalreferencecount = 1;
+            gcval->closure_info = (
+                malloc(sizeof(*gcval->closure_info))
+            );
+            if (!gcval->closure_info) {
+                poolalloc_free(heap, gcval);
+                target->ptr_value = NULL;
+                goto triggeroom;
+            }
+            memset(gcval->closure_info, 0,
+                    sizeof(*gcval->closure_info));
+            gcval->closure_info->closure_func_id = (
+                lookup_func_idx
+            );
+            // Vectors aren't gc values, so bind them as a value:
+            gcval->closure_info->closure_bound_values = malloc(
+                sizeof(*gcval->closure_info->closure_bound_values) *
+                1
+            );
+            if (!gcval->closure_info->closure_bound_values) {
+                free(gcval->closure_info);
+                poolalloc_free(heap, gcval);
+                target->ptr_value = NULL;
+                goto triggeroom;
+            }
+            gcval->closure_info->closure_bound_values_count = 1;
+            memcpy(
+                &gcval->closure_info->closure_bound_values[0],
+                vc, sizeof(*vc)
+            );
+            ADDREF_HEAP(vc);  // for ref by closure
         } else if ((((vc->type == H64VALTYPE_GCVAL && (
                 ((h64gcvalue *)vc->ptr_value)->type ==
                     H64GCVALUETYPE_BYTES)) ||
@@ -4067,10 +4931,11 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
                 vc->type == H64VALTYPE_GCVAL &&
                 ((h64gcvalue *)vc->ptr_value)->type ==
                 H64GCVALUETYPE_OBJINSTANCE &&
-                ((attr_index = h64program_LookupClassAttribute(
-                    pr, ((h64gcvalue *)vc->ptr_value)->class_id,
+                ((attr_index = _vmexec_LookupClassAttributeCached(
+                    pr, cache, ((h64gcvalue *)vc->ptr_value)->class_id,
                     nameidx
                     )) >= 0)) {  // regular obj attributes
+            getattr_objattribute: ;
             if (attr_index < H64CLASS_METHOD_OFFSET) {
                 // A varattr, just copy the contents:
                 h64gcvalue *gcv = ((h64gcvalue *)vc->ptr_value);
@@ -4079,6 +4944,11 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
                 memcpy(target, &gcv->varattr[attr_index],
                        sizeof(*target));
                 ADDREF_NONHEAP(target);
+                if (QUICKEN_ISPLAIN(inst_getattributebyname) &&
+                        QUICKEN_COUNT(h64instruction_getattributebyname,
+                            (((uint64_t)(uint32_t)gcv->class_id + 1) << 16) |
+                            (uint64_t)attr_index))
+                    QUICKEN_TO(H64INST_GETOBJVARATTR);
             } else {
                 // It's a function attribute, return closure:
                 classid_t class_id = (
@@ -4124,7 +4994,7 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
                 H64STDERROR_ATTRIBUTEERROR,
                 "given attribute not present on this value"
             );
-            goto *jumptable[((h64instructionany *)p)->type];
+            DISPATCH_INST();
         }
         if (copyatend) {
             DELREF_NONHEAP(STACK_ENTRY(stack, inst->slotto));
@@ -4139,8 +5009,139 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
         vmexec_VerifyStack(vmthread);
         #endif
 
-        p += sizeof(*inst);
-        goto *jumptable[((h64instructionany *)p)->type];
+        p += INSTSTRIDE(h64instruction_getattributebyname);
+        DISPATCH_INST();
+    }
+    inst_getattrcallsettop: {
+        // An attribute lookup for a call, with the call's callsettop
+        // right after it. The compiler only fuses names that aren't
+        // special-cased above, so object attributes can be looked up
+        // directly. Everything else takes the regular path:
+        h64instruction_getattributebyname *inst = (
+            (h64instruction_getattributebyname *)p
+        );
+        #ifndef NDEBUG
+        if (vmthread->vmexec_owner->moptions.vmexec_debug &&
+                !vmthread_PrintExec(vmthread, func_id, (void*)inst))
+            goto triggeroom;
+        #endif
+
+        #ifndef NDEBUG
+        vmexec_VerifyStack(vmthread);
+        #endif
+
+        valuecontent *vc = STACK_ENTRY(stack, inst->objslotfrom);
+        if (unlikely(inst->slotto == inst->objslotfrom ||
+                vc->type != H64VALTYPE_GCVAL ||
+                ((h64gcvalue *)vc->ptr_value)->type !=
+                    H64GCVALUETYPE_OBJINSTANCE)) {
+            VMSTATS_INC(superinst_fallback_count);
+            goto inst_getattributebyname;
+        }
+        h64gcvalue *gcv = ((h64gcvalue *)vc->ptr_value);
+        assert(inst->cacheidx >= 0 &&
+               inst->cacheidx < pr->attrcache_count);
+        attridx_t attr_index = _vmexec_LookupClassAttributeCached(
+            pr, &pr->attrcache[inst->cacheidx], gcv->class_id,
+            inst->nameidx
+        );
+        if (unlikely(attr_index < 0)) {
+            VMSTATS_INC(superinst_fallback_count);
+            goto inst_getattributebyname;
+        }
+        valuecontent *target = STACK_ENTRY(stack, inst->slotto);
+        DELREF_NONHEAP(target);
+        valuecontent_Free(vmthread, target);
+        memset(target, 0, sizeof(*target));
+        if (attr_index < H64CLASS_METHOD_OFFSET) {
+            memcpy(target, &gcv->varattr[attr_index],
+                   sizeof(*target));
+            ADDREF_NONHEAP(target);
+        } else {
+            assert(
+                attr_index - H64CLASS_METHOD_OFFSET <
+                pr->classes[gcv->class_id].funcattr_count
+            );
+            h64gcvalue *gcval = poolalloc_malloc(heap, 0);
+            if (!gcval)
+                goto triggeroom;
+            gcval->hash = 0;
+            gcval->type = H64GCVALUETYPE_FUNCREF_CLOSURE;
+            gcval->heapreferencecount = 0;
+            gcval->externalreferencecount = 1;
+            gcval->closure_info = (
+                malloc(sizeof(*gcval->closure_info))
+            );
+            if (!gcval->closure_info) {
+                poolalloc_free(heap, gcval);
+                goto triggeroom;
+            }
+            memset(gcval->closure_info, 0,
+                   sizeof(*gcval->closure_info));
+            gcval->closure_info->closure_func_id = (
+                pr->classes[gcv->class_id].funcattr_func_idx[
+                    (attr_index - H64CLASS_METHOD_OFFSET)
+                ]
+            );
+            gcval->closure_info->closure_self = gcv;
+            ADDREF_HEAP(vc);  // for ref by closure
+            target->type = H64VALTYPE_GCVAL;
+            target->ptr_value = gcval;
+        }
+
+        #ifndef NDEBUG
+        vmexec_VerifyStack(vmthread);
+        #endif
+
+        p += INSTSTRIDE(h64instruction_getattributebyname);
+        assert(((h64instructionany *)p)->type == H64INST_CALLSETTOP);
+        goto inst_callsettop;
+    }
+    inst_getobjvarattr: {
+        // An attribute lookup quickened for the one class it kept
+        // finding a var attribute on. The quicken key is the class id
+        // plus one, and the var attribute index:
+        h64instruction_getattributebyname *inst = (
+            (h64instruction_getattributebyname *)p
+        );
+        #ifndef NDEBUG
+        if (vmthread->vmexec_owner->moptions.vmexec_debug &&
+                !vmthread_PrintExec(vmthread, func_id, (void*)inst))
+            goto triggeroom;
+        #endif
+
+        #ifndef NDEBUG
+        vmexec_VerifyStack(vmthread);
+        #endif
+
+        valuecontent *vc = STACK_ENTRY(stack, inst->objslotfrom);
+        uint64_t key = QUICKEN_KEY(h64instruction_getattributebyname);
+        if (unlikely(vc->type != H64VALTYPE_GCVAL ||
+                ((h64gcvalue *)vc->ptr_value)->type !=
+                    H64GCVALUETYPE_OBJINSTANCE ||
+                (uint64_t)(uint32_t)((h64gcvalue *)vc->ptr_value)->
+                    class_id + 1 != (key >> 16))) {
+            QUICKEN_REVERT(
+                h64instruction_getattributebyname, H64INST_GETATTRIBUTEBYNAME
+            );
+            goto inst_getattributebyname;
+        }
+        h64gcvalue *gcv = ((h64gcvalue *)vc->ptr_value);
+        attridx_t attr_index = (attridx_t)(key & 0xFFFFULL);
+        assert(attr_index >= 0 &&
+               attr_index < pr->classes[gcv->class_id].varattr_count);
+        // Reference the value first, in case the target slot holds the
+        // only reference to the object:
+        valuecontent result;
+        memcpy(&result, &gcv->varattr[attr_index], sizeof(result));
+        ADDREF_NONHEAP(&result);
+        valuecontent *target = STACK_ENTRY(stack, inst->slotto);
+        DELREF_NONHEAP(target);
+        valuecontent_Free(vmthread, target);
+        memcpy(target, &result, sizeof(*target));
+
+        p += INSTSTRIDE(h64instruction_getattributebyname);
+        DISPATCH_INST();
     }
     inst_jumptofinally: {
         h64instruction_jumptofinally *inst = (
@@ -4152,12 +5153,12 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
             goto triggeroom;
         #endif
 
-        int64_t offset = (p - pr->func[func_id].instructions);
+        int64_t offset = (p - FUNCCODE(func_id));
         vmthread_errors_ProceedToFinally(
             vmthread, &func_id, &offset
         );
-        p = (pr->func[func_id].instructions + offset);
-        goto *jumptable[((h64instructionany *)p)->type];
+        p = (FUNCCODE(func_id) + offset);
+        DISPATCH_INST();
     }
     inst_newlist: {
         h64instruction_newlist *inst = (
@@ -4195,12 +5196,47 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
         vmexec_VerifyStack(vmthread);
         #endif
 
-        p += sizeof(h64instruction_newlist);
-        goto *jumptable[((h64instructionany *)p)->type];
+        p += INSTSTRIDE(h64instruction_newlist);
+        DISPATCH_INST();
     }
     inst_newset: {
-        h64fprintf(stderr, "newset not implemented\n");
-        return 0;
+        h64instruction_newset *inst = (
+            (h64instruction_newset *)p
+        );
+        #ifndef NDEBUG
+        if (vmthread->vmexec_owner->moptions.vmexec_debug &&
+                !vmthread_PrintExec(vmthread, func_id, (void*)inst))
+            goto triggeroom;
+        #endif
+
+        valuecontent *vc = STACK_ENTRY(stack, inst->slotto);
+        DELREF_NONHEAP(vc);
+        valuecontent_Free(vmthread, vc);
+        memset(vc, 0, sizeof(*vc));
+        vc->type = H64VALTYPE_GCVAL;
+        vc->ptr_value = poolalloc_malloc(
+            heap, 0
+        );
+        if (!vc->ptr_value)
+            goto triggeroom;
+        h64gcvalue *gcval = (h64gcvalue *)vc->ptr_value;
+        gcval->hash = 0;
+        gcval->type = H64GCVALUETYPE_SET;
+        gcval->heapreferencecount = 0;
+        gcval->externalreferencecount = 1;
+        gcval->set_values = vmset_New();
+        if (!gcval->set_values) {
+            poolalloc_free(heap, vc->ptr_value);
+            vc->ptr_value = NULL;
+            goto triggeroom;
+        }
+
+        #ifndef NDEBUG
+        vmexec_VerifyStack(vmthread);
+        #endif
+
+        p += INSTSTRIDE(h64instruction_newset);
+        DISPATCH_INST();
     }
     inst_newmap: {
         h64instruction_newmap *inst = (
@@ -4238,12 +5274,36 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
         vmexec_VerifyStack(vmthread);
         #endif
 
-        p += sizeof(h64instruction_newmap);
-        goto *jumptable[((h64instructionany *)p)->type];
+        p += INSTSTRIDE(h64instruction_newmap);
+        DISPATCH_INST();
     }
     inst_newvector: {
-        h64fprintf(stderr, "newvector not implemented\n");
-        return 0;
+        h64instruction_newvector *inst = (
+            (h64instruction_newvector *)p
+        );
+        #ifndef NDEBUG
+        if (vmthread->vmexec_owner->moptions.vmexec_debug &&
+                !vmthread_PrintExec(vmthread, func_id, (void*)inst))
+            goto triggeroom;
+        #endif
+
+        valuecontent *vc = STACK_ENTRY(stack, inst->slotto);
+        DELREF_NONHEAP(vc);
+        valuecontent_Free(vmthread, vc);
+        memset(vc, 0, sizeof(*vc));
+        genericvector *vector = vmvector_New(0);
+        if (!vector)
+            goto triggeroom;
+        vc->type = H64VALTYPE_VECTOR;
+        vc->vector_values = vector;
+        vector->refcount = 1;
+
+        #ifndef NDEBUG
+        vmexec_VerifyStack(vmthread);
+        #endif
+
+        p += INSTSTRIDE(h64instruction_newvector);
+        DISPATCH_INST();
     }
     {
         // WARNING: ALL UNINITIALIZED, since goto jumps over them:
@@ -4270,7 +5330,7 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
             #ifndef NDEBUG
             wasbyref = 1;
             #endif
-            skipbytes = sizeof(*inst);
+            skipbytes = INSTSTRIDE(h64instruction_newinstancebyref);
             slot_to = inst->slotto;
             valuecontent *vcfrom = STACK_ENTRY(
                 stack, inst->classtypeslotfrom
@@ -4280,7 +5340,7 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
                     H64STDERROR_TYPEERROR,
                     "new must be called on a class type"
                 );
-                goto *jumptable[((h64instructionany *)p)->type];
+                DISPATCH_INST();
             }
             class_id = vcfrom->int_value;
             goto sharedending_newinstance_newinstancebyref;
@@ -4302,7 +5362,7 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
             #ifndef NDEBUG
             wasbyref = 0;
             #endif
-            skipbytes = sizeof(*inst);
+            skipbytes = INSTSTRIDE(h64instruction_newinstance);
             slot_to = inst->slotto;
             class_id = inst->classidcreatefrom;
             goto sharedending_newinstance_newinstancebyref;
@@ -4323,6 +5383,7 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
             gcval->heapreferencecount = 0;
             gcval->externalreferencecount = 1;
             gcval->class_id = class_id;
+            gcval->cdata = NULL;
             int32_t varattr_count = (
                 vmexec->program->classes[class_id].varattr_count
             );
@@ -4353,7 +5414,7 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
                     STACK_TOTALSIZE(stack) + 1
                 );
                 int64_t offset = (ptrdiff_t)(
-                    p - pr->func[func_id].instructions
+                    p - FUNCCODE(func_id)
                 ) + skipbytes;
                 if (!pushfuncframe(vmthread, varinit_func_id,
                         -1, func_id, offset,
@@ -4392,10 +5453,9 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
                 #endif
                 func_id = varinit_func_id;
                 vmthread->call_settop_reverse = -1;
-                p = pr->func[func_id].instructions;
-                pend = pr->func[func_id].instructions +
-                       (intptr_t)pr->func[func_id].instructions_bytes;
-                goto *jumptable[((h64instructionany *)p)->type];
+                p = FUNCCODE(func_id);
+                pend = FUNCCODE(func_id) + (intptr_t)FUNCCODESIZE(func_id);
+                DISPATCH_INST();
             } else {
                 // No $$varinit.
                 #ifndef NDEBUG
@@ -4403,7 +5463,7 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
                 #endif
 
                 p += skipbytes;
-                goto *jumptable[((h64instructionany *)p)->type];
+                DISPATCH_INST();
             }
         }
     }
@@ -4496,8 +5556,8 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
         vmexec_VerifyStack(vmthread);
         #endif
 
-        p += sizeof(*inst);
-        goto *jumptable[((h64instructionany *)p)->type];
+        p += INSTSTRIDE(h64instruction_getconstructor);
+        DISPATCH_INST();
     }
     inst_awaititem: {
         h64fprintf(stderr, "awaititem not implemented\n");
@@ -4563,11 +5623,13 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
         }
 
         if (!found) {
-            p += (int64_t)inst->jumpbytesoffset;
+            p = INSTJUMPDEST(
+                h64instruction_hasattrjump, inst, jumpbytesoffset, 0
+            );
         } else {
-            p += sizeof(*inst);
+            p += INSTSTRIDE(h64instruction_hasattrjump);
         }
-        goto *jumptable[((h64instructionany *)p)->type];
+        DISPATCH_INST();
     }
     inst_raise: {
         h64instruction_raise *inst = (
@@ -4613,7 +5675,7 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
                 H64STDERROR_TYPEERROR,
                 "cannot raise from something else than an error class"
             );
-            goto *jumptable[((h64instructionany *)p)->type];
+            DISPATCH_INST();
         }
         _raise_error_class_id = (
             (classid_t)vobj->int_value
@@ -4636,7 +5698,7 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
                 H64STDERROR_TYPEERROR,
                 "error message must be a string"
             );
-            goto *jumptable[((h64instructionany *)p)->type];
+            DISPATCH_INST();
         }
 
         // Extract error message:
@@ -4664,7 +5726,7 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
             _raise_error_class_id,
             errmsgbuf, errmsglen
         );
-        goto *jumptable[((h64instructionany *)p)->type];
+        DISPATCH_INST();
     }
 
     setupinterpreter:
@@ -4709,11 +5771,40 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
     jumptable[H64INST_HASATTRJUMP] = &&inst_hasattrjump;
     jumptable[H64INST_RAISE] = &&inst_raise;
     jumptable[H64INST_RAISEBYREF] = &&inst_raisebyref;
+    jumptable[H64INST_BINOPCONDJUMP] = &&inst_binopcondjump;
+    jumptable[H64INST_SETCONSTBINOP] = &&inst_setconstbinop;
+    jumptable[H64INST_GETATTRCALLSETTOP] = &&inst_getattrcallsettop;
+    jumptable[H64INST_ADDINT] = &&inst_addint;
+    jumptable[H64INST_SUBINT] = &&inst_subint;
+    jumptable[H64INST_MULINT] = &&inst_mulint;
+    jumptable[H64INST_MODINT] = &&inst_modint;
+    jumptable[H64INST_EQINT] = &&inst_eqint;
+    jumptable[H64INST_NEINT] = &&inst_neint;
+    jumptable[H64INST_LTINT] = &&inst_ltint;
+    jumptable[H64INST_LEINT] = &&inst_leint;
+    jumptable[H64INST_GTINT] = &&inst_gtint;
+    jumptable[H64INST_GEINT] = &&inst_geint;
+    jumptable[H64INST_ADDFLOAT] = &&inst_addfloat;
+    jumptable[H64INST_SUBFLOAT] = &&inst_subfloat;
+    jumptable[H64INST_MULFLOAT] = &&inst_mulfloat;
+    jumptable[H64INST_DIVFLOAT] = &&inst_divfloat;
+    jumptable[H64INST_LTFLOAT] = &&inst_ltfloat;
+    jumptable[H64INST_LEFLOAT] = &&inst_lefloat;
+    jumptable[H64INST_GTFLOAT] = &&inst_gtfloat;
+    jumptable[H64INST_GEFLOAT] = &&inst_gefloat;
+    jumptable[H64INST_GETOBJVARATTR] = &&inst_getobjvarattr;
+    jumptable[H64INST_ITERATELIST] = &&inst_iteratelist;
+    jumptable[H64INST_CALLKNOWNFUNC] = &&inst_callknownfunc;
     op_jumptable[H64OP_MATH_DIVIDE] = &&binop_divide;
     op_jumptable[H64OP_MATH_ADD] = &&binop_add;
     op_jumptable[H64OP_MATH_SUBSTRACT] = &&binop_substract;
     op_jumptable[H64OP_MATH_MULTIPLY] = &&binop_multiply;
     op_jumptable[H64OP_MATH_MODULO] = &&binop_modulo;
+    op_jumptable[H64OP_MATH_BINAND] = &&binop_binand;
+    op_jumptable[H64OP_MATH_BINOR] = &&binop_binor;
+    op_jumptable[H64OP_MATH_BINXOR] = &&binop_binxor;
+    op_jumptable[H64OP_MATH_BINSHIFTLEFT] = &&binop_binshiftleft;
+    op_jumptable[H64OP_MATH_BINSHIFTRIGHT] = &&binop_binshiftright;
     op_jumptable[H64OP_CMP_EQUAL] = &&binop_cmp_equal;
     op_jumptable[H64OP_CMP_NOTEQUAL] = &&binop_cmp_notequal;
     op_jumptable[H64OP_CMP_LARGEROREQUAL] = &&binop_cmp_largerorequal;
@@ -4723,6 +5814,13 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
     op_jumptable[H64OP_BOOLCOND_AND] = &&binop_boolcond_and;
     op_jumptable[H64OP_BOOLCOND_OR] = &&binop_boolcond_or;
     op_jumptable[H64OP_INDEXBYEXPR] = &&binop_indexbyexpr;
+    if (unlikely(!rinfo)) {
+        #if defined(H64VM_PREDECODE)
+        return _vmexec_PredecodeAll(pr, jumptable);
+        #else
+        return 1;
+        #endif
+    }
     assert(stack != NULL);
     if (!isresume) {
         // Final set-up before we go:
@@ -4735,7 +5833,7 @@ HOTSPOT int _vmthread_RunFunction_NoPopFuncFrames(
         funcnestdepth++;
     }
 
-    goto *jumptable[((h64instructionany *)p)->type];
+    DISPATCH_INST();
 }
 
 void vmthread_FreeAsyncForegroundWorkWithoutAbort(h64vmthread *vt) {
@@ -4769,6 +5867,17 @@ void vmthread_AbortAsyncForegroundWork(h64vmthread *vt) {
     vmthread_FreeAsyncForegroundWorkWithoutAbort(vt);
 }
 
+int vmexec_PredecodeProgram(ATTR_UNUSED h64vmexec *vmexec) {
+    #if defined(H64VM_PREDECODE)
+    assert(vmexec->program != NULL);
+    return _vmthread_RunFunction_NoPopFuncFrames(
+        vmexec, NULL, NULL, 0, NULL, NULL, NULL, NULL
+    );
+    #else
+    return 1;
+    #endif
+}
+
 int vmthread_RunFunction(
         h64vmexec *vmexec, h64vmthread *start_thread,
         vmthreadresumeinfo *rinfo, int worker_no,
@@ -4922,6 +6031,8 @@ int vmthread_RunFunctionWithReturnInt(
         }
     }
     start_thread->run_by_worker = worker;
+    // A sample that came due while idle shouldn't hit this vmthread:
+    worker->profile_sample_due = 0;
     vmthreadresumeinfo storedresumeinfo;
     memcpy(
         &storedresumeinfo, start_thread->upcoming_resume_info,
@@ -4955,6 +6066,7 @@ int vmthread_RunFunctionWithReturnInt(
     }
     assert(storedresumeinfo.run_from_start ||
            storedresumeinfo.precall_old_stack >= 0);
+    _vmthread_TakeFramesFromPool(start_thread, worker);
     int result = vmthread_RunFunction(
         vmexec, start_thread, &storedresumeinfo, worker_no,
         &innerreturnedsuspend, suspendinfo,
@@ -4972,6 +6084,7 @@ int vmthread_RunFunctionWithReturnInt(
         vmthread_SetSuspendState(
             start_thread, SUSPENDTYPE_DONE, 0
         );
+        _vmthread_ReturnFramesToPool(start_thread, worker);
         return 1;
     } else if (innerreturnedsuspend) {
         *returneduncaughterror = 0;
@@ -4985,6 +6098,7 @@ int vmthread_RunFunctionWithReturnInt(
     vmthread_SetSuspendState(
         start_thread, SUSPENDTYPE_DONE, 0
     );
+    _vmthread_ReturnFramesToPool(start_thread, worker);
     *returneduncaughterror = 0;
     *returnedsuspend = 0;
     if (!result || start_thread->stack->
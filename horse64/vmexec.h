@@ -13,6 +13,12 @@
 
 #define MAX_STACK_FRAMES 10
 
+// The interpreter runs from a pre-decoded, direct threaded copy of the
+// bytecode unless built with -DH64VM_NOPREDECODE:
+#ifndef H64VM_NOPREDECODE
+#define H64VM_PREDECODE
+#endif
+
 #include "bytecode.h"
 #include "compiler/main.h"
 #include "vmsuspendtypeenum.h"
@@ -24,6 +30,8 @@ typedef struct h64stack h64stack;
 typedef struct h64refvalue h64refvalue;
 typedef struct h64vmexec h64vmexec;
 typedef struct h64vmworkerset h64vmworkerset;
+typedef struct h64gcstate h64gcstate;
+typedef struct h64vmprofile h64vmprofile;
 
 
 typedef struct h64vmfunctionframe {
@@ -37,19 +45,41 @@ typedef struct h64vmfunctionframe {
     ptrdiff_t return_to_execution_offset;
 } h64vmfunctionframe;
 
+#define VMTHREAD_INITIAL_FUNCFRAMES 32
+#define VMTHREAD_INITIAL_RESCUEFRAMES 8
+#define VMTHREAD_RESCUEFRAME_INLINETYPES 3
+
 typedef struct h64vmrescueframe {
     int32_t func_frame_no, id;
     int64_t catch_instruction_offset;
     int64_t finally_instruction_offset;
-    int error_obj_temporary_id;
+    int32_t error_obj_temporary_id;
     uint8_t triggered_catch, triggered_finally;
-    h64errorinfo storeddelayederror;
-
-    int caught_types_count;
-    int64_t caught_types_firstfive[5];
-    int64_t *caught_types_more;
+    uint8_t has_extra;  // whether errorframeextra at same index is used
+    int16_t caught_types_count;
+    classid_t caught_types_first[VMTHREAD_RESCUEFRAME_INLINETYPES];
 } h64vmrescueframe;
 
+// The rarely needed parts of a rescue frame. These live in a separate
+// array with the same index as the frame, and are only touched once a
+// frame catches many types or needs to delay an error past finally:
+typedef struct h64vmrescueframeextra {
+    h64errorinfo storeddelayederror;  // error_class_id < 0 if unused
+    int caught_types_more_alloc;
+    classid_t *caught_types_more;
+} h64vmrescueframeextra;
+
+// Frame arrays left behind by a finished vmthread, kept by a worker
+// for the next vmthread it runs:
+typedef struct h64vmframepool {
+    int funcframe_alloc;
+    h64vmfunctionframe *funcframe;
+    int errorframe_alloc;
+    h64vmrescueframe *errorframe;
+    int errorframeextra_alloc;
+    h64vmrescueframeextra *errorframeextra;
+} h64vmframepool;
+
 typedef enum leftover_async_work_type {
     LEFTOVER_ASYNC_WORK_NONE = 0,
     LEFTOVER_ASYNC_WORK_ASYNCSYSJOB = 1
@@ -79,11 +109,17 @@ typedef struct h64vmthread {
     h64stack *stack;
     poolalloc *heap, *str_pile, *cfunc_asyncdata_pile,
         *iteratorstruct_pile;
+    h64gcstate *gc;  // NULL if heap is shared with other vmthreads
+    int64_t releasequeue_count, releasequeue_alloc;
+    h64gcvalue **releasequeue;  // unreferenced values nested too deep
+    uint8_t releasequeue_draining;
 
     int funcframe_count, funcframe_alloc;
     h64vmfunctionframe *funcframe;
     int errorframe_count, errorframe_alloc;
     h64vmrescueframe *errorframe;
+    int errorframeextra_alloc;
+    h64vmrescueframeextra *errorframeextra;
 
     int foreground_async_work_funcid;
     void *foreground_async_work_dataptr;
@@ -107,6 +143,7 @@ typedef struct h64vmexec {
     h64vmthread *active_thread;
 
     int program_return_value;
+    h64vmprofile *profile;  // NULL unless running with --profile
 } h64vmexec;
 
 ATTR_UNUSED static inline int VMTHREAD_FUNCSTACKBOTTOM(
@@ -120,10 +157,14 @@ ATTR_UNUSED static inline int VMTHREAD_FUNCSTACKBOTTOM(
 
 void vmthread_WipeFuncStack(h64vmthread *vmthread);
 
+void vmexec_FreeFramePool(h64vmframepool *pool);
+
 h64vmthread *vmthread_New(h64vmexec *owner, int is_on_main_thread);
 
 h64vmexec *vmexec_New();
 
+int vmexec_PredecodeProgram(h64vmexec *vmexec);
+
 void vmthread_SetSuspendState(
     h64vmthread *vmthread,
     suspendtype suspend_type, int64_t suspend_arg
@@ -56,10 +56,32 @@ inst_binop: {
             return 0;
         }
         #endif
+        if (QUICKEN_ISPLAIN(inst_binop) && QUICKEN_COUNT(
+                h64instruction_binop,
+                ((uint64_t)v1->type << 8) | (uint64_t)v2->type)) {
+            // Always the same operand types here, so specialize:
+            instructiontype qtype = H64INST_BINOP;
+            if (v1->type == v2->type)
+                qtype = bytecode_SpecializedBinopType(
+                    inst->optype, v1->type
+                );
+            if (qtype != H64INST_BINOP)
+                QUICKEN_TO(qtype);
+            else
+                QUICKEN_GIVEUP(h64instruction_binop);
+        }
         int invalidtypes = 1;
         int divisionbyzero = 0;
+        VMSTATS_INCIDX(binop_count, inst->optype);
+        #if defined(H64VM_STATS)
+        if (v1->type != H64VALTYPE_INT64 || v2->type != H64VALTYPE_INT64)
+            VMSTATS_INCIDX(binop_typemiss_count, inst->optype);
+        #endif
         goto *op_jumptable[inst->optype];
         binop_divide: {
+            if (unlikely(v1->type == H64VALTYPE_VECTOR ||
+                    v2->type == H64VALTYPE_VECTOR))
+                goto binop_vectorop;
             if (unlikely((v1->type != H64VALTYPE_INT64 &&
                     v1->type != H64VALTYPE_FLOAT64) ||
                     (v2->type != H64VALTYPE_INT64 &&
@@ -102,7 +124,7 @@ inst_binop: {
                             H64STDERROR_OVERFLOWERROR,
                             "number range overflow"
                         );
-                        goto *jumptable[((h64instructionany *)p)->type];
+                        DISPATCH_INST();
                     }
                     // See if the result is non-fractional, in which case
                     // we want to go back to int:
@@ -129,6 +151,9 @@ inst_binop: {
                     v2->type == H64VALTYPE_INT64)) {
                 goto fasttrack_intadd;
             }
+            if (unlikely(v1->type == H64VALTYPE_VECTOR ||
+                    v2->type == H64VALTYPE_VECTOR))
+                goto binop_vectorop;
             if (likely((v1->type == H64VALTYPE_INT64 ||
                     v1->type == H64VALTYPE_FLOAT64) &&
                     (v2->type == H64VALTYPE_INT64 ||
@@ -145,7 +170,7 @@ inst_binop: {
                             H64STDERROR_OVERFLOWERROR,
                             "number range overflow"
                         );
-                        goto *jumptable[((h64instructionany *)p)->type];
+                        DISPATCH_INST();
                     }
                     tmpresult->type = H64VALTYPE_INT64;
                     tmpresult->int_value = (
@@ -177,7 +202,7 @@ inst_binop: {
                             H64STDERROR_OVERFLOWERROR,
                             "number range overflow"
                         );
-                        goto *jumptable[((h64instructionany *)p)->type];
+                        DISPATCH_INST();
                     } else if (unlikely(mixed)) {
                         // Avoid unexpected jumps in the opposite direction
                         // of the operation caused by int -> float change:
@@ -327,6 +352,9 @@ inst_binop: {
             goto binop_done;
         }
         binop_substract: {
+            if (unlikely(v1->type == H64VALTYPE_VECTOR ||
+                    v2->type == H64VALTYPE_VECTOR))
+                goto binop_vectorop;
             if (unlikely((v1->type != H64VALTYPE_INT64 &&
                     v1->type != H64VALTYPE_FLOAT64) ||
                     (v2->type != H64VALTYPE_INT64 &&
@@ -359,7 +387,7 @@ inst_binop: {
                             H64STDERROR_OVERFLOWERROR,
                             "number range overflow"
                         );
-                        goto *jumptable[((h64instructionany *)p)->type];
+                        DISPATCH_INST();
                     } else if (unlikely(mixed)) {
                         // Avoid unexpected jumps in the opposite direction
                         // of the operation caused by int -> float change:
@@ -402,7 +430,7 @@ inst_binop: {
                             H64STDERROR_OVERFLOWERROR,
                             "number range overflow"
                         );
-                        goto *jumptable[((h64instructionany *)p)->type];
+                        DISPATCH_INST();
                     }
                     tmpresult->type = H64VALTYPE_INT64;
                     tmpresult->int_value = (
@@ -413,6 +441,9 @@ inst_binop: {
             goto binop_done;
         }
         binop_multiply: {
+            if (unlikely(v1->type == H64VALTYPE_VECTOR ||
+                    v2->type == H64VALTYPE_VECTOR))
+                goto binop_vectorop;
             if (unlikely((v1->type != H64VALTYPE_INT64 &&
                     v1->type != H64VALTYPE_FLOAT64) ||
                     (v2->type != H64VALTYPE_INT64 &&
@@ -441,7 +472,7 @@ inst_binop: {
                             H64STDERROR_MATHERROR,
                             "division by zero"
                         );
-                        goto *jumptable[((h64instructionany *)p)->type];
+                        DISPATCH_INST();
                     } else if (unlikely(
                             !isfinite(tmpresult->float_value) ||
                             tmpresult->float_value > (double)INT64_MAX ||
@@ -450,7 +481,7 @@ inst_binop: {
                             H64STDERROR_OVERFLOWERROR,
                             "number range overflow"
                         );
-                        goto *jumptable[((h64instructionany *)p)->type];
+                        DISPATCH_INST();
                     }
                 } else {
                     tmpresult->type = H64VALTYPE_INT64;
@@ -465,7 +496,7 @@ inst_binop: {
                                 H64STDERROR_OVERFLOWERROR,
                                 "number range overflow"
                             );
-                            goto *jumptable[((h64instructionany *)p)->type];
+                            DISPATCH_INST();
                         }
                     }
                 }
@@ -529,6 +560,110 @@ inst_binop: {
             }
             goto binop_done;
         }
+        binop_binand:
+        binop_binor:
+        binop_binxor: {
+            int64_t a = 0;
+            int64_t b = 0;
+            int overflow = 0;
+            if (likely(_vmexec_BitwiseIntValue(v1, &a, &overflow) &&
+                    _vmexec_BitwiseIntValue(v2, &b, &overflow))) {
+                invalidtypes = 0;
+                if (unlikely(overflow)) {
+                    RAISE_ERROR(
+                        H64STDERROR_OVERFLOWERROR,
+                        "number range overflow"
+                    );
+                    DISPATCH_INST();
+                }
+                tmpresult->type = H64VALTYPE_INT64;
+                if (inst->optype == H64OP_MATH_BINAND)
+                    tmpresult->int_value = a & b;
+                else if (inst->optype == H64OP_MATH_BINOR)
+                    tmpresult->int_value = a | b;
+                else
+                    tmpresult->int_value = a ^ b;
+                goto binopdone_success;
+            }
+            char *s1 = NULL;
+            char *s2 = NULL;
+            int64_t len1 = 0;
+            int64_t len2 = 0;
+            if (!vmbytes_GetBuffer(v1, &s1, &len1) ||
+                    !vmbytes_GetBuffer(v2, &s2, &len2))
+                goto binop_done;  // leave invalidtypes=1 set
+            if (unlikely(len1 != len2)) {
+                RAISE_ERROR(
+                    H64STDERROR_VALUEERROR,
+                    "cannot apply %s operator to bytes of "
+                    "different length",
+                    operator_OpPrintedAsStr(inst->optype)
+                );
+                DISPATCH_INST();
+            }
+            invalidtypes = 0;
+            // Copy the left side, then combine the right side into it:
+            if (!valuecontent_SetBytesU8(
+                    vmthread, tmpresult, (uint8_t *)s1, len1
+                    ))
+                goto triggeroom;
+            ADDREF_NONHEAP(tmpresult);
+            char *out = NULL;
+            int64_t outlen = 0;
+            vmbytes_GetBuffer(tmpresult, &out, &outlen);
+            assert(out != NULL && outlen == len1);
+            int64_t i = 0;
+            if (inst->optype == H64OP_MATH_BINAND) {
+                while (i < outlen) {
+                    out[i] &= s2[i];
+                    i++;
+                }
+            } else if (inst->optype == H64OP_MATH_BINOR) {
+                while (i < outlen) {
+                    out[i] |= s2[i];
+                    i++;
+                }
+            } else {
+                while (i < outlen) {
+                    out[i] ^= s2[i];
+                    i++;
+                }
+            }
+            goto binopdone_success;
+        }
+        binop_binshiftleft:
+        binop_binshiftright: {
+            int64_t a = 0;
+            int64_t b = 0;
+            int overflow = 0;
+            if (unlikely(!_vmexec_BitwiseIntValue(v1, &a, &overflow) ||
+                    !_vmexec_BitwiseIntValue(v2, &b, &overflow)))
+                goto binop_done;  // leave invalidtypes=1 set
+            invalidtypes = 0;
+            if (unlikely(overflow)) {
+                RAISE_ERROR(
+                    H64STDERROR_OVERFLOWERROR,
+                    "number range overflow"
+                );
+                DISPATCH_INST();
+            }
+            if (unlikely(b < 0 || b >= 64)) {
+                RAISE_ERROR(
+                    H64STDERROR_VALUEERROR,
+                    "shift count %" PRId64 " is out of range", b
+                );
+                DISPATCH_INST();
+            }
+            tmpresult->type = H64VALTYPE_INT64;
+            if (inst->optype == H64OP_MATH_BINSHIFTLEFT) {
+                // Bits shifted out are dropped, like in C on uint64_t:
+                tmpresult->int_value = (int64_t)((uint64_t)a << b);
+            } else {
+                // Sign-extending, so e.g. -8 >> 1 is -4:
+                tmpresult->int_value = (a < 0 ? ~(~a >> b) : (a >> b));
+            }
+            goto binopdone_success;
+        }
         binop_cmp_equal: {
             invalidtypes = 0;
             tmpresult->type = H64VALTYPE_BOOL;
@@ -575,9 +710,7 @@ inst_binop: {
                         "out of memory comparing the "
                         "given types"
                     );
-                    goto *jumptable[
-                        ((h64instructionany *)p)->type
-                    ];
+                    DISPATCH_INST();
                 }
             } else {
                 tmpresult->type = H64VALTYPE_BOOL;
@@ -601,9 +734,7 @@ inst_binop: {
                         "out of memory comparing the "
                         "given types"
                     );
-                    goto *jumptable[
-                        ((h64instructionany *)p)->type
-                    ];
+                    DISPATCH_INST();
                 }
             } else {
                 tmpresult->type = H64VALTYPE_BOOL;
@@ -627,9 +758,7 @@ inst_binop: {
                         "out of memory comparing the "
                         "given types"
                     );
-                    goto *jumptable[
-                        ((h64instructionany *)p)->type
-                    ];
+                    DISPATCH_INST();
                 }
             } else {
                 tmpresult->type = H64VALTYPE_BOOL;
@@ -653,9 +782,7 @@ inst_binop: {
                         "out of memory comparing the "
                         "given types"
                     );
-                    goto *jumptable[
-                        ((h64instructionany *)p)->type
-                    ];
+                    DISPATCH_INST();
                 }
             } else {
                 tmpresult->type = H64VALTYPE_BOOL;
@@ -671,7 +798,7 @@ inst_binop: {
                     "this value type cannot be "
                     "evaluated as conditional"
                 );
-                goto *jumptable[((h64instructionany *)p)->type];
+                DISPATCH_INST();
             }
             if (!bool1) {
                 invalidtypes = 0;
@@ -685,7 +812,7 @@ inst_binop: {
                         "this value type cannot be "
                         "evaluated as conditional"
                     );
-                    goto *jumptable[((h64instructionany *)p)->type];
+                    DISPATCH_INST();
                 }
                 invalidtypes = 0;
                 tmpresult->type = H64VALTYPE_BOOL;
@@ -701,7 +828,7 @@ inst_binop: {
                     "this value type cannot be "
                     "evaluated as conditional"
                 );
-                goto *jumptable[((h64instructionany *)p)->type];
+                DISPATCH_INST();
             }
             if (bool1) {
                 invalidtypes = 0;
@@ -715,7 +842,7 @@ inst_binop: {
                         "this value type cannot be "
                         "evaluated as conditional"
                     );
-                    goto *jumptable[((h64instructionany *)p)->type];
+                    DISPATCH_INST();
                 }
                 invalidtypes = 0;
                 tmpresult->type = H64VALTYPE_BOOL;
@@ -723,6 +850,45 @@ inst_binop: {
                 goto binop_done;
             }
         }
+        binop_vectorop: {
+            // Elementwise vector math, see vmvector.c:
+            vmvectorop vop = VMVECTOR_OP_ADD;
+            if (inst->optype == H64OP_MATH_SUBSTRACT) {
+                vop = VMVECTOR_OP_SUBSTRACT;
+            } else if (inst->optype == H64OP_MATH_MULTIPLY) {
+                vop = VMVECTOR_OP_MULTIPLY;
+            } else if (inst->optype == H64OP_MATH_DIVIDE) {
+                vop = VMVECTOR_OP_DIVIDE;
+            } else {
+                assert(inst->optype == H64OP_MATH_ADD);
+            }
+            vmvectorerror verror = VMVECTOR_ERROR_NONE;
+            if (unlikely(!vmvector_Binop(
+                    vop, v1, v2, tmpresult, &verror))) {
+                if (verror == VMVECTOR_ERROR_OUTOFMEMORY) {
+                    goto triggeroom;
+                } else if (verror == VMVECTOR_ERROR_OVERFLOW) {
+                    RAISE_ERROR(
+                        H64STDERROR_OVERFLOWERROR,
+                        "number range overflow"
+                    );
+                    DISPATCH_INST();
+                } else if (verror == VMVECTOR_ERROR_LENMISMATCH) {
+                    RAISE_ERROR(
+                        H64STDERROR_VALUEERROR,
+                        "vectors must have the same length"
+                    );
+                    DISPATCH_INST();
+                } else if (verror == VMVECTOR_ERROR_DIVISIONBYZERO) {
+                    invalidtypes = 0;
+                    divisionbyzero = 1;
+                }
+                // Otherwise, leave invalidtypes=1 set.
+                goto binop_done;
+            }
+            invalidtypes = 0;
+            goto binop_done;
+        }
         binop_indexbyexpr: {
             int64_t index_by = -1;
             if (v1->type != H64VALTYPE_GCVAL || (
@@ -736,7 +902,7 @@ inst_binop: {
                         H64STDERROR_TYPEERROR,
                         "this value must be indexed with a number"
                     );
-                    goto *jumptable[((h64instructionany *)p)->type];
+                    DISPATCH_INST();
                 }
                 if (likely(v2->type == H64VALTYPE_INT64)) {
                     index_by = v2->int_value;
@@ -759,7 +925,7 @@ inst_binop: {
                         "index %" PRId64 " is out of range",
                         (int64_t)index_by
                     );
-                    goto *jumptable[((h64instructionany *)p)->type];
+                    DISPATCH_INST();
                 }
                 memcpy(tmpresult, v, sizeof(*v));
                 ADDREF_NONHEAP(tmpresult);
@@ -779,16 +945,27 @@ inst_binop: {
                             H64STDERROR_INDEXERROR,
                             "out of memory while indexing map"
                         );
-                        goto *jumptable[((h64instructionany *)p)->type];
+                        DISPATCH_INST();
                     }
                     RAISE_ERROR(
                         H64STDERROR_INDEXERROR,
                         "key not found in map"
                     );
-                    goto *jumptable[((h64instructionany *)p)->type];
+                    DISPATCH_INST();
                 }
                 memcpy(tmpresult, &v, sizeof(v));
                 ADDREF_NONHEAP(tmpresult);
+            } else if (v1->type == H64VALTYPE_VECTOR) {
+                if (index_by < 1 ||
+                        index_by > vmvector_Count(v1->vector_values)) {
+                    RAISE_ERROR(
+                        H64STDERROR_INDEXERROR,
+                        "index %" PRId64 " is out of range",
+                        (int64_t)index_by
+                    );
+                    DISPATCH_INST();
+                }
+                vmvector_Get(v1->vector_values, index_by, tmpresult);
             } else if ((v1->type == H64VALTYPE_GCVAL &&
                     ((h64gcvalue *)v1->ptr_value)->type ==
                     H64GCVALUETYPE_STRING
@@ -797,18 +974,17 @@ inst_binop: {
                 char *s = NULL;
                 int64_t slen = -1;
                 int64_t sletters = -1;
+                h64stringval *gcstr = NULL;
                 if (v1->type == H64VALTYPE_GCVAL) {
                     assert(
                         ((h64gcvalue *)v1->ptr_value)->type ==
                         H64GCVALUETYPE_STRING
                     );
-                    s = (char *)((h64gcvalue *)v1->ptr_value)->str_val.s;
-                    slen = ((h64gcvalue *)v1->ptr_value)->str_val.len;
-                    vmstrings_RequireLetterLen(
-                        &(((h64gcvalue *)v1->ptr_value)->str_val)
-                    );
-                    sletters = ((h64gcvalue *)v1->ptr_value)->str_val.
-                        letterlen;
+                    gcstr = &(((h64gcvalue *)v1->ptr_value)->str_val);
+                    s = (char *)gcstr->s;
+                    slen = gcstr->len;
+                    vmstrings_RequireLetterLen(gcstr);
+                    sletters = gcstr->letterlen;
                 } else {
                     if (v1->type == H64VALTYPE_CONSTPREALLOCSTR) {
                         s = (char *)v1->constpreallocstr_value;
@@ -825,6 +1001,17 @@ inst_binop: {
                         "index %" PRId64 " is out of range",
                         (int64_t)index_by
                     );
+                    DISPATCH_INST();
+                }
+                if (gcstr != NULL && index_by > 1) {
+                    // Long strings have a letter index to skip ahead:
+                    int64_t offset = vmstrings_LetterToCodepointOffset(
+                        gcstr, index_by - 1
+                    );
+                    s += offset * sizeof(h64wchar);
+                    slen -= offset;
+                    sletters -= index_by - 1;
+                    index_by = 1;
                 }
                 while (index_by > 1) {
                     int64_t len = utf32_letter_len((h64wchar *)s, slen);
@@ -851,7 +1038,7 @@ inst_binop: {
                     H64STDERROR_TYPEERROR,
                     "given value cannot be indexed"
                 );
-                goto *jumptable[((h64instructionany *)p)->type];
+                DISPATCH_INST();
             }
             goto binop_done;
         }
@@ -862,13 +1049,13 @@ inst_binop: {
                 "cannot apply %s operator to given types",
                 operator_OpPrintedAsStr(inst->optype)
             );
-            goto *jumptable[((h64instructionany *)p)->type];
+            DISPATCH_INST();
         } else if (divisionbyzero) {
             RAISE_ERROR(
                 H64STDERROR_MATHERROR,
                 "division by zero"
             );
-            goto *jumptable[((h64instructionany *)p)->type];
+            DISPATCH_INST();
         }
         binopdone_success:
         if (copyatend) {
@@ -878,9 +1065,317 @@ inst_binop: {
             memcpy(target, tmpresult, sizeof(*tmpresult));
         }
         #pragma GCC diagnostic pop
-        p += sizeof(h64instruction_binop);
-        goto *jumptable[((h64instructionany *)p)->type];
+        p += INSTSTRIDE(h64instruction_binop);
+        DISPATCH_INST();
     }
+    inst_binopcondjump: {
+        // A comparison with a condjump on its result right after it.
+        // Only int operands are handled here, everything else takes
+        // the regular binop and then the condjump separately:
+        h64instruction_binop *inst = (h64instruction_binop *)p;
+        #ifndef NDEBUG
+        if (vmthread->vmexec_owner->moptions.vmexec_debug &&
+                !vmthread_PrintExec(vmthread, func_id, (void*)inst))
+            goto triggeroom;
+        #endif
+
+        #ifndef NDEBUG
+        vmexec_VerifyStack(vmthread);
+        #endif
+
+        valuecontent *v1 = STACK_ENTRY(stack, inst->arg1slotfrom);
+        valuecontent *v2 = STACK_ENTRY(stack, inst->arg2slotfrom);
+        if (unlikely(v1->type != H64VALTYPE_INT64 ||
+                v2->type != H64VALTYPE_INT64)) {
+            VMSTATS_INC(superinst_fallback_count);
+            goto inst_binop;
+        }
+        int64_t a = v1->int_value;
+        int64_t b = v2->int_value;
+        int result = 0;
+        switch (inst->optype) {
+        case H64OP_CMP_EQUAL:
+            result = (a == b);
+            break;
+        case H64OP_CMP_NOTEQUAL:
+            result = (a != b);
+            break;
+        case H64OP_CMP_LARGEROREQUAL:
+            result = (a >= b);
+            break;
+        case H64OP_CMP_SMALLEROREQUAL:
+            result = (a <= b);
+            break;
+        case H64OP_CMP_LARGER:
+            result = (a > b);
+            break;
+        case H64OP_CMP_SMALLER:
+            result = (a < b);
+            break;
+        default:
+            VMSTATS_INC(superinst_fallback_count);
+            goto inst_binop;
+        }
+        valuecontent *target = STACK_ENTRY(stack, inst->slotto);
+        DELREF_NONHEAP(target);
+        valuecontent_Free(vmthread, target);
+        target->type = H64VALTYPE_BOOL;
+        target->int_value = result;
+
+        h64instruction_condjump *jumpinst = (
+            (h64instruction_condjump *)(p + INSTSTRIDE(h64instruction_binop))
+        );
+        assert(jumpinst->type == H64INST_CONDJUMP &&
+               jumpinst->conditionalslot == inst->slotto &&
+               jumpinst->jumpbytesoffset != 0);
+        if (!result) {  // jump if it is false
+            p = INSTJUMPDEST(
+                h64instruction_condjump, jumpinst, jumpbytesoffset, 0
+            );
+            assert(p >= FUNCCODE(func_id) && p < pend);
+            DISPATCH_INST();
+        }
+        p += (
+            INSTSTRIDE(h64instruction_binop) +
+            INSTSTRIDE(h64instruction_condjump)
+        );
+        DISPATCH_INST();
+    }
+    inst_setconstbinop: {
+        // An int constant that is then added to or substracted from
+        // something right after. The constant slot is still written,
+        // since later code may read it again:
+        h64instruction_setconst *inst = (h64instruction_setconst *)p;
+        #ifndef NDEBUG
+        if (vmthread->vmexec_owner->moptions.vmexec_debug &&
+                !vmthread_PrintExec(vmthread, func_id, (void*)inst))
+            goto triggeroom;
+        #endif
+
+        #ifndef NDEBUG
+        vmexec_VerifyStack(vmthread);
+        #endif
+
+        h64instruction_binop *binopinst = (
+            (h64instruction_binop *)(p + INSTSTRIDE(h64instruction_setconst))
+        );
+        assert(inst->content.type == H64VALTYPE_INT64 &&
+               (_vmexec_InstType(binopinst) == H64INST_BINOP ||
+                IS_SPECIALIZED_BINOP(_vmexec_InstType(binopinst))));
+        int64_t constvalue = inst->content.int_value;
+        int64_t a = constvalue;
+        int64_t b = constvalue;
+        if (binopinst->arg1slotfrom != inst->slot) {
+            valuecontent *v1 = STACK_ENTRY(stack, binopinst->arg1slotfrom);
+            if (unlikely(v1->type != H64VALTYPE_INT64)) {
+                VMSTATS_INC(superinst_fallback_count);
+                goto inst_setconst;
+            }
+            a = v1->int_value;
+        }
+        if (binopinst->arg2slotfrom != inst->slot) {
+            valuecontent *v2 = STACK_ENTRY(stack, binopinst->arg2slotfrom);
+            if (unlikely(v2->type != H64VALTYPE_INT64)) {
+                VMSTATS_INC(superinst_fallback_count);
+                goto inst_setconst;
+            }
+            b = v2->int_value;
+        }
+        int64_t result = 0;
+        if (binopinst->optype == H64OP_MATH_ADD) {
+            if (unlikely((b >= 0 && a > INT64_MAX - b) ||
+                    (b < 0 && a < INT64_MIN - b))) {
+                VMSTATS_INC(superinst_fallback_count);
+                goto inst_setconst;  // let the binop raise the error
+            }
+            result = a + b;
+        } else {
+            assert(binopinst->optype == H64OP_MATH_SUBSTRACT);
+            if (unlikely((b < 0 && a > INT64_MAX + b) ||
+                    (b >= 0 && a < INT64_MIN + b))) {
+                VMSTATS_INC(superinst_fallback_count);
+                goto inst_setconst;  // let the binop raise the error
+            }
+            result = a - b;
+        }
+        valuecontent *vc = STACK_ENTRY(stack, inst->slot);
+        DELREF_NONHEAP(vc);
+        valuecontent_Free(vmthread, vc);
+        vc->type = H64VALTYPE_INT64;
+        vc->int_value = constvalue;
+        vc = STACK_ENTRY(stack, binopinst->slotto);
+        DELREF_NONHEAP(vc);
+        valuecontent_Free(vmthread, vc);
+        vc->type = H64VALTYPE_INT64;
+        vc->int_value = result;
+
+        p += (
+            INSTSTRIDE(h64instruction_setconst) +
+            INSTSTRIDE(h64instruction_binop)
+        );
+        DISPATCH_INST();
+    }
+    // Type specialized binops, picked by the peephole pass when the
+    // operand types are known or likely, or quickened to at runtime.
+    // If the types don't match, these are reverted to the regular binop.
+    // If the result would overflow or divide by zero, they just fall
+    // back to it for this once, and it then raises the error:
+    #ifndef NDEBUG
+    #define SPECIALIZEDBINOP_DEBUG() \
+        if (vmthread->vmexec_owner->moptions.vmexec_debug && \
+                !vmthread_PrintExec(vmthread, func_id, (void*)p)) \
+            goto triggeroom; \
+        vmexec_VerifyStack(vmthread);
+    #else
+    #define SPECIALIZEDBINOP_DEBUG()
+    #endif
+    #define SPECIALIZEDBINOP_BEGIN(valtype, ctype, field) \
+        h64instruction_binop *inst = (h64instruction_binop *)p; \
+        SPECIALIZEDBINOP_DEBUG(); \
+        valuecontent *v1 = STACK_ENTRY(stack, inst->arg1slotfrom); \
+        valuecontent *v2 = STACK_ENTRY(stack, inst->arg2slotfrom); \
+        if (unlikely(v1->type != valtype || v2->type != valtype)) { \
+            QUICKEN_REVERT(h64instruction_binop, H64INST_BINOP); \
+            SPECIALIZEDBINOP_DEOPT(); \
+        } \
+        ctype a = v1->field; \
+        ctype b = v2->field;
+    #define SPECIALIZEDBINOP_DEOPT() do { \
+        VMSTATS_INC(specializedbinop_deopt_count); \
+        goto inst_binop; \
+        } while (0)
+    // Types up to bool hold nothing that would need freeing:
+    #define SPECIALIZEDBINOP_STORE(valtype, field, value) do { \
+        valuecontent *target = STACK_ENTRY(stack, inst->slotto); \
+        if (unlikely(target->type > H64VALTYPE_BOOL)) { \
+            DELREF_NONHEAP(target); \
+            valuecontent_Free(vmthread, target); \
+            memset(target, 0, sizeof(*target)); \
+        } \
+        target->type = valtype; \
+        target->field = (value); \
+        p += INSTSTRIDE(h64instruction_binop); \
+        DISPATCH_INST(); \
+        } while (0)
+    inst_addint: {
+        SPECIALIZEDBINOP_BEGIN(H64VALTYPE_INT64, int64_t, int_value);
+        int64_t result;
+        if (unlikely(__builtin_add_overflow(a, b, &result)))
+            SPECIALIZEDBINOP_DEOPT();
+        SPECIALIZEDBINOP_STORE(H64VALTYPE_INT64, int_value, result);
+    }
+    inst_subint: {
+        SPECIALIZEDBINOP_BEGIN(H64VALTYPE_INT64, int64_t, int_value);
+        int64_t result;
+        if (unlikely(__builtin_sub_overflow(a, b, &result)))
+            SPECIALIZEDBINOP_DEOPT();
+        SPECIALIZEDBINOP_STORE(H64VALTYPE_INT64, int_value, result);
+    }
+    inst_mulint: {
+        SPECIALIZEDBINOP_BEGIN(H64VALTYPE_INT64, int64_t, int_value);
+        int64_t result;
+        if (unlikely(__builtin_mul_overflow(a, b, &result)))
+            SPECIALIZEDBINOP_DEOPT();
+        SPECIALIZEDBINOP_STORE(H64VALTYPE_INT64, int_value, result);
+    }
+    inst_modint: {
+        SPECIALIZEDBINOP_BEGIN(H64VALTYPE_INT64, int64_t, int_value);
+        if (unlikely(b == 0))
+            SPECIALIZEDBINOP_DEOPT();
+        SPECIALIZEDBINOP_STORE(
+            H64VALTYPE_INT64, int_value, (b == -1 ? 0 : a % b)
+        );  // (INT64_MIN % -1 would trap.)
+    }
+    inst_eqint: {
+        SPECIALIZEDBINOP_BEGIN(H64VALTYPE_INT64, int64_t, int_value);
+        SPECIALIZEDBINOP_STORE(H64VALTYPE_BOOL, int_value, (a == b));
+    }
+    inst_neint: {
+        SPECIALIZEDBINOP_BEGIN(H64VALTYPE_INT64, int64_t, int_value);
+        SPECIALIZEDBINOP_STORE(H64VALTYPE_BOOL, int_value, (a != b));
+    }
+    inst_ltint: {
+        SPECIALIZEDBINOP_BEGIN(H64VALTYPE_INT64, int64_t, int_value);
+        SPECIALIZEDBINOP_STORE(H64VALTYPE_BOOL, int_value, (a < b));
+    }
+    inst_leint: {
+        SPECIALIZEDBINOP_BEGIN(H64VALTYPE_INT64, int64_t, int_value);
+        SPECIALIZEDBINOP_STORE(H64VALTYPE_BOOL, int_value, (a <= b));
+    }
+    inst_gtint: {
+        SPECIALIZEDBINOP_BEGIN(H64VALTYPE_INT64, int64_t, int_value);
+        SPECIALIZEDBINOP_STORE(H64VALTYPE_BOOL, int_value, (a > b));
+    }
+    inst_geint: {
+        SPECIALIZEDBINOP_BEGIN(H64VALTYPE_INT64, int64_t, int_value);
+        SPECIALIZEDBINOP_STORE(H64VALTYPE_BOOL, int_value, (a >= b));
+    }
+    inst_addfloat: {
+        SPECIALIZEDBINOP_BEGIN(H64VALTYPE_FLOAT64, double, float_value);
+        double result = a + b;
+        if (unlikely(!isfinite(result) ||
+                result >= (double)INT64_MAX ||
+                result < (double)INT64_MIN))
+            SPECIALIZEDBINOP_DEOPT();
+        // Like the regular add, go back to int if non-fractional:
+        int64_t intresult = result;
+        if ((double)intresult == result)
+            SPECIALIZEDBINOP_STORE(H64VALTYPE_INT64, int_value, intresult);
+        SPECIALIZEDBINOP_STORE(H64VALTYPE_FLOAT64, float_value, result);
+    }
+    inst_subfloat: {
+        SPECIALIZEDBINOP_BEGIN(H64VALTYPE_FLOAT64, double, float_value);
+        double result = a - b;
+        if (unlikely(!isfinite(result) ||
+                result > (double)INT64_MAX ||
+                result < (double)INT64_MIN))
+            SPECIALIZEDBINOP_DEOPT();
+        SPECIALIZEDBINOP_STORE(H64VALTYPE_FLOAT64, float_value, result);
+    }
+    inst_mulfloat: {
+        SPECIALIZEDBINOP_BEGIN(H64VALTYPE_FLOAT64, double, float_value);
+        double result = a * b;
+        if (unlikely(!isfinite(result) ||
+                result > (double)INT64_MAX ||
+                result < (double)INT64_MIN))
+            SPECIALIZEDBINOP_DEOPT();
+        SPECIALIZEDBINOP_STORE(H64VALTYPE_FLOAT64, float_value, result);
+    }
+    inst_divfloat: {
+        SPECIALIZEDBINOP_BEGIN(H64VALTYPE_FLOAT64, double, float_value);
+        if (unlikely(b == 0))
+            SPECIALIZEDBINOP_DEOPT();
+        double result = a / b;
+        if (unlikely(!isfinite(result) ||
+                result > (double)INT64_MAX ||
+                result < (double)INT64_MIN))
+            SPECIALIZEDBINOP_DEOPT();
+        // Like the regular divide, go back to int if non-fractional:
+        int64_t intresult = result;
+        if ((double)intresult == result)
+            SPECIALIZEDBINOP_STORE(H64VALTYPE_INT64, int_value, intresult);
+        SPECIALIZEDBINOP_STORE(H64VALTYPE_FLOAT64, float_value, result);
+    }
+    inst_ltfloat: {
+        SPECIALIZEDBINOP_BEGIN(H64VALTYPE_FLOAT64, double, float_value);
+        SPECIALIZEDBINOP_STORE(H64VALTYPE_BOOL, int_value, (a < b));
+    }
+    inst_lefloat: {
+        SPECIALIZEDBINOP_BEGIN(H64VALTYPE_FLOAT64, double, float_value);
+        SPECIALIZEDBINOP_STORE(H64VALTYPE_BOOL, int_value, (a <= b));
+    }
+    inst_gtfloat: {
+        SPECIALIZEDBINOP_BEGIN(H64VALTYPE_FLOAT64, double, float_value);
+        SPECIALIZEDBINOP_STORE(H64VALTYPE_BOOL, int_value, (a > b));
+    }
+    inst_gefloat: {
+        SPECIALIZEDBINOP_BEGIN(H64VALTYPE_FLOAT64, double, float_value);
+        SPECIALIZEDBINOP_STORE(H64VALTYPE_BOOL, int_value, (a >= b));
+    }
+    #undef SPECIALIZEDBINOP_DEBUG
+    #undef SPECIALIZEDBINOP_BEGIN
+    #undef SPECIALIZEDBINOP_DEOPT
+    #undef SPECIALIZEDBINOP_STORE
     inst_unop: {
         h64instruction_unop *inst = (h64instruction_unop *)p;
         #ifndef NDEBUG
@@ -915,7 +1410,7 @@ inst_binop: {
                     "this value type cannot be "
                     "evaluated as conditional"
                 );
-                goto *jumptable[((h64instructionany *)p)->type];
+                DISPATCH_INST();
             }
             tmpresult->type = H64VALTYPE_BOOL;
             tmpresult->int_value = !boolv;
@@ -927,7 +1422,7 @@ inst_binop: {
                         H64STDERROR_OVERFLOWERROR,
                         "number range overflow"
                     );
-                    goto *jumptable[((h64instructionany *)p)->type];
+                    DISPATCH_INST();
                 }
                 tmpresult->type = H64VALTYPE_FLOAT64;
                 tmpresult->float_value = -v1->float_value;
@@ -937,7 +1432,7 @@ inst_binop: {
                         H64STDERROR_OVERFLOWERROR,
                         "number range overflow"
                     );
-                    goto *jumptable[((h64instructionany *)p)->type];
+                    DISPATCH_INST();
                 }
                 tmpresult->type = H64VALTYPE_INT64;
                 tmpresult->int_value = -v1->int_value;
@@ -947,7 +1442,45 @@ inst_binop: {
                     "cannot apply %s operator to given type",
                     operator_OpPrintedAsStr(inst->optype)
                 );
-                goto *jumptable[((h64instructionany *)p)->type];
+                DISPATCH_INST();
+            }
+        } else if (inst->optype == H64OP_MATH_BINNOT) {
+            char *s1 = NULL;
+            int64_t len1 = 0;
+            int64_t a = 0;
+            int overflow = 0;
+            if (likely(_vmexec_BitwiseIntValue(v1, &a, &overflow))) {
+                if (unlikely(overflow)) {
+                    RAISE_ERROR(
+                        H64STDERROR_OVERFLOWERROR,
+                        "number range overflow"
+                    );
+                    DISPATCH_INST();
+                }
+                tmpresult->type = H64VALTYPE_INT64;
+                tmpresult->int_value = ~a;
+            } else if (vmbytes_GetBuffer(v1, &s1, &len1)) {
+                if (!valuecontent_SetBytesU8(
+                        vmthread, tmpresult, (uint8_t *)s1, len1
+                        ))
+                    goto triggeroom;
+                ADDREF_NONHEAP(tmpresult);
+                char *out = NULL;
+                int64_t outlen = 0;
+                vmbytes_GetBuffer(tmpresult, &out, &outlen);
+                assert(out != NULL && outlen == len1);
+                int64_t i = 0;
+                while (i < outlen) {
+                    out[i] = ~out[i];
+                    i++;
+                }
+            } else {
+                RAISE_ERROR(
+                    H64STDERROR_TYPEERROR,
+                    "cannot apply %s operator to given type",
+                    operator_OpPrintedAsStr(inst->optype)
+                );
+                DISPATCH_INST();
             }
         } else {
             h64fprintf(stderr, "unop not implemented\n");
@@ -960,7 +1493,7 @@ inst_binop: {
             valuecontent_Free(vmthread, target);
             memcpy(target, tmpresult, sizeof(*tmpresult));
         }
-        p += sizeof(h64instruction_unop);
-        goto *jumptable[((h64instructionany *)p)->type];
+        p += INSTSTRIDE(h64instruction_unop);
+        DISPATCH_INST();
     }
 #pragma GCC diagnostic pop
\ No newline at end of file
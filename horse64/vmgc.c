@@ -0,0 +1,708 @@
+// Copyright (c) 2020-2021, ellie/@ell1e & Horse64 Team (see AUTHORS.md),
+// also see LICENSE.md file.
+// SPDX-License-Identifier: BSD-2-Clause
+
+#include "compileconfig.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bytecode.h"
+#include "datetime.h"
+#include "gcvalue.h"
+#include "poolalloc.h"
+#include "valuecontentstruct.h"
+#include "vmexec.h"
+#include "vmgc.h"
+#include "vmlist.h"
+#include "vmmap.h"
+#include "vmset.h"
+#include "vmstrings.h"
+
+// Cycle collection by trial deletion: reference counting releases a
+// value once nothing refers to it anymore, but that never happens for
+// groups of values that keep each other alive through heap references.
+// Both paths free values with vmgc_ReleaseValue() below. Candidates are
+// container values with no external (stack or global) references but
+// heap references left. From a candidate, the reachable container
+// subgraph is gathered while subtracting each internal edge from a
+// temporary copy of the heap reference count. Any value that then
+// still has references from outside, or that is reachable from such
+// a value, is alive. Everything else is an unreachable cycle.
+//
+// The heap is scanned incrementally with a persistent cursor, and
+// every slice stops once its work budget is used up. Since a slice
+// only runs while its vmthread is not executing, each single trial
+// always completes against a consistent reference graph.
+
+typedef struct h64gcstate {
+    poolalloc *heap;
+    int64_t scan_cursor;
+    int64_t trial_limit;
+    h64gcstats stats;
+
+    // Values of the current trial:
+    int64_t node_count, node_alloc;
+    h64gcvalue **node;
+    int32_t *node_tmprc;
+    uint8_t *node_live;
+    int64_t *node_queue;
+    int64_t node_slot_count;
+    int64_t *node_slot;  // node index + 1, or 0 for empty
+
+    // Values already proven alive during the current slice:
+    int64_t live_count, live_slot_count;
+    h64gcvalue **live_slot;
+} h64gcstate;
+
+enum {
+    VMGC_VISIT_DISCOVER = 0,
+    VMGC_VISIT_PROPAGATE,
+    VMGC_VISIT_DETACH
+};
+
+typedef struct _vmgc_visitctx {
+    h64gcstate *gc;
+    int mode;
+    int64_t limit;
+    int64_t work;
+    int64_t queue_len;
+    int failed_oom, failed_limit;
+} _vmgc_visitctx;
+
+
+h64gcstate *vmgc_New(poolalloc *heap) {
+    h64gcstate *gc = malloc(sizeof(*gc));
+    if (!gc)
+        return NULL;
+    memset(gc, 0, sizeof(*gc));
+    gc->heap = heap;
+    gc->trial_limit = VMGC_SLICE_BUDGET;
+    return gc;
+}
+
+void vmgc_Free(h64gcstate *gc) {
+    if (!gc)
+        return;
+    free(gc->node);
+    free(gc->node_tmprc);
+    free(gc->node_live);
+    free(gc->node_queue);
+    free(gc->node_slot);
+    free(gc->live_slot);
+    free(gc);
+}
+
+void vmgc_GetStats(h64gcstate *gc, h64gcstats *out_stats) {
+    if (!gc) {
+        memset(out_stats, 0, sizeof(*out_stats));
+        return;
+    }
+    memcpy(out_stats, &gc->stats, sizeof(*out_stats));
+}
+
+void vmgc_AddStats(h64gcstats *total, h64gcstats *add) {
+    total->slices_run += add->slices_run;
+    total->passes_completed += add->passes_completed;
+    total->trials_run += add->trials_run;
+    total->trials_aborted += add->trials_aborted;
+    total->cycles_found += add->cycles_found;
+    total->values_freed += add->values_freed;
+    total->bytes_freed += add->bytes_freed;
+    if (add->last_pause_us > 0)
+        total->last_pause_us = add->last_pause_us;
+    if (add->max_pause_us > total->max_pause_us)
+        total->max_pause_us = add->max_pause_us;
+    total->total_pause_us += add->total_pause_us;
+}
+
+static inline uint64_t _vmgc_PtrHash(h64gcvalue *v) {
+    uint64_t h = (uint64_t)(uintptr_t)v;
+    h ^= (h >> 29);
+    h *= 0x9E3779B97F4A7C15ULL;
+    return h ^ (h >> 32);
+}
+
+static inline int _vmgc_IsTraced(h64gcvalue *v) {
+    return (v->type == H64GCVALUETYPE_LIST ||
+            v->type == H64GCVALUETYPE_MAP ||
+            v->type == H64GCVALUETYPE_SET ||
+            v->type == H64GCVALUETYPE_OBJINSTANCE ||
+            v->type == H64GCVALUETYPE_FUNCREF_CLOSURE);
+}
+
+static int64_t _vmgc_FindNode(h64gcstate *gc, h64gcvalue *v) {
+    if (gc->node_slot_count == 0)
+        return -1;
+    uint64_t mask = (uint64_t)gc->node_slot_count - 1;
+    uint64_t i = _vmgc_PtrHash(v) & mask;
+    while (gc->node_slot[i] != 0) {
+        if (gc->node[gc->node_slot[i] - 1] == v)
+            return gc->node_slot[i] - 1;
+        i = (i + 1) & mask;
+    }
+    return -1;
+}
+
+static void _vmgc_InsertNodeSlot(h64gcstate *gc, int64_t nodeidx) {
+    uint64_t mask = (uint64_t)gc->node_slot_count - 1;
+    uint64_t i = _vmgc_PtrHash(gc->node[nodeidx]) & mask;
+    while (gc->node_slot[i] != 0)
+        i = (i + 1) & mask;
+    gc->node_slot[i] = nodeidx + 1;
+}
+
+static int64_t _vmgc_AddNode(h64gcstate *gc, h64gcvalue *v) {
+    if (gc->node_count >= gc->node_alloc) {
+        int64_t new_alloc = (
+            gc->node_alloc < 64 ? 64 : gc->node_alloc * 2
+        );
+        h64gcvalue **new_node = realloc(
+            gc->node, sizeof(*new_node) * new_alloc
+        );
+        if (!new_node)
+            return -1;
+        gc->node = new_node;
+        int32_t *new_tmprc = realloc(
+            gc->node_tmprc, sizeof(*new_tmprc) * new_alloc
+        );
+        if (!new_tmprc)
+            return -1;
+        gc->node_tmprc = new_tmprc;
+        uint8_t *new_live = realloc(
+            gc->node_live, sizeof(*new_live) * new_alloc
+        );
+        if (!new_live)
+            return -1;
+        gc->node_live = new_live;
+        int64_t *new_queue = realloc(
+            gc->node_queue, sizeof(*new_queue) * new_alloc
+        );
+        if (!new_queue)
+            return -1;
+        gc->node_queue = new_queue;
+        gc->node_alloc = new_alloc;
+    }
+    if ((gc->node_count + 1) * 2 > gc->node_slot_count) {
+        int64_t new_count = (
+            gc->node_slot_count < 128 ? 128 : gc->node_slot_count * 2
+        );
+        int64_t *new_slot = malloc(sizeof(*new_slot) * new_count);
+        if (!new_slot)
+            return -1;
+        memset(new_slot, 0, sizeof(*new_slot) * new_count);
+        free(gc->node_slot);
+        gc->node_slot = new_slot;
+        gc->node_slot_count = new_count;
+        int64_t i = 0;
+        while (i < gc->node_count) {
+            _vmgc_InsertNodeSlot(gc, i);
+            i++;
+        }
+    }
+    int64_t idx = gc->node_count;
+    gc->node[idx] = v;
+    gc->node_tmprc[idx] = v->heapreferencecount;
+    gc->node_live[idx] = 0;
+    gc->node_count++;
+    _vmgc_InsertNodeSlot(gc, idx);
+    return idx;
+}
+
+static void _vmgc_ClearNodes(h64gcstate *gc) {
+    // Only wipe the occupied slots, the table may be much larger:
+    if (gc->node_slot_count > 0) {
+        uint64_t mask = (uint64_t)gc->node_slot_count - 1;
+        int64_t k = 0;
+        while (k < gc->node_count) {
+            uint64_t i = _vmgc_PtrHash(gc->node[k]) & mask;
+            while (gc->node_slot[i] != k + 1)
+                i = (i + 1) & mask;
+            gc->node_slot[i] = 0;
+            k++;
+        }
+    }
+    gc->node_count = 0;
+}
+
+static int _vmgc_IsKnownLive(h64gcstate *gc, h64gcvalue *v) {
+    if (gc->live_slot_count == 0)
+        return 0;
+    uint64_t mask = (uint64_t)gc->live_slot_count - 1;
+    uint64_t i = _vmgc_PtrHash(v) & mask;
+    while (gc->live_slot[i] != NULL) {
+        if (gc->live_slot[i] == v)
+            return 1;
+        i = (i + 1) & mask;
+    }
+    return 0;
+}
+
+static void _vmgc_AddKnownLive(h64gcstate *gc, h64gcvalue *v) {
+    if ((gc->live_count + 1) * 2 > gc->live_slot_count) {
+        int64_t new_count = (
+            gc->live_slot_count < 128 ? 128 : gc->live_slot_count * 2
+        );
+        h64gcvalue **new_slot = malloc(sizeof(*new_slot) * new_count);
+        if (!new_slot)
+            return;  // only an optimization, so no need to fail
+        memset(new_slot, 0, sizeof(*new_slot) * new_count);
+        uint64_t mask = (uint64_t)new_count - 1;
+        int64_t k = 0;
+        while (k < gc->live_slot_count) {
+            if (gc->live_slot[k] != NULL) {
+                uint64_t i = _vmgc_PtrHash(gc->live_slot[k]) & mask;
+                while (new_slot[i] != NULL)
+                    i = (i + 1) & mask;
+                new_slot[i] = gc->live_slot[k];
+            }
+            k++;
+        }
+        free(gc->live_slot);
+        gc->live_slot = new_slot;
+        gc->live_slot_count = new_count;
+    }
+    uint64_t mask = (uint64_t)gc->live_slot_count - 1;
+    uint64_t i = _vmgc_PtrHash(v) & mask;
+    while (gc->live_slot[i] != NULL) {
+        if (gc->live_slot[i] == v)
+            return;
+        i = (i + 1) & mask;
+    }
+    gc->live_slot[i] = v;
+    gc->live_count++;
+}
+
+static void _vmgc_ClearKnownLive(h64gcstate *gc) {
+    if (gc->live_count > 0)
+        memset(gc->live_slot, 0,
+               sizeof(*gc->live_slot) * gc->live_slot_count);
+    gc->live_count = 0;
+}
+
+static int _vmgc_VisitRef(
+        _vmgc_visitctx *ctx, h64gcvalue **ref, valuecontent *vc
+        ) {
+    h64gcstate *gc = ctx->gc;
+    h64gcvalue *target = NULL;
+    if (vc) {
+        if (vc->type != H64VALTYPE_GCVAL)
+            return 1;
+        target = vc->ptr_value;
+    } else {
+        target = *ref;
+    }
+    ctx->work++;
+    if (!target || !poolalloc_OwnsPtr(gc->heap, target) ||
+            !_vmgc_IsTraced(target))
+        return 1;  // can't be part of a cycle we may collect
+
+    if (ctx->mode == VMGC_VISIT_DISCOVER) {
+        if (_vmgc_IsKnownLive(gc, target))
+            return 1;
+        int64_t idx = _vmgc_FindNode(gc, target);
+        if (idx < 0) {
+            if (gc->node_count >= ctx->limit) {
+                ctx->failed_limit = 1;
+                return 0;
+            }
+            idx = _vmgc_AddNode(gc, target);
+            if (idx < 0) {
+                ctx->failed_oom = 1;
+                return 0;
+            }
+        }
+        gc->node_tmprc[idx]--;
+    } else if (ctx->mode == VMGC_VISIT_PROPAGATE) {
+        int64_t idx = _vmgc_FindNode(gc, target);
+        if (idx >= 0 && !gc->node_live[idx]) {
+            gc->node_live[idx] = 1;
+            gc->node_queue[ctx->queue_len] = idx;
+            ctx->queue_len++;
+        }
+    } else {
+        assert(ctx->mode == VMGC_VISIT_DETACH);
+        int64_t idx = _vmgc_FindNode(gc, target);
+        if (idx >= 0 && !gc->node_live[idx]) {
+            // Drop reference between two values that are both garbage:
+            target->heapreferencecount--;
+            assert(target->heapreferencecount >= 0);
+            if (vc)
+                memset(vc, 0, sizeof(*vc));
+            else
+                *ref = NULL;
+        }
+    }
+    return 1;
+}
+
+static int _vmgc_VisitValue(void *ud, valuecontent *value) {
+    return _vmgc_VisitRef((_vmgc_visitctx *)ud, NULL, value);
+}
+
+static int _vmgc_VisitMapPair(
+        void *ud, ATTR_UNUSED valuecontent *key, valuecontent *value
+        ) {
+    if (!_vmgc_VisitRef((_vmgc_visitctx *)ud, NULL, key))
+        return 0;
+    return _vmgc_VisitRef((_vmgc_visitctx *)ud, NULL, value);
+}
+
+static int _vmgc_VisitChildren(
+        h64vmthread *vmthread, _vmgc_visitctx *ctx, h64gcvalue *v
+        ) {
+    ctx->work++;
+    switch (v->type) {
+    case H64GCVALUETYPE_LIST:
+        if (v->list_values)
+            return vmmap_IterateValues(
+                v->list_values, ctx, _vmgc_VisitValue
+            );
+        return 1;
+    case H64GCVALUETYPE_MAP:
+        if (v->map_values)
+            return vmmap_IteratePairs(
+                v->map_values, ctx, _vmgc_VisitMapPair
+            );
+        return 1;
+    case H64GCVALUETYPE_SET:
+        if (v->set_values)
+            return vmset_IterateValues(
+                v->set_values, ctx, _vmgc_VisitValue
+            );
+        return 1;
+    case H64GCVALUETYPE_OBJINSTANCE: {
+        if (!v->varattr)
+            return 1;
+        int64_t c = vmthread->vmexec_owner->program->classes[
+            v->class_id
+        ].varattr_count;
+        int64_t i = 0;
+        while (i < c) {
+            if (!_vmgc_VisitRef(ctx, NULL, &v->varattr[i]))
+                return 0;
+            i++;
+        }
+        return 1;
+    }
+    case H64GCVALUETYPE_FUNCREF_CLOSURE: {
+        h64closureinfo *cinfo = v->closure_info;
+        if (!cinfo)
+            return 1;
+        if (cinfo->closure_self &&
+                !_vmgc_VisitRef(ctx, &cinfo->closure_self, NULL))
+            return 0;
+        int i = 0;
+        while (i < cinfo->closure_bound_values_count) {
+            if (!_vmgc_VisitRef(
+                    ctx, NULL, &cinfo->closure_bound_values[i]
+                    ))
+                return 0;
+            i++;
+        }
+        return 1;
+    }
+    default:
+        return 1;
+    }
+}
+
+typedef struct _vmgc_releasectx {
+    h64vmthread *vmthread;
+    int maxrecurse;
+} _vmgc_releasectx;
+
+static int _vmgc_ReleaseChild(void *ud, valuecontent *vc) {
+    _vmgc_releasectx *ctx = ud;
+    DELREF_HEAP(vc);
+    valuecontent_Free_Do(ctx->vmthread, vc, ctx->maxrecurse);
+    memset(vc, 0, sizeof(*vc));
+    return 1;
+}
+
+static int _vmgc_ReleaseMapValue(
+        void *ud, ATTR_UNUSED valuecontent *key, valuecontent *value
+        ) {
+    return _vmgc_ReleaseChild(ud, value);
+}
+
+static void _vmgc_QueueRelease(h64vmthread *vmthread, h64gcvalue *v) {
+    if (vmthread->releasequeue_count >= vmthread->releasequeue_alloc) {
+        int64_t new_alloc = (
+            vmthread->releasequeue_alloc < 16 ? 16 :
+            vmthread->releasequeue_alloc * 2
+        );
+        h64gcvalue **new_queue = realloc(
+            vmthread->releasequeue, sizeof(*new_queue) * new_alloc
+        );
+        if (!new_queue)
+            return;  // out of memory, so it is leaked
+        vmthread->releasequeue = new_queue;
+        vmthread->releasequeue_alloc = new_alloc;
+    }
+    vmthread->releasequeue[vmthread->releasequeue_count] = v;
+    vmthread->releasequeue_count++;
+}
+
+int64_t vmgc_ReleaseValue(
+        h64vmthread *vmthread, h64gcvalue *v, int maxrecurse
+        ) {
+    assert(v->externalreferencecount == 0 &&
+           v->heapreferencecount == 0);
+    if (maxrecurse <= 0) {
+        // Nested too deeply, so continue from the outermost free:
+        _vmgc_QueueRelease(vmthread, v);
+        return 0;
+    }
+    _vmgc_releasectx ctx = {0};
+    ctx.vmthread = vmthread;
+    ctx.maxrecurse = maxrecurse - 1;
+
+    // Children are released here rather than by the container's own
+    // free function, so that the recursion limit carries over:
+    int64_t bytes = sizeof(h64gcvalue);
+    if (v->type == H64GCVALUETYPE_LIST) {
+        if (v->list_values) {
+            bytes += sizeof(genericlist) +
+                vmlist_Count(v->list_values) * sizeof(valuecontent);
+            vmmap_IterateValues(
+                v->list_values, &ctx, _vmgc_ReleaseChild
+            );
+            vmlist_Free(vmthread, v->list_values);
+            v->list_values = NULL;
+        }
+    } else if (v->type == H64GCVALUETYPE_MAP) {
+        if (v->map_values) {
+            bytes += sizeof(genericmap) +
+                vmmap_Count(v->map_values) * sizeof(genericmapslot);
+            vmmap_IteratePairs(
+                v->map_values, &ctx, _vmgc_ReleaseMapValue
+            );
+            vmmap_Free(vmthread, v->map_values);
+            v->map_values = NULL;
+        }
+    } else if (v->type == H64GCVALUETYPE_SET) {
+        if (v->set_values) {
+            bytes += sizeof(genericset) +
+                v->set_values->slot_count * sizeof(genericsetentry);
+            vmset_IterateValues(
+                v->set_values, &ctx, _vmgc_ReleaseChild
+            );
+            vmset_Free(vmthread, v->set_values);
+            v->set_values = NULL;
+        }
+    } else if (v->type == H64GCVALUETYPE_OBJINSTANCE) {
+        if (v->varattr) {
+            int64_t c = vmthread->vmexec_owner->program->classes[
+                v->class_id
+            ].varattr_count;
+            int64_t i = 0;
+            while (i < c) {
+                _vmgc_ReleaseChild(&ctx, &v->varattr[i]);
+                i++;
+            }
+            free(v->varattr);
+            v->varattr = NULL;
+            bytes += c * sizeof(valuecontent);
+        }
+    } else if (v->type == H64GCVALUETYPE_FUNCREF_CLOSURE) {
+        h64closureinfo *cinfo = v->closure_info;
+        if (cinfo) {
+            if (cinfo->closure_self) {
+                valuecontent selfvc = {0};
+                selfvc.type = H64VALTYPE_GCVAL;
+                selfvc.ptr_value = cinfo->closure_self;
+                _vmgc_ReleaseChild(&ctx, &selfvc);
+            }
+            int i = 0;
+            while (i < cinfo->closure_bound_values_count) {
+                _vmgc_ReleaseChild(
+                    &ctx, &cinfo->closure_bound_values[i]
+                );
+                i++;
+            }
+            bytes += sizeof(*cinfo) + (
+                cinfo->closure_bound_values_count *
+                sizeof(valuecontent)
+            );
+            free(cinfo->closure_bound_values);
+            free(cinfo);
+            v->closure_info = NULL;
+        }
+    } else if (v->type == H64GCVALUETYPE_STRING) {
+        vmstrings_Free(vmthread, &v->str_val);
+    } else if (v->type == H64GCVALUETYPE_BYTES) {
+        vmbytes_Free(vmthread, &v->bytes_val);
+    }
+    v->type = H64GCVALUETYPE_INVALID;
+    poolalloc_free(vmthread->heap, v);
+    return bytes;
+}
+
+void vmgc_ReleaseQueued(h64vmthread *vmthread) {
+    if (vmthread->releasequeue_draining)
+        return;
+    vmthread->releasequeue_draining = 1;
+    while (vmthread->releasequeue_count > 0) {
+        vmthread->releasequeue_count--;
+        vmgc_ReleaseValue(
+            vmthread,
+            vmthread->releasequeue[vmthread->releasequeue_count],
+            VMGC_RELEASE_MAXRECURSE
+        );
+    }
+    vmthread->releasequeue_draining = 0;
+}
+
+// Returns 1 if done, 0 on out of memory, -1 if the trial outgrew limit.
+static int _vmgc_RunTrial(
+        h64vmthread *vmthread, h64gcstate *gc, h64gcvalue *candidate,
+        int64_t limit, int64_t *work
+        ) {
+    _vmgc_ClearNodes(gc);
+    gc->stats.trials_run++;
+    _vmgc_visitctx ctx = {0};
+    ctx.gc = gc;
+    ctx.limit = limit;
+    if (_vmgc_AddNode(gc, candidate) < 0)
+        return 0;
+
+    // Gather reachable subgraph, subtracting internal references:
+    ctx.mode = VMGC_VISIT_DISCOVER;
+    int64_t i = 0;
+    while (i < gc->node_count) {
+        if (!_vmgc_VisitChildren(vmthread, &ctx, gc->node[i]) ||
+                ctx.work > limit) {
+            *work += ctx.work;
+            _vmgc_ClearNodes(gc);
+            gc->stats.trials_aborted++;
+            if (ctx.failed_oom)
+                return 0;
+            return -1;
+        }
+        i++;
+    }
+
+    // Anything still referenced from elsewhere is alive:
+    ctx.mode = VMGC_VISIT_PROPAGATE;
+    ctx.queue_len = 0;
+    i = 0;
+    while (i < gc->node_count) {
+        h64gcvalue *v = gc->node[i];
+        if (v->externalreferencecount > 0 || gc->node_tmprc[i] > 0 ||
+                (v->type == H64GCVALUETYPE_OBJINSTANCE &&
+                 v->cdata != NULL)) {
+            gc->node_live[i] = 1;
+            gc->node_queue[ctx.queue_len] = i;
+            ctx.queue_len++;
+        }
+        i++;
+    }
+    while (ctx.queue_len > 0) {
+        ctx.queue_len--;
+        int64_t idx = gc->node_queue[ctx.queue_len];
+        _vmgc_VisitChildren(vmthread, &ctx, gc->node[idx]);
+    }
+
+    // Remember live ones, and collect the rest:
+    int64_t garbage_count = 0;
+    i = 0;
+    while (i < gc->node_count) {
+        if (gc->node_live[i])
+            _vmgc_AddKnownLive(gc, gc->node[i]);
+        else
+            garbage_count++;
+        i++;
+    }
+    if (garbage_count > 0) {
+        assert(!gc->node_live[0]);
+        gc->stats.cycles_found++;
+        ctx.mode = VMGC_VISIT_DETACH;
+        i = 0;
+        while (i < gc->node_count) {
+            if (!gc->node_live[i])
+                _vmgc_VisitChildren(vmthread, &ctx, gc->node[i]);
+            i++;
+        }
+        i = 0;
+        while (i < gc->node_count) {
+            if (!gc->node_live[i]) {
+                assert(gc->node[i]->externalreferencecount == 0 &&
+                       gc->node[i]->heapreferencecount == 0);
+                // References to other garbage were already detached,
+                // so anything left is released the regular way:
+                gc->stats.bytes_freed += vmgc_ReleaseValue(
+                    vmthread, gc->node[i], VMGC_RELEASE_MAXRECURSE
+                );
+                gc->stats.values_freed++;
+            }
+            i++;
+        }
+    }
+    _vmgc_ClearNodes(gc);
+    *work += ctx.work;
+    return 1;
+}
+
+int vmgc_CollectSlice(h64vmthread *vmthread, int64_t budget) {
+    h64gcstate *gc = vmthread->gc;
+    if (!gc)
+        return 1;
+    assert(gc->heap == vmthread->heap);
+    uint64_t start = datetime_MicroTicks();
+    gc->stats.slices_run++;
+    _vmgc_ClearKnownLive(gc);
+
+    int result = 1;
+    int64_t work = 0;
+    int tried_any = 0;
+    while (work < budget) {
+        int64_t prev_cursor = gc->scan_cursor;
+        h64gcvalue *v = poolalloc_IterateUsed(
+            gc->heap, &gc->scan_cursor
+        );
+        work++;
+        if (!v) {
+            gc->stats.passes_completed++;
+            break;
+        }
+        if (v->externalreferencecount != 0 ||
+                v->heapreferencecount <= 0 ||
+                !_vmgc_IsTraced(v) || _vmgc_IsKnownLive(gc, v))
+            continue;
+
+        // The first trial of a slice may use the full budget, or more
+        // if earlier attempts on a large cycle didn't fit:
+        int fresh = !tried_any;
+        tried_any = 1;
+        int64_t limit = budget - work;
+        if (fresh)
+            limit = (gc->trial_limit > budget ? gc->trial_limit : budget);
+        int trialresult = _vmgc_RunTrial(
+            vmthread, gc, v, limit, &work
+        );
+        if (trialresult == 0) {
+            result = 0;
+            break;
+        } else if (trialresult < 0) {
+            if (fresh) {
+                if (gc->trial_limit >= VMGC_MAX_TRIAL_LIMIT)
+                    continue;  // too large, skip it for this pass
+                gc->trial_limit *= 2;
+            }
+            // Retry this candidate in the next slice:
+            gc->scan_cursor = prev_cursor;
+            break;
+        }
+    }
+    _vmgc_ClearKnownLive(gc);
+
+    int64_t pause = (int64_t)(datetime_MicroTicks() - start);
+    gc->stats.last_pause_us = pause;
+    if (pause > gc->stats.max_pause_us)
+        gc->stats.max_pause_us = pause;
+    gc->stats.total_pause_us += pause;
+    return result;
+}
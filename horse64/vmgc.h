@@ -0,0 +1,56 @@
+// Copyright (c) 2020-2021, ellie/@ell1e & Horse64 Team (see AUTHORS.md),
+// also see LICENSE.md file.
+// SPDX-License-Identifier: BSD-2-Clause
+
+#ifndef HORSE64_VMGC_H_
+#define HORSE64_VMGC_H_
+
+#include "compileconfig.h"
+
+#include <stdint.h>
+
+typedef struct h64vmthread h64vmthread;
+typedef struct poolalloc poolalloc;
+typedef struct h64gcvalue h64gcvalue;
+
+// Work units (visited values plus followed references) per slice:
+#define VMGC_SLICE_BUDGET 4096
+// Upper bound a single trial may grow to for very large cycles:
+#define VMGC_MAX_TRIAL_LIMIT (1024 * 1024)
+// Nesting depth up to which values are released recursively:
+#define VMGC_RELEASE_MAXRECURSE 10
+
+typedef struct h64gcstats {
+    int64_t slices_run, passes_completed;
+    int64_t trials_run, trials_aborted;
+    int64_t cycles_found, values_freed;
+    int64_t bytes_freed;
+    int64_t last_pause_us, max_pause_us, total_pause_us;
+} h64gcstats;
+
+typedef struct h64gcstate h64gcstate;
+
+h64gcstate *vmgc_New(poolalloc *heap);
+
+void vmgc_Free(h64gcstate *gc);
+
+int vmgc_CollectSlice(h64vmthread *vmthread, int64_t budget);
+    // Returns 0 on out of memory, otherwise 1. Must only be called
+    // while vmthread is not running, and with the worker mutex held.
+
+int64_t vmgc_ReleaseValue(
+    h64vmthread *vmthread, h64gcvalue *v, int maxrecurse
+);  // Releases a value without references left, including its
+    // contents, and returns its slot to vmthread's heap. Values
+    // nested deeper than maxrecurse are queued instead. Returns
+    // the freed byte count.
+
+void vmgc_ReleaseQueued(h64vmthread *vmthread);
+    // Releases values queued by vmgc_ReleaseValue(), unless this
+    // is already being done further up the call stack.
+
+void vmgc_GetStats(h64gcstate *gc, h64gcstats *out_stats);
+
+void vmgc_AddStats(h64gcstats *total, h64gcstats *add);
+
+#endif  // HORSE64_VMGC_H_
@@ -24,6 +24,7 @@ typedef struct h64iteratorstruct {
         valuecontent iterated_vector;
     };
     uint64_t idx, len;
+    uint64_t container_pos;  // for sets, see vmset_IterateNext()
 } h64iteratorstruct;
 
 
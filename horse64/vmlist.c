@@ -32,6 +32,24 @@ genericlist *vmlist_New() {
     return l;
 }
 
+void vmlist_Free(h64vmthread *vt, genericlist *l) {
+    if (!l)
+        return;
+    listblock *block = l->first_block;
+    while (block) {
+        int i = 0;
+        while (i < block->entry_count) {
+            DELREF_HEAP(&block->entry_values[i]);
+            valuecontent_Free(vt, &block->entry_values[i]);
+            i++;
+        }
+        listblock *next = block->next_block;
+        free(block);
+        block = next;
+    }
+    free(l);
+}
+
 int vmmap_IterateValues(
         genericlist *l, void *userdata,
         int (*cb)(void *udata, valuecontent *value)
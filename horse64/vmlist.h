@@ -15,6 +15,8 @@
 
 genericlist *vmlist_New();
 
+void vmlist_Free(h64vmthread *vt, genericlist *l);
+
 ATTR_UNUSED static inline uint64_t vmlist_Revision(genericlist *l) {
     return l->contentrevisionid;
 }
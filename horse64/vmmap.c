@@ -7,14 +7,25 @@
 
 #include <assert.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "bytecode.h"
 #include "valuecontentstruct.h"
 #include "vmcontainerstruct.h"
 #include "vmmap.h"
 
+// Small maps are a plain array of slots that is searched linearly.
+// Once they grow past GENERICMAP_MIGRATE_HASHED entries, they turn into
+// one contiguous open addressing table using Robin Hood hashing: each
+// slot remembers how far it is from its home slot, an insert takes over
+// the spot of any entry that is closer to home than itself, and a lookup
+// can stop as soon as it passes such an entry. Removal shifts the
+// following entries of the probe chain back by one, so no tombstones
+// are ever needed.
+
 #define GENERICMAP_MIGRATE_HASHED 16
-#define GENERICMAP_DEFAULT_BUCKETS 64
+#define GENERICMAP_MINSLOTS 32
 
 
 genericmap *vmmap_New() {
@@ -26,79 +37,152 @@ genericmap *vmmap_New() {
     return map;
 }
 
-int _vmmap_AddToBucket(
-        genericmapbucket *buck, uint32_t hash,
-        valuecontent *key, valuecontent *value
+static inline genericmapslot *_vmmap_Slots(genericmap *m) {
+    if ((m->flags & GENERICMAP_FLAG_LINEAR) != 0)
+        return m->linear.slot;
+    return m->hashed.slot;
+}
+
+static inline uint64_t _vmmap_HomeSlot(uint32_t hash, uint64_t mask) {
+    return ((uint64_t)hash) & mask;
+}
+
+static void _vmmap_HashedInsertNew(
+        genericmapslot *slots, uint64_t mask, genericmapslot *entry
         ) {
-    valuecontent *entries = realloc(
-        buck->entry,
-        sizeof(*buck->entry) * (buck->entry_count + 1)
-    );
-    if (!entries)
-        return 0;
-    buck->entry = entries;
-    valuecontent *keys = realloc(
-        buck->key,
-        sizeof(*buck->key) * (buck->entry_count + 1)
+    // Moves the entry in as is, with no reference changes.
+    genericmapslot cur;
+    memcpy(&cur, entry, sizeof(cur));
+    cur.probe_dist = 1;
+    uint64_t i = _vmmap_HomeSlot(cur.hash, mask);
+    while (1) {
+        genericmapslot *s = &slots[i];
+        if (s->probe_dist == 0) {
+            memcpy(s, &cur, sizeof(cur));
+            return;
+        }
+        if (s->probe_dist < cur.probe_dist) {
+            genericmapslot swap;
+            memcpy(&swap, s, sizeof(swap));
+            memcpy(s, &cur, sizeof(cur));
+            memcpy(&cur, &swap, sizeof(cur));
+        }
+        cur.probe_dist++;
+        i = (i + 1) & mask;
+    }
+}
+
+static int _vmmap_Rehash(genericmap *m, int64_t new_slot_count) {
+    assert((m->flags & GENERICMAP_FLAG_LINEAR) == 0);
+    assert(new_slot_count >= GENERICMAP_MINSLOTS &&
+           (new_slot_count & (new_slot_count - 1)) == 0);
+    genericmapslot *new_slot = malloc(
+        sizeof(*new_slot) * new_slot_count
     );
-    if (!entries)
+    if (!new_slot)
         return 0;
-    buck->key = keys;
-    uint32_t *entries_hash = realloc(
-        buck->entry_hash,
-        sizeof(*buck->entry_hash) * (buck->entry_count + 1)
+    memset(new_slot, 0, sizeof(*new_slot) * new_slot_count);
+    const uint64_t mask = (uint64_t)new_slot_count - 1;
+    int64_t i = 0;
+    while (i < m->hashed.slot_count) {
+        if (m->hashed.slot[i].probe_dist != 0)
+            _vmmap_HashedInsertNew(new_slot, mask, &m->hashed.slot[i]);
+        i++;
+    }
+    free(m->hashed.slot);
+    m->hashed.slot = new_slot;
+    m->hashed.slot_count = new_slot_count;
+    return 1;
+}
+
+static int _vmmap_MigrateToHashed(genericmap *m) {
+    assert((m->flags & GENERICMAP_FLAG_LINEAR) != 0);
+    // Linear and hashed info share a union, so build the table
+    // fully before switching over:
+    genericmapslot *old_slot = m->linear.slot;
+    int64_t count = m->linear.entry_count;
+    int64_t slot_count = GENERICMAP_MINSLOTS;
+    while ((count + 1) * 5 > slot_count * 4)
+        slot_count *= 2;
+    genericmapslot *new_slot = malloc(
+        sizeof(*new_slot) * slot_count
     );
-    if (!entries_hash)
+    if (!new_slot)
         return 0;
-    buck->entry_hash = entries_hash;
-    memcpy(
-        &buck->key[buck->entry_count],
-        key, sizeof(*key)
-    );
-    ADDREF_HEAP(&buck->key[buck->entry_count]);
-    memcpy(
-        &buck->entry[buck->entry_count],
-        value, sizeof(*value)
-    );
-    ADDREF_HEAP(&buck->entry[buck->entry_count]);
-    buck->entry_hash[buck->entry_count] = hash;
-    buck->entry_count++;
+    memset(new_slot, 0, sizeof(*new_slot) * slot_count);
+    const uint64_t mask = (uint64_t)slot_count - 1;
+    int64_t i = 0;
+    while (i < count) {
+        _vmmap_HashedInsertNew(new_slot, mask, &old_slot[i]);
+        i++;
+    }
+    free(old_slot);
+    m->flags &= ~GENERICMAP_FLAG_LINEAR;
+    m->hashed.entry_count = count;
+    m->hashed.slot_count = slot_count;
+    m->hashed.slot = new_slot;
     return 1;
 }
 
-void _vmmap_ClearBuckets(genericmap *map, h64vmthread *vmthread) {
-    if ((map->flags & GENERICMAP_FLAG_LINEAR) != 0) {
-        int32_t i = 0;
-        while (i < map->linear.entry_count) {
-            DELREF_HEAP(&map->linear.entry[i]);
-            valuecontent_Free(vmthread, &map->linear.entry[i]);
-            DELREF_HEAP(&map->linear.key[i]);
-            valuecontent_Free(vmthread, &map->linear.key[i]);
+void vmmap_Free(h64vmthread *vt, genericmap *m) {
+    if (!m)
+        return;
+    uint64_t pos = 0;
+    valuecontent *key, *value;
+    while (vmmap_IterateNext(m, &pos, &key, &value)) {
+        DELREF_HEAP(key);
+        valuecontent_Free(vt, key);
+        DELREF_HEAP(value);
+        valuecontent_Free(vt, value);
+    }
+    free(_vmmap_Slots(m));
+    free(m);
+}
+
+static int64_t _vmmap_FindSlot(
+        h64vmthread *vt, genericmap *m, uint32_t hash,
+        valuecontent *key, int *oom
+        ) {
+    *oom = 0;
+    if ((m->flags & GENERICMAP_FLAG_LINEAR) != 0) {
+        int64_t i = 0;
+        while (i < m->linear.entry_count) {
+            genericmapslot *s = &m->linear.slot[i];
+            if (s->hash == hash) {
+                int inneroom = 0;
+                if (likely(valuecontent_CheckEquality(
+                        vt, key, &s->key, &inneroom)))
+                    return i;
+                if (unlikely(inneroom)) {
+                    *oom = 1;
+                    return -1;
+                }
+            }
             i++;
         }
-        free(map->linear.entry);
-        map->linear.entry = NULL;
-        free(map->linear.key);
-        map->linear.key = NULL;
-        return;
+        return -1;
     }
-    int32_t i = 0;
-    while (i < map->hashed.bucket_count) {
-        genericmapbucket *b = &map->hashed.bucket[i];
-        int k = 0;
-        while (k < b->entry_count) {
-            DELREF_HEAP(&b->key[k]);
-            valuecontent_Free(vmthread, &b->key[k]);
-            DELREF_HEAP(&b->entry[k]);
-            valuecontent_Free(vmthread, &b->entry[k]);
-            k++;
+    const uint64_t mask = (uint64_t)m->hashed.slot_count - 1;
+    uint64_t i = _vmmap_HomeSlot(hash, mask);
+    uint32_t dist = 1;
+    while (1) {
+        genericmapslot *s = &m->hashed.slot[i];
+        // An empty slot, or one closer to its home than we'd be,
+        // means our key can't be further along:
+        if (s->probe_dist < dist)
+            return -1;
+        if (s->hash == hash) {
+            int inneroom = 0;
+            if (likely(valuecontent_CheckEquality(
+                    vt, key, &s->key, &inneroom)))
+                return (int64_t)i;
+            if (unlikely(inneroom)) {
+                *oom = 1;
+                return -1;
+            }
         }
-        free(b->key);
-        b->key = NULL;
-        free(b->entry);
-        b->entry = NULL;
-        b->entry_count = 0;
-        i++;
+        dist++;
+        i = (i + 1) & mask;
     }
 }
 
@@ -109,34 +193,41 @@ int vmmap_Contains(
     return vmmap_Get(vt, m, key, NULL, oom);
 }
 
+int vmmap_IterateNext(
+        genericmap *m, uint64_t *pos,
+        valuecontent **key, valuecontent **value
+        ) {
+    if ((m->flags & GENERICMAP_FLAG_LINEAR) != 0) {
+        if (*pos >= (uint64_t)m->linear.entry_count)
+            return 0;
+        genericmapslot *s = &m->linear.slot[*pos];
+        (*pos)++;
+        *key = &s->key;
+        *value = &s->value;
+        return 1;
+    }
+    while (*pos < (uint64_t)m->hashed.slot_count) {
+        genericmapslot *s = &m->hashed.slot[*pos];
+        (*pos)++;
+        if (s->probe_dist != 0) {
+            *key = &s->key;
+            *value = &s->value;
+            return 1;
+        }
+    }
+    return 0;
+}
+
 int vmmap_IteratePairs(
         genericmap *m, void *userdata,
         int (*cb)(void *udata, valuecontent *key, valuecontent *value)
         ) {
     assert(m != NULL);
-    if ((m->flags & GENERICMAP_FLAG_LINEAR) != 0) {
-        int i = 0;
-        while (i < m->linear.entry_count) {
-            valuecontent *key = &m->linear.key[i];
-            valuecontent *value = &m->linear.entry[i];
-            if (!cb(userdata, key, value))
-                return 0;
-            i++;
-        }
-    } else {
-        int k = 0;
-        while (k < m->hashed.bucket_count) {
-            genericmapbucket *b = &m->hashed.bucket[k];
-            int i = 0;
-            while (i < b->entry_count) {
-                valuecontent *key = &b->key[i];
-                valuecontent *value = &b->entry[i];
-                if (!cb(userdata, key, value))
-                    return 0;
-                i++;
-            }
-            k++;
-        }
+    uint64_t pos = 0;
+    valuecontent *key, *value;
+    while (vmmap_IterateNext(m, &pos, &key, &value)) {
+        if (!cb(userdata, key, value))
+            return 0;
     }
     return 1;
 }
@@ -146,116 +237,14 @@ int vmmap_Get(
         genericmap *m, valuecontent *key, valuecontent *value,
         int *oom
         ) {
-    uint32_t hash = valuecontent_Hash(key);
-    if ((m->flags & GENERICMAP_FLAG_LINEAR) != 0) {
-        int i = 0;
-        while (i < m->linear.entry_count) {
-            int inneroom = 0;
-            if (unlikely(m->linear.entry_hash[i] == hash) &&
-                    likely(valuecontent_CheckEquality(
-                    vt, key, &m->linear.key[i], &inneroom))) {
-                if (value)
-                    memcpy(value, &m->linear.entry[i], sizeof(*value));
-                return 1;
-            }
-            if (unlikely(inneroom)) {
-                *oom = 1;
-                return 0;
-            }
-            i++;
-        }
-    } else {
-        uint32_t bucket = (
-            hash % m->hashed.bucket_count
-        );
-        genericmapbucket *b = &m->hashed.bucket[bucket];
-        int i = 0;
-        while (i < b->entry_count) {
-            int inneroom = 0;
-            if (likely(b->entry_hash[i] == hash &&
-                    valuecontent_CheckEquality(
-                    vt, key, &b->key[i], &inneroom))) {
-                return 1;
-            }
-            if (unlikely(inneroom)) {
-                *oom = 1;
-                return 0;
-            }
-            i++;
-        }
-    }
-    *oom = 0;
-    return 0;
-}
-
-int _vmmap_RemoveByHash(
-        h64vmthread *vt,
-        genericmap *m, uint32_t hash, valuecontent *key,
-        int *oom
-        ) {
-    int found = 0;
-    if ((m->flags & GENERICMAP_FLAG_LINEAR) != 0) {
-        int i = 0;
-        while (i < m->linear.entry_count) {
-            int inneroom = 0;
-            if (m->linear.entry_hash[i] == hash &&
-                    valuecontent_CheckEquality(
-                    vt, key, &m->linear.key[i],
-                    &inneroom)) {
-                found = 1;
-                DELREF_HEAP(&m->linear.entry[i]);
-                valuecontent_Free(vt, &m->linear.entry[i]);
-                if (i + 1 < m->linear.entry_count)
-                    memmove(
-                        &m->linear.entry[i],
-                        &m->linear.entry[i + 1],
-                        sizeof(*m->linear.entry) *
-                            (m->linear.entry_count - i - 1)
-                    );
-                m->linear.entry_count--;
-                m->contentrevisionid++;
-                continue;
-            }
-            if (unlikely(inneroom)) {
-                *oom = 1;
-                return 0;
-            }
-            i++;
-        }
-    } else {
-        uint32_t bucket = (
-            hash % m->hashed.bucket_count
-        );
-        genericmapbucket *b = &m->hashed.bucket[bucket];
-        int i = 0;
-        while (i < b->entry_count) {
-            int inneroom = 0;
-            if (b->entry_hash[i] == hash &&
-                    valuecontent_CheckEquality(
-                    vt, key, &b->key[i], &inneroom)) {
-                found = 1;
-                DELREF_HEAP(&b->entry[i]);
-                valuecontent_Free(vt, &b->entry[i]);
-                if (i + 1 < b->entry_count)
-                    memmove(
-                        &b->entry[i],
-                        &b->entry[i + 1],
-                        sizeof(*b->entry) *
-                            (b->entry_count - i - 1)
-                    );
-                b->entry_count--;
-                m->contentrevisionid++;
-                continue;
-            }
-            if (unlikely(inneroom)) {
-                *oom = 1;
-                return 0;
-            }
-            i++;
-        }
-    }
-    *oom = 0;
-    return found;
+    int64_t idx = _vmmap_FindSlot(
+        vt, m, valuecontent_Hash(key), key, oom
+    );
+    if (idx < 0)
+        return 0;
+    if (value)
+        memcpy(value, &_vmmap_Slots(m)[idx].value, sizeof(*value));
+    return 1;
 }
 
 int vmmap_Remove(h64vmthread *vt,
@@ -264,45 +253,78 @@ int vmmap_Remove(h64vmthread *vt,
         *oom = 0;
         return 0;
     }
-    uint32_t hash = valuecontent_Hash(key);
-    return _vmmap_RemoveByHash(vt, m, hash, key, oom);
+    int64_t idx = _vmmap_FindSlot(
+        vt, m, valuecontent_Hash(key), key, oom
+    );
+    if (idx < 0)
+        return 0;
+    genericmapslot removed;
+    if ((m->flags & GENERICMAP_FLAG_LINEAR) != 0) {
+        memcpy(&removed, &m->linear.slot[idx], sizeof(removed));
+        if (idx + 1 < m->linear.entry_count)
+            memmove(
+                &m->linear.slot[idx],
+                &m->linear.slot[idx + 1],
+                sizeof(*m->linear.slot) *
+                    (m->linear.entry_count - idx - 1)
+            );
+        m->linear.entry_count--;
+    } else {
+        memcpy(&removed, &m->hashed.slot[idx], sizeof(removed));
+        // Backward shift: pull the rest of the probe chain one closer
+        // to home, until hitting an empty slot or an entry at home.
+        const uint64_t mask = (uint64_t)m->hashed.slot_count - 1;
+        uint64_t i = (uint64_t)idx;
+        while (1) {
+            uint64_t next = (i + 1) & mask;
+            if (m->hashed.slot[next].probe_dist <= 1)
+                break;
+            memcpy(
+                &m->hashed.slot[i], &m->hashed.slot[next],
+                sizeof(*m->hashed.slot)
+            );
+            m->hashed.slot[i].probe_dist--;
+            i = next;
+        }
+        memset(&m->hashed.slot[i], 0, sizeof(*m->hashed.slot));
+        m->hashed.entry_count--;
+    }
+    m->contentrevisionid++;
+    // Only free once the map is consistent again:
+    DELREF_HEAP(&removed.key);
+    valuecontent_Free(vt, &removed.key);
+    DELREF_HEAP(&removed.value);
+    valuecontent_Free(vt, &removed.value);
+    return 1;
 }
 
-valuecontent *vmmap_GetKeyByIdx(genericmap *m, int64_t idx) {
-    if (!m)
-        return NULL;
-    int64_t c = vmmap_Count(m);
-    if (idx < 1 || idx > c)
+valuecontent *vmmap_GetPair(
+        genericmap *m, int64_t idx, valuecontent **value
+        ) {
+    if (!m || idx < 1 || idx > vmmap_Count(m))
         return NULL;
-    if ((m->flags & GENERICMAP_FLAG_LINEAR) != 0) {
-        return &m->linear.key[idx];
-    }
-    int64_t cmp_idx = 0;
+    uint64_t pos = 0;
+    valuecontent *key;
+    valuecontent *v;
     int64_t i = 0;
-    while (i < m->hashed.bucket_count) {
-        genericmapbucket *bucket = &(
-            m->hashed.bucket[i]
-        );
-        if (cmp_idx + bucket->entry_count < idx) {
-            cmp_idx += bucket->entry_count;
-            i++;
-            continue;
-        }
-        int64_t k = 0;
-        while (k < bucket->entry_count) {
-            cmp_idx++;
-            if (cmp_idx == idx)
-                return &bucket->key[k];
-            k++;
-        }
+    while (vmmap_IterateNext(m, &pos, &key, &v)) {
         i++;
+        if (i == idx) {
+            if (value)
+                *value = v;
+            return key;
+        }
     }
     // This should be unreachable since we checked idx boundaries.
-    fprintf(stderr, "vmmap_GetKeyByIdx: corrupt map.");
+    fprintf(stderr, "vmmap_GetPair: corrupt map.");
     assert(0);
     return NULL;
 }
 
+valuecontent *vmmap_GetKeyByIdx(genericmap *m, int64_t idx) {
+    return vmmap_GetPair(m, idx, NULL);
+}
+
 int vmmap_Set(
         h64vmthread *vt,
         genericmap *m, valuecontent *key, valuecontent *value
@@ -311,114 +333,67 @@ int vmmap_Set(
         return 0;
     uint32_t hash = valuecontent_Hash(key);
     int inneroom = 0;
-    if (!vmmap_Remove(vt, m, key, &inneroom)) {
-        if (unlikely(inneroom)) {
-            return 0;
-        }
+    int64_t idx = _vmmap_FindSlot(vt, m, hash, key, &inneroom);
+    if (idx >= 0) {
+        // Keep the key we already hold, and only swap the value:
+        genericmapslot *s = &_vmmap_Slots(m)[idx];
+        valuecontent oldvalue;
+        memcpy(&oldvalue, &s->value, sizeof(oldvalue));
+        memcpy(&s->value, value, sizeof(*value));
+        ADDREF_HEAP(&s->value);
+        m->contentrevisionid++;
+        DELREF_HEAP(&oldvalue);
+        valuecontent_Free(vt, &oldvalue);
+        return 1;
     }
+    if (unlikely(inneroom))
+        return 0;
+
+    genericmapslot entry = {0};
+    entry.hash = hash;
+    memcpy(&entry.key, key, sizeof(*key));
+    memcpy(&entry.value, value, sizeof(*value));
     if ((m->flags & GENERICMAP_FLAG_LINEAR) != 0) {
-        int64_t c = vmmap_Count(m);
-        if (c + 1 < GENERICMAP_MIGRATE_HASHED) {
-            // Add to linear map:
-            if (c + 1 > m->linear.entry_alloc) {
-                int16_t new_alloc = (c + 1) * 2;
-                if (new_alloc < GENERICMAP_MIGRATE_HASHED)
+        if (m->linear.entry_count + 1 < GENERICMAP_MIGRATE_HASHED) {
+            if (m->linear.entry_count + 1 > m->linear.entry_alloc) {
+                int16_t new_alloc = m->linear.entry_alloc * 2;
+                if (new_alloc < 4)
+                    new_alloc = 4;
+                if (new_alloc > GENERICMAP_MIGRATE_HASHED)
                     new_alloc = GENERICMAP_MIGRATE_HASHED;
-                valuecontent *entries = realloc(
-                    m->linear.entry,
-                    sizeof(*m->linear.entry) * new_alloc
+                genericmapslot *new_slot = realloc(
+                    m->linear.slot,
+                    sizeof(*m->linear.slot) * new_alloc
                 );
-                if (!entries)
+                if (!new_slot)
                     return 0;
-                m->linear.entry = entries;
-                valuecontent *keys = realloc(
-                    m->linear.key,
-                    sizeof(*m->linear.key) * new_alloc
-                );
-                if (!keys)
-                    return 0;
-                m->linear.key = keys;
-                uint32_t *hashes = realloc(
-                    m->linear.entry_hash,
-                    sizeof(*m->linear.entry_hash) * new_alloc
-                );
-                if (!hashes)
-                    return 0;
-                m->linear.entry_hash = hashes;
+                m->linear.slot = new_slot;
                 m->linear.entry_alloc = new_alloc;
             }
-            m->linear.entry_hash[m->linear.entry_count] = hash;
-            memcpy(
-                &m->linear.key[m->linear.entry_count],
-                key, sizeof(*key)
-            );
-            ADDREF_HEAP(&m->linear.key[m->linear.entry_count]);
             memcpy(
-                &m->linear.entry[m->linear.entry_count],
-                value, sizeof(*value)
+                &m->linear.slot[m->linear.entry_count],
+                &entry, sizeof(entry)
             );
-            ADDREF_HEAP(&m->linear.entry[m->linear.entry_count]);
+            ADDREF_HEAP(key);
+            ADDREF_HEAP(value);
             m->linear.entry_count++;
             m->contentrevisionid++;
             return 1;
-        } else {
-            m->flags &= ~GENERICMAP_FLAG_LINEAR;
-            // Since linear space and bucket are a union,
-            // we need to create the bucket space separately and
-            // then copy it over:
-            genericmap m2 = {0};
-            m2.hashed.bucket_count = GENERICMAP_DEFAULT_BUCKETS;
-            m2.hashed.bucket = malloc(
-                sizeof(*m2.hashed.bucket) * m2.hashed.bucket_count
-            );
-            if (!m2.hashed.bucket)
-                return 0;
-            memset(
-                m2.hashed.bucket, 0,
-                sizeof(*m2.hashed.bucket) * m2.hashed.bucket_count
-            );
-            // Now, insert into our new buckets:
-            int i = 0;
-            while (i < m->linear.entry_count) {
-                uint32_t bucket = (
-                    m->linear.entry_hash[i] % m2.hashed.bucket_count
-                );
-                if (!_vmmap_AddToBucket(
-                        &m2.hashed.bucket[bucket],
-                        m->linear.entry_hash[i],
-                        &m->linear.key[i],
-                        &m->linear.entry[i])) {
-                    _vmmap_ClearBuckets(&m2, vt);
-                    free(m2.hashed.bucket);
-                    return 0;
-                }
-                i++;
-            }
-            // If it worked, free our old linear space:
-            free(m->linear.entry_hash);
-            i = 0;
-            while (i < m->linear.entry_count) {
-                DELREF_HEAP(&m->linear.key[i]);
-                valuecontent_Free(vt, &m->linear.key[i]);
-                DELREF_HEAP(&m->linear.entry[i]);
-                valuecontent_Free(vt, &m->linear.entry[i]);
-                i++;
-            }
-            free(m->linear.key);
-            free(m->linear.entry);
-            // Now copy in our bucket space:
-            memcpy(&m->hashed, &m2.hashed, sizeof(m2.hashed));
         }
+        if (!_vmmap_MigrateToHashed(m))
+            return 0;
     }
-    // If we arrive here, we need to add to regular buckets:
-    uint32_t bucket = (
-        hash % m->hashed.bucket_count
-    );
-    if (!_vmmap_AddToBucket(
-            &m->hashed.bucket[bucket],
-            hash, key, value)) {
-        return 0;
+    // Keep the load factor below 80%, growing geometrically:
+    if ((m->hashed.entry_count + 1) * 5 > m->hashed.slot_count * 4) {
+        if (!_vmmap_Rehash(m, m->hashed.slot_count * 2))
+            return 0;
     }
+    _vmmap_HashedInsertNew(
+        m->hashed.slot, (uint64_t)m->hashed.slot_count - 1, &entry
+    );
+    ADDREF_HEAP(key);
+    ADDREF_HEAP(value);
+    m->hashed.entry_count++;
     m->contentrevisionid++;
     return 1;
-}
\ No newline at end of file
+}
@@ -15,6 +15,8 @@
 
 genericmap *vmmap_New();
 
+void vmmap_Free(h64vmthread *vt, genericmap *m);
+
 ATTR_UNUSED static inline int64_t vmmap_Count(genericmap *m) {
     if ((m->flags & GENERICMAP_FLAG_LINEAR) != 0)
         return m->linear.entry_count;
@@ -26,6 +28,8 @@ ATTR_UNUSED static inline uint64_t vmmap_Revision(genericmap *l) {
 }
 
 valuecontent *vmmap_GetKeyByIdx(genericmap *l, int64_t idx);
+    // Index is 1-based, in iteration order. This is O(n), so
+    // prefer vmmap_IterateNext() for walking the whole map.
 
 int vmmap_Set(
     h64vmthread *vt,
@@ -50,6 +54,13 @@ valuecontent *vmmap_GetPair(
     genericmap *m, int64_t idx, valuecontent **value
 );
 
+int vmmap_IterateNext(
+    genericmap *m, uint64_t *pos,
+    valuecontent **key, valuecontent **value
+);  // Start with *pos = 0. Returns 1 and sets key and value if there
+    // was another pair, 0 once done. Any change of the map's revision
+    // invalidates the position.
+
 int vmmap_IteratePairs(
     genericmap *m, void *userdata,
     int (*cb)(void *udata, valuecontent *key, valuecontent *value)
@@ -0,0 +1,355 @@
+// Copyright (c) 2020-2021, ellie/@ell1e & Horse64 Team (see AUTHORS.md),
+// also see LICENSE.md file.
+// SPDX-License-Identifier: BSD-2-Clause
+
+#include "compileconfig.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bytecode.h"
+#include "datetime.h"
+#include "debugsymbols.h"
+#include "filesys32.h"
+#include "hash.h"
+#include "itemsort.h"
+#include "nonlocale.h"
+#include "threading.h"
+#include "vmexec.h"
+#include "vmprofile.h"
+#include "vmschedule.h"
+#include "widechar.h"
+
+// A sampling profiler: a separate thread flags every worker as due for
+// a sample at a fixed interval, and each worker then records its own
+// function frame stack the next time it calls, returns or jumps. This
+// way, nothing ever reads a funcframe array that might be reallocated
+// underneath, and a worker that is idle or stuck in a C function just
+// doesn't get sampled. Stacks are counted by their func ids, and only
+// resolved to names when writing the results.
+
+#define VMPROFILE_MAX_DEPTH 256
+
+typedef struct h64vmprofile {
+    h64program *pr;
+    h64vmworkerset *wset;
+    thread *sampler_thread;
+    _Atomic volatile int stop_signal;
+
+    mutex *lock;
+    hashmap *stack_counts;  // func id stack bytes -> sample count
+    int64_t samples_total, samples_dropped;
+} h64vmprofile;
+
+h64vmprofile *vmprofile_New(h64program *pr) {
+    h64vmprofile *prof = malloc(sizeof(*prof));
+    if (!prof)
+        return NULL;
+    memset(prof, 0, sizeof(*prof));
+    prof->pr = pr;
+    prof->lock = mutex_Create();
+    if (!prof->lock) {
+        free(prof);
+        return NULL;
+    }
+    prof->stack_counts = hash_NewBytesMap(1024);
+    if (!prof->stack_counts) {
+        mutex_Destroy(prof->lock);
+        free(prof);
+        return NULL;
+    }
+    return prof;
+}
+
+static void _vmprofile_SamplerRun(void *userdata) {
+    h64vmprofile *prof = (h64vmprofile *)userdata;
+    while (!prof->stop_signal) {
+        datetime_Sleep(VMPROFILE_INTERVAL_MS);
+        int i = 0;
+        while (i < prof->wset->worker_count) {
+            prof->wset->worker[i]->profile_sample_due = 1;
+            i++;
+        }
+    }
+}
+
+int vmprofile_Start(h64vmprofile *prof, h64vmworkerset *wset) {
+    assert(!prof->sampler_thread);
+    prof->wset = wset;
+    prof->stop_signal = 0;
+    prof->sampler_thread = thread_SpawnWithPriority(
+        THREAD_PRIO_HIGH, _vmprofile_SamplerRun, prof
+    );
+    return (prof->sampler_thread != NULL);
+}
+
+void vmprofile_Stop(h64vmprofile *prof) {
+    if (!prof->sampler_thread)
+        return;
+    prof->stop_signal = 1;
+    thread_Join(prof->sampler_thread);
+    prof->sampler_thread = NULL;
+}
+
+void vmprofile_RecordSample(
+        h64vmprofile *prof, h64vmthread *vmthread, int64_t func_id
+        ) {
+    // Collect func ids from outermost to innermost, and if the stack
+    // is too deep then keep the innermost part:
+    int32_t stack[VMPROFILE_MAX_DEPTH];
+    int depth = 0;
+    int i = vmthread->funcframe_count - VMPROFILE_MAX_DEPTH;
+    if (i < 0) i = 0;
+    while (i < vmthread->funcframe_count) {
+        stack[depth] = vmthread->funcframe[i].func_id;
+        depth++;
+        i++;
+    }
+    if (depth == 0 || stack[depth - 1] != func_id) {
+        if (depth == VMPROFILE_MAX_DEPTH) {
+            memmove(&stack[0], &stack[1],
+                sizeof(*stack) * (VMPROFILE_MAX_DEPTH - 1));
+            depth--;
+        }
+        stack[depth] = func_id;
+        depth++;
+    }
+
+    mutex_Lock(prof->lock);
+    uint64_t count = 0;
+    hash_BytesMapGet(
+        prof->stack_counts, (const char *)stack,
+        sizeof(*stack) * depth, &count
+    );
+    if (!hash_BytesMapSet(
+            prof->stack_counts, (const char *)stack,
+            sizeof(*stack) * depth, count + 1
+            ))
+        prof->samples_dropped++;
+    else
+        prof->samples_total++;
+    mutex_Release(prof->lock);
+}
+
+typedef struct _vmprofile_funcstats {
+    int64_t func_id;
+    int64_t self_samples, total_samples;
+    int64_t last_seen_stack;
+} _vmprofile_funcstats;
+
+typedef struct _vmprofile_writeinfo {
+    h64vmprofile *prof;
+    FILE *f;
+    char **funcname;
+    _vmprofile_funcstats *stats;
+    int64_t stack_no;
+    int writefailed;
+} _vmprofile_writeinfo;
+
+static char *_vmprofile_FuncName(h64program *pr, int64_t func_id) {
+    const char *modpath = NULL;
+    const char *classname = NULL;
+    const char *name = NULL;
+    if (pr->symbols) {
+        h64modulesymbols *msymbols = (
+            h64debugsymbols_GetModuleSymbolsByFuncId(
+                pr->symbols, func_id
+            )
+        );
+        if (msymbols)
+            modpath = msymbols->module_path;
+        h64funcsymbol *fsymbol = h64debugsymbols_GetFuncSymbolById(
+            pr->symbols, func_id
+        );
+        if (fsymbol)
+            name = fsymbol->name;
+        if (pr->func[func_id].associated_class_index >= 0) {
+            h64classsymbol *csymbol = h64debugsymbols_GetClassSymbolById(
+                pr->symbols, pr->func[func_id].associated_class_index
+            );
+            if (csymbol)
+                classname = csymbol->name;
+        }
+    }
+    char unnamed[64];
+    if (!name) {
+        h64snprintf(unnamed, sizeof(unnamed) - 1,
+            "<func %" PRId64 ">", func_id);
+        unnamed[sizeof(unnamed) - 1] = '\0';
+        name = unnamed;
+    }
+    size_t len = strlen(name) + 1;
+    if (modpath) len += strlen(modpath) + 1;
+    if (classname) len += strlen(classname) + 1;
+    char *result = malloc(len);
+    if (!result)
+        return NULL;
+    h64snprintf(result, len, "%s%s%s%s%s",
+        (modpath ? modpath : ""), (modpath ? "." : ""),
+        (classname ? classname : ""), (classname ? "." : ""),
+        name);
+    // Folded stack lines are split by ';' and ' ', so avoid these:
+    char *p = result;
+    while (*p) {
+        if (*p == ';' || *p == ' ')
+            *p = '_';
+        p++;
+    }
+    return result;
+}
+
+static int _vmprofile_WriteStackCb(
+        ATTR_UNUSED hashmap *map, const char *bytes,
+        uint64_t byteslen, uint64_t number,
+        void *userdata
+        ) {
+    _vmprofile_writeinfo *winfo = (_vmprofile_writeinfo *)userdata;
+    int64_t stack_no = winfo->stack_no;
+    winfo->stack_no++;
+    int depth = (int)(byteslen / sizeof(int32_t));
+    int i = 0;
+    while (i < depth) {
+        int32_t func_id;
+        memcpy(&func_id, bytes + i * sizeof(func_id), sizeof(func_id));
+        assert(func_id >= 0 && func_id < winfo->prof->pr->func_count);
+        _vmprofile_funcstats *stats = &winfo->stats[func_id];
+        if (stats->last_seen_stack != stack_no) {
+            // Count recursion only once towards the total:
+            stats->last_seen_stack = stack_no;
+            stats->total_samples += (int64_t)number;
+        }
+        if (i + 1 >= depth)
+            stats->self_samples += (int64_t)number;
+        if (h64fprintf(winfo->f, "%s%s", (i > 0 ? ";" : ""),
+                winfo->funcname[func_id]) < 0)
+            winfo->writefailed = 1;
+        i++;
+    }
+    if (h64fprintf(winfo->f, " %" PRIu64 "\n", number) < 0)
+        winfo->writefailed = 1;
+    return 1;
+}
+
+static int _vmprofile_CompareStats(void *item1, void *item2) {
+    _vmprofile_funcstats *s1 = (_vmprofile_funcstats *)item1;
+    _vmprofile_funcstats *s2 = (_vmprofile_funcstats *)item2;
+    if (s1->self_samples != s2->self_samples)
+        return (s1->self_samples > s2->self_samples ? -1 : 1);
+    if (s1->total_samples != s2->total_samples)
+        return (s1->total_samples > s2->total_samples ? -1 : 1);
+    if (s1->func_id != s2->func_id)
+        return (s1->func_id < s2->func_id ? -1 : 1);
+    return 0;
+}
+
+int vmprofile_WriteResults(
+        h64vmprofile *prof, const h64wchar *path, int64_t pathlen
+        ) {
+    h64program *pr = prof->pr;
+    _vmprofile_writeinfo winfo = {0};
+    winfo.prof = prof;
+    winfo.funcname = malloc(sizeof(*winfo.funcname) * pr->func_count);
+    winfo.stats = malloc(sizeof(*winfo.stats) * pr->func_count);
+    if (!winfo.funcname || !winfo.stats) {
+        free(winfo.funcname);
+        free(winfo.stats);
+        return 0;
+    }
+    memset(winfo.funcname, 0, sizeof(*winfo.funcname) * pr->func_count);
+    int64_t i = 0;
+    while (i < pr->func_count) {
+        winfo.stats[i].func_id = i;
+        winfo.stats[i].self_samples = 0;
+        winfo.stats[i].total_samples = 0;
+        winfo.stats[i].last_seen_stack = -1;
+        winfo.funcname[i] = _vmprofile_FuncName(pr, i);
+        if (!winfo.funcname[i])
+            goto failed;
+        i++;
+    }
+
+    int innererr = 0;
+    winfo.f = filesys32_OpenFromPath(path, pathlen, "wb", &innererr);
+    if (!winfo.f) {
+        failed: ;
+        i = 0;
+        while (i < pr->func_count) {
+            free(winfo.funcname[i]);
+            i++;
+        }
+        free(winfo.funcname);
+        free(winfo.stats);
+        return 0;
+    }
+    hash_BytesMapIterate(
+        prof->stack_counts, _vmprofile_WriteStackCb, &winfo
+    );
+    if (fclose(winfo.f) != 0)
+        winfo.writefailed = 1;
+    winfo.f = NULL;
+    if (winfo.writefailed)
+        goto failed;
+
+    // Print the per function table, heaviest self time first:
+    int oom = 0;
+    if (!itemsort_Do(
+            winfo.stats, sizeof(*winfo.stats) * pr->func_count,
+            sizeof(*winfo.stats), _vmprofile_CompareStats,
+            &oom, NULL
+            ))
+        goto failed;
+    int64_t total = prof->samples_total;
+    h64fprintf(
+        stderr, "horsevm: info: profile: %" PRId64 " samples "
+        "every %dms (%" PRId64 " dropped), folded stacks in %s\n",
+        total, (int)VMPROFILE_INTERVAL_MS, prof->samples_dropped,
+        AS_U8_TMP(path, pathlen)
+    );
+    h64fprintf(
+        stderr, "horsevm: info: profile: %9s %7s %9s %7s  %s\n",
+        "self ms", "self%", "total ms", "total%", "function"
+    );
+    i = 0;
+    while (i < pr->func_count) {
+        _vmprofile_funcstats *stats = &winfo.stats[i];
+        if (stats->total_samples <= 0) {
+            i++;
+            continue;
+        }
+        h64fprintf(
+            stderr, "horsevm: info: profile: %9" PRId64 " %6.1f%% "
+            "%9" PRId64 " %6.1f%%  %s\n",
+            stats->self_samples * VMPROFILE_INTERVAL_MS,
+            (total > 0 ?
+             (double)stats->self_samples * 100.0 / total : 0.0),
+            stats->total_samples * VMPROFILE_INTERVAL_MS,
+            (total > 0 ?
+             (double)stats->total_samples * 100.0 / total : 0.0),
+            winfo.funcname[stats->func_id]
+        );
+        i++;
+    }
+    i = 0;
+    while (i < pr->func_count) {
+        free(winfo.funcname[i]);
+        i++;
+    }
+    free(winfo.funcname);
+    free(winfo.stats);
+    return 1;
+}
+
+void vmprofile_Free(h64vmprofile *prof) {
+    if (!prof)
+        return;
+    vmprofile_Stop(prof);
+    if (prof->stack_counts)
+        hash_FreeMap(prof->stack_counts);
+    if (prof->lock)
+        mutex_Destroy(prof->lock);
+    free(prof);
+}
@@ -0,0 +1,42 @@
+// Copyright (c) 2020-2021, ellie/@ell1e & Horse64 Team (see AUTHORS.md),
+// also see LICENSE.md file.
+// SPDX-License-Identifier: BSD-2-Clause
+
+#ifndef HORSE64_VMPROFILE_H_
+#define HORSE64_VMPROFILE_H_
+
+#include "compileconfig.h"
+
+#include <stdint.h>
+
+#include "widechar.h"
+
+typedef struct h64program h64program;
+typedef struct h64vmthread h64vmthread;
+typedef struct h64vmworkerset h64vmworkerset;
+
+// How often the sampler asks each worker for a stack snapshot:
+#define VMPROFILE_INTERVAL_MS 1
+
+typedef struct h64vmprofile h64vmprofile;
+
+h64vmprofile *vmprofile_New(h64program *pr);
+
+int vmprofile_Start(h64vmprofile *prof, h64vmworkerset *wset);
+    // Spawns the sampler thread. Returns 0 on out of memory.
+
+void vmprofile_Stop(h64vmprofile *prof);
+
+void vmprofile_RecordSample(
+    h64vmprofile *prof, h64vmthread *vmthread, int64_t func_id
+);  // Called by a worker itself when its sample is due.
+
+int vmprofile_WriteResults(
+    h64vmprofile *prof, const h64wchar *path, int64_t pathlen
+);
+    // Writes folded stacks to the given file, and prints a table
+    // with self and total time per function to stderr.
+
+void vmprofile_Free(h64vmprofile *prof);
+
+#endif  // HORSE64_VMPROFILE_H_
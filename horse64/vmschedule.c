@@ -28,9 +28,13 @@
 #include "threading.h"
 #include "valuecontentstruct.h"
 #include "vmexec.h"
+#include "vmgc.h"
 #include "vmlist.h"
+#include "vmprofile.h"
 #include "vmschedule.h"
+#include "vmstats.h"
 #include "vmsuspendtypeenum.h"
+#include "widechar.h"
 
 
 static char _unexpectedlookupfail[] = "<unexpected lookup fail>";
@@ -228,6 +232,7 @@ void vmschedule_FreeWorkerSet(
                 thread_Join(wset->worker[i]->worker_thread);
                 wset->worker[i]->worker_thread = NULL;
             }
+            vmexec_FreeFramePool(wset->worker[i]->framepool);
             free(wset->worker[i]);
         }
         i++;
@@ -599,6 +604,11 @@ void vmschedule_WorkerRun(void *userdata) {
                 } else if (!hadsuspendevent && !haduncaughterror) {
                     worker->vmexec->program_return_value = rval;
                 }
+                // Collect cycles while the thread isn't running.
+                // (Out of memory is ignored, next slice retries.)
+                vmgc_CollectSlice(vt, VMGC_SLICE_BUDGET);
+                // Give back stack memory a past deep recursion left:
+                stack_Trim(vt->stack);
                 break;
             }
             i++;
@@ -925,6 +935,12 @@ int vmschedule_ExecuteProgram(
 
     assert(pr->main_func_index >= 0);
     memcpy(&mainexec->moptions, moptions, sizeof(*moptions));
+    if (!vmexec_PredecodeProgram(mainexec)) {
+        h64fprintf(stderr, "horsevm: error: vmschedule.c: "
+            "out of memory or invalid code when pre-decoding "
+            "bytecode during setup\n");
+        return -1;
+    }
 
     int asyncfd = _asyncjob_GetSupervisorWaitFD();
     if (asyncfd < 0) {
@@ -1033,6 +1049,21 @@ int vmschedule_ExecuteProgram(
         );
     }
 
+    // Launch sampling profiler if requested:
+    if (!threaderror && moptions->profile_output) {
+        mainexec->profile = vmprofile_New(pr);
+        if (!mainexec->profile ||
+                !vmprofile_Start(
+                    mainexec->profile, mainexec->worker_overview
+                )) {
+            threaderror = 1;
+            h64fprintf(
+                stderr, "horsevm: error: vmschedule.c: out of memory "
+                "starting profiler\n"
+            );
+        }
+    }
+
     // Launch supervisor thread:
     struct threadinfo *supervisor_thread = NULL;
     if (!threaderror)
@@ -1140,6 +1171,29 @@ int vmschedule_ExecuteProgram(
         }
         i++;
     }
+    if (mainexec->profile) {
+        vmprofile_Stop(mainexec->profile);
+        if (!vmprofile_WriteResults(
+                mainexec->profile, moptions->profile_output,
+                moptions->profile_output_len
+                ))
+            h64fprintf(
+                stderr, "horsevm: error: vmschedule.c: "
+                "failed to write profile to %s\n",
+                AS_U8_TMP(moptions->profile_output,
+                          moptions->profile_output_len)
+            );
+    }
+    if (moptions->vmstats_output &&
+            !vmstats_WriteJSON(
+                moptions->vmstats_output, moptions->vmstats_output_len
+            ))
+        h64fprintf(
+            stderr, "horsevm: error: vmschedule.c: "
+            "failed to write VM stats to %s\n",
+            AS_U8_TMP(moptions->vmstats_output,
+                      moptions->vmstats_output_len)
+        );
     mainexec->supervisor_stop_signal = 1;
     #ifndef NDEBUG
     if (moptions->vmscheduler_debug)
@@ -1195,6 +1249,34 @@ int vmschedule_ExecuteProgram(
             i++;
         }
     }
+    if (moptions->vmgc_stats) {
+        h64gcstats total = {0};
+        i = 0;
+        while (i < mainexec->thread_count) {
+            h64gcstats stats = {0};
+            vmgc_GetStats(mainexec->thread[i]->gc, &stats);
+            vmgc_AddStats(&total, &stats);
+            i++;
+        }
+        h64fprintf(
+            stderr, "horsevm: info: vmgc: slices: %" PRId64
+            ", passes: %" PRId64 ", trials: %" PRId64
+            " (%" PRId64 " aborted)\n",
+            total.slices_run, total.passes_completed,
+            total.trials_run, total.trials_aborted
+        );
+        h64fprintf(
+            stderr, "horsevm: info: vmgc: cycles found: %" PRId64
+            ", values freed: %" PRId64 ", bytes freed: %" PRId64 "\n",
+            total.cycles_found, total.values_freed, total.bytes_freed
+        );
+        h64fprintf(
+            stderr, "horsevm: info: vmgc: pause total: %" PRId64
+            "us, max: %" PRId64 "us, last: %" PRId64 "us\n",
+            total.total_pause_us, total.max_pause_us,
+            total.last_pause_us
+        );
+    }
     // Clean up everything:
     if (threaderror && mainexec->program_return_value == 0)
         mainexec->program_return_value = -1;
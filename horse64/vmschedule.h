@@ -17,6 +17,7 @@
 typedef struct h64vmexec h64vmexec;
 typedef struct h64vmthread h64vmthread;
 typedef struct h64misccompileroptions h64misccompileroptions;
+typedef struct h64vmframepool h64vmframepool;
 
 #include "vmsuspendtypeenum.h"
 
@@ -57,6 +58,8 @@ typedef struct h64vmworker {
     h64vmexec *vmexec;
     threadevent *wakeupevent;
     h64misccompileroptions *moptions;
+    h64vmframepool *framepool;  // allocated on first use
+    _Atomic volatile int profile_sample_due;  // set by vmprofile.c
 } h64vmworker;
 
 typedef struct h64vmworkerset {
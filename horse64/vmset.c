@@ -0,0 +1,239 @@
+// Copyright (c) 2020-2021, ellie/@ell1e & Horse64 Team (see AUTHORS.md),
+// also see LICENSE.md file.
+// SPDX-License-Identifier: BSD-2-Clause
+
+#include "compileconfig.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bytecode.h"
+#include "valuecontentstruct.h"
+#include "vmcontainerstruct.h"
+#include "vmset.h"
+
+// Hashable values live in an open addressing table with linear probing,
+// with the hash cached next to each value so a miss rarely needs to look
+// at the value itself. Mutable values can't keep a stable hash, so like
+// map keys they can't be added at all.
+
+#define GENERICSET_MINSLOTS 16
+
+
+genericset *vmset_New() {
+    genericset *s = malloc(sizeof(*s));
+    if (!s)
+        return NULL;
+    memset(s, 0, sizeof(*s));
+    return s;
+}
+
+void vmset_Free(h64vmthread *vt, genericset *s) {
+    if (!s)
+        return;
+    int64_t i = 0;
+    while (i < s->slot_count) {
+        if (s->slot[i].state == GENERICSET_SLOT_USED) {
+            DELREF_HEAP(&s->slot[i].value);
+            valuecontent_Free(vt, &s->slot[i].value);
+        }
+        i++;
+    }
+    free(s->slot);
+    free(s);
+}
+
+static int64_t _vmset_FindSlot(
+        h64vmthread *vt, genericset *s, uint32_t hash,
+        valuecontent *v, int *oom
+        ) {
+    *oom = 0;
+    if (s->slot_count == 0)
+        return -1;
+    const uint64_t mask = (uint64_t)s->slot_count - 1;
+    uint64_t i = hash & mask;
+    while (1) {
+        genericsetentry *e = &s->slot[i];
+        if (e->state == GENERICSET_SLOT_EMPTY)
+            return -1;
+        if (e->state == GENERICSET_SLOT_USED && e->hash == hash) {
+            int inneroom = 0;
+            if (likely(valuecontent_CheckEquality(
+                    vt, v, &e->value, &inneroom)))
+                return (int64_t)i;
+            if (unlikely(inneroom)) {
+                *oom = 1;
+                return -1;
+            }
+        }
+        i = (i + 1) & mask;
+    }
+}
+
+static int _vmset_Rehash(genericset *s, int64_t new_slot_count) {
+    assert(new_slot_count >= GENERICSET_MINSLOTS &&
+           (new_slot_count & (new_slot_count - 1)) == 0);
+    genericsetentry *new_slot = malloc(
+        sizeof(*new_slot) * new_slot_count
+    );
+    if (!new_slot)
+        return 0;
+    memset(new_slot, 0, sizeof(*new_slot) * new_slot_count);
+    const uint64_t mask = (uint64_t)new_slot_count - 1;
+    int64_t i = 0;
+    while (i < s->slot_count) {
+        if (s->slot[i].state == GENERICSET_SLOT_USED) {
+            uint64_t k = s->slot[i].hash & mask;
+            while (new_slot[k].state != GENERICSET_SLOT_EMPTY)
+                k = (k + 1) & mask;
+            memcpy(&new_slot[k], &s->slot[i], sizeof(*new_slot));
+        }
+        i++;
+    }
+    free(s->slot);
+    s->slot = new_slot;
+    s->slot_count = new_slot_count;
+    s->deleted_count = 0;
+    return 1;
+}
+
+int vmset_Contains(
+        h64vmthread *vt, genericset *s, valuecontent *v, int *oom
+        ) {
+    if (unlikely(valuecontent_IsMutable(v))) {
+        *oom = 0;
+        return 0;  // can't be in a set
+    }
+    return (_vmset_FindSlot(
+        vt, s, valuecontent_Hash(v), v, oom
+    ) >= 0);
+}
+
+int vmset_Add(
+        h64vmthread *vt, genericset *s, valuecontent *v
+        ) {
+    assert(!valuecontent_IsMutable(v));
+    int inneroom = 0;
+    uint32_t hash = valuecontent_Hash(v);
+    if (_vmset_FindSlot(vt, s, hash, v, &inneroom) >= 0)
+        return 1;
+    if (inneroom)
+        return 0;
+
+    // Keep load including deleted slots below 70%:
+    if ((s->entry_count + s->deleted_count + 1) * 10 >
+            s->slot_count * 7) {
+        int64_t new_count = (
+            s->slot_count < GENERICSET_MINSLOTS ?
+            GENERICSET_MINSLOTS : s->slot_count
+        );
+        while ((s->entry_count + 1) * 10 > new_count * 5)
+            new_count *= 2;
+        if (!_vmset_Rehash(s, new_count))
+            return 0;
+    }
+    const uint64_t mask = (uint64_t)s->slot_count - 1;
+    uint64_t i = hash & mask;
+    while (s->slot[i].state == GENERICSET_SLOT_USED)
+        i = (i + 1) & mask;
+    if (s->slot[i].state == GENERICSET_SLOT_DELETED)
+        s->deleted_count--;
+    s->slot[i].hash = hash;
+    s->slot[i].state = GENERICSET_SLOT_USED;
+    memcpy(&s->slot[i].value, v, sizeof(*v));
+    ADDREF_HEAP(&s->slot[i].value);
+    s->entry_count++;
+    s->contentrevisionid++;
+    return 1;
+}
+
+int vmset_Remove(
+        h64vmthread *vt, genericset *s, valuecontent *v, int *oom
+        ) {
+    if (unlikely(valuecontent_IsMutable(v))) {
+        *oom = 0;
+        return 0;  // can't be in a set
+    }
+    int64_t idx = _vmset_FindSlot(
+        vt, s, valuecontent_Hash(v), v, oom
+    );
+    if (idx < 0)
+        return 0;
+    genericsetentry *e = &s->slot[idx];
+    DELREF_HEAP(&e->value);
+    valuecontent_Free(vt, &e->value);
+    memset(&e->value, 0, sizeof(e->value));
+    // If the probe chain ends right after, no tombstone is needed:
+    if (s->slot[(idx + 1) & (s->slot_count - 1)].state ==
+            GENERICSET_SLOT_EMPTY) {
+        e->state = GENERICSET_SLOT_EMPTY;
+    } else {
+        e->state = GENERICSET_SLOT_DELETED;
+        s->deleted_count++;
+    }
+    s->entry_count--;
+    s->contentrevisionid++;
+    return 1;
+}
+
+valuecontent *vmset_IterateNext(genericset *s, uint64_t *pos) {
+    while (*pos < (uint64_t)s->slot_count) {
+        genericsetentry *e = &s->slot[*pos];
+        (*pos)++;
+        if (e->state == GENERICSET_SLOT_USED)
+            return &e->value;
+    }
+    return NULL;
+}
+
+int vmset_IterateValues(
+        genericset *s, void *userdata,
+        int (*cb)(void *udata, valuecontent *value)
+        ) {
+    uint64_t pos = 0;
+    valuecontent *v;
+    while ((v = vmset_IterateNext(s, &pos)) != NULL) {
+        if (!cb(userdata, v))
+            return 0;
+    }
+    return 1;
+}
+
+int vmset_AddAll(
+        h64vmthread *vt, genericset *s, genericset *other
+        ) {
+    if (s == other)
+        return 1;
+    uint64_t pos = 0;
+    valuecontent *v;
+    while ((v = vmset_IterateNext(other, &pos)) != NULL) {
+        if (!vmset_Add(vt, s, v))
+            return 0;
+    }
+    return 1;
+}
+
+int vmset_AddIntersection(
+        h64vmthread *vt, genericset *s, genericset *a, genericset *b
+        ) {
+    // Walk the smaller one, and look up in the larger one:
+    if (vmset_Count(a) > vmset_Count(b)) {
+        genericset *swap = a;
+        a = b;
+        b = swap;
+    }
+    uint64_t pos = 0;
+    valuecontent *v;
+    while ((v = vmset_IterateNext(a, &pos)) != NULL) {
+        int inneroom = 0;
+        if (vmset_Contains(vt, b, v, &inneroom)) {
+            if (!vmset_Add(vt, s, v))
+                return 0;
+        } else if (inneroom) {
+            return 0;
+        }
+    }
+    return 1;
+}
@@ -11,6 +11,47 @@
 #include <stdio.h>
 
 #include "bytecode.h"
+#include "vmcontainerstruct.h"
 
+genericset *vmset_New();
+
+void vmset_Free(h64vmthread *vt, genericset *s);
+
+ATTR_UNUSED static inline int64_t vmset_Count(genericset *s) {
+    return s->entry_count;
+}
+
+ATTR_UNUSED static inline uint64_t vmset_Revision(genericset *s) {
+    return s->contentrevisionid;
+}
+
+int vmset_Add(
+    h64vmthread *vt, genericset *s, valuecontent *v
+);  // return value: 1 = ok (also if already present), 0 = oom.
+    // Like map keys, v must not be mutable (see valuecontent_IsMutable).
+
+int vmset_Remove(
+    h64vmthread *vt, genericset *s, valuecontent *v, int *oom
+);
+
+int vmset_Contains(
+    h64vmthread *vt, genericset *s, valuecontent *v, int *oom
+);
+
+valuecontent *vmset_IterateNext(genericset *s, uint64_t *pos);
+    // Start with *pos = 0, returns NULL once past the last value.
+
+int vmset_IterateValues(
+    genericset *s, void *userdata,
+    int (*cb)(void *udata, valuecontent *value)
+);
+
+int vmset_AddAll(
+    h64vmthread *vt, genericset *s, genericset *other
+);  // union into s, return value: 1 = ok, 0 = oom
+
+int vmset_AddIntersection(
+    h64vmthread *vt, genericset *s, genericset *a, genericset *b
+);  // adds values in both a and b to s, return value: 1 = ok, 0 = oom
 
 #endif  // HORSE64_VMSET_H_
@@ -0,0 +1,121 @@
+// Copyright (c) 2020-2021, ellie/@ell1e & Horse64 Team (see AUTHORS.md),
+// also see LICENSE.md file.
+// SPDX-License-Identifier: BSD-2-Clause
+
+#include "compileconfig.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bytecode.h"
+#include "compiler/operator.h"
+#include "filesys32.h"
+#include "json.h"
+#include "vmstats.h"
+#include "widechar.h"
+
+#if defined(H64VM_STATS)
+h64vmstats vmstats = {0};
+
+static int _vmstats_SetDictDict(
+        jsonvalue *dict, const char *key, jsonvalue *value
+        ) {
+    if (!json_SetDict(dict, key, value)) {
+        json_Free(value);
+        return 0;
+    }
+    return 1;
+}
+
+static jsonvalue *_vmstats_ToJSON() {
+    jsonvalue *result = json_Dict();
+    if (!result)
+        return NULL;
+
+    jsonvalue *insts = json_Dict();
+    if (!insts || !_vmstats_SetDictDict(result, "instructions", insts))
+        goto failed;
+    int i = 0;
+    while (i < H64INST_TOTAL_COUNT) {
+        int64_t count = vmstats.inst_count[i];
+        if (count > 0 && !json_SetDictInt(
+                insts, bytecode_InstructionTypeToStr(i), count))
+            goto failed;
+        i++;
+    }
+
+    jsonvalue *binops = json_Dict();
+    if (!binops || !_vmstats_SetDictDict(result, "binops", binops))
+        goto failed;
+    i = 0;
+    while (i < TOTAL_OP_COUNT) {
+        int64_t count = vmstats.binop_count[i];
+        if (count <= 0) {
+            i++;
+            continue;
+        }
+        jsonvalue *binop = json_Dict();
+        if (!binop || !_vmstats_SetDictDict(
+                binops, operator_OpPrintedAsStr(i), binop))
+            goto failed;
+        if (!json_SetDictInt(binop, "count", count) ||
+                !json_SetDictInt(binop, "type-misses",
+                    vmstats.binop_typemiss_count[i]))
+            goto failed;
+        i++;
+    }
+
+    if (!json_SetDictInt(result, "superinstruction-fallbacks",
+                vmstats.superinst_fallback_count) ||
+            !json_SetDictInt(result, "specialized-binop-deopts",
+                vmstats.specializedbinop_deopt_count) ||
+            !json_SetDictInt(result, "quickened-instructions",
+                vmstats.quicken_count) ||
+            !json_SetDictInt(result, "quicken-reverts",
+                vmstats.quicken_revert_count) ||
+            !json_SetDictInt(result, "attribute-cache-misses",
+                vmstats.attrcache_miss_count) ||
+            !json_SetDictInt(result, "stack-reallocs",
+                vmstats.stack_realloc_count) ||
+            !json_SetDictInt(result, "poolalloc-areas-added",
+                vmstats.poolalloc_area_count) ||
+            !json_SetDictInt(result, "asyncjobs-queued",
+                vmstats.asyncjob_queued_count) ||
+            !json_SetDictInt(result, "asyncjob-queue-depth-max",
+                vmstats.asyncjob_queue_depth_max))
+        goto failed;
+    return result;
+
+    failed:
+    json_Free(result);
+    return NULL;
+}
+#else
+static jsonvalue *_vmstats_ToJSON() {
+    return json_Dict();
+}
+#endif
+
+int vmstats_WriteJSON(const h64wchar *path, int64_t pathlen) {
+    jsonvalue *v = _vmstats_ToJSON();
+    if (!v)
+        return 0;
+    char *s = json_Dump(v);
+    json_Free(v);
+    if (!s)
+        return 0;
+    int innererr = 0;
+    FILE *f = filesys32_OpenFromPath(path, pathlen, "wb", &innererr);
+    if (!f) {
+        free(s);
+        return 0;
+    }
+    size_t len = strlen(s);
+    int result = (fwrite(s, 1, len, f) == len);
+    free(s);
+    if (fclose(f) != 0)
+        result = 0;
+    return result;
+}
@@ -0,0 +1,58 @@
+// Copyright (c) 2020-2021, ellie/@ell1e & Horse64 Team (see AUTHORS.md),
+// also see LICENSE.md file.
+// SPDX-License-Identifier: BSD-2-Clause
+
+#ifndef HORSE64_VMSTATS_H_
+#define HORSE64_VMSTATS_H_
+
+#include "compileconfig.h"
+
+#include <stdint.h>
+
+#include "bytecode.h"
+#include "compiler/operator.h"
+#include "widechar.h"
+
+// Execution counters for tuning the VM. These are only compiled in
+// with -DH64VM_STATS (make VMSTATS=true), since counting every single
+// instruction isn't free:
+#if defined(H64VM_STATS)
+
+typedef struct h64vmstats {
+    _Atomic volatile int64_t inst_count[H64INST_TOTAL_COUNT];
+    _Atomic volatile int64_t binop_count[TOTAL_OP_COUNT];
+    _Atomic volatile int64_t binop_typemiss_count[TOTAL_OP_COUNT];
+        // ^ operands weren't both ints, so no fast path applied
+    _Atomic volatile int64_t superinst_fallback_count;
+    _Atomic volatile int64_t specializedbinop_deopt_count;
+    _Atomic volatile int64_t quicken_count;
+    _Atomic volatile int64_t quicken_revert_count;
+    _Atomic volatile int64_t attrcache_miss_count;
+    _Atomic volatile int64_t stack_realloc_count;
+    _Atomic volatile int64_t poolalloc_area_count;
+    _Atomic volatile int64_t asyncjob_queued_count;
+    int64_t asyncjob_queue_depth_max;  // only set with schedule lock
+} h64vmstats;
+
+extern h64vmstats vmstats;
+
+#define VMSTATS_INC(field) (vmstats.field++)
+#define VMSTATS_INCIDX(field, idx) (vmstats.field[idx]++)
+#define VMSTATS_MAX(field, value) do { \
+    if ((int64_t)(value) > vmstats.field) \
+        vmstats.field = (value); \
+    } while (0)
+
+#else
+
+#define VMSTATS_INC(field)
+#define VMSTATS_INCIDX(field, idx)
+#define VMSTATS_MAX(field, value) ((void)0)
+
+#endif
+
+int vmstats_WriteJSON(const h64wchar *path, int64_t pathlen);
+    // Returns 0 on I/O error or out of memory. If built without
+    // H64VM_STATS, this writes an empty object.
+
+#endif  // HORSE64_VMSTATS_H_
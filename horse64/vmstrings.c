@@ -17,6 +17,68 @@
 #define POOLEDSTRSIZE 64
 
 
+static void _vmstrings_BuildLetterIndex(h64stringval *v) {
+    assert(!v->letterindex);
+    int64_t *index = malloc(
+        sizeof(*index) * (v->len / VMSTRINGS_LETTERINDEX_STEP + 1)
+    );
+    if (!index)
+        return;
+    int64_t letters = 0;
+    int64_t offset = 0;
+    while (offset < (int64_t)v->len) {
+        if (letters % VMSTRINGS_LETTERINDEX_STEP == 0)
+            index[letters / VMSTRINGS_LETTERINDEX_STEP] = offset;
+        offset += utf32_letter_len(v->s + offset, v->len - offset);
+        letters++;
+    }
+    assert(v->letterlen == 0 || v->letterlen == (uint64_t)letters);
+    v->letterlen = letters;
+    if (v->letterlen == v->len) {
+        // Every letter is a single code point, no index needed.
+        free(index);
+        return;
+    }
+    int64_t entries = (
+        (letters + VMSTRINGS_LETTERINDEX_STEP - 1) /
+        VMSTRINGS_LETTERINDEX_STEP
+    );
+    int64_t *shrunkindex = realloc(index, sizeof(*index) * entries);
+    if (shrunkindex)
+        index = shrunkindex;
+    v->letterindex = index;
+}
+
+int64_t vmstrings_LetterToCodepointOffset(
+        h64stringval *v, int64_t letteridx
+        ) {
+    assert(letteridx >= 0);
+    if (v->len >= VMSTRINGS_LETTERINDEX_MINLEN && !v->letterindex &&
+            v->letterlen != v->len)
+        _vmstrings_BuildLetterIndex(v);
+    if (v->letterlen == v->len) {
+        // Every letter is a single code point:
+        return (letteridx < (int64_t)v->len ? letteridx : (int64_t)v->len);
+    }
+    int64_t offset = 0;
+    int64_t k = 0;
+    if (v->letterindex) {
+        int64_t slot = letteridx / VMSTRINGS_LETTERINDEX_STEP;
+        int64_t lastslot = (
+            ((int64_t)v->letterlen - 1) / VMSTRINGS_LETTERINDEX_STEP
+        );
+        if (slot > lastslot)
+            slot = lastslot;
+        offset = v->letterindex[slot];
+        k = slot * VMSTRINGS_LETTERINDEX_STEP;
+    }
+    while (k < letteridx && offset < (int64_t)v->len) {
+        offset += utf32_letter_len(v->s + offset, v->len - offset);
+        k++;
+    }
+    return offset;
+}
+
 int vmstrings_Equality(
         valuecontent *v1, valuecontent *v2
         ) {
@@ -72,12 +134,15 @@ int vmstrings_AllocBuffer(
         v->s = malloc(sizeof(h64wchar) * len);
     }
     v->len = len;
+    v->letterindex = NULL;
     return (v->s != NULL);
 }
 
 void vmstrings_Free(h64vmthread *vthread, h64stringval *v) {
     if (!vthread || !v)
         return;
+    free(v->letterindex);
+    v->letterindex = NULL;
     if (v->len * sizeof(h64wchar) <= POOLEDSTRSIZE) {
         poolalloc_free(vthread->str_pile, v->s);
     } else {
@@ -86,6 +151,25 @@ void vmstrings_Free(h64vmthread *vthread, h64stringval *v) {
     v->len = 0;
 }
 
+int vmbytes_GetBuffer(
+        valuecontent *v, char **s, int64_t *slen
+        ) {
+    if (v->type == H64VALTYPE_SHORTBYTES) {
+        *s = (char*) v->shortbytes_value;
+        *slen = v->shortbytes_len;
+    } else if (v->type == H64VALTYPE_CONSTPREALLOCBYTES) {
+        *s = (char*) v->constpreallocbytes_value;
+        *slen = v->constpreallocbytes_len;
+    } else if (v->type == H64VALTYPE_GCVAL &&
+            ((h64gcvalue*)v->ptr_value)->type == H64GCVALUETYPE_BYTES) {
+        *s = (char*) ((h64gcvalue*)v->ptr_value)->bytes_val.s;
+        *slen = ((h64gcvalue*)v->ptr_value)->bytes_val.len;
+    } else {
+        return 0;
+    }
+    return 1;
+}
+
 int vmbytes_Equality(
         valuecontent *v1, valuecontent *v2
         ) {
@@ -93,29 +177,8 @@ int vmbytes_Equality(
     char *s2v = NULL;
     int64_t s1l = 0;
     int64_t s2l = 0;
-    if (v1->type == H64VALTYPE_SHORTBYTES) {
-        s1v = (char*) v1->shortbytes_value;
-        s1l = v1->shortbytes_len;
-    } else if (v1->type == H64VALTYPE_CONSTPREALLOCBYTES) {
-        s1v = (char*) v1->constpreallocbytes_value;
-        s1l = v1->constpreallocbytes_len;
-    } else if (v1->type == H64VALTYPE_GCVAL &&
-            ((h64gcvalue*)v1->ptr_value)->type == H64GCVALUETYPE_BYTES) {
-        s1v = (char*) ((h64gcvalue*)v1->ptr_value)->bytes_val.s;
-        s1l = ((h64gcvalue*)v1->ptr_value)->bytes_val.len;
-    }
-    if (v2->type == H64VALTYPE_SHORTBYTES) {
-        s2v = (char*) v2->shortbytes_value;
-        s2l = v2->shortbytes_len;
-    } else if (v2->type == H64VALTYPE_CONSTPREALLOCBYTES) {
-        s2v = (char*) v2->constpreallocbytes_value;
-        s2l = v2->constpreallocbytes_len;
-    } else if (v2->type == H64VALTYPE_GCVAL &&
-            ((h64gcvalue*)v2->ptr_value)->type == H64GCVALUETYPE_BYTES) {
-        s2v = (char*) ((h64gcvalue*)v2->ptr_value)->bytes_val.s;
-        s2l = ((h64gcvalue*)v2->ptr_value)->bytes_val.len;
-    }
-    if (!s1v || !s2v || s1l != s2l)
+    if (!vmbytes_GetBuffer(v1, &s1v, &s1l) ||
+            !vmbytes_GetBuffer(v2, &s2v, &s2l) || s1l != s2l)
         return 0;
     return (memcmp(s1v, s2v, s1l) == 0);
 }
@@ -30,6 +30,21 @@ ATTR_UNUSED static inline void vmstrings_RequireLetterLen(
     }
 }
 
+// Long strings get a sparse index with the code point offset of every
+// VMSTRINGS_LETTERINDEX_STEP-th letter, so that going to a letter
+// doesn't need to segment the entire string before it every time:
+#define VMSTRINGS_LETTERINDEX_STEP 64
+#define VMSTRINGS_LETTERINDEX_MINLEN 256
+
+int64_t vmstrings_LetterToCodepointOffset(
+    h64stringval *v, int64_t letteridx
+);
+    // Returns the code point offset where the letter at the given
+    // zero-based letter index starts, or v->len if it is past the end.
+    // If every letter is a single code point, this needs no walking
+    // at all. Otherwise the letter index gets built on first use, or
+    // if that fails due to out of memory, this walks from the start.
+
 int vmstrings_Equality(
     valuecontent *v1, valuecontent *v2
 );
@@ -38,6 +53,9 @@ int vmbytes_Equality(
     valuecontent *v1, valuecontent *v2
 );
 
+int vmbytes_GetBuffer(valuecontent *v, char **s, int64_t *slen);
+    // Returns 0 if v isn't a bytes value of any kind.
+
 int vmstrings_AllocBuffer(
     h64vmthread *vthread, h64stringval *v, uint64_t len
 );
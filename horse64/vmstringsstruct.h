@@ -13,6 +13,8 @@ typedef struct h64stringval {
     h64wchar *s;
     uint64_t len, letterlen;
     int refcount;
+    int64_t *letterindex;
+        // ^ lazily built, see vmstrings_LetterToCodepointOffset()
 } h64stringval;
 
 typedef struct h64bytesval {
@@ -0,0 +1,955 @@
+// Copyright (c) 2020-2021, ellie/@ell1e & Horse64 Team (see AUTHORS.md),
+// also see LICENSE.md file.
+// SPDX-License-Identifier: BSD-2-Clause
+
+#include "compileconfig.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(USE_SSE_KERNELS) && defined(__GNUC__) && ( \
+    defined(__x86_64__) || defined(__i386__))
+#define VMVECTOR_X86
+#include <immintrin.h>
+#endif
+
+#include "bytecode.h"
+#include "valuecontentstruct.h"
+#include "vmcontainerstruct.h"
+#include "vmvector.h"
+
+// Vectors are packed & homogeneous: all values are either int64 or
+// float64 in one contiguous array, so the elementwise ops and the
+// reductions below can run over them with SIMD. The x86 kernels are
+// built with per-function target attributes and picked at runtime,
+// so a generic build still uses AVX2 when the CPU has it.
+
+typedef struct vmvectorkernels {
+    const char *name;
+    void (*op_f64[4])(
+        const double *a, const double *b, double *out, int64_t n
+    );  // indexed by vmvectorop
+    int (*add_i64)(
+        const int64_t *a, const int64_t *b, int64_t *out, int64_t n
+    );  // return value: 1 = ok, 0 = overflow
+    int (*sub_i64)(
+        const int64_t *a, const int64_t *b, int64_t *out, int64_t n
+    );  // return value: 1 = ok, 0 = overflow
+    double (*dot_f64)(const double *a, const double *b, int64_t n);
+    double (*sum_f64)(const double *a, int64_t n);
+    double (*min_f64)(const double *a, int64_t n);
+    double (*max_f64)(const double *a, int64_t n);
+    int64_t (*min_i64)(const int64_t *a, int64_t n);
+    int64_t (*max_i64)(const int64_t *a, int64_t n);
+} vmvectorkernels;
+
+// ---- Scalar kernels, used as fallback and for all loop tails ----
+
+static void _scalar_add_f64(
+        const double *a, const double *b, double *out, int64_t n
+        ) {
+    int64_t i = 0;
+    while (i < n) {
+        out[i] = a[i] + b[i];
+        i++;
+    }
+}
+
+static void _scalar_sub_f64(
+        const double *a, const double *b, double *out, int64_t n
+        ) {
+    int64_t i = 0;
+    while (i < n) {
+        out[i] = a[i] - b[i];
+        i++;
+    }
+}
+
+static void _scalar_mul_f64(
+        const double *a, const double *b, double *out, int64_t n
+        ) {
+    int64_t i = 0;
+    while (i < n) {
+        out[i] = a[i] * b[i];
+        i++;
+    }
+}
+
+static void _scalar_div_f64(
+        const double *a, const double *b, double *out, int64_t n
+        ) {
+    int64_t i = 0;
+    while (i < n) {
+        out[i] = a[i] / b[i];
+        i++;
+    }
+}
+
+static int _scalar_add_i64(
+        const int64_t *a, const int64_t *b, int64_t *out, int64_t n
+        ) {
+    int overflow = 0;
+    int64_t i = 0;
+    while (i < n) {
+        overflow |= __builtin_add_overflow(a[i], b[i], &out[i]);
+        i++;
+    }
+    return !overflow;
+}
+
+static int _scalar_sub_i64(
+        const int64_t *a, const int64_t *b, int64_t *out, int64_t n
+        ) {
+    int overflow = 0;
+    int64_t i = 0;
+    while (i < n) {
+        overflow |= __builtin_sub_overflow(a[i], b[i], &out[i]);
+        i++;
+    }
+    return !overflow;
+}
+
+static double _scalar_dot_f64(
+        const double *a, const double *b, int64_t n
+        ) {
+    double result = 0;
+    int64_t i = 0;
+    while (i < n) {
+        result += a[i] * b[i];
+        i++;
+    }
+    return result;
+}
+
+static double _scalar_sum_f64(const double *a, int64_t n) {
+    double result = 0;
+    int64_t i = 0;
+    while (i < n) {
+        result += a[i];
+        i++;
+    }
+    return result;
+}
+
+static double _scalar_min_f64(const double *a, int64_t n) {
+    assert(n > 0);
+    double result = a[0];
+    int64_t i = 1;
+    while (i < n) {
+        if (a[i] < result)
+            result = a[i];
+        i++;
+    }
+    return result;
+}
+
+static double _scalar_max_f64(const double *a, int64_t n) {
+    assert(n > 0);
+    double result = a[0];
+    int64_t i = 1;
+    while (i < n) {
+        if (a[i] > result)
+            result = a[i];
+        i++;
+    }
+    return result;
+}
+
+static int64_t _scalar_min_i64(const int64_t *a, int64_t n) {
+    assert(n > 0);
+    int64_t result = a[0];
+    int64_t i = 1;
+    while (i < n) {
+        if (a[i] < result)
+            result = a[i];
+        i++;
+    }
+    return result;
+}
+
+static int64_t _scalar_max_i64(const int64_t *a, int64_t n) {
+    assert(n > 0);
+    int64_t result = a[0];
+    int64_t i = 1;
+    while (i < n) {
+        if (a[i] > result)
+            result = a[i];
+        i++;
+    }
+    return result;
+}
+
+static const vmvectorkernels _vmvector_scalarkernels = {
+    "scalar",
+    {_scalar_add_f64, _scalar_sub_f64, _scalar_mul_f64, _scalar_div_f64},
+    _scalar_add_i64, _scalar_sub_i64,
+    _scalar_dot_f64, _scalar_sum_f64,
+    _scalar_min_f64, _scalar_max_f64,
+    _scalar_min_i64, _scalar_max_i64
+};
+
+#if defined(VMVECTOR_X86)
+// ---- SSE2 kernels, 2 lanes ----
+
+#define SSE2_ATTR __attribute__((target("sse2")))
+
+#define SSE2_F64OP(opname, intrin) \
+SSE2_ATTR static void _sse2_##opname##_f64( \
+        const double *a, const double *b, double *out, int64_t n \
+        ) { \
+    int64_t i = 0; \
+    while (i + 2 <= n) { \
+        _mm_storeu_pd(out + i, intrin( \
+            _mm_loadu_pd(a + i), _mm_loadu_pd(b + i) \
+        )); \
+        i += 2; \
+    } \
+    _scalar_##opname##_f64(a + i, b + i, out + i, n - i); \
+}
+
+SSE2_F64OP(add, _mm_add_pd)
+SSE2_F64OP(sub, _mm_sub_pd)
+SSE2_F64OP(mul, _mm_mul_pd)
+SSE2_F64OP(div, _mm_div_pd)
+
+SSE2_ATTR static int _sse2_add_i64(
+        const int64_t *a, const int64_t *b, int64_t *out, int64_t n
+        ) {
+    // Signed overflow iff both inputs differ in sign from the result:
+    __m128i overflow = _mm_setzero_si128();
+    int64_t i = 0;
+    while (i + 2 <= n) {
+        __m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+        __m128i r = _mm_add_epi64(va, vb);
+        overflow = _mm_or_si128(overflow, _mm_and_si128(
+            _mm_xor_si128(va, r), _mm_xor_si128(vb, r)
+        ));
+        _mm_storeu_si128((__m128i *)(out + i), r);
+        i += 2;
+    }
+    if (_mm_movemask_pd(_mm_castsi128_pd(overflow)) != 0)
+        return 0;
+    return _scalar_add_i64(a + i, b + i, out + i, n - i);
+}
+
+SSE2_ATTR static int _sse2_sub_i64(
+        const int64_t *a, const int64_t *b, int64_t *out, int64_t n
+        ) {
+    // Signed overflow iff inputs differ in sign, and result's sign
+    // differs from the first input:
+    __m128i overflow = _mm_setzero_si128();
+    int64_t i = 0;
+    while (i + 2 <= n) {
+        __m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+        __m128i r = _mm_sub_epi64(va, vb);
+        overflow = _mm_or_si128(overflow, _mm_and_si128(
+            _mm_xor_si128(va, vb), _mm_xor_si128(va, r)
+        ));
+        _mm_storeu_si128((__m128i *)(out + i), r);
+        i += 2;
+    }
+    if (_mm_movemask_pd(_mm_castsi128_pd(overflow)) != 0)
+        return 0;
+    return _scalar_sub_i64(a + i, b + i, out + i, n - i);
+}
+
+SSE2_ATTR static double _sse2_dot_f64(
+        const double *a, const double *b, int64_t n
+        ) {
+    __m128d acc = _mm_setzero_pd();
+    int64_t i = 0;
+    while (i + 2 <= n) {
+        acc = _mm_add_pd(acc, _mm_mul_pd(
+            _mm_loadu_pd(a + i), _mm_loadu_pd(b + i)
+        ));
+        i += 2;
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, acc);
+    return lanes[0] + lanes[1] + _scalar_dot_f64(a + i, b + i, n - i);
+}
+
+SSE2_ATTR static double _sse2_sum_f64(const double *a, int64_t n) {
+    __m128d acc = _mm_setzero_pd();
+    int64_t i = 0;
+    while (i + 2 <= n) {
+        acc = _mm_add_pd(acc, _mm_loadu_pd(a + i));
+        i += 2;
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, acc);
+    return lanes[0] + lanes[1] + _scalar_sum_f64(a + i, n - i);
+}
+
+SSE2_ATTR static double _sse2_min_f64(const double *a, int64_t n) {
+    assert(n > 0);
+    if (n < 2)
+        return a[0];
+    __m128d acc = _mm_loadu_pd(a);
+    int64_t i = 2;
+    while (i + 2 <= n) {
+        acc = _mm_min_pd(acc, _mm_loadu_pd(a + i));
+        i += 2;
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, acc);
+    double result = (lanes[1] < lanes[0] ? lanes[1] : lanes[0]);
+    if (i < n && a[i] < result)
+        result = a[i];
+    return result;
+}
+
+SSE2_ATTR static double _sse2_max_f64(const double *a, int64_t n) {
+    assert(n > 0);
+    if (n < 2)
+        return a[0];
+    __m128d acc = _mm_loadu_pd(a);
+    int64_t i = 2;
+    while (i + 2 <= n) {
+        acc = _mm_max_pd(acc, _mm_loadu_pd(a + i));
+        i += 2;
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, acc);
+    double result = (lanes[1] > lanes[0] ? lanes[1] : lanes[0]);
+    if (i < n && a[i] > result)
+        result = a[i];
+    return result;
+}
+
+static const vmvectorkernels _vmvector_sse2kernels = {
+    "sse2",
+    {_sse2_add_f64, _sse2_sub_f64, _sse2_mul_f64, _sse2_div_f64},
+    _sse2_add_i64, _sse2_sub_i64,
+    _sse2_dot_f64, _sse2_sum_f64,
+    _sse2_min_f64, _sse2_max_f64,
+    _scalar_min_i64, _scalar_max_i64  // no 64bit compare in SSE2
+};
+
+// ---- AVX2 kernels, 4 lanes ----
+
+#define AVX2_ATTR __attribute__((target("avx2")))
+
+#define AVX2_F64OP(opname, intrin) \
+AVX2_ATTR static void _avx2_##opname##_f64( \
+        const double *a, const double *b, double *out, int64_t n \
+        ) { \
+    int64_t i = 0; \
+    while (i + 4 <= n) { \
+        _mm256_storeu_pd(out + i, intrin( \
+            _mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i) \
+        )); \
+        i += 4; \
+    } \
+    _scalar_##opname##_f64(a + i, b + i, out + i, n - i); \
+}
+
+AVX2_F64OP(add, _mm256_add_pd)
+AVX2_F64OP(sub, _mm256_sub_pd)
+AVX2_F64OP(mul, _mm256_mul_pd)
+AVX2_F64OP(div, _mm256_div_pd)
+
+AVX2_ATTR static int _avx2_add_i64(
+        const int64_t *a, const int64_t *b, int64_t *out, int64_t n
+        ) {
+    __m256i overflow = _mm256_setzero_si256();
+    int64_t i = 0;
+    while (i + 4 <= n) {
+        __m256i va = _mm256_loadu_si256((const __m256i *)(a + i));
+        __m256i vb = _mm256_loadu_si256((const __m256i *)(b + i));
+        __m256i r = _mm256_add_epi64(va, vb);
+        overflow = _mm256_or_si256(overflow, _mm256_and_si256(
+            _mm256_xor_si256(va, r), _mm256_xor_si256(vb, r)
+        ));
+        _mm256_storeu_si256((__m256i *)(out + i), r);
+        i += 4;
+    }
+    if (_mm256_movemask_pd(_mm256_castsi256_pd(overflow)) != 0)
+        return 0;
+    return _scalar_add_i64(a + i, b + i, out + i, n - i);
+}
+
+AVX2_ATTR static int _avx2_sub_i64(
+        const int64_t *a, const int64_t *b, int64_t *out, int64_t n
+        ) {
+    __m256i overflow = _mm256_setzero_si256();
+    int64_t i = 0;
+    while (i + 4 <= n) {
+        __m256i va = _mm256_loadu_si256((const __m256i *)(a + i));
+        __m256i vb = _mm256_loadu_si256((const __m256i *)(b + i));
+        __m256i r = _mm256_sub_epi64(va, vb);
+        overflow = _mm256_or_si256(overflow, _mm256_and_si256(
+            _mm256_xor_si256(va, vb), _mm256_xor_si256(va, r)
+        ));
+        _mm256_storeu_si256((__m256i *)(out + i), r);
+        i += 4;
+    }
+    if (_mm256_movemask_pd(_mm256_castsi256_pd(overflow)) != 0)
+        return 0;
+    return _scalar_sub_i64(a + i, b + i, out + i, n - i);
+}
+
+AVX2_ATTR static double _avx2_hsum(__m256d v) {
+    double lanes[4];
+    _mm256_storeu_pd(lanes, v);
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+AVX2_ATTR static double _avx2_dot_f64(
+        const double *a, const double *b, int64_t n
+        ) {
+    __m256d acc = _mm256_setzero_pd();
+    int64_t i = 0;
+    while (i + 4 <= n) {
+        acc = _mm256_add_pd(acc, _mm256_mul_pd(
+            _mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)
+        ));
+        i += 4;
+    }
+    return _avx2_hsum(acc) + _scalar_dot_f64(a + i, b + i, n - i);
+}
+
+AVX2_ATTR static double _avx2_sum_f64(const double *a, int64_t n) {
+    __m256d acc = _mm256_setzero_pd();
+    int64_t i = 0;
+    while (i + 4 <= n) {
+        acc = _mm256_add_pd(acc, _mm256_loadu_pd(a + i));
+        i += 4;
+    }
+    return _avx2_hsum(acc) + _scalar_sum_f64(a + i, n - i);
+}
+
+AVX2_ATTR static double _avx2_min_f64(const double *a, int64_t n) {
+    assert(n > 0);
+    if (n < 4)
+        return _scalar_min_f64(a, n);
+    __m256d acc = _mm256_loadu_pd(a);
+    int64_t i = 4;
+    while (i + 4 <= n) {
+        acc = _mm256_min_pd(acc, _mm256_loadu_pd(a + i));
+        i += 4;
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, acc);
+    double result = _scalar_min_f64(lanes, 4);
+    while (i < n) {
+        if (a[i] < result)
+            result = a[i];
+        i++;
+    }
+    return result;
+}
+
+AVX2_ATTR static double _avx2_max_f64(const double *a, int64_t n) {
+    assert(n > 0);
+    if (n < 4)
+        return _scalar_max_f64(a, n);
+    __m256d acc = _mm256_loadu_pd(a);
+    int64_t i = 4;
+    while (i + 4 <= n) {
+        acc = _mm256_max_pd(acc, _mm256_loadu_pd(a + i));
+        i += 4;
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, acc);
+    double result = _scalar_max_f64(lanes, 4);
+    while (i < n) {
+        if (a[i] > result)
+            result = a[i];
+        i++;
+    }
+    return result;
+}
+
+AVX2_ATTR static int64_t _avx2_min_i64(const int64_t *a, int64_t n) {
+    assert(n > 0);
+    if (n < 4)
+        return _scalar_min_i64(a, n);
+    __m256i acc = _mm256_loadu_si256((const __m256i *)a);
+    int64_t i = 4;
+    while (i + 4 <= n) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(a + i));
+        acc = _mm256_blendv_epi8(
+            acc, v, _mm256_cmpgt_epi64(acc, v)
+        );
+        i += 4;
+    }
+    int64_t lanes[4];
+    _mm256_storeu_si256((__m256i *)lanes, acc);
+    int64_t result = _scalar_min_i64(lanes, 4);
+    while (i < n) {
+        if (a[i] < result)
+            result = a[i];
+        i++;
+    }
+    return result;
+}
+
+AVX2_ATTR static int64_t _avx2_max_i64(const int64_t *a, int64_t n) {
+    assert(n > 0);
+    if (n < 4)
+        return _scalar_max_i64(a, n);
+    __m256i acc = _mm256_loadu_si256((const __m256i *)a);
+    int64_t i = 4;
+    while (i + 4 <= n) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(a + i));
+        acc = _mm256_blendv_epi8(
+            acc, v, _mm256_cmpgt_epi64(v, acc)
+        );
+        i += 4;
+    }
+    int64_t lanes[4];
+    _mm256_storeu_si256((__m256i *)lanes, acc);
+    int64_t result = _scalar_max_i64(lanes, 4);
+    while (i < n) {
+        if (a[i] > result)
+            result = a[i];
+        i++;
+    }
+    return result;
+}
+
+static const vmvectorkernels _vmvector_avx2kernels = {
+    "avx2",
+    {_avx2_add_f64, _avx2_sub_f64, _avx2_mul_f64, _avx2_div_f64},
+    _avx2_add_i64, _avx2_sub_i64,
+    _avx2_dot_f64, _avx2_sum_f64,
+    _avx2_min_f64, _avx2_max_f64,
+    _avx2_min_i64, _avx2_max_i64
+};
+#endif  // VMVECTOR_X86
+
+static const vmvectorkernels *_vmvector_kernels = NULL;
+
+static const vmvectorkernels *_vmvector_GetKernels() {
+    if (likely(_vmvector_kernels != NULL))
+        return _vmvector_kernels;
+    const vmvectorkernels *k = &_vmvector_scalarkernels;
+    #if defined(VMVECTOR_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        k = &_vmvector_avx2kernels;
+    else if (__builtin_cpu_supports("sse2"))
+        k = &_vmvector_sse2kernels;
+    #endif
+    // Note: racing threads all pick the same, so this is harmless.
+    _vmvector_kernels = k;
+    return k;
+}
+
+const char *vmvector_KernelsName() {
+    return _vmvector_GetKernels()->name;
+}
+
+int vmvector_ForceKernels(const char *name) {
+    if (strcmp(name, "scalar") == 0) {
+        _vmvector_kernels = &_vmvector_scalarkernels;
+        return 1;
+    }
+    #if defined(VMVECTOR_X86)
+    __builtin_cpu_init();
+    if (strcmp(name, "sse2") == 0 && __builtin_cpu_supports("sse2")) {
+        _vmvector_kernels = &_vmvector_sse2kernels;
+        return 1;
+    }
+    if (strcmp(name, "avx2") == 0 && __builtin_cpu_supports("avx2")) {
+        _vmvector_kernels = &_vmvector_avx2kernels;
+        return 1;
+    }
+    #endif
+    return 0;
+}
+
+// ---- Vector container ----
+
+genericvector *vmvector_New(int is_float) {
+    genericvector *v = malloc(sizeof(*v));
+    if (!v)
+        return NULL;
+    memset(v, 0, sizeof(*v));
+    v->is_float = (is_float != 0);
+    return v;
+}
+
+void vmvector_Free(genericvector *v) {
+    if (!v)
+        return;
+    free(v->int_values);
+    free(v);
+}
+
+static int _vmvector_Reserve(genericvector *v, int64_t len) {
+    if (len <= v->alloc)
+        return 1;
+    int64_t new_alloc = (v->alloc < 8 ? 8 : v->alloc * 2);
+    while (new_alloc < len)
+        new_alloc *= 2;
+    // int64_t and double are both 8 bytes, so either works here:
+    int64_t *new_values = realloc(
+        v->int_values, sizeof(*new_values) * new_alloc
+    );
+    if (!new_values)
+        return 0;
+    v->int_values = new_values;
+    v->alloc = new_alloc;
+    return 1;
+}
+
+static void _vmvector_ToFloat(genericvector *v) {
+    if (v->is_float)
+        return;
+    // Same element size, so this can be converted in-place:
+    int64_t i = 0;
+    while (i < v->len) {
+        double f = (double)v->int_values[i];
+        memcpy(&v->float_values[i], &f, sizeof(f));
+        i++;
+    }
+    v->is_float = 1;
+}
+
+int vmvector_Set(
+        genericvector *v, int64_t index, valuecontent *value
+        ) {
+    assert(index >= 1 && index <= v->len + 1);
+    assert(value->type == H64VALTYPE_INT64 ||
+           value->type == H64VALTYPE_FLOAT64);
+    if (index == v->len + 1) {
+        if (!_vmvector_Reserve(v, v->len + 1))
+            return 0;
+        v->len++;
+    }
+    if (value->type == H64VALTYPE_FLOAT64)
+        _vmvector_ToFloat(v);
+    if (v->is_float) {
+        v->float_values[index - 1] = (
+            value->type == H64VALTYPE_FLOAT64 ? value->float_value :
+            (double)value->int_value
+        );
+    } else {
+        v->int_values[index - 1] = value->int_value;
+    }
+    return 1;
+}
+
+int vmvector_CheckEquality(genericvector *v1, genericvector *v2) {
+    if (v1 == v2)
+        return 1;
+    if (v1->len != v2->len)
+        return 0;
+    if (v1->is_float == v2->is_float) {
+        if (!v1->is_float)
+            return (memcmp(v1->int_values, v2->int_values,
+                           sizeof(*v1->int_values) * v1->len) == 0);
+        int64_t i = 0;
+        while (i < v1->len) {
+            if (v1->float_values[i] != v2->float_values[i])
+                return 0;
+            i++;
+        }
+        return 1;
+    }
+    if (v1->is_float) {
+        genericvector *swap = v1;
+        v1 = v2;
+        v2 = swap;
+    }
+    int64_t i = 0;
+    while (i < v1->len) {
+        if ((double)v1->int_values[i] != v2->float_values[i])
+            return 0;
+        i++;
+    }
+    return 1;
+}
+
+static int _vmvector_AsFloatArray(
+        genericvector *v, double **out_values, double **out_tofree
+        ) {
+    // Gets the float values, converting to a temporary copy first
+    // if this is an int vector. Return value: 1 = ok, 0 = oom
+    *out_tofree = NULL;
+    if (v->is_float) {
+        *out_values = v->float_values;
+        return 1;
+    }
+    double *result = malloc(
+        sizeof(*result) * (v->len > 0 ? v->len : 1)
+    );
+    if (!result)
+        return 0;
+    int64_t i = 0;
+    while (i < v->len) {
+        result[i] = (double)v->int_values[i];
+        i++;
+    }
+    *out_values = result;
+    *out_tofree = result;
+    return 1;
+}
+
+static int _vmvector_FillFromNumber(
+        genericvector *v, int64_t len, valuecontent *number
+        ) {
+    assert(number->type == H64VALTYPE_INT64 ||
+           number->type == H64VALTYPE_FLOAT64);
+    memset(v, 0, sizeof(*v));
+    if (!_vmvector_Reserve(v, (len > 0 ? len : 1)))
+        return 0;
+    v->len = len;
+    v->is_float = (number->type == H64VALTYPE_FLOAT64);
+    int64_t i = 0;
+    while (i < len) {
+        if (v->is_float)
+            v->float_values[i] = number->float_value;
+        else
+            v->int_values[i] = number->int_value;
+        i++;
+    }
+    return 1;
+}
+
+static int _vmvector_OpOperands(
+        valuecontent *v1, valuecontent *v2,
+        genericvector **out_a, genericvector **out_b,
+        genericvector *broadcastbuf, vmvectorerror *error
+        ) {
+    // Figure out the two vector operands, turning a number on
+    // either side into a temporary vector of matching length:
+    int isnum1 = (v1->type == H64VALTYPE_INT64 ||
+                  v1->type == H64VALTYPE_FLOAT64);
+    int isnum2 = (v2->type == H64VALTYPE_INT64 ||
+                  v2->type == H64VALTYPE_FLOAT64);
+    if ((v1->type != H64VALTYPE_VECTOR && !isnum1) ||
+            (v2->type != H64VALTYPE_VECTOR && !isnum2) ||
+            (isnum1 && isnum2)) {
+        *error = VMVECTOR_ERROR_INVALIDTYPES;
+        return 0;
+    }
+    if (isnum1) {
+        if (!_vmvector_FillFromNumber(
+                broadcastbuf, v2->vector_values->len, v1)) {
+            *error = VMVECTOR_ERROR_OUTOFMEMORY;
+            return 0;
+        }
+        *out_a = broadcastbuf;
+        *out_b = v2->vector_values;
+    } else if (isnum2) {
+        if (!_vmvector_FillFromNumber(
+                broadcastbuf, v1->vector_values->len, v2)) {
+            *error = VMVECTOR_ERROR_OUTOFMEMORY;
+            return 0;
+        }
+        *out_a = v1->vector_values;
+        *out_b = broadcastbuf;
+    } else {
+        *out_a = v1->vector_values;
+        *out_b = v2->vector_values;
+        if ((*out_a)->len != (*out_b)->len) {
+            *error = VMVECTOR_ERROR_LENMISMATCH;
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int vmvector_Binop(
+        vmvectorop op, valuecontent *v1, valuecontent *v2,
+        valuecontent *out, vmvectorerror *error
+        ) {
+    *error = VMVECTOR_ERROR_NONE;
+    genericvector broadcastbuf = {0};
+    genericvector *a = NULL;
+    genericvector *b = NULL;
+    if (!_vmvector_OpOperands(v1, v2, &a, &b, &broadcastbuf, error)) {
+        free(broadcastbuf.int_values);
+        return 0;
+    }
+    const vmvectorkernels *k = _vmvector_GetKernels();
+    const int64_t len = a->len;
+
+    // Division always gives a float vector, unlike with single
+    // numbers, since every element would need a separate check:
+    int result_float = (a->is_float || b->is_float ||
+                        op == VMVECTOR_OP_DIVIDE);
+    genericvector *result = vmvector_New(result_float);
+    double *tofree_a = NULL;
+    double *tofree_b = NULL;
+    if (!result || !_vmvector_Reserve(result, (len > 0 ? len : 1))) {
+        oom:
+        *error = VMVECTOR_ERROR_OUTOFMEMORY;
+        failure:
+        free(tofree_a);
+        free(tofree_b);
+        free(broadcastbuf.int_values);
+        vmvector_Free(result);
+        return 0;
+    }
+    result->len = len;
+
+    if (result_float) {
+        double *fa = NULL;
+        double *fb = NULL;
+        if (!_vmvector_AsFloatArray(a, &fa, &tofree_a) ||
+                !_vmvector_AsFloatArray(b, &fb, &tofree_b))
+            goto oom;
+        if (op == VMVECTOR_OP_DIVIDE) {
+            int64_t i = 0;
+            while (i < len) {
+                if (unlikely(fb[i] == 0)) {
+                    *error = VMVECTOR_ERROR_DIVISIONBYZERO;
+                    goto failure;
+                }
+                i++;
+            }
+        }
+        k->op_f64[op](fa, fb, result->float_values, len);
+    } else if (op == VMVECTOR_OP_ADD) {
+        if (!k->add_i64(a->int_values, b->int_values,
+                        result->int_values, len)) {
+            *error = VMVECTOR_ERROR_OVERFLOW;
+            goto failure;
+        }
+    } else if (op == VMVECTOR_OP_SUBSTRACT) {
+        if (!k->sub_i64(a->int_values, b->int_values,
+                        result->int_values, len)) {
+            *error = VMVECTOR_ERROR_OVERFLOW;
+            goto failure;
+        }
+    } else {
+        // No 64bit int multiply in SSE2/AVX2, so this stays scalar:
+        assert(op == VMVECTOR_OP_MULTIPLY);
+        int overflow = 0;
+        int64_t i = 0;
+        while (i < len) {
+            overflow |= __builtin_mul_overflow(
+                a->int_values[i], b->int_values[i],
+                &result->int_values[i]
+            );
+            i++;
+        }
+        if (overflow) {
+            *error = VMVECTOR_ERROR_OVERFLOW;
+            goto failure;
+        }
+    }
+    free(tofree_a);
+    free(tofree_b);
+    free(broadcastbuf.int_values);
+
+    memset(out, 0, sizeof(*out));
+    out->type = H64VALTYPE_VECTOR;
+    out->vector_values = result;
+    result->refcount = 1;
+    return 1;
+}
+
+int vmvector_Dot(
+        genericvector *v1, genericvector *v2,
+        valuecontent *out, vmvectorerror *error
+        ) {
+    *error = VMVECTOR_ERROR_NONE;
+    if (v1->len != v2->len) {
+        *error = VMVECTOR_ERROR_LENMISMATCH;
+        return 0;
+    }
+    memset(out, 0, sizeof(*out));
+    if (!v1->is_float && !v2->is_float) {
+        int64_t result = 0;
+        int64_t i = 0;
+        while (i < v1->len) {
+            int64_t product;
+            if (__builtin_mul_overflow(
+                    v1->int_values[i], v2->int_values[i], &product
+                    ) ||
+                    __builtin_add_overflow(result, product, &result)) {
+                *error = VMVECTOR_ERROR_OVERFLOW;
+                return 0;
+            }
+            i++;
+        }
+        out->type = H64VALTYPE_INT64;
+        out->int_value = result;
+        return 1;
+    }
+    double *tofree_a = NULL;
+    double *tofree_b = NULL;
+    double *fa = NULL;
+    double *fb = NULL;
+    if (!_vmvector_AsFloatArray(v1, &fa, &tofree_a) ||
+            !_vmvector_AsFloatArray(v2, &fb, &tofree_b)) {
+        free(tofree_a);
+        *error = VMVECTOR_ERROR_OUTOFMEMORY;
+        return 0;
+    }
+    out->type = H64VALTYPE_FLOAT64;
+    out->float_value = _vmvector_GetKernels()->dot_f64(fa, fb, v1->len);
+    free(tofree_a);
+    free(tofree_b);
+    return 1;
+}
+
+int vmvector_Sum(
+        genericvector *v, valuecontent *out, vmvectorerror *error
+        ) {
+    *error = VMVECTOR_ERROR_NONE;
+    memset(out, 0, sizeof(*out));
+    if (v->is_float) {
+        out->type = H64VALTYPE_FLOAT64;
+        out->float_value = _vmvector_GetKernels()->sum_f64(
+            v->float_values, v->len
+        );
+        return 1;
+    }
+    int64_t result = 0;
+    int64_t i = 0;
+    while (i < v->len) {
+        if (__builtin_add_overflow(result, v->int_values[i], &result)) {
+            *error = VMVECTOR_ERROR_OVERFLOW;
+            return 0;
+        }
+        i++;
+    }
+    out->type = H64VALTYPE_INT64;
+    out->int_value = result;
+    return 1;
+}
+
+static int _vmvector_MinMax(
+        genericvector *v, valuecontent *out, vmvectorerror *error,
+        int domax
+        ) {
+    *error = VMVECTOR_ERROR_NONE;
+    if (v->len == 0) {
+        *error = VMVECTOR_ERROR_EMPTY;
+        return 0;
+    }
+    const vmvectorkernels *k = _vmvector_GetKernels();
+    memset(out, 0, sizeof(*out));
+    if (v->is_float) {
+        out->type = H64VALTYPE_FLOAT64;
+        out->float_value = (domax ? k->max_f64(v->float_values, v->len) :
+                            k->min_f64(v->float_values, v->len));
+    } else {
+        out->type = H64VALTYPE_INT64;
+        out->int_value = (domax ? k->max_i64(v->int_values, v->len) :
+                          k->min_i64(v->int_values, v->len));
+    }
+    return 1;
+}
+
+int vmvector_Min(
+        genericvector *v, valuecontent *out, vmvectorerror *error
+        ) {
+    return _vmvector_MinMax(v, out, error, 0);
+}
+
+int vmvector_Max(
+        genericvector *v, valuecontent *out, vmvectorerror *error
+        ) {
+    return _vmvector_MinMax(v, out, error, 1);
+}
@@ -0,0 +1,95 @@
+// Copyright (c) 2020-2021, ellie/@ell1e & Horse64 Team (see AUTHORS.md),
+// also see LICENSE.md file.
+// SPDX-License-Identifier: BSD-2-Clause
+
+#ifndef HORSE64_VMVECTOR_H_
+#define HORSE64_VMVECTOR_H_
+
+#include "compileconfig.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "bytecode.h"
+#include "vmcontainerstruct.h"
+
+typedef enum vmvectorop {
+    VMVECTOR_OP_ADD = 0,
+    VMVECTOR_OP_SUBSTRACT,
+    VMVECTOR_OP_MULTIPLY,
+    VMVECTOR_OP_DIVIDE
+} vmvectorop;
+
+typedef enum vmvectorerror {
+    VMVECTOR_ERROR_NONE = 0,
+    VMVECTOR_ERROR_OUTOFMEMORY,
+    VMVECTOR_ERROR_INVALIDTYPES,
+    VMVECTOR_ERROR_LENMISMATCH,
+    VMVECTOR_ERROR_OVERFLOW,
+    VMVECTOR_ERROR_DIVISIONBYZERO,
+    VMVECTOR_ERROR_EMPTY
+} vmvectorerror;
+
+genericvector *vmvector_New(int is_float);
+    // Returned with refcount 0, like a fresh list has no refs yet.
+
+void vmvector_Free(genericvector *v);
+
+ATTR_UNUSED static inline int64_t vmvector_Count(genericvector *v) {
+    return v->len;
+}
+
+ATTR_UNUSED static inline void vmvector_Get(
+        genericvector *v, int64_t index, valuecontent *out
+        ) {
+    // Index is 1-based and must be in range:
+    assert(index >= 1 && index <= v->len);
+    memset(out, 0, sizeof(*out));
+    if (v->is_float) {
+        out->type = H64VALTYPE_FLOAT64;
+        out->float_value = v->float_values[index - 1];
+    } else {
+        out->type = H64VALTYPE_INT64;
+        out->int_value = v->int_values[index - 1];
+    }
+}
+
+int vmvector_Set(
+    genericvector *v, int64_t index, valuecontent *value
+);  // Index 1-based, up to len + 1 for appending. Value must be
+    // a number. An int vector turns into a float vector if a
+    // float value is set. Return value: 1 = ok, 0 = oom
+
+int vmvector_CheckEquality(genericvector *v1, genericvector *v2);
+
+int vmvector_Binop(
+    vmvectorop op, valuecontent *v1, valuecontent *v2,
+    valuecontent *out, vmvectorerror *error
+);  // Elementwise op of two vectors, or of a vector and a number.
+    // The result in out is a new vector holding one reference.
+
+int vmvector_Dot(
+    genericvector *v1, genericvector *v2,
+    valuecontent *out, vmvectorerror *error
+);
+
+int vmvector_Sum(
+    genericvector *v, valuecontent *out, vmvectorerror *error
+);
+
+int vmvector_Min(
+    genericvector *v, valuecontent *out, vmvectorerror *error
+);
+
+int vmvector_Max(
+    genericvector *v, valuecontent *out, vmvectorerror *error
+);
+
+const char *vmvector_KernelsName();
+    // Name of the kernel set in use: "avx2", "sse2", or "scalar".
+
+int vmvector_ForceKernels(const char *name);
+    // For testing, returns 0 if not supported on this CPU.
+
+#endif  // HORSE64_VMVECTOR_H_
@@ -17,156 +17,195 @@
 #include <string.h>
 
 
+#if defined(USE_SSE_KERNELS) && defined(__GNUC__) && ( \
+    defined(__x86_64__) || defined(__i386__))
+#define WIDECHAR_X86
+#include <immintrin.h>
+#endif
+
 #include "threading.h"
 #include "vendor/unicode/unicode_data_header.h"
-#include "vfs.h"
 #include "widechar.h"
 
-// The equivalents to the unicode data header "extern" refs:
-uint8_t *_widechartbl_ismodifier = NULL;
-uint8_t *_widechartbl_iscombining = NULL;
-uint8_t *_widechartbl_istag = NULL;
-int64_t *_widechartbl_lowercp = NULL;
-int64_t *_widechartbl_uppercp = NULL;
-uint8_t *_widechartbl_graphemebreaktype = NULL;
+// Looks up a code point in one of the tries from unicode_data_header.h.
+// The code point must be <= _widechartbl_highest_cp:
+#define _WIDECHARTBL_LOOKUP(name, cp) (\
+    _widechartbl_##name##_stage3[\
+        ((uint32_t)_widechartbl_##name##_stage2[\
+            ((uint32_t)_widechartbl_##name##_stage1[\
+                (cp) >> _WIDECHARTBL_SHIFT1\
+            ] << (_WIDECHARTBL_SHIFT1 - _WIDECHARTBL_SHIFT2)) |\
+            (((cp) >> _WIDECHARTBL_SHIFT2) & ((1U <<\
+                (_WIDECHARTBL_SHIFT1 - _WIDECHARTBL_SHIFT2)) - 1))\
+        ] << _WIDECHARTBL_SHIFT2) |\
+        ((cp) & ((1U << _WIDECHARTBL_SHIFT2) - 1))\
+    ])
 
-void _load_unicode_data() {
-    int _exists = 0;
-    if (!vfs_ExistsEx(
-            NULL, "horse_modules_builtin/"
-                "unicode_data___widechartbl_ismodifier.dat",
-            &_exists, VFSFLAG_NO_REALDISK_ACCESS
-            ) || !_exists) {
-        loadfail:
-        fprintf(stderr, "horsevm: error: fatal, failed "
-            "to unpack integrated unicode data, out of memory?\n");
-        exit(1);
-        return;
-    }
-    _widechartbl_ismodifier = malloc(
-        sizeof(*_widechartbl_ismodifier) *
-        _widechartbl_arraylen
-    );
-    if (!_widechartbl_ismodifier)
-        goto loadfail;
-    if (!vfs_GetBytesEx(
-            NULL, "horse_modules_builtin/"
-                "unicode_data___widechartbl_ismodifier.dat",
-            0, sizeof(*_widechartbl_ismodifier) *
-            _widechartbl_arraylen,
-            (char *)_widechartbl_ismodifier,
-            VFSFLAG_NO_REALDISK_ACCESS))
-        goto loadfail;
+// Most text is mostly ASCII, so the UTF-8 <-> UTF-32 conversions below
+// hand runs of ASCII to these kernels, and only decode the rest one
+// code point at a time. Like in vmvector.c, the x86 kernels use
+// per-function target attributes and get picked at runtime.
 
-    if (!vfs_ExistsEx(
-            NULL, "horse_modules_builtin/"
-                "unicode_data___widechartbl_graphemebreaktype.dat",
-            &_exists, VFSFLAG_NO_REALDISK_ACCESS
-            ) || !_exists)
-        goto loadfail;
-    _widechartbl_graphemebreaktype = malloc(
-        sizeof(*_widechartbl_graphemebreaktype) *
-        _widechartbl_arraylen
+typedef struct widecharkernels {
+    int64_t (*ascii_run_to_utf32)(
+        const uint8_t *in, int64_t len, h64wchar *out
     );
-    if (!_widechartbl_graphemebreaktype)
-        goto loadfail;
-    if (!vfs_GetBytesEx(
-            NULL, "horse_modules_builtin/"
-                "unicode_data___widechartbl_graphemebreaktype.dat",
-            0, sizeof(*_widechartbl_graphemebreaktype) *
-            _widechartbl_arraylen,
-            (char *)_widechartbl_graphemebreaktype,
-            VFSFLAG_NO_REALDISK_ACCESS))
-        goto loadfail;
-
-    if (!vfs_ExistsEx(
-            NULL, "horse_modules_builtin/"
-                "unicode_data___widechartbl_iscombining.dat",
-            &_exists, VFSFLAG_NO_REALDISK_ACCESS
-            ) || !_exists)
-        goto loadfail;
-    _widechartbl_iscombining = malloc(
-        sizeof(*_widechartbl_iscombining) *
-        _widechartbl_arraylen
+    int64_t (*ascii_run_to_utf8)(
+        const h64wchar *in, int64_t len, uint8_t *out
     );
-    if (!_widechartbl_iscombining)
-        goto loadfail;
-    if (!vfs_GetBytesEx(
-            NULL, "horse_modules_builtin/"
-                "unicode_data___widechartbl_iscombining.dat",
-            0, sizeof(*_widechartbl_iscombining) *
-            _widechartbl_arraylen,
-            (char *)_widechartbl_iscombining,
-            VFSFLAG_NO_REALDISK_ACCESS))
-        goto loadfail;
+} widecharkernels;
 
-    if (!vfs_ExistsEx(
-            NULL, "horse_modules_builtin/"
-                "unicode_data___widechartbl_istag.dat",
-            &_exists, VFSFLAG_NO_REALDISK_ACCESS
-            ) || !_exists) {
-        goto loadfail;
+static int64_t _scalar_ascii_run_to_utf32(
+        const uint8_t *in, int64_t len, h64wchar *out
+        ) {
+    int64_t i = 0;
+    while (i + 8 <= len) {
+        uint64_t v;
+        memcpy(&v, in + i, sizeof(v));
+        if (v & 0x8080808080808080ULL)
+            break;
+        int k = 0;
+        while (k < 8) {
+            out[i + k] = in[i + k];
+            k++;
+        }
+        i += 8;
     }
-    _widechartbl_istag = malloc(
-        sizeof(*_widechartbl_istag) *
-        _widechartbl_arraylen
-    );
-    if (!_widechartbl_istag)
-        goto loadfail;
-    if (!vfs_GetBytesEx(
-            NULL, "horse_modules_builtin/"
-                "unicode_data___widechartbl_istag.dat",
-            0, sizeof(*_widechartbl_istag) *
-            _widechartbl_arraylen,
-            (char *)_widechartbl_istag,
-            VFSFLAG_NO_REALDISK_ACCESS))
-        goto loadfail;
+    while (i < len && in[i] < 0x80) {
+        out[i] = in[i];
+        i++;
+    }
+    return i;
+}
 
-    if (!vfs_ExistsEx(
-            NULL, "horse_modules_builtin/"
-                "unicode_data___widechartbl_lowercp.dat",
-            &_exists, VFSFLAG_NO_REALDISK_ACCESS
-            ) || !_exists) {
-        goto loadfail;
+static int64_t _scalar_ascii_run_to_utf8(
+        const h64wchar *in, int64_t len, uint8_t *out
+        ) {
+    int64_t i = 0;
+    while (i < len && in[i] < 0x80) {
+        out[i] = in[i];
+        i++;
     }
-    _widechartbl_lowercp = malloc(
-        sizeof(*_widechartbl_lowercp) *
-        _widechartbl_arraylen
-    );
-    if (!_widechartbl_lowercp)
-        goto loadfail;
-    if (!vfs_GetBytesEx(
-            NULL, "horse_modules_builtin/"
-                "unicode_data___widechartbl_lowercp.dat",
-            0, sizeof(*_widechartbl_lowercp) *
-            _widechartbl_arraylen,
-            (char *)_widechartbl_lowercp,
-            VFSFLAG_NO_REALDISK_ACCESS))
-        goto loadfail;
+    return i;
+}
+
+static const widecharkernels _widechar_scalarkernels = {
+    _scalar_ascii_run_to_utf32, _scalar_ascii_run_to_utf8
+};
+
+#if defined(WIDECHAR_X86)
+#define SSE2_ATTR __attribute__((target("sse2")))
+#define AVX2_ATTR __attribute__((target("avx2")))
 
-    if (!vfs_ExistsEx(
-            NULL, "horse_modules_builtin/"
-                "unicode_data___widechartbl_uppercp.dat",
-            &_exists, VFSFLAG_NO_REALDISK_ACCESS
-            ) || !_exists) {
-        goto loadfail;
+SSE2_ATTR static int64_t _sse2_ascii_run_to_utf32(
+        const uint8_t *in, int64_t len, h64wchar *out
+        ) {
+    const __m128i zero = _mm_setzero_si128();
+    int64_t i = 0;
+    while (i + 16 <= len) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(in + i));
+        if (_mm_movemask_epi8(v) != 0)  // some byte has its top bit set
+            break;
+        __m128i lo = _mm_unpacklo_epi8(v, zero);
+        __m128i hi = _mm_unpackhi_epi8(v, zero);
+        _mm_storeu_si128((__m128i *)(out + i),
+            _mm_unpacklo_epi16(lo, zero));
+        _mm_storeu_si128((__m128i *)(out + i + 4),
+            _mm_unpackhi_epi16(lo, zero));
+        _mm_storeu_si128((__m128i *)(out + i + 8),
+            _mm_unpacklo_epi16(hi, zero));
+        _mm_storeu_si128((__m128i *)(out + i + 12),
+            _mm_unpackhi_epi16(hi, zero));
+        i += 16;
     }
-    _widechartbl_uppercp = malloc(
-        sizeof(*_widechartbl_uppercp) *
-        _widechartbl_arraylen
-    );
-    if (!_widechartbl_uppercp)
-        goto loadfail;
-    if (!vfs_GetBytesEx(
-            NULL, "horse_modules_builtin/"
-                "unicode_data___widechartbl_uppercp.dat",
-            0, sizeof(*_widechartbl_uppercp) *
-            _widechartbl_arraylen,
-            (char *)_widechartbl_uppercp,
-            VFSFLAG_NO_REALDISK_ACCESS))
-        goto loadfail;
+    return i + _scalar_ascii_run_to_utf32(in + i, len - i, out + i);
 }
 
+SSE2_ATTR static int64_t _sse2_ascii_run_to_utf8(
+        const h64wchar *in, int64_t len, uint8_t *out
+        ) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i nonascii = _mm_set1_epi32((int)0xFFFFFF80);
+    int64_t i = 0;
+    while (i + 16 <= len) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(in + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(in + i + 4));
+        __m128i c = _mm_loadu_si128((const __m128i *)(in + i + 8));
+        __m128i d = _mm_loadu_si128((const __m128i *)(in + i + 12));
+        __m128i any = _mm_and_si128(nonascii, _mm_or_si128(
+            _mm_or_si128(a, b), _mm_or_si128(c, d)
+        ));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(any, zero)) != 0xFFFF)
+            break;
+        // All values are < 0x80, so the saturating packs are exact:
+        _mm_storeu_si128((__m128i *)(out + i), _mm_packus_epi16(
+            _mm_packs_epi32(a, b), _mm_packs_epi32(c, d)
+        ));
+        i += 16;
+    }
+    return i + _scalar_ascii_run_to_utf8(in + i, len - i, out + i);
+}
+
+static const widecharkernels _widechar_sse2kernels = {
+    _sse2_ascii_run_to_utf32, _sse2_ascii_run_to_utf8
+};
+
+AVX2_ATTR static int64_t _avx2_ascii_run_to_utf32(
+        const uint8_t *in, int64_t len, h64wchar *out
+        ) {
+    int64_t i = 0;
+    while (i + 32 <= len) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(in + i));
+        if (_mm256_movemask_epi8(v) != 0)
+            break;
+        int k = 0;
+        while (k < 32) {
+            _mm256_storeu_si256((__m256i *)(out + i + k),
+                _mm256_cvtepu8_epi32(
+                    _mm_loadl_epi64((const __m128i *)(in + i + k))
+                ));
+            k += 8;
+        }
+        i += 32;
+    }
+    return i + _sse2_ascii_run_to_utf32(in + i, len - i, out + i);
+}
+
+static const widecharkernels _widechar_avx2kernels = {
+    // The AVX2 packs work per 128-bit lane, so narrowing stays SSE2:
+    _avx2_ascii_run_to_utf32, _sse2_ascii_run_to_utf8
+};
+#endif  // WIDECHAR_X86
+
+static const widecharkernels *_widechar_kernels = NULL;
+
+static const widecharkernels *_widechar_GetKernels() {
+    if (likely(_widechar_kernels != NULL))
+        return _widechar_kernels;
+    const widecharkernels *k = &_widechar_scalarkernels;
+    #if defined(WIDECHAR_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        k = &_widechar_avx2kernels;
+    else if (__builtin_cpu_supports("sse2"))
+        k = &_widechar_sse2kernels;
+    #endif
+    // Note: racing threads all pick the same, so this is harmless.
+    _widechar_kernels = k;
+    return k;
+}
+
+int64_t utf8_ascii_run_to_utf32(
+        const uint8_t *in, int64_t len, h64wchar *out
+        ) {
+    return _widechar_GetKernels()->ascii_run_to_utf32(in, len, out);
+}
+
+int64_t utf32_ascii_run_to_utf8(
+        const h64wchar *in, int64_t len, uint8_t *out
+        ) {
+    return _widechar_GetKernels()->ascii_run_to_utf8(in, len, out);
+}
 
 static int is_utf8_start(uint8_t c) {
     if ((int)(c & 0xE0) == (int)0xC0) {  // 110xxxxx
@@ -194,6 +233,14 @@ int64_t utf32_letters_count(
         ) {
     int64_t len = 0;
     while (sdata_len > 0) {
+        if (sdata_len > 1 && sdata[0] < 0x80 && sdata[1] < 0x80) {
+            // Fast path, ASCII code points are always letters by
+            // themselves:
+            len += 1;
+            sdata++;
+            sdata_len--;
+            continue;
+        }
         int64_t letterlen = utf32_letter_len(sdata, sdata_len);
         assert(letterlen > 0);
         len += 1;
@@ -292,10 +339,60 @@ int64_t utf32_next_letter_byteslen_in_utf8(
 }
 
 static int _gbt(uint64_t cp) {
-    if ((int64_t)cp < _widechartbl_lowest_cp ||
-            (int64_t)cp > _widechartbl_highest_cp)
+    if ((int64_t)cp > _widechartbl_highest_cp)
         return GBT_NONE;
-    return _widechartbl_graphemebreaktype[cp];
+    return (_WIDECHARTBL_LOOKUP(props, cp) & _WIDECHARTBL_GBT_MASK);
+}
+
+static inline int _utf32_letter_continues(
+        uint64_t cp0, uint64_t cp1, uint64_t cp2, int64_t len
+        ) {
+    // Returns whether cp2 still belongs to the letter made up of the
+    // len code points before it, the last two of which are cp0 and cp1
+    // (cp0 is 0 if len < 2).
+    if (likely(cp1 < 0x80 && cp2 < 0x80)) {
+        // No ASCII code point extends or joins anything:
+        return 0;
+    }
+    if (unlikely(cp2 == '\r' || (cp2 == '\n' && cp1 != '\r') ||
+            cp1 == '\n')) {
+        return 0;
+    }
+    // This should follow the grapheme break rules from the Unicode(R)
+    // standard:
+    int _gbt1 = _gbt(cp1);
+    int _gbt2 = _gbt(cp2);
+    if (unlikely(_gbt1 == GBT_CONTROL || _gbt2 == GBT_CONTROL))
+        return 0;
+    if (unlikely(_gbt1 == GBT_L && (
+            _gbt2 == GBT_L || _gbt2 == GBT_V ||
+            _gbt2 == GBT_LV || _gbt2 == GBT_LVT)))
+        return 1;
+    if (unlikely((_gbt1 == GBT_LV || _gbt1 == GBT_V) && (
+            _gbt2 == GBT_V || _gbt2 == GBT_T)))
+        return 1;
+    if (unlikely((_gbt1 == GBT_LVT || _gbt1 == GBT_T) && (
+            _gbt2 == GBT_T)))
+        return 1;
+    if (unlikely(_gbt2 == GBT_EXTEND || _gbt2 == GBT_ZWJ))
+        return 1;
+    if (unlikely(_gbt1 == GBT_PREPEND || _gbt2 == GBT_SPACINGMARK))
+        return 1;
+    if (unlikely(cp1 >= 0x1F1E6LL &&
+            cp1 <= 0x1F1FFLL &&
+            cp2 >= 0x1F1E6LL &&
+            cp2 <= 0x1F1FFLL)) {  // A region pair!
+        uint64_t cpminus1 = (
+            len > 2 ? cp0 : 0
+        );
+        if (likely(cp0 < 0x1F1E6LL || cp0 > 0x1F1FFLL ||
+                (cpminus1 >= 0x1F1E6LL && cpminus1 <= 0x1F1FFLL))) {
+            // Can only continue after an uneven number of region pair
+            // items. (Since after one full pair we might want to break.)
+            return 1;
+        }
+    }
+    return 0;
 }
 
 int64_t utf32_letter_len(
@@ -307,65 +404,46 @@ int64_t utf32_letter_len(
         return 0;
     int64_t len = 1;
     while (likely(len < sdata_len)) {
-        uint64_t cp1 = sdata[len - 1];
-        uint64_t cp2 = sdata[len];
-        if (unlikely(cp2 == '\r' || (cp2 == '\n' && cp1 != '\r') ||
-                cp1 == '\n')) {
+        if (!_utf32_letter_continues(
+                (len > 1 ? sdata[len - 2] : 0), sdata[len - 1],
+                sdata[len], len))
             break;
-        }
-        // This should follow the grapheme break rules from the Unicode(R)
-        // standard:
-        int _gbt1 = _gbt(cp1);
-        int _gbt2 = _gbt(cp2);
-        if (unlikely(_gbt1 == GBT_CONTROL || _gbt2 == GBT_CONTROL))
-            break;
-        if (unlikely(_gbt1 == GBT_L && (
-                _gbt2 == GBT_L || _gbt2 == GBT_V ||
-                _gbt2 == GBT_LV || _gbt2 == GBT_LVT))) {
-            len++;
-            continue;
-        }
-        if (unlikely((_gbt1 == GBT_LV || _gbt1 == GBT_V) && (
-                _gbt2 == GBT_V || _gbt2 == GBT_T))) {
-            len++;
-            continue;
-        }
-        if (unlikely((_gbt1 == GBT_LVT || _gbt1 == GBT_T) && (
-                _gbt2 == GBT_T))) {
-            len++;
-            continue;
-        }
-        if (unlikely(_gbt2 == GBT_EXTEND || _gbt2 == GBT_ZWJ)) {
-            len++;
-            continue;
-        }
-        if (unlikely(_gbt1 == GBT_PREPEND || _gbt2 == GBT_SPACINGMARK)) {
-            len++;
-            continue;
-        }
-        if (unlikely(cp1 >= 0x1F1E6LL &&
-                cp1 <= 0x1F1FFLL &&
-                cp2 >= 0x1F1E6LL &&
-                cp2 <= 0x1F1FFLL)) {  // A region pair!
-            uint64_t cp0 = (
-                len > 1 ? sdata[len - 2] : 0
-            );
-            uint64_t cpminus1 = (
-                len > 2 ? sdata[len - 2] : 0
-            );
-            if (likely(cp0 < 0x1F1E6LL || cp0 > 0x1F1FFLL ||
-                    (cpminus1 >= 0x1F1E6LL && cpminus1 <= 0x1F1FFLL))) {
-                // Can only continue after an uneven number of region pair
-                // items. (Since after one full pair we might want to break.)
-                len++;
-                continue;
-            }
-        }
-        break;
+        len++;
     }
     return len;
 }
 
+int utf32_letterstream_feed(
+        utf32letterstream *ls, h64wchar cp
+        ) {
+    if (ls->len > 0 && _utf32_letter_continues(
+            ls->cp0, ls->cp1, cp, ls->len)) {
+        ls->cp0 = ls->cp1;
+        ls->cp1 = cp;
+        ls->len++;
+        return 0;
+    }
+    ls->cp0 = 0;
+    ls->cp1 = cp;
+    ls->len = 1;
+    return 1;
+}
+
+int64_t utf32_letterstream_feedascii(
+        utf32letterstream *ls, const uint8_t *in, int64_t len,
+        h64wchar *out
+        ) {
+    if (ls->len <= 0 || ls->cp1 >= 0x80)
+        return 0;
+    int64_t run = utf8_ascii_run_to_utf32(in, len, out);
+    if (run > 0) {
+        ls->cp0 = 0;
+        ls->cp1 = out[run - 1];
+        ls->len = 1;
+    }
+    return run;
+}
+
 int write_codepoint_as_utf8(
         uint64_t codepoint, int surrogateunescape,
         int questionmarkescape,
@@ -574,8 +652,26 @@ h64wchar *utf8_to_utf32_ex(
     int free_temp_buf = 0;
     char *temp_buf = NULL;
     int64_t temp_buf_len = (input_len + 1) * sizeof(h64wchar);
-    if (temp_buf_len < 1024 * 2) {
+    // If the worst case size fits where the result goes anyway, then
+    // decode right into it to save the extra copy. (This is never the
+    // alloca() buffer, which can't be returned.)
+    char *inplace_buf = NULL;
+    if (short_out_buf && short_out_buf_bytes >= temp_buf_len) {
+        inplace_buf = short_out_buf;
+        temp_buf = inplace_buf;
+    } else if (temp_buf_len < 1024 * 2) {
         temp_buf = alloca(temp_buf_len);
+    } else if (!out_alloc) {
+        inplace_buf = malloc(temp_buf_len);
+        if (!inplace_buf) {
+            if (was_aborted_invalid)
+                *was_aborted_invalid = 0;
+            if (was_aborted_outofmemory)
+                *was_aborted_outofmemory = 1;
+            return NULL;
+        }
+        temp_buf = inplace_buf;
+        free_temp_buf = 1;
     } else {
         free_temp_buf = 1;
         temp_buf = malloc(temp_buf_len);
@@ -587,9 +683,19 @@ h64wchar *utf8_to_utf32_ex(
             return NULL;
         }
     }
-    int k = 0;
-    int i = 0;
+    int64_t k = 0;
+    int64_t i = 0;
     while (i < input_len) {
+        if (((const uint8_t *)input)[i] < 0x80) {
+            int64_t run = utf8_ascii_run_to_utf32(
+                (const uint8_t *)input + i, input_len - i,
+                (h64wchar *)temp_buf + k
+            );
+            assert(run > 0);
+            i += run;
+            k += run;
+            continue;
+        }
         h64wchar c;
         int cbytes = 0;
         if (!get_utf8_codepoint(
@@ -620,7 +726,21 @@ h64wchar *utf8_to_utf32_ex(
         memcpy((char*)temp_buf + k * sizeof(c), &c, sizeof(c));
         k++;
     }
-    temp_buf[k * sizeof(h64wchar)] = '\0';
+    memset(temp_buf + k * sizeof(h64wchar), 0, sizeof(h64wchar));
+    if (inplace_buf) {
+        if (free_temp_buf && (k + 1) < (input_len + 1) / 2) {
+            // Mostly multi-byte input, so don't keep all of it around:
+            char *shrunk = realloc(
+                inplace_buf, (k + 1) * sizeof(h64wchar)
+            );
+            if (shrunk)
+                inplace_buf = shrunk;
+        }
+        if (was_aborted_invalid) *was_aborted_invalid = 0;
+        if (was_aborted_outofmemory) *was_aborted_outofmemory = 0;
+        if (out_len) *out_len = k;
+        return (h64wchar*)inplace_buf;
+    }
     char *result = NULL;
     if (short_out_buf && (unsigned int)short_out_buf_bytes >=
             (k + 1) * sizeof(h64wchar)) {
@@ -662,6 +782,23 @@ int utf32_to_utf8(
     uint64_t totallen = 0;
     int64_t i = 0;
     while (i < input_len) {
+        if (*p < 0x80 && outbuflen > 1) {
+            // Leave room for the terminator, like for single chars:
+            int64_t maxrun = input_len - i;
+            if (maxrun > outbuflen - 1)
+                maxrun = outbuflen - 1;
+            int64_t run = utf32_ascii_run_to_utf8(
+                p, maxrun, (uint8_t *)outbuf
+            );
+            assert(run > 0);
+            p += run;
+            outbuflen -= run;
+            outbuf += run;
+            totallen += run;
+            i += run;
+            outbuf[0] = '\0';
+            continue;
+        }
         if (outbuflen < 1)
             return 0;
         int inneroutlen = 0;
@@ -902,12 +1039,10 @@ void utf32_tolower(h64wchar *s, int64_t slen) {
     int i = 0;
     while (i < slen) {
         uint64_t codepoint = s[i];
-        int64_t lowered = -1;
-        if ((int64_t)codepoint <= _widechartbl_highest_cp &&
-                (int64_t)codepoint >= _widechartbl_lowest_cp)
-            lowered = _widechartbl_lowercp[codepoint];
-        if (lowered >= 0)
-            s[i] = lowered;
+        if ((int64_t)codepoint <= _widechartbl_highest_cp)
+            s[i] = codepoint + _WIDECHARTBL_LOOKUP(
+                lowerdelta, codepoint
+            );
         i++;
     }
 }
@@ -916,12 +1051,10 @@ void utf32_toupper(h64wchar *s, int64_t slen) {
     int i = 0;
     while (i < slen) {
         uint64_t codepoint = s[i];
-        int64_t uppered = -1;
-        if ((int64_t)codepoint <= _widechartbl_highest_cp &&
-                (int64_t)codepoint >= _widechartbl_lowest_cp)
-            uppered = _widechartbl_uppercp[codepoint];
-        if (uppered >= 0)
-            s[i] = uppered;
+        if ((int64_t)codepoint <= _widechartbl_highest_cp)
+            s[i] = codepoint + _WIDECHARTBL_LOOKUP(
+                upperdelta, codepoint
+            );
         i++;
     }
 }
@@ -81,6 +81,29 @@ int64_t utf32_letters_count(
     h64wchar *sdata, int64_t sdata_len
 );
 
+typedef struct utf32letterstream {
+    h64wchar cp0, cp1;  // last two code points of the open letter
+    int64_t len;  // code points in the open letter, 0 before the start
+} utf32letterstream;
+
+int utf32_letterstream_feed(
+    utf32letterstream *ls, h64wchar cp
+);
+    // Letter segmentation for code points that arrive piece by piece,
+    // e.g. while decoding a file. Start with a zeroed utf32letterstream,
+    // then feed every code point in order. Returns 1 if the code point
+    // starts a new letter, which also means the letter before it (if
+    // any) is complete. This matches utf32_letter_len().
+
+int64_t utf32_letterstream_feedascii(
+    utf32letterstream *ls, const uint8_t *in, int64_t len,
+    h64wchar *out
+);
+    // Fast path for the above: if the last code point fed was ASCII,
+    // copies the leading run of ASCII bytes in over to out as code
+    // points and feeds them. Every one of them starts a new letter.
+    // Returns how many there were, which may be 0.
+
 int utf8_to_utf16(
     const uint8_t *input, int64_t input_len,
     uint16_t *outbuf, int64_t outbuflen,
@@ -94,6 +117,17 @@ int utf16_to_utf8(
     int64_t *out_len, int surrogateescape
 );
 
+int64_t utf8_ascii_run_to_utf32(
+    const uint8_t *in, int64_t len, h64wchar *out
+);
+    // Copies the leading run of ASCII bytes over as code points,
+    // and returns how many there were. (SIMD where available.)
+
+int64_t utf32_ascii_run_to_utf8(
+    const h64wchar *in, int64_t len, uint8_t *out
+);
+    // The reverse, for a leading run of code points below 0x80.
+
 void utf32_tolower(h64wchar *s, int64_t slen);
 
 void utf32_toupper(h64wchar *s, int64_t slen);
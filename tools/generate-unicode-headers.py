@@ -3,18 +3,31 @@
 
 
 import os
-import shutil
-import struct
 import sys
 import textwrap
 
-if os.path.exists(os.path.join(
-        os.path.abspath(os.path.dirname(__file__)),
-        "..", "vendor", "unicode", "unicode_data_header.h")
-        ):
-    print("Unicode(R) data header exists. Remove this file to regenerate:")
-    print("    vendor/unicode/unicode_data_header.h")
-    sys.exit(0)
+# Bump this whenever the layout of the generated header changes, so
+# that old headers lying around get regenerated:
+HEADER_FORMAT = "// unicode_data_header format: 2\n"
+
+# The tables are three-stage tries: the code point bits above SHIFT1
+# pick a stage 2 block, the bits between SHIFT1 and SHIFT2 an entry in
+# it, which picks a stage 3 block, and the lowest SHIFT2 bits the value.
+# Identical blocks are only stored once, which is what makes this small.
+SHIFT1 = 12
+SHIFT2 = 7
+
+header_path = os.path.join(
+    os.path.abspath(os.path.dirname(__file__)),
+    "..", "vendor", "unicode", "unicode_data_header.h")
+if os.path.exists(header_path):
+    with open(header_path, "r", encoding="utf-8") as f:
+        is_current = (HEADER_FORMAT in f.read())
+    if is_current:
+        print("Unicode(R) data header exists. "
+              "Remove this file to regenerate:")
+        print("    vendor/unicode/unicode_data_header.h")
+        sys.exit(0)
 
 print("Generating Unicode(R) data header...")
 
@@ -58,67 +71,6 @@ with open(os.path.join(
         if highest_cp_seen is None or codepoint > highest_cp_seen:
             highest_cp_seen = codepoint
 
-arraylen = (highest_cp_seen - smallest_cp_seen) + 1
-
-with open(os.path.join(
-        os.path.abspath(os.path.dirname(__file__)),
-            "..", "vendor", "unicode",
-            "unicode_data___widechartbl_ismodifier.dat"),
-        "wb") as f:
-    i = smallest_cp_seen
-    while i <= highest_cp_seen:
-        f.write(struct.pack(
-            "<B", 1 if i in chars and chars[i][2] else 0
-        ))
-        i += 1
-
-with open(os.path.join(
-        os.path.abspath(os.path.dirname(__file__)),
-            "..", "vendor", "unicode",
-            "unicode_data___widechartbl_iscombining.dat"),
-        "wb") as f:
-    i = smallest_cp_seen
-    while i <= highest_cp_seen:
-        f.write(struct.pack(
-            "<B", 1 if i in chars and chars[i][6] else 0
-        ))
-        i += 1
-
-with open(os.path.join(
-        os.path.abspath(os.path.dirname(__file__)),
-        "..", "vendor", "unicode", "unicode_data___widechartbl_istag.dat"),
-        "wb") as f:
-    i = smallest_cp_seen
-    while i <= highest_cp_seen:
-        f.write(struct.pack(
-            "<B", 1 if i in chars and chars[i][3] else 0
-        ))
-        i += 1
-
-with open(os.path.join(
-        os.path.abspath(os.path.dirname(__file__)),
-        "..", "vendor", "unicode", "unicode_data___widechartbl_lowercp.dat"),
-        "wb") as f:
-    i = smallest_cp_seen
-    while i <= highest_cp_seen:
-        if i in chars:
-            f.write(struct.pack("<q", chars[i][4]))
-        else:
-            f.write(struct.pack("<q", -1))
-        i += 1
-
-with open(os.path.join(
-        os.path.abspath(os.path.dirname(__file__)),
-        "..", "vendor", "unicode", "unicode_data___widechartbl_uppercp.dat"),
-        "wb") as f:
-    i = smallest_cp_seen
-    while i <= highest_cp_seen:
-        if i in chars:
-            f.write(struct.pack("<q", chars[i][5]))
-        else:
-            f.write(struct.pack("<q", -1))
-        i += 1
-
 graphemebreak_property_values = list()
 graphemebreak_property_ranges = dict()
 
@@ -154,54 +106,116 @@ with open(os.path.join(
             )
         i = range_start
         while i <= range_end:
-            idx = graphemebreak_property_values.index(breaktype)
-            assert(idx >= 0)
-            graphemebreak_property_ranges[i] = (idx + 1)
+            # Store the name, since the index into the sorted
+            # graphemebreak_property_values can still change:
+            graphemebreak_property_ranges[i] = breaktype
             i += 1
 
-with open(os.path.join(
-        os.path.abspath(os.path.dirname(__file__)),
-        "..", "vendor", "unicode",
-        "unicode_data___widechartbl_graphemebreaktype.dat"),
-        "wb") as f:
-    print("Analysing grapheme break ranges, this may take a while...")
-    i = smallest_cp_seen
-    while i <= highest_cp_seen:
-        gbt = 0
-        if i in graphemebreak_property_ranges:
-            gbt = graphemebreak_property_ranges[i]
-            assert(gbt > 0)
-        f.write(struct.pack(
-            "<B", gbt
-        ))
-        i += 1
 
-with open(os.path.join(
-        os.path.abspath(os.path.dirname(__file__)),
-        "..", "vendor", "unicode", "unicode_data_header.h"),
-        "w", encoding="utf-8") as f:
+def c_type_for(values):
+    # Returns the smallest fitting C type, and its size in bytes:
+    lowest = min(values)
+    highest = max(values)
+    for bits in (8, 16, 32):
+        if lowest >= 0 and highest < (1 << bits):
+            return ("uint" + str(bits) + "_t", bits // 8)
+        if lowest >= -(1 << (bits - 1)) and highest < (1 << (bits - 1)):
+            return ("int" + str(bits) + "_t", bits // 8)
+    raise ValueError("table value out of range")
+
+
+def dedup_blocks(values, block_size):
+    blocks = list()
+    block_index = dict()
+    refs = list()
+    i = 0
+    while i < len(values):
+        block = tuple(values[i:i + block_size])
+        if block not in block_index:
+            block_index[block] = len(blocks)
+            blocks.append(block)
+        refs.append(block_index[block])
+        i += block_size
+    return [v for block in blocks for v in block], refs
+
+
+def build_trie(value_func):
+    total = ((highest_cp_seen >> SHIFT1) + 1) << SHIFT1
+    values = [value_func(cp) for cp in range(total)]
+    stage3, stage2_refs = dedup_blocks(values, 1 << SHIFT2)
+    stage2, stage1 = dedup_blocks(stage2_refs, 1 << (SHIFT1 - SHIFT2))
+    return (stage1, stage2, stage3)
+
+
+def write_c_array(f, name, values):
+    f.write("static const " + c_type_for(values)[0] + " " + name +
+            "[" + str(len(values)) + "] = {\n")
+    f.write(textwrap.fill(
+        ", ".join(str(v) for v in values) + ",",
+        width=79, initial_indent="    ", subsequent_indent="    "))
+    f.write("\n};\n")
+
+
+def write_trie(f, name, trie):
+    total_size = 0
+    stage_no = 1
+    for stage in trie:
+        write_c_array(f, "_widechartbl_" + name + "_stage" +
+                      str(stage_no), stage)
+        total_size += len(stage) * c_type_for(stage)[1]
+        stage_no += 1
+    print("Table " + name + ": " + str(total_size) + " bytes.")
+
+
+def props_value(cp):
+    # Grapheme break type in the lower bits, and then some flags:
+    gbt = 0
+    if cp in graphemebreak_property_ranges:
+        gbt = graphemebreak_property_values.index(
+            graphemebreak_property_ranges[cp]) + 1
+    assert(gbt < 32)
+    if cp in chars:
+        if chars[cp][2]:
+            gbt |= 0x20
+        if chars[cp][6]:
+            gbt |= 0x40
+        if chars[cp][3]:
+            gbt |= 0x80
+    return gbt
+
+
+def case_delta(cp, idx):
+    # Stored as the distance to the mapped code point, since that is
+    # the same for whole runs of letters and so deduplicates well:
+    if cp not in chars or chars[cp][idx] < 0:
+        return 0
+    return chars[cp][idx] - cp
+
+
+print("Building tables, this may take a while...")
+props_trie = build_trie(props_value)
+lower_trie = build_trie(lambda cp: case_delta(cp, 4))
+upper_trie = build_trie(lambda cp: case_delta(cp, 5))
+
+with open(header_path, "w", encoding="utf-8") as f:
     print("Writing final unicode_data_header.h...")
     f.write(textwrap.dedent("""\
     // UnicodeData.txt-based header as generated for core.horse64.org.
     // Original data still belongs to Unicode(R) Consortium, see accompanied
     // license files. This just transforms it for easier use by
     // horsec/horsevm.
-
-    #include <stdint.h>
-
     """))
-    f.write("static int64_t _widechartbl_lowest_cp = " +
-            str(smallest_cp_seen) + "LL;\n\n")
-    f.write("static int64_t _widechartbl_highest_cp = " +
-            str(highest_cp_seen) + "LL;\n\n")
-    f.write("static int64_t _widechartbl_arraylen = " +
-            str((highest_cp_seen - smallest_cp_seen) + 1) + ";\n")
-    f.write("extern uint8_t *_widechartbl_ismodifier;\n")
-    f.write("extern uint8_t *_widechartbl_istag;\n")
-    f.write("extern int64_t *_widechartbl_lowercp;\n")
-    f.write("extern int64_t *_widechartbl_uppercp;\n")
-    f.write("extern uint8_t *_widechartbl_iscombining;\n")
-    f.write("extern uint8_t *_widechartbl_graphemebreaktype;\n")
+    f.write(HEADER_FORMAT)
+    f.write("\n#include <stdint.h>\n\n")
+    f.write("static const int64_t _widechartbl_highest_cp = " +
+            str(((highest_cp_seen >> SHIFT1) + 1 << SHIFT1) - 1) +
+            "LL;\n\n")
+    f.write("#define _WIDECHARTBL_SHIFT1 " + str(SHIFT1) + "\n")
+    f.write("#define _WIDECHARTBL_SHIFT2 " + str(SHIFT2) + "\n\n")
+    f.write("#define _WIDECHARTBL_GBT_MASK 0x1F\n")
+    f.write("#define _WIDECHARTBL_FLAG_MODIFIER 0x20\n")
+    f.write("#define _WIDECHARTBL_FLAG_COMBINING 0x40\n")
+    f.write("#define _WIDECHARTBL_FLAG_TAG 0x80\n")
     f.write("\nenum _widechargraphbreaktype {\n")
     f.write("    GBT_NONE = 0,\n")
     n = 1
@@ -210,20 +224,11 @@ with open(os.path.join(
                 " = " + str(n) + ",\n")
         n += 1
     f.write("    GBT_TOTAL_TYPES = " + str(n) + "\n")
-    f.write("};\n")
-
-for fname in os.listdir(os.path.join(
-        os.path.abspath(os.path.dirname(__file__)),
-        "..", "vendor", "unicode")):
-    if fname.startswith("unicode_data__") and fname.endswith(".dat"):
-        src_path = os.path.join(
-            os.path.abspath(os.path.dirname(__file__)),
-            "..", "vendor", "unicode", fname)
-        dest_path = os.path.join(
-            os.path.abspath(os.path.dirname(__file__)),
-            "..", "horse_modules_builtin", fname)
-        if os.path.exists(dest_path):
-            os.remove(dest_path)
-        shutil.copyfile(src_path, dest_path)
+    f.write("};\n\n")
+    write_trie(f, "props", props_trie)
+    f.write("\n")
+    write_trie(f, "lowerdelta", lower_trie)
+    f.write("\n")
+    write_trie(f, "upperdelta", upper_trie)
 
 print("Generated.")
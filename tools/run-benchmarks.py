@@ -0,0 +1,163 @@
+#!/usr/bin/python3
+
+# Runs the benchmarks in ./benchmarks/ and compares them against the
+# stored baseline in ./benchmarks/baseline.json. This is what
+# "make bench" calls. The baseline is specific to the machine it was
+# saved on, so it is not checked in (see .gitignore). Usage:
+#
+#     python3 tools/run-benchmarks.py [--save-baseline] [--filter=text]
+#
+# The C micro benchmarks (./benchmarks/bench_*.bin) print their own
+# "name: X ns/op, Y allocs/op (N iterations)" lines. The .h64 macro
+# benchmarks in ./benchmarks/h64/ are run with "./horsec run", and
+# their median wall clock time is reported.
+
+import json
+import os
+import re
+import subprocess
+import sys
+import time
+
+BASELINE_PATH = os.path.join("benchmarks", "baseline.json")
+SCRIPT_REPEAT = 5
+REGRESSION_THRESHOLD = 0.10  # warn about anything 10% slower
+
+RESULT_LINE = re.compile(
+    r"^([A-Za-z0-9_]+): ([0-9.]+) ns/op, ([0-9.]+) allocs/op"
+)
+
+
+def horsec_path():
+    if os.path.exists("horsec.exe") and not os.path.exists("horsec"):
+        return os.path.abspath("horsec.exe")
+    return os.path.abspath("horsec")
+
+
+def run_micro_benchmarks(name_filter):
+    results = {}
+    for f in sorted(os.listdir("benchmarks")):
+        if not f.startswith("bench_") or not f.endswith(".bin"):
+            continue
+        args = [os.path.join(".", "benchmarks", f)]
+        if name_filter:
+            args.append(name_filter)
+        try:
+            output = subprocess.check_output(args)
+        except subprocess.CalledProcessError as e:
+            print("run-benchmarks.py: error: " + f +
+                  " failed with exit code " + str(e.returncode),
+                  file=sys.stderr)
+            sys.exit(1)
+        for line in output.decode("utf-8", "replace").splitlines():
+            m = RESULT_LINE.match(line.strip())
+            if not m:
+                continue
+            results[m.group(1)] = {
+                "ns/op": float(m.group(2)),
+                "allocs/op": float(m.group(3)),
+            }
+            print(line.strip())
+            sys.stdout.flush()
+    return results
+
+
+def run_script_benchmarks(name_filter):
+    results = {}
+    folder = os.path.join("benchmarks", "h64")
+    for f in sorted(os.listdir(folder)):
+        if not f.endswith(".h64"):
+            continue
+        name = "h64_" + f[:-len(".h64")]
+        if name_filter and name_filter not in name:
+            continue
+        durations = []
+        for i in range(SCRIPT_REPEAT):
+            start = time.monotonic()
+            exitcode = subprocess.call(
+                [horsec_path(), "run", os.path.join(folder, f)],
+                stdout=subprocess.DEVNULL
+            )
+            durations.append(time.monotonic() - start)
+            if exitcode != 0:
+                print("run-benchmarks.py: error: " + f +
+                      " failed with exit code " + str(exitcode),
+                      file=sys.stderr)
+                sys.exit(1)
+        durations.sort()
+        ms = durations[len(durations) // 2] * 1000.0
+        results[name] = {"ms": ms}
+        print("{}: {:.1f} ms".format(name, ms))
+        sys.stdout.flush()
+    return results
+
+
+def compare_to_baseline(results, baseline):
+    regressions = 0
+    print("")
+    print("Compared to baseline:")
+    for name in sorted(results.keys()):
+        if name not in baseline:
+            print("  {}: new, no baseline".format(name))
+            continue
+        line = "  {}:".format(name)
+        for key in sorted(results[name].keys()):
+            old = baseline[name].get(key)
+            new = results[name][key]
+            if old is None:
+                continue
+            if old == 0:
+                change = (0.0 if new == 0 else float("inf"))
+            else:
+                change = (new - old) / old
+            line += " {} {:+.1f}%".format(key, change * 100.0)
+            if change > REGRESSION_THRESHOLD:
+                line += " (REGRESSION)"
+                regressions += 1
+        print(line)
+    return regressions
+
+
+def main():
+    save_baseline = False
+    name_filter = None
+    for arg in sys.argv[1:]:
+        if arg == "--save-baseline":
+            save_baseline = True
+        elif arg.startswith("--filter="):
+            name_filter = arg[len("--filter="):]
+        else:
+            print("run-benchmarks.py: error: unknown argument: " + arg,
+                  file=sys.stderr)
+            sys.exit(1)
+
+    results = run_micro_benchmarks(name_filter)
+    results.update(run_script_benchmarks(name_filter))
+
+    baseline = {}
+    if os.path.exists(BASELINE_PATH):
+        with open(BASELINE_PATH, "r", encoding="utf-8") as f:
+            baseline = json.load(f)
+    if save_baseline:
+        # Keep entries that were filtered out this time:
+        baseline.update(results)
+        with open(BASELINE_PATH, "w", encoding="utf-8") as f:
+            json.dump(baseline, f, indent=4, sort_keys=True)
+            f.write("\n")
+        print("run-benchmarks.py: info: baseline written to " +
+              BASELINE_PATH, file=sys.stderr)
+        return
+    if not baseline:
+        print("run-benchmarks.py: info: no baseline found, use "
+              "--save-baseline to store one", file=sys.stderr)
+        return
+    regressions = compare_to_baseline(results, baseline)
+    if regressions > 0:
+        print("run-benchmarks.py: warning: {} result(s) more than "
+              "{:.0f}% worse than baseline".format(
+                  regressions, REGRESSION_THRESHOLD * 100.0),
+              file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()